@@ -107,6 +107,92 @@ void stfio::importABFFile(const std::string &fName, Recording &ReturnData, Progr
 }
 
 
+// Builds sections that keep the samples of an ABF2 file memory-mapped.
+// Returns false if the file layout doesn't allow mapping; the file should
+// then be read as usual.
+static bool mapABF2Sections(int hFile, const ABF2FileHeader* pFH, const std::string& fName,
+                            bool gapfree, ABFLONG numberSections,
+                            std::vector<Channel>& TempChannels,
+                            std::vector<Section>& TempSectionsGrand,
+                            std::size_t& nSection)
+{
+    int numberChannels = pFH->nADCNumChannels;
+    bool integerData = (pFH->nDataFormat == ABF_INTEGERDATA);
+    std::size_t sampleSize = integerData ? sizeof(short) : sizeof(float);
+    std::size_t stride = sampleSize * numberChannels;
+
+    // ABF files are little-endian:
+    const short one = 1;
+    bool swap = (*(const char*)&one == 0);
+
+    std::vector<float> fFactors(numberChannels, 1.0f), fShifts(numberChannels, 0.0f);
+    if (integerData) {
+        for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+            ABF2H_GetADCtoUUFactors(pFH, pFH->nADCSamplingSeq[nChannel],
+                                    &fFactors[nChannel], &fShifts[nChannel]);
+        }
+    }
+
+    std::vector<LONGLONG> offsets(numberSections);
+    std::vector<UINT> lengths(numberSections);
+    for (int nEpisode=1; nEpisode<=numberSections; ++nEpisode) {
+        int nError = 0;
+        if (!ABF2_GetEpisodeLocation(hFile, pFH, nEpisode, &offsets[nEpisode-1],
+                                     &lengths[nEpisode-1], &nError))
+        {
+            return false;
+        }
+        // A gapfree section can only be mapped if all chunks are contiguous:
+        if (gapfree && nEpisode > 1 &&
+            offsets[nEpisode-1] != offsets[nEpisode-2] + (LONGLONG)(lengths[nEpisode-2] * sampleSize))
+        {
+            return false;
+        }
+    }
+
+    stfio::MappedFilePtr file(new stfio::MappedFile(fName));
+    stfio::sample_type type = integerData ? stfio::sample_int16 : stfio::sample_float32;
+
+    if (gapfree) {
+        std::size_t total = 0;
+        for (ABFLONG n=0; n<numberSections; ++n) {
+            total += lengths[n];
+        }
+        std::ostringstream label;
+        label
+            << fName
+            << ", gapfree section";
+        TempSectionsGrand.clear();
+        for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+            stfio::RawSamples raw(file, (std::size_t)offsets[0] + nChannel*sampleSize, stride,
+                                  total / numberChannels, type, swap,
+                                  fFactors[nChannel], fShifts[nChannel]);
+            TempSectionsGrand.push_back(Section(raw, label.str()));
+        }
+        return true;
+    }
+
+    nSection = 0;
+    for (int nEpisode=1; nEpisode<=numberSections; ++nEpisode) {
+        std::size_t uNumSamples = lengths[nEpisode-1] / numberChannels;
+        if (uNumSamples == 0) {
+            continue;
+        }
+        std::ostringstream label;
+        label
+            << fName
+            << ", Section # " << nEpisode;
+        for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+            stfio::RawSamples raw(file, (std::size_t)offsets[nEpisode-1] + nChannel*sampleSize,
+                                  stride, uNumSamples, type, swap,
+                                  fFactors[nChannel], fShifts[nChannel]);
+            TempChannels[nChannel].InsertSection(Section(raw, label.str()), nSection);
+        }
+        nSection++;
+    }
+    return true;
+}
+
 void stfio::importABF2File(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
 
     CABF2ProtocolReader abf2;
@@ -155,8 +241,26 @@ void stfio::importABF2File(const std::string &fName, Recording &ReturnData, Prog
     ABFLONG finalSections = numberSections;
     int hFile = abf2.GetFileNumber();
     bool gapfree = (pFH->nOperationMode == ABF2_GAPFREEFILE);
+    ABFLONG grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
     if (gapfree) {
-        UINT uMaxSamples = pFH->lNumSamplesPerEpisode / numberChannels;
+        grandsize = pFH->lActualAcqLength / numberChannels;
+        Vector_double test_size(0);
+        ABFLONG maxsize = test_size.max_size()
+#if defined(_MSC_VER)
+            // doesn't seem to return the correct size on Windows.
+            ;
+#else
+            ;
+#endif
+        // Gapfree data are read in chunks that are as large as possible,
+        // so that the file is traversed with a few long sequential reads:
+        UINT uMaxSamples = PCLAMP7_MAXSWEEPLEN_PERCHAN;
+        if (grandsize <= 0 || grandsize >= maxsize) {
+            progDlg.Update(0, "Gapfree file is too large for a single section." \
+                           "It will be segmented.\nFile opening may be very slow.");
+            gapfree = false;
+            uMaxSamples = pFH->lNumSamplesPerEpisode / numberChannels;
+        }
         DWORD dwMaxEpi;
         if (!ABF2_SetChunkSize(hFile,abf2.GetFileHeaderW(),&uMaxSamples,&dwMaxEpi,&nError)) {
             std::ostringstream errorMsg;
@@ -165,143 +269,142 @@ void stfio::importABF2File(const std::string &fName, Recording &ReturnData, Prog
             ABF_Close(hFile,&nError);
             throw std::runtime_error(errorMsg.str());
         }
-        finalSections = 1;
+        numberSections = dwMaxEpi;
+        if (gapfree) {
+            finalSections = 1;
+        } else {
+            grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
+            finalSections = numberSections;
+        }
     }
-    for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
-        int progbar = (int)(((double)nChannel/(double)numberChannels)*100.0);
-        progDlg.Update(progbar, "Memory allocation");
-        ABFLONG grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
+
+    progDlg.Update(0, "Memory allocation");
+    std::vector<Channel> TempChannels(numberChannels, Channel(finalSections));
+    std::vector<Section> TempSectionsGrand;
+    std::size_t nSection = 0;
+
+    // Large files keep their samples in a memory mapping instead of being read:
+    bool mapped = false;
+    if (UseMapping(fName)) {
+        progDlg.Update(0, "Mapping file");
+        try {
+            mapped = mapABF2Sections(hFile, pFH, fName, gapfree, numberSections,
+                                     TempChannels, TempSectionsGrand, nSection);
+        }
+        catch (const std::exception&) {
+            mapped = false;
+        }
+        if (!mapped) {
+            TempChannels.assign(numberChannels, Channel(finalSections));
+            TempSectionsGrand.clear();
+            nSection = 0;
+        }
+    }
+
+    if (gapfree && !mapped) {
         std::ostringstream label;
-        label  
-               << fName
-               << ", gapfree section";
-        if (gapfree) {
-            grandsize = pFH->lActualAcqLength / numberChannels;
-            Vector_double test_size(0);
-            ABFLONG maxsize = test_size.max_size()
-#if defined(_MSC_VER)
-                // doesn't seem to return the correct size on Windows.
-                ;
-#else
-                ;
-#endif
-            
-            if (grandsize <= 0 || grandsize >= maxsize) {
-                    
-                progDlg.Update(progbar, "Gapfree file is too large for a single section." \
-                               "It will be segmented.\nFile opening may be very slow.");
-                
-                gapfree=false;
-                grandsize = pFH->lNumSamplesPerEpisode / numberChannels;
-                finalSections=numberSections;
+        label
+            << fName
+            << ", gapfree section";
+        TempSectionsGrand.assign(numberChannels, Section(grandsize, label.str()));
+    }
+
+    // Each multiplexed episode is read and decoded once for all channels:
+    std::vector<Vector_float> TempSections(numberChannels);
+    double bytesPerSample = (pFH->nDataFormat == ABF_INTEGERDATA) ? sizeof(short) : sizeof(float);
+    double bytesTotal = (double)pFH->lActualAcqLength * bytesPerSample;
+    double bytesRead = 0;
+    ABFLONG gapfreePos = 0;
+    for (int nEpisode=1; !mapped && nEpisode<=numberSections;++nEpisode) {
+        int progbar = (bytesTotal > 0) ? (int)(bytesRead/bytesTotal*100.0) : 0;
+        std::ostringstream progStr;
+        progStr << "Reading section #" << nEpisode << " of " << numberSections
+                << " (" << (int)(bytesRead/1048576.0) << " of "
+                << (int)(bytesTotal/1048576.0) << " MB)";
+        progDlg.Update(progbar, progStr.str());
+
+        UINT uNumSamples = 0;
+        if (!gapfree) {
+            if (!ABF2_GetNumSamples(hFile, pFH, nEpisode, &uNumSamples, &nError)) {
+                std::ostringstream errorMsg;
+                errorMsg << "Exception while calling ABF2_GetNumSamples() "
+                         << "for episode # "
+                         << nEpisode << "\n"
+                         << ABF1Error(fName, nError);
+                ReturnData.resize(0);
+                ABF_Close(hFile,&nError);
+                throw std::runtime_error(errorMsg.str());
+            }
+            if (uNumSamples == 0) {
+                continue;
             }
         }
-        Channel TempChannel(finalSections, grandsize);
-        Section TempSectionGrand(grandsize, label.str());
-        for (int nEpisode=1; nEpisode<=numberSections;++nEpisode) {
-            int progbar =
-                // Channel contribution:
-                (int)(((double)nChannel/(double)numberChannels)*100.0+
-                      // Section contribution:
-                      (double)(nEpisode-1)/(double)numberSections*(100.0/numberChannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << nChannel + 1 << " of " << numberChannels
-                    << ", Section #" << nEpisode << " of " << numberSections;
-            progDlg.Update(progbar, progStr.str());
-            
-            UINT uNumSamples = 0;
-            if (gapfree) {
-                if (nEpisode == numberSections) {
-                    uNumSamples = grandsize - (nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels;
-#ifdef _STFDEBUG
-                    std::cout << "Last section size " << uNumSamples << std::endl;
-#endif
-                } else {
-                    uNumSamples = pFH->lNumSamplesPerEpisode / numberChannels;
+        unsigned int uNumSamplesW = 0;
+        if (!ABF2_ReadAllChannels(hFile, pFH, nEpisode, TempSections, &uNumSamplesW, &nError)) {
+            std::string errorMsg("Exception while calling ABF2_ReadAllChannels():\n");
+            errorMsg += ABF1Error(fName, nError);
+            ReturnData.resize(0);
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error(errorMsg);
+        }
+        if (uNumSamples!=uNumSamplesW && !gapfree) {
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error("Exception while calling ABF2_ReadAllChannels()");
+        }
+        bytesRead += (double)uNumSamplesW * numberChannels * bytesPerSample;
+
+        if (!gapfree) {
+            std::ostringstream label;
+            label
+                << fName
+                << ", Section # " << nEpisode;
+            for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+                // convert into the vector that becomes the section's storage:
+                Vector_double TempSectionT(TempSections[nChannel].begin(),TempSections[nChannel].end());
+                try {
+                    TempChannels[nChannel].InsertSection(Section(std::move(TempSectionT),label.str()),nSection);
                 }
-            } else {
-                if (!ABF2_GetNumSamples(hFile, pFH, nEpisode, &uNumSamples, &nError)) {
-                    std::ostringstream errorMsg;
-                    errorMsg << "Exception while calling ABF2_GetNumSamples() "
-                             << "for episode # "
-                             << nEpisode << "\n"
-                             << ABF1Error(fName, nError);
-                    ReturnData.resize(0);
+                catch (...) {
                     ABF_Close(hFile,&nError);
-                    throw std::runtime_error(errorMsg.str());
+                    throw;
                 }
             }
-            // Use a vector here because memory allocation can
-            // be controlled more easily:
-            // request memory:
-            if (uNumSamples > 0) {
-                Vector_float TempSection(uNumSamples, 0.0);
-                unsigned int uNumSamplesW;
-                if (!ABF2_ReadChannel(hFile, pFH, pFH->nADCSamplingSeq[nChannel],nEpisode,TempSection,
-                                      &uNumSamplesW,&nError))
-                {
-                    std::string errorMsg("Exception while calling ABF2_ReadChannel():\n");
-                    errorMsg += ABF1Error(fName, nError);
-                    ReturnData.resize(0);
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error(errorMsg);
+            nSection++;
+        } else {
+            if (gapfreePos + (ABFLONG)uNumSamplesW <= grandsize) {
+                for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
+                    std::copy(TempSections[nChannel].begin(),TempSections[nChannel].end(),
+                              &TempSectionsGrand[nChannel][gapfreePos]);
                 }
-                if (uNumSamples!=uNumSamplesW && !gapfree) {
-                    ABF_Close(hFile,&nError);
-                    throw std::runtime_error("Exception while calling ABF2_ReadChannel()");
-                }
-                if (!gapfree) {
-                    std::ostringstream label;
-                    label
-                        << fName
-                        << ", Section # " << nEpisode;
-                    Section TempSectionT(TempSection.size(),label.str());
-                    std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
-                    try {
-                        TempChannel.InsertSection(TempSectionT,nEpisode-1);
-                    }
-                    catch (...) {
-                        ABF_Close(hFile,&nError);
-                        throw;
-                    }
-                } else {
-                    if ((nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels + TempSection.size() <= TempSectionGrand.size()) {
-                        std::copy(TempSection.begin(),TempSection.end(),
-                                  &TempSectionGrand[(nEpisode-1) * pFH->lNumSamplesPerEpisode / numberChannels]);
-                    }
-    #ifdef _STFDEBUG
-                    else {
-                        std::cout << "Overflow while copying gapfree sections" << std::endl;
-                    }
-    #endif
-                }
-            } else {
-                TempChannel.resize(TempChannel.size()-1);
             }
-        }
-        if (gapfree) {
-            try {
-                TempChannel.InsertSection(TempSectionGrand,0);
-            }
-            catch (...) {
-                ABF_Close(hFile,&nError);
-                throw;
+#ifdef _STFDEBUG
+            else {
+                std::cout << "Overflow while copying gapfree sections" << std::endl;
             }
+#endif
+            gapfreePos += uNumSamplesW;
         }
+    }
+
+    progDlg.Update(100, "Completing channel reading\n");
+    if ((int)ReturnData.size()<numberChannels) {
+        ReturnData.resize(numberChannels);
+    }
+    for (int nChannel=0; nChannel < numberChannels; ++nChannel) {
         try {
-            if ((int)ReturnData.size()<numberChannels) {
-                ReturnData.resize(numberChannels);
+            if (gapfree) {
+                TempChannels[nChannel].InsertSection(std::move(TempSectionsGrand[nChannel]),0);
+            } else {
+                // empty episodes have been skipped:
+                TempChannels[nChannel].resize(nSection);
             }
-            ReturnData.InsertChannel(TempChannel,nChannel);
+            ReturnData.InsertChannel(std::move(TempChannels[nChannel]),nChannel);
         }
         catch (...) {
             ReturnData.resize(0);
             ABF_Close(hFile,&nError);
             throw;
         }
-        
-        progbar = (int)(((double)(nChannel+1)/(double)numberChannels)*100.0);
-        progDlg.Update(progbar, "Completing channel reading\n");
 
         std::string channel_name( pFH->sADCChannelName[pFH->nADCSamplingSeq[nChannel]] );
         if (channel_name.find("  ")<channel_name.size()) {
@@ -387,63 +490,69 @@ void stfio::importABF1File(const std::string &fName, Recording &ReturnData, Prog
         throw std::runtime_error("Error while calling stfio::importABFFile():\n"
             "lActualEpisodes>dwMaxEpi");
     }
-    for (int nChannel=0;nChannel<numberChannels;++nChannel) {
-        Channel TempChannel(numberSections);
-        for (DWORD dwEpisode=1;dwEpisode<=(DWORD)numberSections;++dwEpisode) {
-            int progbar = // Channel contribution:
-                (int)(((double)nChannel/(double)numberChannels)*100.0+
-                      // Section contribution:
-                      (double)(dwEpisode-1)/(double)numberSections*(100.0/numberChannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << nChannel + 1 << " of " << numberChannels
-                    << ", Section #" << dwEpisode << " of " << numberSections;
-            progDlg.Update(progbar, progStr.str());
-            
-            unsigned int uNumSamples=0;
-            if (!ABF_GetNumSamples(hFile,&FH,dwEpisode,&uNumSamples,&nError)) {
-                std::string errorMsg( "Exception while calling ABF_GetNumSamples():\n" );
-                errorMsg += ABF1Error(fName, nError);
-                ReturnData.resize(0);
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error(errorMsg);
-            }
-            // Use a vector here because memory allocation can
-            // be controlled more easily:
-            // request memory:
-            Vector_float TempSection(uNumSamples, 0.0);
-            unsigned int uNumSamplesW=0;
-            if (!ABF_ReadChannel(hFile, &FH, FH.nADCSamplingSeq[nChannel], dwEpisode, TempSection,
-                                 &uNumSamplesW, &nError))
-            {
-                std::string errorMsg("Exception while calling ABF_ReadChannel():\n");
-                errorMsg += ABF1Error(fName, nError);
-                ReturnData.resize(0);
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error(errorMsg);
-            }
-            if (uNumSamples!=uNumSamplesW) {
-                ABF_Close(hFile,&nError);
-                throw std::runtime_error("Exception while calling ABF_ReadChannel()");
-            }
-            std::ostringstream label;
-            label
-                << fName
-                << ", Section # " << dwEpisode;
-            Section TempSectionT(TempSection.size(),label.str());
-            std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
+    progDlg.Update(0, "Memory allocation");
+    std::vector<Channel> TempChannels(numberChannels, Channel(numberSections));
+
+    // Each multiplexed episode is read and decoded once for all channels:
+    std::vector<Vector_float> TempSections(numberChannels);
+    double bytesPerSample = (FH.nDataFormat == ABF_INTEGERDATA) ? sizeof(short) : sizeof(float);
+    double bytesTotal = (double)FH.lActualAcqLength * bytesPerSample;
+    double bytesRead = 0;
+    for (DWORD dwEpisode=1;dwEpisode<=(DWORD)numberSections;++dwEpisode) {
+        int progbar = (bytesTotal > 0) ? (int)(bytesRead/bytesTotal*100.0) : 0;
+        std::ostringstream progStr;
+        progStr << "Reading section #" << dwEpisode << " of " << numberSections
+                << " (" << (int)(bytesRead/1048576.0) << " of "
+                << (int)(bytesTotal/1048576.0) << " MB)";
+        progDlg.Update(progbar, progStr.str());
+
+        unsigned int uNumSamples=0;
+        if (!ABF_GetNumSamples(hFile,&FH,dwEpisode,&uNumSamples,&nError)) {
+            std::string errorMsg( "Exception while calling ABF_GetNumSamples():\n" );
+            errorMsg += ABF1Error(fName, nError);
+            ReturnData.resize(0);
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error(errorMsg);
+        }
+        unsigned int uNumSamplesW=0;
+        if (!ABF_ReadAllChannels(hFile, &FH, dwEpisode, TempSections, &uNumSamplesW, &nError))
+        {
+            std::string errorMsg("Exception while calling ABF_ReadAllChannels():\n");
+            errorMsg += ABF1Error(fName, nError);
+            ReturnData.resize(0);
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error(errorMsg);
+        }
+        if (uNumSamples!=uNumSamplesW) {
+            ABF_Close(hFile,&nError);
+            throw std::runtime_error("Exception while calling ABF_ReadAllChannels()");
+        }
+        bytesRead += (double)uNumSamplesW * numberChannels * bytesPerSample;
+
+        std::ostringstream label;
+        label
+            << fName
+            << ", Section # " << dwEpisode;
+        for (int nChannel=0;nChannel<numberChannels;++nChannel) {
+            // convert into the vector that becomes the section's storage:
+            Vector_double TempSectionT(TempSections[nChannel].begin(),TempSections[nChannel].end());
             try {
-                TempChannel.InsertSection(TempSectionT,dwEpisode-1);
+                TempChannels[nChannel].InsertSection(Section(std::move(TempSectionT),label.str()),dwEpisode-1);
             }
             catch (...) {
                 ABF_Close(hFile,&nError);
                 throw;
             }
         }
+    }
+
+    progDlg.Update(100, "Completing channel reading\n");
+    if ((int)ReturnData.size()<numberChannels) {
+        ReturnData.resize(numberChannels);
+    }
+    for (int nChannel=0;nChannel<numberChannels;++nChannel) {
         try {
-            if ((int)ReturnData.size()<numberChannels) {
-                ReturnData.resize(numberChannels);
-            }
-            ReturnData.InsertChannel(TempChannel,nChannel);
+            ReturnData.InsertChannel(std::move(TempChannels[nChannel]),nChannel);
         }
         catch (...) {
             ReturnData.resize(0);
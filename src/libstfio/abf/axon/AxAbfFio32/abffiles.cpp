@@ -21,6 +21,10 @@
 #include "./../Common/ArrayPtr.hpp"   // Smart array pointer template class.
 #include "./../Common/FileReadCache.hpp"
 
+#if (__cplusplus >= 201103)
+#include <mutex>
+#endif
+
 //
 // Set the maximum number of files that can be open simultaneously.
 // This can be overridden from the compiler command line.
@@ -44,6 +48,11 @@
 */
 static CFileDescriptor *g_FileData[ABF_MAXFILES];
 
+#if (__cplusplus >= 201103)
+// Protects the slots of g_FileData so that several files can be read at the same time.
+static std::mutex g_FileDataMutex;
+#endif
+
 HINSTANCE g_hInstance = NULL;
 
 //===============================================================================================
@@ -78,15 +87,6 @@ BOOL GetNewFileDescriptor(CFileDescriptor **ppFI, int *pnFile, int *pnError)
     //   WPTRASSERT(pnFile);
     int nFile;
    
-    // Find an empty slot.
-    for (nFile=0; nFile < ABF_MAXFILES; nFile++)
-        if (g_FileData[nFile] == NULL)
-            break;
-   
-    // Return an error if no space left.   
-    if (nFile == ABF_MAXFILES)
-        return ErrorReturn(pnError, ABF_TOOMANYFILESOPEN);
-
     // Allocate a new descriptor.
     CFileDescriptor *pFI = new CFileDescriptor;
     if (pFI == NULL)
@@ -98,7 +98,27 @@ BOOL GetNewFileDescriptor(CFileDescriptor **ppFI, int *pnFile, int *pnError)
         return ErrorReturn(pnError, ABF_BADTEMPFILE);
     }
       
-    *ppFI = g_FileData[nFile] = pFI;
+    {
+#if (__cplusplus >= 201103)
+        std::lock_guard<std::mutex> lock(g_FileDataMutex);
+#endif
+        // Find an empty slot.
+        for (nFile=0; nFile < ABF_MAXFILES; nFile++)
+            if (g_FileData[nFile] == NULL)
+                break;
+   
+        if (nFile < ABF_MAXFILES)
+            g_FileData[nFile] = pFI;
+    }
+
+    // Return an error if no space left.   
+    if (nFile == ABF_MAXFILES)
+    {
+        delete pFI;
+        return ErrorReturn(pnError, ABF_TOOMANYFILESOPEN);
+    }
+
+    *ppFI = pFI;
     *pnFile = nFile;
     return TRUE;
 }
@@ -131,8 +151,15 @@ BOOL GetFileDescriptor(CFileDescriptor **ppFI, int nFile, int *pnError)
 //
 void ReleaseFileDescriptor(int nFile)
 {
-    delete g_FileData[nFile];
-    g_FileData[nFile] = NULL;
+    CFileDescriptor *pFI = NULL;
+    {
+#if (__cplusplus >= 201103)
+        std::lock_guard<std::mutex> lock(g_FileDataMutex);
+#endif
+        pFI = g_FileData[nFile];
+        g_FileData[nFile] = NULL;
+    }
+    delete pFI;
 }
 
 //===============================================================================================
@@ -1830,6 +1857,36 @@ BOOL WINAPI ABF2_MultiplexRead(int nFile, const ABF2FileHeader *pFH, DWORD dwEpi
     return TRUE;
 }
 
+//===============================================================================================
+// FUNCTION: ABF2_GetEpisodeLocation
+// PURPOSE:  Returns where the multiplexed samples of an episode are stored in the file,
+//           so that they can be accessed without reading them.
+//
+// OUTPUT:
+//   plFileOffset    the absolute byte offset of the first sample of the episode
+//   puSizeInSamples the number of samples of all channels in the episode
+// 
+BOOL WINAPI ABF2_GetEpisodeLocation(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode, 
+                                    LONGLONG *plFileOffset, UINT *puSizeInSamples, int *pnError)
+{
+    CFileDescriptor *pFI = NULL;
+    if (!GetFileDescriptor(&pFI, nFile, pnError))
+        return FALSE;
+   
+    if (!pFI->CheckEpisodeNumber(dwEpisode))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    Synch SynchEntry;
+    if (!ABF2_GetSynchEntry( pFH, pFI, dwEpisode, &SynchEntry ))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+      
+    if (plFileOffset)
+        *plFileOffset = LONGLONG(ABF2_GetDataOffset(pFH)) + SynchEntry.dwFileOffset;
+    if (puSizeInSamples)
+        *puSizeInSamples = UINT(SynchEntry.dwLength);
+    return TRUE;
+}
+
 #if 0
 //===============================================================================================
 // FUNCTION: SynchCountToSamples
@@ -2459,6 +2516,176 @@ BOOL WINAPI ABF2_ReadChannel(int nFile, const ABF2FileHeader *pFH, int nChannel,
     return TRUE;
 }
 
+//===============================================================================================
+// FUNCTION: DemultiplexADC
+// PURPOSE:  Converts all channels of a multiplexed episode of two byte integers to "UserUnits"
+//           in a single pass over the episode.
+//
+static void DemultiplexADC(const ADC_VALUE *pnSource, UINT uNumChannels, UINT uSamplesPerChannel,
+                           const std::vector<float> &fFactors, const std::vector<float> &fShifts,
+                           std::vector<Vector_float> &pfBuffers)
+{
+    std::vector<float *> pfDest(uNumChannels);
+    for (UINT c=0; c<uNumChannels; c++)
+        pfDest[c] = &pfBuffers[c][0];
+
+    for (UINT i=0; i<uSamplesPerChannel; i++)
+    {
+        const ADC_VALUE *pnFrame = pnSource + i*uNumChannels;
+        for (UINT c=0; c<uNumChannels; c++)
+            pfDest[c][i] = pnFrame[c] * fFactors[c] + fShifts[c];
+    }
+}
+
+//===============================================================================================
+// FUNCTION: DemultiplexFloats
+// PURPOSE:  De-multiplexes all channels of an episode of 4-byte floats in a single pass.
+//
+static void DemultiplexFloats(const float *pfSource, UINT uNumChannels, UINT uSamplesPerChannel,
+                              std::vector<Vector_float> &pfBuffers)
+{
+    std::vector<float *> pfDest(uNumChannels);
+    for (UINT c=0; c<uNumChannels; c++)
+        pfDest[c] = &pfBuffers[c][0];
+
+    for (UINT i=0; i<uSamplesPerChannel; i++)
+    {
+        const float *pfFrame = pfSource + i*uNumChannels;
+        for (UINT c=0; c<uNumChannels; c++)
+            pfDest[c][i] = pfFrame[c];
+    }
+}
+
+//===============================================================================================
+// FUNCTION: ABF_ReadAllChannels
+// PURPOSE:  This function reads a complete multiplexed episode from the data file once and
+//           converts all de-multiplexed channels to "UserUnits".
+//
+// On return, pfBuffers contains one buffer per ADC channel, in the order of the sampling
+// sequence (i.e. pfBuffers[i] holds channel pFH->nADCSamplingSeq[i]). Each buffer is resized
+// to the number of samples per channel in this episode, which is also returned in puNumSamples.
+//
+BOOL WINAPI ABF_ReadAllChannels(int nFile, const ABFFileHeader *pFH, DWORD dwEpisode, 
+                                std::vector<Vector_float>& pfBuffers, UINT *puNumSamples, int *pnError)
+{
+    CFileDescriptor *pFI = NULL;
+    if (!GetFileDescriptor(&pFI, nFile, pnError))
+        return FALSE;
+
+    if (!pFI->CheckEpisodeNumber(dwEpisode))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    UINT uNumChannels = (UINT)pFH->nADCNumChannels;
+    UINT uSampleSize = SampleSize(pFH);
+
+    // Only create the read buffer on demand, it is freed when the file is closed.
+    if (!pFI->GetReadBuffer())
+    {      
+        if (!pFI->AllocReadBuffer(pFH->lNumSamplesPerEpisode * uSampleSize))
+            return ErrorReturn(pnError, ABF_OUTOFMEMORY);
+    }
+
+    // Read the whole episode from the ABF file only if it is not already cached.
+    UINT uEpisodeSize = pFI->GetCachedEpisodeSize();
+    if (dwEpisode != pFI->GetCachedEpisode())
+    {         
+        uEpisodeSize = (UINT)pFH->lNumSamplesPerEpisode;
+        if (!ABF_MultiplexRead(nFile, pFH, dwEpisode, pFI->GetReadBuffer(), pFH->lNumSamplesPerEpisode * uSampleSize, &uEpisodeSize, pnError))
+        {
+            pFI->SetCachedEpisode(UINT(-1), 0);
+            return FALSE;
+        }
+        pFI->SetCachedEpisode(dwEpisode, uEpisodeSize);
+    }
+
+    UINT uSamplesPerChannel = uEpisodeSize / uNumChannels;
+    pfBuffers.resize(uNumChannels);
+    for (UINT c=0; c<uNumChannels; c++)
+        pfBuffers[c].resize(uSamplesPerChannel);
+
+    if (uSamplesPerChannel > 0)
+    {
+        if (pFH->nDataFormat == ABF_INTEGERDATA)
+        {
+            std::vector<float> fFactors(uNumChannels), fShifts(uNumChannels);
+            for (UINT c=0; c<uNumChannels; c++)
+                ABFH_GetADCtoUUFactors( pFH, pFH->nADCSamplingSeq[c], &fFactors[c], &fShifts[c]);
+            DemultiplexADC((ADC_VALUE *)pFI->GetReadBuffer(), uNumChannels, uSamplesPerChannel,
+                           fFactors, fShifts, pfBuffers);
+        }
+        else
+            DemultiplexFloats((float *)pFI->GetReadBuffer(), uNumChannels, uSamplesPerChannel, pfBuffers);
+    }
+
+    if (puNumSamples)
+        *puNumSamples = uSamplesPerChannel;
+    return TRUE;
+}
+
+//===============================================================================================
+// FUNCTION: ABF2_ReadAllChannels
+// PURPOSE:  This function reads a complete multiplexed episode from the data file once and
+//           converts all de-multiplexed channels to "UserUnits".
+//
+// See ABF_ReadAllChannels for the layout of pfBuffers.
+//
+BOOL WINAPI ABF2_ReadAllChannels(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode, 
+                                 std::vector<Vector_float>& pfBuffers, UINT *puNumSamples, int *pnError)
+{
+    CFileDescriptor *pFI = NULL;
+    if (!GetFileDescriptor(&pFI, nFile, pnError))
+        return FALSE;
+
+    if (!pFI->CheckEpisodeNumber(dwEpisode))
+        return ErrorReturn(pnError, ABF_EEPISODERANGE);
+
+    UINT uNumChannels = (UINT)pFH->nADCNumChannels;
+    UINT uSampleSize = ABF2_SampleSize(pFH);
+
+    // Only create the read buffer on demand, it is freed when the file is closed.
+    if (!pFI->GetReadBuffer())
+    {      
+        if (!pFI->AllocReadBuffer(pFH->lNumSamplesPerEpisode * uSampleSize))
+            return ErrorReturn(pnError, ABF_OUTOFMEMORY);
+    }
+
+    // Read the whole episode from the ABF file only if it is not already cached.
+    UINT uEpisodeSize = pFI->GetCachedEpisodeSize();
+    if (dwEpisode != pFI->GetCachedEpisode())
+    {         
+        uEpisodeSize = (UINT)pFH->lNumSamplesPerEpisode;
+        if (!ABF2_MultiplexRead(nFile, pFH, dwEpisode, pFI->GetReadBuffer(), pFH->lNumSamplesPerEpisode * uSampleSize, &uEpisodeSize, pnError))
+        {
+            pFI->SetCachedEpisode(UINT(-1), 0);
+            return FALSE;
+        }
+        pFI->SetCachedEpisode(dwEpisode, uEpisodeSize);
+    }
+
+    UINT uSamplesPerChannel = uEpisodeSize / uNumChannels;
+    pfBuffers.resize(uNumChannels);
+    for (UINT c=0; c<uNumChannels; c++)
+        pfBuffers[c].resize(uSamplesPerChannel);
+
+    if (uSamplesPerChannel > 0)
+    {
+        if (pFH->nDataFormat == ABF_INTEGERDATA)
+        {
+            std::vector<float> fFactors(uNumChannels), fShifts(uNumChannels);
+            for (UINT c=0; c<uNumChannels; c++)
+                ABF2H_GetADCtoUUFactors( pFH, pFH->nADCSamplingSeq[c], &fFactors[c], &fShifts[c]);
+            DemultiplexADC((ADC_VALUE *)pFI->GetReadBuffer(), uNumChannels, uSamplesPerChannel,
+                           fFactors, fShifts, pfBuffers);
+        }
+        else
+            DemultiplexFloats((float *)pFI->GetReadBuffer(), uNumChannels, uSamplesPerChannel, pfBuffers);
+    }
+
+    if (puNumSamples)
+        *puNumSamples = uSamplesPerChannel;
+    return TRUE;
+}
+
 #if 0
 //===============================================================================================
 // FUNCTION: ABF_ReadRawChannel
@@ -122,6 +122,8 @@ BOOL WINAPI ABF_MultiplexRead(int nFile, const ABFFileHeader *pFH, DWORD dwEpiso
                               void *pvBuffer, UINT uBufferSize, UINT *puSizeInSamples, int *pnError);
 BOOL WINAPI ABF2_MultiplexRead(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode, 
                                void *pvBuffer, UINT uBufferSize, UINT *puSizeInSamples, int *pnError);
+BOOL WINAPI ABF2_GetEpisodeLocation(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode, 
+                                    LONGLONG *plFileOffset, UINT *puSizeInSamples, int *pnError);
 /*
 BOOL WINAPI ABF_MultiplexWrite(int nFile, ABFFileHeader *pFH, UINT uFlags, const void *pvBuffer, 
                                DWORD dwEpiStart, UINT uSizeInSamples, int *pnError);
@@ -132,6 +134,10 @@ BOOL WINAPI ABF_ReadChannel(int nFile, const ABFFileHeader *pFH, int nChannel, D
                             Vector_float& pfBuffer, UINT *puNumSamples, int *pnError);
 BOOL WINAPI ABF2_ReadChannel(int nFile, const ABF2FileHeader *pFH, int nChannel, DWORD dwEpisode, 
                              Vector_float& pfBuffer, UINT *puNumSamples, int *pnError);
+BOOL WINAPI ABF_ReadAllChannels(int nFile, const ABFFileHeader *pFH, DWORD dwEpisode, 
+                                std::vector<Vector_float>& pfBuffers, UINT *puNumSamples, int *pnError);
+BOOL WINAPI ABF2_ReadAllChannels(int nFile, const ABF2FileHeader *pFH, DWORD dwEpisode, 
+                                 std::vector<Vector_float>& pfBuffers, UINT *puNumSamples, int *pnError);
 /*                                   
 BOOL WINAPI ABF_ReadRawChannel(int nFile, const ABFFileHeader *pFH, int nChannel, DWORD dwEpisode, 
                                void *pvBuffer, UINT *puNumSamples, int *pnError);
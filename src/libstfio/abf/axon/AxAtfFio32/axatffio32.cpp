@@ -1099,6 +1099,33 @@ BOOL WINAPI ATF_CountDataLines(int nFile, long *plNumLines, int *pnError)
    return TRUE;
 }
 
+//===============================================================================================
+// FUNCTION: ATF_GetDataOffset
+// PURPOSE:  Gets the byte offset of the first line of data in an ATF file, so that the
+//           data can be parsed without going through the line buffer.
+//
+BOOL WINAPI ATF_GetDataOffset(int nFile, long *plOffset, int *pnError)
+{
+   WPTRASSERT(plOffset);
+   ATF_FILEINFO *pATF = NULL;
+   if (!GetFileDescriptor(&pATF, nFile, pnError))
+      return FALSE;
+
+   if (pATF->bWriting)
+      ERRORRETURN(pnError, ATF_ERROR_BADSTATE);
+
+   // Reading the first record skips the headers and sets the data pointer:
+   if (pATF->eState < eDATAREAD)
+   {
+      if (!ReadDataRecord(pATF, pnError))
+         return FALSE;
+      ATF_RewindFile(nFile, NULL);
+   }
+
+   *plOffset = pATF->lDataPtr;
+   return TRUE;
+}
+
 //===============================================================================================
 // FUNCTION: ATF_GetNumHeaders
 // PURPOSE:  Gets the number of optional data records in the ATF file.
@@ -74,6 +74,8 @@ BOOL WINAPI ATF_RewindFile(int nFile, int *pnError);
 
 BOOL WINAPI ATF_CountDataLines(int nFile, long *plNumLines, int *pnError);
 
+BOOL WINAPI ATF_GetDataOffset(int nFile, long *plOffset, int *pnError);
+
 BOOL WINAPI ATF_GetNumHeaders(int nFile, int *pnHeaders, int *pnError);
 
 BOOL WINAPI ATF_WriteHeaderRecord(int nFile, LPCSTR pszText, int *pnError);
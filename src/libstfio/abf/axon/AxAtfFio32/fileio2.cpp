@@ -611,7 +611,10 @@ int getsBuf(ATF_FILEINFO *pATF, LPSTR pszString, DWORD dwBufSize)
 #if defined(_MSC_VER)
             if (!ReadFile(pATF->hFile, pszReadBuf, pATF->lBufSize, &dwBytesRead, NULL))
 #else
-            if (!c_ReadFile((FILE*)pATF->hFile, pszReadBuf, pATF->lBufSize, &dwBytesRead, NULL))
+            // Unlike ReadFile, c_ReadFile fails if it reads less than a buffer's worth,
+            // which happens at the end of every file:
+            if (!c_ReadFile((FILE*)pATF->hFile, pszReadBuf, pATF->lBufSize, &dwBytesRead, NULL) &&
+                !feof((FILE*)pATF->hFile))
 #endif
                 return GETS_ERROR;
 
@@ -14,6 +14,8 @@
 
 #include <iostream>
 #include <sstream>
+#include <cstring>
+#include <locale>
 
 #include "./atflib.h"
 #include "../recording.h"
@@ -105,11 +107,180 @@ bool stfio::exportATFFile(const std::string& fName, const Recording& WData) {
     return true;
 }
 
+namespace {
+
+    // Text of the data lines that is parsed by one thread at a time:
+    const std::size_t atf_chunk_size = std::size_t(1) << 20;
+
+    // Powers of ten that can be represented exactly:
+    const double exact_pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    inline bool is_delimiter(char c) { return c == '\t' || c == ','; }
+
+    // Parses a number from [p, end) independently of the locale. Numbers
+    // with up to 15 significant digits and small exponents are converted
+    // exactly with a single multiplication or division; others are left
+    // to the C++ library. Returns a pointer past the number, or p if there
+    // is no number.
+    const char* parse_number(const char* p, const char* end, double& val) {
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            ++p;
+        }
+        unsigned long long mantissa = 0;
+        int ndigits = 0, exp10 = 0;
+        bool any = false;
+        for (; p < end && is_digit(*p); ++p) {
+            any = true;
+            if (ndigits < 19) {
+                mantissa = mantissa*10 + (*p-'0');
+                if (mantissa) ++ndigits;
+            } else {
+                ++exp10;
+                ++ndigits;
+            }
+        }
+        if (p < end && *p == '.') {
+            for (++p; p < end && is_digit(*p); ++p) {
+                any = true;
+                if (ndigits < 19) {
+                    mantissa = mantissa*10 + (*p-'0');
+                    if (mantissa) ++ndigits;
+                    --exp10;
+                } else if (*p != '0') {
+                    ++ndigits;
+                }
+            }
+        }
+        if (!any) {
+            return start;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            const char* pe = p+1;
+            bool exp_negative = false;
+            if (pe < end && (*pe == '-' || *pe == '+')) {
+                exp_negative = (*pe == '-');
+                ++pe;
+            }
+            if (pe < end && is_digit(*pe)) {
+                int e = 0;
+                for (; pe < end && is_digit(*pe); ++pe) {
+                    if (e < 10000) e = e*10 + (*pe-'0');
+                }
+                exp10 += exp_negative ? -e : e;
+                p = pe;
+            }
+        }
+        if (ndigits <= 15 && exp10 >= -22 && exp10 <= 22) {
+            val = (exp10 < 0) ? (double)mantissa / exact_pow10[-exp10]
+                              : (double)mantissa * exact_pow10[exp10];
+        } else {
+            std::istringstream token(std::string(start, p));
+            token.imbue(std::locale::classic());
+            token >> val;
+            return p;
+        }
+        if (negative) val = -val;
+        return p;
+    }
+
+    // Parses the values of one data line [p, end) into row. Values that are
+    // missing or can't be read are set to 0, as the ATF library does.
+    void parse_line(const char* p, const char* end, double* row, int nColumns) {
+        for (int n_c = 0; n_c < nColumns; ++n_c) {
+            while (p < end && *p == ' ') ++p;
+            double val = 0;
+            const char* next = parse_number(p, end, val);
+            if (next == p) {
+                // skip a token that isn't a number:
+                while (next < end && !is_delimiter(*next) && *next != ' ') ++next;
+                val = 0;
+            }
+            row[n_c] = val;
+            p = next;
+            while (p < end && *p == ' ') ++p;
+            if (p < end && is_delimiter(*p)) ++p;
+        }
+    }
+
+    // Finds the line that starts at p. Returns the start of the next line and
+    // sets line_end to the end of this line without its terminator:
+    const char* next_line(const char* p, const char* end, const char*& line_end) {
+        const char* eol = (const char*)memchr(p, '\n', end-p);
+        line_end = (eol == NULL) ? end : eol;
+        if (line_end > p && line_end[-1] == '\r') --line_end;
+        return (eol == NULL) ? end : eol+1;
+    }
+
+    // A range of data lines that is parsed by one thread:
+    struct atf_chunk {
+        const char* begin;
+        const char* end;
+        std::size_t first_line;
+    };
+
+    // Splits the data lines in [p, end) into chunks, stopping at the first
+    // empty line. Returns the total number of lines.
+    std::size_t split_lines(const char* p, const char* end, std::vector<atf_chunk>& chunks) {
+        std::size_t n_lines = 0;
+        atf_chunk chunk = {p, p, 0};
+        while (p < end) {
+            if (*p == '\r' || *p == '\n') {
+                // empty line: end of data
+                break;
+            }
+            const char* line_end = NULL;
+            p = next_line(p, end, line_end);
+            ++n_lines;
+            if ((std::size_t)(p - chunk.begin) >= atf_chunk_size) {
+                chunk.end = p;
+                chunks.push_back(chunk);
+                chunk.begin = p;
+                chunk.first_line = n_lines;
+            }
+        }
+        if (p > chunk.begin) {
+            chunk.end = p;
+            chunks.push_back(chunk);
+        }
+        return n_lines;
+    }
+
+    // Parses the lines of a chunk and scatters the values into the columns;
+    // columns with a NULL pointer are skipped:
+    void parse_chunk(const atf_chunk& chunk, const std::vector<double*>& columns) {
+        int nColumns = (int)columns.size();
+        Vector_double row(nColumns);
+        std::size_t n_l = chunk.first_line;
+        for (const char* p = chunk.begin; p < chunk.end; ++n_l) {
+            const char* line_end = NULL;
+            const char* next = next_line(p, chunk.end, line_end);
+            parse_line(p, line_end, &row[0], nColumns);
+            for (int n_c = 0; n_c < nColumns; ++n_c) {
+                if (columns[n_c] != NULL) {
+                    columns[n_c][n_l] = row[n_c];
+                }
+            }
+            p = next;
+        }
+    }
+
+}
+
 void stfio::importATFFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
     int nColumns, nFileNum;
     int nError;
     const int nMaxText=64;
 
+    // The ATF library reads the header; the data lines are parsed below
+    // in a single pass over the file.
     if (!ATF_OpenFile(fName.c_str(),ATF_READONLY,&nColumns,&nFileNum,&nError)) {
         std::string errorMsg("Exception while calling ATF_OpenFile():\n");
         errorMsg+=ATFError(fName,nError);
@@ -117,12 +288,14 @@ void stfio::importATFFile(const std::string &fName, Recording &ReturnData, Progr
     }
     // Assume that the first column is time:
     if (nColumns==0) {
+        ATF_CloseFile(nFileNum);
         std::string errorMsg("Error while opening ATF file:\nFile appears to be empty");
         throw std::runtime_error(errorMsg);
     }
-    long sectionSize;
-    if (!ATF_CountDataLines(nFileNum,&sectionSize,&nError)) {
-        std::string errorMsg("Exception while calling ATF_CountDataLines():\n");
+    long dataOffset = 0;
+    if (!ATF_GetDataOffset(nFileNum,&dataOffset,&nError)) {
+        ATF_CloseFile(nFileNum);
+        std::string errorMsg("Exception while calling ATF_GetDataOffset():\n");
         errorMsg+=ATFError(fName,nError);
         throw std::runtime_error(errorMsg);
     }
@@ -130,6 +303,7 @@ void stfio::importATFFile(const std::string &fName, Recording &ReturnData, Progr
     // If first column contains time values, determine sampling interval:
     std::vector<char> titleVec(nMaxText);
     if (!ATF_GetColumnTitle(nFileNum,0,&titleVec[0],nMaxText,&nError)) {
+        ATF_CloseFile(nFileNum);
         std::string errorMsg("Exception while calling ATF_GetColumnTitle():\n");
         errorMsg+=ATFError(fName,nError);
         throw std::runtime_error(errorMsg);
@@ -140,80 +314,81 @@ void stfio::importATFFile(const std::string &fName, Recording &ReturnData, Progr
             titleString.find("Time")!=std::string::npos ||
             titleString.find("TIME")!=std::string::npos)
     {
-        // Read sampling information from first two time values:
-        double time[2];
-        for (int n_l=0;n_l<2;++n_l) {
-            if (!ATF_ReadDataColumn(nFileNum,0,&time[n_l],&nError)) {
-                std::string errorMsg("Exception while calling ATF_ReadDataColumn():\n");
-                errorMsg+=ATFError(fName,nError);
-                throw std::runtime_error(errorMsg);
-            }
-        }
-        if (!ATF_RewindFile(nFileNum,&nError)) {
-            std::string errorMsg("Exception while calling ATF_RewindFile():\n");
-            errorMsg+=ATFError(fName,nError);
-            throw std::runtime_error(errorMsg);
-        }
-
-        ReturnData.SetXScale(time[1]-time[0]);
         timeInFirstColumn=1;
     }
+    std::vector<char> unitsVec(nMaxText);
+    if (nColumns > timeInFirstColumn &&
+        !ATF_GetColumnUnits(nFileNum,timeInFirstColumn,&unitsVec[0],nMaxText,&nError))
+    {
+        ATF_CloseFile(nFileNum);
+        std::string errorMsg("Exception while calling ATF_GetColumnUnits():\n");
+        errorMsg+=ATFError(fName,nError);
+        throw std::runtime_error(errorMsg);
+    }
+    if (!ATF_CloseFile(nFileNum)) {
+        std::string errorMsg("Exception while calling ATF_CloseFile():\n");
+        errorMsg += "Error while closing ATF file";
+        throw std::runtime_error(errorMsg);
+    }
+
+    progDlg.Update(0, "Reading data lines");
+    MappedFile file(fName);
+    if (dataOffset < 0 || (std::size_t)dataOffset > file.size()) {
+        throw std::runtime_error("Error while reading ATF file:\nData offset out of range");
+    }
+    const char* data = file.data() + dataOffset;
+    const char* data_end = file.data() + file.size();
+
+    std::vector<atf_chunk> chunks;
+    std::size_t sectionSize = split_lines(data, data_end, chunks);
+
     ReturnData.resize(1);
-    Channel TempChannel(nColumns-timeInFirstColumn);
+    Channel TempChannel(nColumns-timeInFirstColumn, sectionSize);
+    std::vector<double*> columns(nColumns, (double*)NULL);
     for (int n_c=timeInFirstColumn;n_c<nColumns;++n_c) {
-        int progbar = (double)100.0*(n_c+1-timeInFirstColumn)/(double)(nColumns-timeInFirstColumn);
-
-        std::ostringstream progStr;
-        progStr << "Section #" << n_c+1-timeInFirstColumn << " of " << nColumns-timeInFirstColumn;
-        progDlg.Update(progbar, progStr.str());
         std::ostringstream label;
         label
             << fName 
             << ", Section # " << n_c-timeInFirstColumn+1;
-        Section TempSection(sectionSize,label.str());
-        for (int n_l=0;n_l<sectionSize;++n_l) {
-            if (!ATF_ReadDataColumn(nFileNum,n_c,&TempSection[n_l],&nError)) {
-                std::string errorMsg("Exception while calling ATF_ReadDataColumn():\n");
-                errorMsg+=ATFError(fName,nError);
-                ReturnData.resize(0);
-                throw std::runtime_error(errorMsg);
-            }
+        Section& sec = TempChannel[n_c-timeInFirstColumn];
+        sec.SetSectionDescription(label.str());
+        if (sectionSize > 0) {
+            columns[n_c] = &sec.get_w()[0];
         }
-        if (n_c-timeInFirstColumn==0) {
-            std::vector<char> unitsVec(nMaxText);
-            if (!ATF_GetColumnUnits(nFileNum,n_c,&unitsVec[0],nMaxText,&nError)) {
-                std::string errorMsg("Exception while calling ATF_GetColumnUnits():\n");
-                errorMsg+=ATFError(fName,nError);
-                ReturnData.resize(0);
-                throw std::runtime_error(errorMsg);
-            }
-            ReturnData[0].SetYUnits(std::string(&unitsVec[0]));
-        }
-        try {
-            TempChannel.InsertSection(TempSection,n_c-timeInFirstColumn);
-        }
-        catch (...) {
-            throw;
-        }
-        // Rewind file before reading next column:
-        if (!ATF_RewindFile(nFileNum,&nError)) {
-            std::string errorMsg("Exception while calling ATF_RewindFile():\n");
-            errorMsg+=ATFError(fName,nError);
-            ReturnData.resize(0);
-            throw std::runtime_error(errorMsg);
+    }
+
+    progDlg.Update(10, "Parsing data lines");
+    int n_chunks = (int)chunks.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int n_ch=0; n_ch < n_chunks; ++n_ch) {
+        parse_chunk(chunks[n_ch], columns);
+    }
+    progDlg.Update(100, "Parsing data lines");
+
+    if (timeInFirstColumn && sectionSize > 1) {
+        // Read sampling information from first two time values:
+        Vector_double row(nColumns);
+        double time[2];
+        const char* p = data;
+        for (int n_l=0;n_l<2;++n_l) {
+            const char* line_end = NULL;
+            const char* next = next_line(p, data_end, line_end);
+            parse_line(p, line_end, &row[0], nColumns);
+            time[n_l] = row[0];
+            p = next;
         }
+        ReturnData.SetXScale(time[1]-time[0]);
+    }
+    if (nColumns > timeInFirstColumn) {
+        TempChannel.SetYUnits(std::string(&unitsVec[0]));
     }
     try {
-        ReturnData.InsertChannel(TempChannel,0);
+        ReturnData.InsertChannel(std::move(TempChannel),0);
     }
     catch (...) {
         ReturnData.resize(0);
         throw;
     }
-
-    if (!ATF_CloseFile(nFileNum)) {
-        std::string errorMsg("Exception while calling ATF_CloseFile():\n");
-        errorMsg += "Error while closing ATF file";
-        throw std::runtime_error(errorMsg);
-    }
 }
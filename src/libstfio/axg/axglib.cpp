@@ -115,20 +115,19 @@ void stfio::importAXGFile(const std::string &fName, Recording &ReturnData, Progr
         if ( columnNumber == 0 ) {
             xscale = column.seriesArray.increment * 1.0e3;
         } else {
-            section_list.push_back( Section(column.points, column.title ) );
-            std::size_t last = section_list.size()-1;
-
             if (column.points<1) {
                 throw std::out_of_range("number of points too small");
             }
             if ((int)column.floatArray.size()<column.points) {
                 throw std::out_of_range("floatArray too small in importAXGFile()");
             }
-            if (section_list[last].get().size()!=column.floatArray.size()) {
+            if ((int)column.floatArray.size()!=column.points) {
                 throw std::out_of_range("section too small in importAXGFile()");
             }
 
-            std::copy(column.floatArray.begin(),column.floatArray.end(),section_list[last].get_w().begin());
+            // convert into the vector that becomes the section's storage:
+            section_list.push_back( Section(Vector_double(column.floatArray.begin(),column.floatArray.end()),
+                                            column.title) );
             // check whether this is a new channel:
             bool isnew = true;
 
@@ -165,10 +164,10 @@ void stfio::importAXGFile(const std::string &fName, Recording &ReturnData, Progr
         }
         for (std::size_t n_s=n_c; (int)n_s < numberOfColumns-1; n_s += numberOfChannels) {
             if (factor != 1.0) {
-                section_list[n_s].get_w() = stfio::vec_scal_mul(section_list[n_s].get(), factor);
+                stfio::TraceOps().mul(factor).apply(section_list[n_s].get_w());
             }
             try {
-                TempChannel.InsertSection( section_list[n_s], (n_s-n_c)/numberOfChannels );
+                TempChannel.InsertSection( std::move(section_list[n_s]), (n_s-n_c)/numberOfChannels );
             }
             catch (...) {
                 ReturnData.resize(0);
@@ -182,7 +181,7 @@ void stfio::importAXGFile(const std::string &fName, Recording &ReturnData, Progr
             if ((int)ReturnData.size()<numberOfChannels) {
                 ReturnData.resize(numberOfChannels);
             }
-            ReturnData.InsertChannel(TempChannel,n_c);
+            ReturnData.InsertChannel(std::move(TempChannel),n_c);
         }
         catch (...) {
             ReturnData.resize(0);
@@ -14,7 +14,12 @@
 
 // Copyright 2012,2013,2017 Alois Schloegl, IST Austria
 
+#include <algorithm>
 #include <sstream>
+#include <vector>
+#if (__cplusplus >= 201103)
+#include <atomic>
+#endif
 
 #include "../stfio.h"
 
@@ -43,6 +48,25 @@ extern "C" uint32_t lcm(uint32_t A, uint32_t B);
 
 #include "./biosiglib.h"
 
+namespace {
+    // Size of the blocks of records that are read at a time; files may be
+    // imported by several conversion threads while it is changed:
+#if (__cplusplus >= 201103)
+    std::atomic<std::size_t> biosig_block_size(std::size_t(64)*1024*1024);
+#else
+    // only a single thread imports files without C++11:
+    std::size_t biosig_block_size = std::size_t(64)*1024*1024;
+#endif
+}
+
+std::size_t stfio::GetBiosigBlockSize() {
+    return biosig_block_size;
+}
+
+void stfio::SetBiosigBlockSize(std::size_t bytes) {
+    biosig_block_size = bytes;
+}
+
 stfio::filetype stfio_file_type(HDRTYPE* hdr) {
         switch (biosig_get_filetype(hdr)) {
 
@@ -178,56 +202,78 @@ stfio::filetype stfio::importBiosigFile(const std::string &fName, Recording &Ret
     }
 
     /*************************************************************************
-        read bulk data
+        allocate the sections, so that the data can be read into them
      *************************************************************************/
-    biosig_data_type *data = biosig_get_data(hdr, 0);
+    std::vector< std::vector<double*> > dest(numberOfChannels, std::vector<double*>(nsections));
+    try {
+        ReturnData.resize(numberOfChannels);
+        for (int NS=0; NS < numberOfChannels; ++NS) {
+            CHANNEL_TYPE *hc = biosig_get_channel(hdr, NS);
+            ReturnData[NS].resize(nsections);
+            ReturnData[NS].SetChannelName(biosig_channel_get_label(hc));
+            ReturnData[NS].SetYUnits(biosig_channel_get_physdim(hc));
+            for (size_t ns=0; ns < nsections; ns++) {
+                size_t SPS = SegIndexList[ns+1]-SegIndexList[ns];	// length of segment, samples per segment
+                ReturnData[NS][ns].resize(SPS);
+                if (SPS > 0)
+                    dest[NS][ns] = &ReturnData[NS][ns].get_w()[0];
+            }
+        }
+    }
+    catch (...) {
+        ReturnData.resize(0);
+        destructHDR(hdr);
+        return type;
+    }
 
 #ifdef _STFDEBUG
     std::cout << "Number of events: " << numberOfEvents << std::endl;
     /*int res = */ hdr2ascii(hdr, stdout, 4);
 #endif
 
-    for (int NS=0; NS < numberOfChannels; ) {
-        CHANNEL_TYPE *hc = biosig_get_channel(hdr, NS);
-        Channel TempChannel(nsections);
-        TempChannel.SetChannelName(biosig_channel_get_label(hc));
-        TempChannel.SetYUnits(biosig_channel_get_physdim(hc));
-
-        for (size_t ns=1; ns<=nsections; ns++) {
-            size_t SPS = SegIndexList[ns]-SegIndexList[ns-1];	// length of segment, samples per segment
-
-            int progbar = int(100.0 * (1.0 * ns / nsections + NS) / numberOfChannels);
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << NS + 1 << " of " << numberOfChannels
-                << ", Section #" << ns << " of " << nsections;
-            progDlg.Update(progbar, progStr.str());
-
-            Section TempSection(SPS, "");
-
-            std::copy(&(data[NS*SPR + SegIndexList[ns-1]]),
-			    &(data[NS*SPR + SegIndexList[ns]]),
-			    TempSection.get_w().begin() );
-
-            try {
-                TempChannel.InsertSection(TempSection, ns-1);
-            }
-            catch (...) {
-                ReturnData.resize(0);
-                destructHDR(hdr);
-                return type;
-            }
-        }   // end for sections
-        try {
-            if ((int)ReturnData.size() < numberOfChannels)
-                ReturnData.resize(numberOfChannels);
-            ReturnData.InsertChannel(TempChannel, NS++);
-        }
-        catch (...) {
+    /*************************************************************************
+        read bulk data in blocks of records, one channel after the other
+     *************************************************************************/
+    size_t NRec = biosig_get_number_of_records(hdr);
+    size_t recSPR = (NRec > 0) ? SPR/NRec : 0;	// samples per record
+    size_t recordsPerBlock = 1;
+    if (recSPR > 0 && numberOfChannels > 0)
+        recordsPerBlock = std::max<size_t>(1, GetBiosigBlockSize() / (recSPR*numberOfChannels*sizeof(biosig_data_type)));
+    recordsPerBlock = std::min(recordsPerBlock, NRec);
+    // the block is owned by us, sread() only writes to it:
+    std::vector<biosig_data_type> block(recordsPerBlock*recSPR*numberOfChannels);
+    biosig_reset_flag(hdr, BIOSIG_FLAG_ROW_BASED_CHANNELS);
+
+    size_t ns = 0;	// first section that hasn't been read completely
+    for (size_t rec=0; rec < NRec; rec += recordsPerBlock) {
+        size_t count = std::min(recordsPerBlock, NRec-rec);
+
+        int progbar = int(100.0 * rec / NRec);
+        std::ostringstream progStr;
+        progStr << "Reading record #" << rec + 1 << " of " << NRec;
+        progDlg.Update(progbar, progStr.str());
+
+        if (sread(&block[0], rec, count, hdr) != count || biosig_check_error(hdr)) {
             ReturnData.resize(0);
             destructHDR(hdr);
             return type;
         }
-    }   // end for channels
+
+        // samples [first, last) are in the block, channel-major:
+        size_t first = rec*recSPR;
+        size_t last = first + count*recSPR;
+        for (size_t k=ns; k < nsections && SegIndexList[k] < last; k++) {
+            size_t from = std::max(SegIndexList[k], first);
+            size_t to = std::min(SegIndexList[k+1], last);
+            for (int NS=0; NS < numberOfChannels; ++NS) {
+                const biosig_data_type* src = &block[NS*count*recSPR];
+                std::copy(src + (from-first), src + (to-first),
+                          dest[NS][k] + (from-SegIndexList[k]));
+            }
+        }
+        while (ns < nsections && SegIndexList[ns+1] <= last)
+            ns++;
+    }
 
     ReturnData.SetComment ( biosig_get_recording_id(hdr) );
 
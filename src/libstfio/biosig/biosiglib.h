@@ -44,6 +44,15 @@ namespace stfio {
 StfioDll bool check_biosig_version(int a, int b, int c);
 #endif
 
+//! Returns the size of the blocks in which importBiosigFile() reads the data.
+StfioDll std::size_t GetBiosigBlockSize();
+
+//! Sets the size of the blocks in which importBiosigFile() reads the data.
+/*! Peak memory of an import is the size of the recording plus one block.
+ *  \param bytes The block size in bytes. At least one record is read at a time.
+ */
+StfioDll void SetBiosigBlockSize(std::size_t bytes);
+
 //! Open an BIOSIG file and store its contents to a Recording object.
 /*! \param fName The full path to the file to be opened.
  *  \param ReturnData On entry, an empty Recording object. On exit,
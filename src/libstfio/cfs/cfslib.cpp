@@ -518,7 +518,7 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
             //-----------------------------------------------------
             try {
                 if (TempSection.size()!=0) {
-                    TempChannel.InsertSection(TempSection,n_section-empty_sections);
+                    TempChannel.InsertSection(std::move(TempSection),n_section-empty_sections);
                 } else {
                     empty_sections++;
                     TempChannel.resize(TempChannel.size()-1);
@@ -530,7 +530,7 @@ int stfio::importCFSFile(const std::string& fName, Recording& ReturnData, Progre
         }	//End loop: n_section
         try {
             if (TempChannel.size()!=0) {
-                ReturnData.InsertChannel(TempChannel,n_channel-empty_channels);
+                ReturnData.InsertChannel(std::move(TempChannel),n_channel-empty_channels);
             } else {
                 empty_channels++;
                 ReturnData.resize(ReturnData.size()-1);
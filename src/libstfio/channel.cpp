@@ -23,6 +23,12 @@ Channel::Channel(const Section& c_Section)
 : name("\0"), yunits( "\0" ),
 SectionArray(1, c_Section) {}
 
+#if (__cplusplus >= 201103)
+Channel::Channel(Section&& c_Section) 
+: name("\0"), yunits( "\0" ),
+SectionArray(1) { SectionArray[0] = std::move(c_Section); }
+#endif
+
 Channel::Channel(const std::deque<Section>& SectionList) 
 : name("\0"), yunits( "\0" ),
 SectionArray(SectionList) {}
@@ -34,16 +40,15 @@ SectionArray(c_n_sections, Section(section_size)) {}
 Channel::~Channel(void) {}
 
 void Channel::InsertSection(const Section& c_Section, std::size_t pos) {
-    try {
-        if (SectionArray.at(pos).size() != c_Section.size()) {
-            SectionArray.at(pos).resize(c_Section.size());
-        }
-        SectionArray.at(pos) = c_Section;
-    }
-    catch (...) {
-        throw;
-    }
+    // assignment reuses or replaces the storage; resizing it first would only fill it with zeros:
+    SectionArray.at(pos) = c_Section;
+}
+
+#if (__cplusplus >= 201103)
+void Channel::InsertSection(Section&& c_Section, std::size_t pos) {
+    SectionArray.at(pos) = std::move(c_Section);
 }
+#endif
 
 const Section& Channel::at(std::size_t at_) const {
     try {
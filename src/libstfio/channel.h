@@ -40,6 +40,13 @@ public:
      */
     explicit Channel(const Section& c_Section); 
 
+#if (__cplusplus >= 201103)
+    //! Constructor
+    /*! \param c_Section A single section that is moved into the channel
+     */
+    explicit Channel(Section&& c_Section); 
+#endif
+
     //! Constructor
     /*! \param SectionList A vector of Sections from which to construct the channel
      */
@@ -54,9 +61,25 @@ public:
      */
     explicit Channel(std::size_t c_n_sections, std::size_t section_size = 0);
     
+#if (__cplusplus >= 201103)
+    //! Copy constructor
+    Channel(const Channel& c_Channel) = default;
+
+    //! Move constructor; takes over the sections without copying them.
+    Channel(Channel&& c_Channel) = default;
+#endif
+
     //! Destructor
     ~Channel();
 
+#if (__cplusplus >= 201103)
+    //! Copy assignment
+    Channel& operator=(const Channel& c_Channel) = default;
+
+    //! Move assignment; takes over the sections without copying them.
+    Channel& operator=(Channel&& c_Channel) = default;
+#endif
+
     //operators---------------------------------------------------
 
     //! Unchecked access to a section (read and write)
@@ -138,6 +161,16 @@ public:
      */
     void InsertSection(const Section& c_Section, std::size_t pos);
 
+#if (__cplusplus >= 201103)
+    //! Moves a section to the given position, overwriting anything that's currently stored at that position
+    /*! Same as InsertSection(const Section&, std::size_t), but the data points
+     *  are taken over instead of being copied.
+     *  \param c_Section The section to be inserted. Its contents are unspecified on return.
+     *  \param pos The position at which to insert the section.
+     */
+    void InsertSection(Section&& c_Section, std::size_t pos);
+#endif
+
     //! Resize the section array.
     /*! \param newSize The new number of sections.
      */
@@ -0,0 +1,110 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <stdexcept>
+
+#include "./stfio.h"
+
+const std::size_t stfio::Envelope::block_size;
+
+stfio::Envelope::Envelope(const Vector_double& data)
+    : levels()
+{
+    std::size_t nblocks = data.size()/block_size;
+    if (nblocks == 0) {
+        return;
+    }
+    levels.push_back(Vector_double(2*nblocks));
+    for (std::size_t nb=0; nb<nblocks; ++nb) {
+        set_block(nb, &data[nb*block_size]);
+    }
+    build_levels();
+}
+
+stfio::Envelope::Envelope(const MappedSamples& samples)
+    : levels()
+{
+    std::size_t nblocks = samples.size()/block_size;
+    if (nblocks == 0) {
+        return;
+    }
+    levels.push_back(Vector_double(2*nblocks));
+    // convert a few thousand blocks at a time:
+    const std::size_t chunk_blocks = 4096;
+    Vector_double window(chunk_blocks*block_size);
+    for (std::size_t nb=0; nb<nblocks; nb+=chunk_blocks) {
+        std::size_t n = std::min(chunk_blocks, nblocks-nb);
+        samples.convert(nb*block_size, n*block_size, &window[0]);
+        for (std::size_t i=0; i<n; ++i) {
+            set_block(nb+i, &window[i*block_size]);
+        }
+    }
+    build_levels();
+}
+
+void stfio::Envelope::set_block(std::size_t nb, const double* samples) {
+    double min = samples[0], max = samples[0];
+    for (std::size_t ns=1; ns<block_size; ++ns) {
+        if (samples[ns] < min) min = samples[ns];
+        if (samples[ns] > max) max = samples[ns];
+    }
+    levels[0][2*nb] = min;
+    levels[0][2*nb+1] = max;
+}
+
+void stfio::Envelope::build_levels() {
+    while (levels.back().size() >= 4) {
+        const Vector_double& fine = levels.back();
+        // an odd trailing block is only kept in the finer level:
+        std::size_t ncoarse = fine.size()/4;
+        Vector_double coarse(2*ncoarse);
+        for (std::size_t nb=0; nb<ncoarse; ++nb) {
+            coarse[2*nb] = std::min(fine[4*nb], fine[4*nb+2]);
+            coarse[2*nb+1] = std::max(fine[4*nb+1], fine[4*nb+3]);
+        }
+        levels.push_back(coarse);
+    }
+}
+
+void stfio::Envelope::minmax(std::size_t first, std::size_t last, double& min, double& max) const {
+    if (first >= last || last > blocks()) {
+        throw std::out_of_range("Envelope::minmax: block range out of range");
+    }
+    min = levels[0][2*first];
+    max = levels[0][2*first+1];
+    // walk up the levels, taking the blocks at either end of the range
+    // that don't share a block of the next coarser level with their neighbour:
+    for (std::size_t nl=0; first < last; ++nl) {
+        const Vector_double& level = levels[nl];
+        if (nl+1 == levels.size()) {
+            for (; first < last; ++first) {
+                min = std::min(min, level[2*first]);
+                max = std::max(max, level[2*first+1]);
+            }
+            break;
+        }
+        if (first % 2 == 1) {
+            min = std::min(min, level[2*first]);
+            max = std::max(max, level[2*first+1]);
+            ++first;
+        }
+        if (last % 2 == 1) {
+            --last;
+            min = std::min(min, level[2*last]);
+            max = std::max(max, level[2*last+1]);
+        }
+        first /= 2;
+        last /= 2;
+    }
+}
@@ -0,0 +1,87 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file envelope.h
+ *  \brief Declares a multi-resolution min/max envelope of a section.
+ */
+
+#ifndef _ENVELOPE_H
+#define _ENVELOPE_H
+
+namespace stfio {
+
+/*! \addtogroup stfio
+ *  @{
+ */
+
+//! Minima and maxima of a sampled trace at several resolutions.
+/*! Level 0 holds the extrema of consecutive blocks of block_size samples;
+ *  every following level halves the number of blocks of the previous one.
+ *  The extrema of any range of whole blocks can then be looked up in
+ *  O(log(n)) instead of scanning all samples. The envelope is read-only
+ *  once it has been built.
+ */
+class StfioDll Envelope {
+public:
+    //! Number of samples that make up a block of level 0.
+    static const std::size_t block_size = 64;
+
+    //! Builds the envelope of an array of samples.
+    /*! \param data The samples.
+     */
+    explicit Envelope(const Vector_double& data);
+
+    //! Builds the envelope of memory-mapped samples.
+    /*! The samples are converted window by window; the complete array is not kept.
+     *  \param samples The memory-mapped samples.
+     */
+    explicit Envelope(const MappedSamples& samples);
+
+    //! Number of whole blocks of level 0.
+    std::size_t blocks() const { return levels.empty() ? 0 : levels[0].size()/2; }
+
+    //! Number of levels.
+    std::size_t size() const { return levels.size(); }
+
+    //! Extrema of a range of whole blocks.
+    /*! Throws std::out_of_range if the range is empty or exceeds blocks().
+     *  \param first Index of the first block.
+     *  \param last Index past the last block.
+     *  \param min On return, the minimum of all samples in the blocks.
+     *  \param max On return, the maximum of all samples in the blocks.
+     */
+    void minmax(std::size_t first, std::size_t last, double& min, double& max) const;
+
+private:
+    // Extrema of block nb of level 0 from its samples:
+    void set_block(std::size_t nb, const double* samples);
+
+    // Builds the coarser levels from level 0:
+    void build_levels();
+
+    // Level k stores min and max of block i at 2*i and 2*i+1:
+    std::vector<Vector_double> levels;
+};
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<Envelope> EnvelopePtr;
+#else
+typedef std::shared_ptr<Envelope> EnvelopePtr;
+#endif
+
+/*@}*/
+
+} // end of namespace
+
+#endif
@@ -19,6 +19,8 @@
   #include "H5TA.h"
 #endif
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 
@@ -45,8 +47,407 @@ typedef struct st {
     char yunits[UNITLEN];
 } st;
 
-bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg) {
+// Attribute of the root group with the stfio::hdf5_layout of a file.
+// Files without it use stfio::hdf5_legacy:
+const static char* layout_attribute = "stfio_layout";
+
+// Chunks of the chunked layout are kept below the default chunk cache of
+// the hdf5 library (1 MB), so that partial reads decompress every chunk
+// only once. Uncompressed datasets are written and read in blocks of rows
+// of about this size:
+const static std::size_t chunk_bytes = 512*1024;
+const static std::size_t block_bytes = 8*1024*1024;
+
+// Entry of the section table of the chunked layout:
+typedef struct sect {
+    unsigned long long length;
+    char* description;
+} sect;
+
+// Type of the section table, in memory and in the file:
+static hid_t sectionType() {
+    hid_t string_type = H5Tcopy( H5T_C_S1 );
+    H5Tset_size( string_type, H5T_VARIABLE );
+    hid_t section_type = H5Tcreate( H5T_COMPOUND, sizeof(sect) );
+    H5Tinsert( section_type, "length", HOFFSET( sect, length ), H5T_NATIVE_ULLONG );
+    H5Tinsert( section_type, "description", HOFFSET( sect, description ), string_type );
+    H5Tclose( string_type );
+    return section_type;
+}
+
+// Tells whether all sections of a channel are memory-mapped integers with
+// the same scaling, which can then be stored as they are in the file:
+static bool rawIntegers(const Channel& channel, stfio::sample_type& type, double& scale, double& offset) {
+    bool first = true;
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        const stfio::MappedSamplesPtr& mapped = channel[n_s].get_mapped();
+        if (!mapped) {
+            return false;
+        }
+        // concatenated sections may consist of several parts:
+        const std::vector<stfio::RawSamples>& parts = mapped->get_parts();
+        for (std::size_t n_p=0; n_p < parts.size(); ++n_p) {
+            const stfio::RawSamples& raw = parts[n_p];
+            if (raw.type != stfio::sample_int16 && raw.type != stfio::sample_int32) {
+                return false;
+            }
+            if (first) {
+                type = raw.type;
+                scale = raw.scale;
+                offset = raw.shift;
+                first = false;
+            } else if (raw.type != type || raw.scale != scale || raw.shift != offset) {
+                return false;
+            }
+        }
+    }
+    return !first && scale != 0;
+}
+
+// Converts a section to the type of the file and writes it to dest,
+// which is padded with zeros up to width samples:
+template <typename T>
+static void packRow(const Section& section, bool raw, double scale, double offset,
+                    std::size_t width, Vector_double& row, T* dest) {
+    std::size_t n = section.size();
+    if (raw) {
+        // recover the integers from the converted samples:
+        section.get_mapped()->convert(0, n, &row[0]);
+        for (std::size_t i = 0; i < n; ++i) {
+            dest[i] = (T)lround((row[i]-offset)/scale);
+        }
+    } else {
+        for (std::size_t i = 0; i < n; ++i) {
+            dest[i] = (T)section[i];
+        }
+    }
+    std::fill(dest+n, dest+width, T(0));
+}
+
+template <typename T>
+static void writeRows(hid_t dataset, hid_t mem_type, const Channel& channel, bool raw,
+                      double scale, double offset, hsize_t width, hsize_t rows,
+                      std::size_t n_c, std::size_t n_channels, stfio::ProgressInfo& progDlg) {
+    hsize_t n_sections = channel.size();
+    if (n_sections == 0 || width == 0) {
+        return;
+    }
+    std::vector<T> buffer(rows*width);
+    Vector_double row(raw ? width : 0);
+    hid_t file_space = H5Dget_space(dataset);
+    for (hsize_t first = 0; first < n_sections; first += rows) {
+        hsize_t count[2] = { std::min(rows, n_sections-first), width };
+        hsize_t start[2] = { first, 0 };
+        int progbar = (int)(((double)n_c + (double)first/(double)n_sections)*100.0/n_channels);
+        std::ostringstream progStr;
+        progStr << "Writing channel #" << n_c + 1 << " of " << n_channels
+                << ", Section #" << first+1 << " of " << n_sections;
+        progDlg.Update(progbar, progStr.str());
+
+        for (hsize_t r = 0; r < count[0]; ++r) {
+            packRow(channel[first+r], raw, scale, offset, width, row, &buffer[r*width]);
+        }
+        hid_t mem_space = H5Screate_simple(2, count, NULL);
+        H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
+        herr_t status = H5Dwrite(dataset, mem_type, mem_space, file_space, H5P_DEFAULT, &buffer[0]);
+        H5Sclose(mem_space);
+        if (status < 0) {
+            H5Sclose(file_space);
+            throw std::runtime_error("Exception while writing data in stfio::exportHDF5File");
+        }
+    }
+    H5Sclose(file_space);
+}
+
+// Writes the samples of a channel in the chunked layout:
+static void writeChunked(hid_t channel_group, const Recording& WData, std::size_t n_c,
+                         const stfio::HDF5Options& options, stfio::ProgressInfo& progDlg) {
+    const Channel& channel = WData[n_c];
+    hsize_t n_sections = channel.size();
+    hsize_t width = 0;
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        width = std::max(width, (hsize_t)channel[n_s].size());
+    }
+
+    // integers from an ADC are stored as they are, everything else as float32
+    // as in the legacy layout:
+    stfio::sample_type type = stfio::sample_float32;
+    double scale = 1.0, offset = 0.0;
+    bool raw = rawIntegers(channel, type, scale, offset);
+    hid_t file_type = H5T_IEEE_F32LE, mem_type = H5T_NATIVE_FLOAT;
+    std::size_t sample_size = sizeof(float);
+    if (raw && type == stfio::sample_int16) {
+        file_type = H5T_STD_I16LE; mem_type = H5T_NATIVE_SHORT; sample_size = sizeof(short);
+    } else if (raw) {
+        file_type = H5T_STD_I32LE; mem_type = H5T_NATIVE_INT; sample_size = sizeof(int);
+    }
+
+    // compressed datasets are chunked, uncompressed ones stay contiguous so that
+    // the importer can map them:
+    hsize_t rows = std::max<hsize_t>(1, block_bytes/(std::max<hsize_t>(width, 1)*sample_size));
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    if ((options.deflate > 0 || options.shuffle) && n_sections > 0 && width > 0) {
+        hsize_t chunk[2];
+        chunk[1] = std::min<hsize_t>(width, chunk_bytes/sample_size);
+        chunk[0] = std::min<hsize_t>(n_sections, std::max<hsize_t>(1, chunk_bytes/(chunk[1]*sample_size)));
+        H5Pset_chunk(dcpl, 2, chunk);
+        if (options.shuffle) {
+            H5Pset_shuffle(dcpl);
+        }
+        if (options.deflate > 0) {
+            H5Pset_deflate(dcpl, options.deflate);
+        }
+        rows = chunk[0];
+    }
+    hsize_t dims[2] = { n_sections, width };
+    hid_t space = H5Screate_simple(2, dims, NULL);
+    hid_t dataset = H5Dcreate2(channel_group, "data", file_type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5Sclose(space);
+    H5Pclose(dcpl);
+    if (dataset < 0) {
+        throw std::runtime_error("Exception while creating data in stfio::exportHDF5File");
+    }
+    try {
+        if (mem_type == H5T_NATIVE_SHORT) {
+            writeRows<short>(dataset, mem_type, channel, raw, scale, offset, width, rows, n_c, WData.size(), progDlg);
+        } else if (mem_type == H5T_NATIVE_INT) {
+            writeRows<int>(dataset, mem_type, channel, raw, scale, offset, width, rows, n_c, WData.size(), progDlg);
+        } else {
+            writeRows<float>(dataset, mem_type, channel, raw, scale, offset, width, rows, n_c, WData.size(), progDlg);
+        }
+    }
+    catch (...) {
+        H5Dclose(dataset);
+        throw;
+    }
+    H5Dclose(dataset);
+
+    // scaling and units:
+    double dt = WData.GetXScale();
+    if (H5LTset_attribute_double(channel_group, "data", "scale", &scale, 1) < 0 ||
+        H5LTset_attribute_double(channel_group, "data", "offset", &offset, 1) < 0 ||
+        H5LTset_attribute_double(channel_group, "data", "dt", &dt, 1) < 0 ||
+        H5LTset_attribute_string(channel_group, "data", "xunits", WData.GetXUnits().c_str()) < 0 ||
+        H5LTset_attribute_string(channel_group, "data", "yunits", channel.GetYUnits().c_str()) < 0)
+    {
+        throw std::runtime_error("Exception while writing scaling in stfio::exportHDF5File");
+    }
+
+    // section table:
+    std::vector<sect> sections(channel.size());
+    for (std::size_t n_s=0; n_s < channel.size(); ++n_s) {
+        sections[n_s].length = channel[n_s].size();
+        sections[n_s].description = const_cast<char*>(channel[n_s].GetSectionDescription().c_str());
+    }
+    hsize_t sdims[1] = { n_sections };
+    hid_t section_space = H5Screate_simple(1, sdims, NULL);
+    hid_t section_type = sectionType();
+    hid_t section_set = H5Dcreate2(channel_group, "sections", section_type, section_space,
+                                   H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t status = section_set;
+    if (section_set >= 0 && n_sections > 0) {
+        status = H5Dwrite(section_set, section_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &sections[0]);
+    }
+    if (section_set >= 0) H5Dclose(section_set);
+    H5Tclose(section_type);
+    H5Sclose(section_space);
+    if (status < 0) {
+        throw std::runtime_error("Exception while writing sections in stfio::exportHDF5File");
+    }
+}
+
+// Samples of a channel in the chunked layout:
+struct chunked_channel {
+    chunked_channel() : dataset(-1), width(0), scale(1.0), offset(0.0), dt(1.0) {}
+
+    hid_t dataset;
+    hsize_t width;
+    double scale, offset, dt;
+    std::string xunits, yunits;
+    std::vector<std::size_t> lengths;
+    std::vector<std::string> descriptions;
+};
+
+static std::string readStringAttribute(hid_t group, const char* name) {
+    hsize_t dims;
+    H5T_class_t class_id;
+    size_t type_size;
+    if (H5LTget_attribute_info(group, "data", name, &dims, &class_id, &type_size) < 0) {
+        return "";
+    }
+    std::vector<char> value(type_size+1, 0);
+    if (H5LTget_attribute_string(group, "data", name, &value[0]) < 0) {
+        return "";
+    }
+    return std::string(&value[0]);
+}
+
+// Opens the samples of a channel in the chunked layout; the dataset has to be
+// closed by the caller:
+static void openChunked(hid_t channel_group, chunked_channel& channel) {
+    channel.dataset = H5Dopen2(channel_group, "data", H5P_DEFAULT);
+    if (channel.dataset < 0) {
+        throw std::runtime_error("Exception while opening data in stfio::importHDF5File");
+    }
+    hid_t space = H5Dget_space(channel.dataset);
+    hsize_t dims[2] = { 0, 0 };
+    int rank = H5Sget_simple_extent_dims(space, dims, NULL);
+    H5Sclose(space);
+    if (rank != 2 ||
+        H5LTget_attribute_double(channel_group, "data", "scale", &channel.scale) < 0 ||
+        H5LTget_attribute_double(channel_group, "data", "offset", &channel.offset) < 0 ||
+        H5LTget_attribute_double(channel_group, "data", "dt", &channel.dt) < 0)
+    {
+        H5Dclose(channel.dataset);
+        throw std::runtime_error("Exception while reading data description in stfio::importHDF5File");
+    }
+    channel.width = dims[1];
+    channel.xunits = readStringAttribute(channel_group, "xunits");
+    channel.yunits = readStringAttribute(channel_group, "yunits");
+
+    hid_t section_set = H5Dopen2(channel_group, "sections", H5P_DEFAULT);
+    if (section_set < 0) {
+        H5Dclose(channel.dataset);
+        throw std::runtime_error("Exception while opening sections in stfio::importHDF5File");
+    }
+    hid_t section_space = H5Dget_space(section_set);
+    hsize_t n_sections = 0;
+    H5Sget_simple_extent_dims(section_space, &n_sections, NULL);
+    std::vector<sect> sections(n_sections);
+    hid_t section_type = sectionType();
+    herr_t status = 0;
+    if (n_sections > 0) {
+        status = H5Dread(section_set, section_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &sections[0]);
+    }
+    if (status >= 0) {
+        channel.lengths.resize(n_sections);
+        channel.descriptions.resize(n_sections);
+        for (hsize_t n_s = 0; n_s < n_sections; ++n_s) {
+            channel.lengths[n_s] = std::min<hsize_t>(sections[n_s].length, channel.width);
+            if (sections[n_s].description != NULL) {
+                channel.descriptions[n_s] = sections[n_s].description;
+            }
+        }
+        if (n_sections > 0) {
+#if defined(H5_VERSION_GE)
+#if H5_VERSION_GE(1,12,0)
+            H5Treclaim(section_type, section_space, H5P_DEFAULT, &sections[0]);
+#else
+            H5Dvlen_reclaim(section_type, section_space, H5P_DEFAULT, &sections[0]);
+#endif
+#else
+            H5Dvlen_reclaim(section_type, section_space, H5P_DEFAULT, &sections[0]);
+#endif
+        }
+    }
+    H5Tclose(section_type);
+    H5Sclose(section_space);
+    H5Dclose(section_set);
+    if (status < 0 || dims[0] != n_sections) {
+        H5Dclose(channel.dataset);
+        throw std::runtime_error("Exception while reading sections in stfio::importHDF5File");
+    }
+}
+
+// Reads samples [start, start+n) of the rows [first, first+rows) of a channel in
+// the chunked layout to dest, one row after the other, in physical units:
+static void readRows(const chunked_channel& channel, hsize_t first, hsize_t rows,
+                     hsize_t start, hsize_t n, double* dest) {
+    if (rows == 0 || n == 0) {
+        return;
+    }
+    hsize_t offset[2] = { first, start };
+    hsize_t count[2] = { rows, n };
+    hid_t file_space = H5Dget_space(channel.dataset);
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, offset, NULL, count, NULL);
+    hid_t mem_space = H5Screate_simple(2, count, NULL);
+    // the library converts the samples to double:
+    herr_t status = H5Dread(channel.dataset, H5T_NATIVE_DOUBLE, mem_space, file_space, H5P_DEFAULT, dest);
+    H5Sclose(mem_space);
+    H5Sclose(file_space);
+    if (status < 0) {
+        throw std::runtime_error("Exception while reading data in stfio::importHDF5File");
+    }
+    if (channel.scale != 1.0 || channel.offset != 0.0) {
+        for (hsize_t i = 0; i < rows*n; ++i) {
+            dest[i] = dest[i]*channel.scale + channel.offset;
+        }
+    }
+}
+
+// Reads the channel names from /channels:
+static std::string readChannelName(hid_t file_id, int n_c) {
+    hsize_t cdims;
+    H5T_class_t cclass_id;
+    size_t ctype_size;
+    std::ostringstream desc_path;
+    desc_path << "/channels/ch" << (n_c);
+    herr_t status = H5LTget_dataset_info( file_id, desc_path.str().c_str(), &cdims, &cclass_id, &ctype_size );
+    if (status < 0) {
+        std::string errorMsg("Exception while reading channel in stfio::importHDF5File");
+        throw std::runtime_error(errorMsg);
+    }
+    hid_t string_typec= H5Tcopy( H5T_C_S1 );
+    H5Tset_size( string_typec,  ctype_size );
+    std::vector<char> szchannel_name(ctype_size);
+    status = H5LTread_dataset(file_id, desc_path.str().c_str(), string_typec, &szchannel_name[0] );
+    H5Tclose( string_typec );
+    if (status < 0) {
+        std::string errorMsg("Exception while reading channel name in stfio::importHDF5File");
+        throw std::runtime_error(errorMsg);
+    }
+    std::ostringstream channel_name;
+    for (std::size_t c=0; c<ctype_size; ++c) {
+        channel_name << szchannel_name[c];
+    }
+    return channel_name.str();
+}
+
+// Path of a section group in the legacy layout, with leading zeros:
+static std::string sectionPath(const std::string& channel_path, int n_s, int n_sections) {
+    int max_log10 = 0;
+    if (n_sections > 1) {
+        max_log10 = int(log10((double)n_sections-1.0));
+    }
+    int n10 = 0;
+    if (n_s > 0) {
+        n10 = int(log10((double)n_s));
+    }
+    std::ostringstream section_path;
+    section_path << channel_path << "/" << "section_";
+    for (int n_z=n10; n_z < max_log10; ++n_z) {
+        section_path << "0";
+    }
+    section_path << n_s;
+    return section_path.str();
+}
+
+static int readLayout(hid_t file_id) {
+    int layout = stfio::hdf5_legacy;
+    if (H5Aexists(file_id, layout_attribute) > 0) {
+        H5LTget_attribute_int(file_id, "/", layout_attribute, &layout);
+    }
+    return layout;
+}
+
+stfio::HDF5Options::HDF5Options()
+    : layout(stfio::hdf5_chunked), deflate(0), shuffle(false)
+{}
+
+bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg,
+                           const HDF5Options& options) {
     
+    if (options.layout != stfio::hdf5_legacy && options.layout != stfio::hdf5_chunked) {
+        throw std::runtime_error("Unknown layout in stfio::exportHDF5File");
+    }
+    if (options.deflate < 0 || options.deflate > 9) {
+        throw std::out_of_range("Deflate level out of range in stfio::exportHDF5File");
+    }
+    if (options.layout == stfio::hdf5_chunked && options.deflate > 0 &&
+        H5Zfilter_avail(H5Z_FILTER_DEFLATE) <= 0) {
+        throw std::runtime_error("Deflate compression isn't available in stfio::exportHDF5File");
+    }
+
     hid_t file_id = H5Fcreate(fName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
     
     const int NRECORDS = 1;
@@ -85,14 +486,25 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
     
     herr_t status = H5TBmake_table( desc.str().c_str(), file_id, "description", (hsize_t)NFIELDS, (hsize_t)NRECORDS, sizeof(rt),
                                     field_names, rt_offset, field_type, 10, NULL, 0, &p_data  );
+    H5Tclose( string_type1 );
+    H5Tclose( string_type2 );
 
     if (status < 0) {
         std::string errorMsg("Exception while writing description in stfio::exportHDF5File");
         H5Fclose(file_id);
-        H5close();
         throw std::runtime_error(errorMsg);
     }
 
+    if (options.layout != stfio::hdf5_legacy) {
+        int layout = options.layout;
+        status = H5LTset_attribute_int(file_id, "/", layout_attribute, &layout, 1);
+        if (status < 0) {
+            std::string errorMsg("Exception while writing layout in stfio::exportHDF5File");
+            H5Fclose(file_id);
+            throw std::runtime_error(errorMsg);
+        }
+    }
+
     hid_t comment_group = H5Gcreate2( file_id,"/comment", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 
     /* File comment. */
@@ -105,7 +517,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
     if (status < 0) {
         std::string errorMsg("Exception while writing description in stfio::exportHDF5File");
         H5Fclose(file_id);
-        H5close();
         throw std::runtime_error(errorMsg);
     }
 
@@ -118,7 +529,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
     if (status < 0) {
         std::string errorMsg("Exception while writing comment in stfio::exportHDF5File");
         H5Fclose(file_id);
-        H5close();
         throw std::runtime_error(errorMsg);
     }
     H5Gclose(comment_group);
@@ -145,10 +555,10 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
         std::copy(channel_name[n_c].begin(),channel_name[n_c].end(), datac.begin());
         std::ostringstream desc_path; desc_path << "/channels/ch" << (n_c);
         status = H5LTmake_dataset(file_id, desc_path.str().c_str(), 1, dimsc, string_typec, &datac[0]);
+        H5Tclose( string_typec );
         if (status < 0) {
             std::string errorMsg("Exception while writing channel name in stfio::exportHDF5File");
             H5Fclose(file_id);
-            H5close();
             throw std::runtime_error(errorMsg);
         }
 
@@ -159,7 +569,6 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
             errorMsg << "Exception while creating channel group for "
                      << channel_path.str().c_str();
             H5Fclose(file_id);
-            H5close();
             throw std::runtime_error(errorMsg.str());
         }
 
@@ -179,10 +588,22 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
         if (status < 0) {
             std::string errorMsg("Exception while writing channel description in stfio::exportHDF5File");
             H5Fclose(file_id);
-            H5close();
             throw std::runtime_error(errorMsg);
         }
 
+        if (options.layout != stfio::hdf5_legacy) {
+            try {
+                writeChunked(channel_group, WData, n_c, options, progDlg);
+            }
+            catch (...) {
+                H5Gclose(channel_group);
+                H5Fclose(file_id);
+                throw;
+            }
+            H5Gclose(channel_group);
+            continue;
+        }
+
         int max_log10 = 0;
         if (WData[n_c].size() > 1) {
             max_log10 = int(log10((double)WData[n_c].size()-1.0));
@@ -224,15 +645,14 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
             hsize_t dims[1] = { WData[n_c][n_s].size() };
             std::ostringstream data_path;
             data_path << section_path.str() << "/data";
-            Vector_float data_cp(WData[n_c][n_s].get().size()); /* 32 bit */
-            for (std::size_t n_cp = 0; n_cp < WData[n_c][n_s].get().size(); ++n_cp) {
+            Vector_float data_cp(WData[n_c][n_s].size()); /* 32 bit */
+            for (std::size_t n_cp = 0; n_cp < WData[n_c][n_s].size(); ++n_cp) {
                 data_cp[n_cp] = float(WData[n_c][n_s][n_cp]);
             }
             status = H5LTmake_dataset(file_id, data_path.str().c_str(), 1, dims, H5T_IEEE_F32LE, &data_cp[0]);
             if (status < 0) {
                 std::string errorMsg("Exception while writing data in stfio::exportHDF5File");
                 H5Fclose(file_id);
-                H5close();
                 throw std::runtime_error(errorMsg);
             }
 
@@ -273,10 +693,11 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
             sdesc << "Description of " << section_name.str();
             status = H5TBmake_table( sdesc.str().c_str(), section_group, "description", (hsize_t)NSFIELDS, (hsize_t)NSRECORDS, st_size,
                                      sfield_names, st_offset, sfield_type, 10, NULL, 0, &s_data  );
+            H5Tclose( string_type4 );
+            H5Tclose( string_type5 );
             if (status < 0) {
                 std::string errorMsg("Exception while writing section description in stfio::exportHDF5File");
                 H5Fclose(file_id);
-                H5close();
                 throw std::runtime_error(errorMsg);
             }
             H5Gclose(section_group);
@@ -292,20 +713,32 @@ bool stfio::exportHDF5File(const std::string& fName, const Recording& WData, Pro
         throw std::runtime_error(errorMsg);
     }
 
-    /* Release all hdf5 resources */
-    status = H5close();
-    if (status < 0) {
-        std::string errorMsg("Exception while closing file in stfio::exportHDF5File");
-        throw std::runtime_error(errorMsg);
-    }
-    
     return (status >= 0);
 }
 
-void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg) {
-    /* Create a new file using default properties. */
-    hid_t file_id = H5Fopen(fName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-    
+// Returns the byte offset of a contiguous, uncompressed single-precision
+// dataset in the file, or HADDR_UNDEF if its samples can't be memory-mapped.
+static haddr_t mappableOffset(hid_t file_id, const char* path, hsize_t npoints) {
+    hid_t dataset_id = H5Dopen2(file_id, path, H5P_DEFAULT);
+    if (dataset_id < 0) {
+        return HADDR_UNDEF;
+    }
+    haddr_t offset = HADDR_UNDEF;
+    hid_t type_id = H5Dget_type(dataset_id);
+    hid_t plist_id = H5Dget_create_plist(dataset_id);
+    if (H5Pget_layout(plist_id) == H5D_CONTIGUOUS &&
+        H5Tequal(type_id, H5T_IEEE_F32LE) > 0 &&
+        H5Dget_storage_size(dataset_id) == npoints*sizeof(float))
+    {
+        offset = H5Dget_offset(dataset_id);
+    }
+    H5Pclose(plist_id);
+    H5Tclose(type_id);
+    H5Dclose(dataset_id);
+    return offset;
+}
+
+static void readRoot(hid_t file_id, rt& root) {
     /* H5TBread_table
        const int NRECORDS = 1;*/
     const int NFIELDS    = 3;
@@ -314,16 +747,231 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
     size_t rt_offset[NFIELDS] = {  HOFFSET( rt, channels ),
                                    HOFFSET( rt, date ),
                                    HOFFSET( rt, time )};
-    rt rt_buf[1];
-    size_t rt_sizes[NFIELDS] = { sizeof( rt_buf[0].channels),
-                                 sizeof( rt_buf[0].date),
-                                 sizeof( rt_buf[0].time)};
-    herr_t status=H5TBread_table( file_id, "description", sizeof(rt), rt_offset, rt_sizes, rt_buf );
+    size_t rt_sizes[NFIELDS] = { sizeof( root.channels),
+                                 sizeof( root.date),
+                                 sizeof( root.time)};
+    herr_t status=H5TBread_table( file_id, "description", sizeof(rt), rt_offset, rt_sizes, &root );
     if (status < 0) {
         std::string errorMsg("Exception while reading description in stfio::importHDF5File");
         throw std::runtime_error(errorMsg);
     }
+}
+
+static int readSectionCount(hid_t channel_group) {
+    /* Calculate the size and the offsets of our struct members in memory */
+    size_t ct_offset[1] = { HOFFSET( ct, n_sections ) };
+    ct ct_buf[1];
+    size_t ct_sizes[1] = { sizeof( ct_buf[0].n_sections) };
+    herr_t status=H5TBread_table( channel_group, "description", sizeof(ct), ct_offset, ct_sizes, ct_buf );
+    if (status < 0) {
+        std::string errorMsg("Exception while reading channel description in stfio::importHDF5File");
+        throw std::runtime_error(errorMsg);
+    }
+    return ct_buf[0].n_sections;
+}
+
+// Reads the sections of a channel in the legacy layout:
+static void readLegacy(hid_t file_id, hid_t channel_group, const std::string& channel_path,
+                       const stfio::MappedFilePtr& mapped, bool swap, int n_c, int numberChannels,
+                       double& dt, std::string& yunits, Channel& TempChannel, stfio::ProgressInfo& progDlg) {
+    int n_sections = readSectionCount(channel_group);
+    TempChannel.resize(n_sections);
+
+    for (int n_s=0; n_s < n_sections; ++n_s) {
+        int progbar =
+            // Channel contribution:
+            (int)(((double)n_c/(double)numberChannels)*100.0+
+                  // Section contribution:
+                  (double)(n_s)/(double)n_sections*(100.0/numberChannels));
+        std::ostringstream progStr;
+        progStr << "Reading channel #" << n_c + 1 << " of " << numberChannels
+                << ", Section #" << n_s+1 << " of " << n_sections;
+        progDlg.Update(progbar, progStr.str());
+
+        // construct a section name:
+        std::ostringstream section_name;
+        section_name << "sec" << n_s;
+
+        // open the child group in the channel:
+        std::string section_path = sectionPath(channel_path, n_s, n_sections);
+        hid_t section_group = H5Gopen2(file_id, section_path.c_str(), H5P_DEFAULT );
+
+        std::string data_path = section_path + "/data";
+        hsize_t sdims;
+        H5T_class_t sclass_id;
+        size_t stype_size;
+        herr_t status = H5LTget_dataset_info( file_id, data_path.c_str(), &sdims, &sclass_id, &stype_size );
+        if (status < 0) {
+            std::string errorMsg("Exception while reading data information in stfio::importHDF5File");
+            throw std::runtime_error(errorMsg);
+        }
+        haddr_t offset = HADDR_UNDEF;
+        if (mapped) {
+            offset = mappableOffset(file_id, data_path.c_str(), sdims);
+        }
+        if (offset != HADDR_UNDEF) {
+            stfio::RawSamples raw(mapped, (std::size_t)offset, sizeof(float), sdims,
+                                  stfio::sample_float32, swap);
+            TempChannel.InsertSection(Section(raw, section_name.str()),n_s);
+        } else {
+            Vector_double TempSectionT(sdims);
+            // the library converts the samples to double:
+            if (sdims > 0) {
+                status = H5LTread_dataset(file_id, data_path.c_str(), H5T_NATIVE_DOUBLE, &TempSectionT[0]);
+                if (status < 0) {
+                    std::string errorMsg("Exception while reading data in stfio::importHDF5File");
+                    throw std::runtime_error(errorMsg);
+                }
+            }
+            TempChannel.InsertSection(Section(std::move(TempSectionT), section_name.str()),n_s);
+        }
+
+        /* H5TBread_table
+           const int NSRECORDS = 1; */
+        const int NSFIELDS    = 3;
+
+        /* Calculate the size and the offsets of our struct members in memory */
+        size_t st_offset[NSFIELDS] = {  HOFFSET( st, dt ),
+                                        HOFFSET( st, xunits ),
+                                        HOFFSET( st, yunits )};
+        st st_buf[1];
+        size_t st_sizes[NSFIELDS] = { sizeof( st_buf[0].dt),
+                                      sizeof( st_buf[0].xunits),
+                                      sizeof( st_buf[0].yunits)};
+        status=H5TBread_table( section_group, "description", sizeof(st), st_offset, st_sizes, st_buf );
+        if (status < 0) {
+            std::string errorMsg("Exception while reading data description in stfio::importHDF5File");
+            throw std::runtime_error(errorMsg);
+        }
+        dt = st_buf[0].dt;
+        yunits = st_buf[0].yunits;
+        H5Gclose( section_group );
+    }
+}
+
+// Returns the byte offset of a contiguous, unfiltered dataset of the chunked
+// layout and its sample type, or HADDR_UNDEF if its samples can't be memory-mapped.
+static haddr_t mappableOffset(const chunked_channel& channel, stfio::sample_type& type,
+                              std::size_t& sample_size) {
+    haddr_t offset = HADDR_UNDEF;
+    hid_t type_id = H5Dget_type(channel.dataset);
+    hid_t plist_id = H5Dget_create_plist(channel.dataset);
+    if (H5Pget_layout(plist_id) == H5D_CONTIGUOUS) {
+        if (H5Tequal(type_id, H5T_STD_I16LE) > 0) {
+            type = stfio::sample_int16; sample_size = 2;
+        } else if (H5Tequal(type_id, H5T_STD_I32LE) > 0) {
+            type = stfio::sample_int32; sample_size = 4;
+        } else if (H5Tequal(type_id, H5T_IEEE_F32LE) > 0) {
+            type = stfio::sample_float32; sample_size = 4;
+        } else {
+            sample_size = 0;
+        }
+        hsize_t n_samples = channel.lengths.size()*channel.width;
+        if (sample_size > 0 && n_samples > 0 &&
+            H5Dget_storage_size(channel.dataset) == n_samples*sample_size) {
+            offset = H5Dget_offset(channel.dataset);
+        }
+    }
+    H5Pclose(plist_id);
+    H5Tclose(type_id);
+    return offset;
+}
+
+// Reads the sections of a channel in the chunked layout:
+static void readChunked(hid_t channel_group, const stfio::MappedFilePtr& mapped, bool swap,
+                        int n_c, int numberChannels, double& dt, std::string& yunits,
+                        Channel& TempChannel, stfio::ProgressInfo& progDlg) {
+    chunked_channel channel;
+    openChunked(channel_group, channel);
+    dt = channel.dt;
+    yunits = channel.yunits;
+    std::size_t n_sections = channel.lengths.size();
+    TempChannel.resize(n_sections);
+
+    try {
+        stfio::sample_type type = stfio::sample_float32;
+        std::size_t sample_size = 0;
+        haddr_t offset = HADDR_UNDEF;
+        if (mapped) {
+            offset = mappableOffset(channel, type, sample_size);
+        }
+
+        // read blocks of rows, as far as possible in whole chunks:
+        hsize_t rows = std::max<hsize_t>(1, block_bytes/(std::max<hsize_t>(channel.width, 1)*sizeof(double)));
+        hid_t plist_id = H5Dget_create_plist(channel.dataset);
+        if (H5Pget_layout(plist_id) == H5D_CHUNKED) {
+            hsize_t chunk[2];
+            if (H5Pget_chunk(plist_id, 2, chunk) == 2) {
+                rows = std::max<hsize_t>(1, (rows/chunk[0])*chunk[0]);
+            }
+        }
+        H5Pclose(plist_id);
+        Vector_double block(offset == HADDR_UNDEF ? rows*channel.width : 0);
+
+        for (std::size_t first = 0; first < n_sections; first += rows) {
+            std::size_t count = std::min<std::size_t>(rows, n_sections-first);
+            int progbar = (int)(((double)n_c + (double)first/(double)n_sections)*100.0/numberChannels);
+            std::ostringstream progStr;
+            progStr << "Reading channel #" << n_c + 1 << " of " << numberChannels
+                    << ", Section #" << first+1 << " of " << n_sections;
+            progDlg.Update(progbar, progStr.str());
+
+            if (offset == HADDR_UNDEF && channel.width > 0) {
+                readRows(channel, first, count, 0, channel.width, &block[0]);
+            }
+            for (std::size_t r = 0; r < count; ++r) {
+                std::size_t n_s = first + r;
+                std::string section_name = channel.descriptions[n_s];
+                if (section_name.empty()) {
+                    std::ostringstream sec; sec << "sec" << n_s;
+                    section_name = sec.str();
+                }
+                if (offset != HADDR_UNDEF) {
+                    stfio::RawSamples raw(mapped, (std::size_t)offset + n_s*channel.width*sample_size,
+                                          sample_size, channel.lengths[n_s], type, swap,
+                                          channel.scale, channel.offset);
+                    TempChannel.InsertSection(Section(raw, section_name), n_s);
+                } else {
+                    Vector_double::const_iterator row = block.begin() + r*channel.width;
+                    TempChannel.InsertSection(Section(Vector_double(row, row+channel.lengths[n_s]), section_name), n_s);
+                }
+            }
+        }
+    }
+    catch (...) {
+        H5Dclose(channel.dataset);
+        throw;
+    }
+    H5Dclose(channel.dataset);
+}
+
+void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg) {
+    /* Create a new file using default properties. */
+    hid_t file_id = H5Fopen(fName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+
+    // Large files keep their samples in a memory mapping instead of being read:
+    stfio::MappedFilePtr mapped;
+    if (UseMapping(fName)) {
+        try {
+            mapped.reset(new stfio::MappedFile(fName));
+        }
+        catch (const std::exception&) {
+            mapped.reset();
+        }
+    }
+    // little-endian samples need to be swapped on big-endian hosts:
+    const short one = 1;
+    bool swap = (*(const char*)&one == 0);
+    
+    rt rt_buf[1];
+    readRoot(file_id, rt_buf[0]);
     int numberChannels =rt_buf[0].channels;
+    int layout = readLayout(file_id);
+    if (layout != stfio::hdf5_legacy && layout != stfio::hdf5_chunked) {
+        H5Fclose(file_id);
+        throw std::runtime_error("Unknown layout in stfio::importHDF5File");
+    }
+    herr_t status = 0;
     if ( ReturnData.SetDate(rt_buf[0].date)
       || ReturnData.SetTime(rt_buf[0].time) ) {
         std::cout << "Warning HDF5: could not decode date/time " << rt_buf[0].date << " " << rt_buf[0].time << std::endl;
@@ -364,142 +1012,30 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
             }
         }
     }
+    H5Gclose(group_id);
     ReturnData.SetComment(comment);
 
     double dt = 1.0;
     std::string yunits = "";
     for (int n_c=0;n_c<numberChannels;++n_c) {
-        /* Calculate the size and the offsets of our struct members in memory */
-        size_t ct_offset[NFIELDS] = { HOFFSET( ct, n_sections ) };
-        ct ct_buf[1];
-        size_t ct_sizes[NFIELDS] = { sizeof( ct_buf[0].n_sections) };
-
-        /* Read channel name */
-        hsize_t cdims;
-        H5T_class_t cclass_id;
-        size_t ctype_size;
-        std::ostringstream desc_path;
-        desc_path << "/channels/ch" << (n_c);
-        status = H5LTget_dataset_info( file_id, desc_path.str().c_str(), &cdims, &cclass_id, &ctype_size );
-        if (status < 0) {
-            std::string errorMsg("Exception while reading channel in stfio::importHDF5File");
-            throw std::runtime_error(errorMsg);
-        }
-        hid_t string_typec= H5Tcopy( H5T_C_S1 );
-        H5Tset_size( string_typec,  ctype_size );
-        std::vector<char> szchannel_name(ctype_size);
-        // szchannel_name.reset( new char[ctype_size] );
-        status = H5LTread_dataset(file_id, desc_path.str().c_str(), string_typec, &szchannel_name[0] );
-        if (status < 0) {
-            std::string errorMsg("Exception while reading channel name in stfio::importHDF5File");
-            throw std::runtime_error(errorMsg);
-        }
-        std::ostringstream channel_name;
-        for (std::size_t c=0; c<ctype_size; ++c) {
-            channel_name << szchannel_name[c];
-        }
+        std::string channel_name = readChannelName(file_id, n_c);
+        std::string channel_path = "/" + channel_name;
 
-        std::ostringstream channel_path;
-        channel_path << "/" << channel_name.str();
-
-        hid_t channel_group = H5Gopen2(file_id, channel_path.str().c_str(), H5P_DEFAULT );
-        status=H5TBread_table( channel_group, "description", sizeof(ct), ct_offset, ct_sizes, ct_buf );
-        if (status < 0) {
-            std::string errorMsg("Exception while reading channel description in stfio::importHDF5File");
-            throw std::runtime_error(errorMsg);
-        }
-        Channel TempChannel(ct_buf[0].n_sections);
-        TempChannel.SetChannelName( channel_name.str() );
-        int max_log10 = 0;
-        if (ct_buf[0].n_sections > 1) {
-            max_log10 = int(log10((double)ct_buf[0].n_sections-1.0));
-        }
-
-        for (int n_s=0; n_s < ct_buf[0].n_sections; ++n_s) {
-            int progbar =
-                // Channel contribution:
-                (int)(((double)n_c/(double)numberChannels)*100.0+
-                      // Section contribution:
-                      (double)(n_s)/(double)ct_buf[0].n_sections*(100.0/numberChannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << n_c + 1 << " of " << numberChannels
-                    << ", Section #" << n_s+1 << " of " << ct_buf[0].n_sections;
-            progDlg.Update(progbar, progStr.str());
-            
-            // construct a number with leading zeros:
-            int n10 = 0;
-            if (n_s > 0) {
-                n10 = int(log10((double)n_s));
-            }
-            std::ostringstream strZero; strZero << "";
-            for (int n_z=n10; n_z < max_log10; ++n_z) {
-                strZero << "0";
-            }
-
-            // construct a section name:
-            std::ostringstream section_name;
-            section_name << "sec" << n_s;
-
-            // create a child group in the channel:
-            std::ostringstream section_path;
-            section_path << channel_path.str() << "/" << "section_" << strZero.str() << n_s;
-            hid_t section_group = H5Gopen2(file_id, section_path.str().c_str(), H5P_DEFAULT );
-
-            std::ostringstream data_path; data_path << section_path.str() << "/data";
-            hsize_t sdims;
-            H5T_class_t sclass_id;
-            size_t stype_size;
-            status = H5LTget_dataset_info( file_id, data_path.str().c_str(), &sdims, &sclass_id, &stype_size );
-            if (status < 0) {
-                std::string errorMsg("Exception while reading data information in stfio::importHDF5File");
-                throw std::runtime_error(errorMsg);
-            }
-            Vector_float TempSection(sdims);
-            status = H5LTread_dataset(file_id, data_path.str().c_str(), H5T_IEEE_F32LE, &TempSection[0]);
-            if (status < 0) {
-                std::string errorMsg("Exception while reading data in stfio::importHDF5File");
-                throw std::runtime_error(errorMsg);
-            }
-
-            Section TempSectionT(TempSection.size(), section_name.str());
-            for (std::size_t cp = 0; cp < TempSectionT.size(); ++cp) {
-                TempSectionT[cp] = double(TempSection[cp]);
-            }
-            // std::copy(TempSection.begin(),TempSection.end(),&TempSectionT[0]);
-            try {
-                TempChannel.InsertSection(TempSectionT,n_s);
-            }
-            catch (...) {
-                throw;
-            }
-
-
-            /* H5TBread_table
-               const int NSRECORDS = 1; */
-            const int NSFIELDS    = 3;
-
-            /* Calculate the size and the offsets of our struct members in memory */
-            size_t st_offset[NSFIELDS] = {  HOFFSET( st, dt ),
-                                            HOFFSET( st, xunits ),
-                                            HOFFSET( st, yunits )};
-            st st_buf[1];
-            size_t st_sizes[NSFIELDS] = { sizeof( st_buf[0].dt),
-                                          sizeof( st_buf[0].xunits),
-                                          sizeof( st_buf[0].yunits)};
-            status=H5TBread_table( section_group, "description", sizeof(st), st_offset, st_sizes, st_buf );
-            if (status < 0) {
-                std::string errorMsg("Exception while reading data description in stfio::importHDF5File");
-                throw std::runtime_error(errorMsg);
-            }
-            dt = st_buf[0].dt;
-            yunits = st_buf[0].yunits;
-            H5Gclose( section_group );
+        hid_t channel_group = H5Gopen2(file_id, channel_path.c_str(), H5P_DEFAULT );
+        Channel TempChannel;
+        if (layout == stfio::hdf5_legacy) {
+            readLegacy(file_id, channel_group, channel_path, mapped, swap,
+                       n_c, numberChannels, dt, yunits, TempChannel, progDlg);
+        } else {
+            readChunked(channel_group, mapped, swap, n_c, numberChannels,
+                        dt, yunits, TempChannel, progDlg);
         }
+        TempChannel.SetChannelName( channel_name );
         try {
             if ((int)ReturnData.size()<numberChannels) {
                 ReturnData.resize(numberChannels);
             }
-            ReturnData.InsertChannel(TempChannel,n_c);
+            ReturnData.InsertChannel(std::move(TempChannel),n_c);
             ReturnData[n_c].SetYUnits( yunits );
         }
         catch (...) {
@@ -515,14 +1051,172 @@ void stfio::importHDF5File(const std::string& fName, Recording& ReturnData, Prog
         std::string errorMsg("Exception while closing file in stfio::importHDF5File");
         throw std::runtime_error(errorMsg);
     }
+}
 
-    /* Release all hdf5 resources */
-    status = H5close();
-    if (status < 0) {
-        std::string errorMsg("Exception while closing file in stfio::exportHDF5File");
-        throw std::runtime_error(errorMsg);
+
+
+struct stfio::HDF5Reader::Impl {
+    Impl() : file_id(-1), layout(stfio::hdf5_legacy) {}
+
+    hid_t file_id;
+    int layout;
+    std::vector<std::string> names;
+    // chunked layout:
+    std::vector<chunked_channel> chunked;
+    // legacy layout, number of samples of every section:
+    std::vector< std::vector<std::size_t> > lengths;
+
+    void close() {
+        for (std::size_t n_c = 0; n_c < chunked.size(); ++n_c) {
+            if (chunked[n_c].dataset >= 0) {
+                H5Dclose(chunked[n_c].dataset);
+            }
+        }
+        chunked.clear();
+        if (file_id >= 0) {
+            H5Fclose(file_id);
+            file_id = -1;
+        }
+    }
+};
+
+stfio::HDF5Reader::HDF5Reader(const std::string& fName)
+    : impl(new Impl)
+{
+    try {
+        impl->file_id = H5Fopen(fName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (impl->file_id < 0) {
+            throw std::runtime_error("Couldn't open " + fName + " in stfio::HDF5Reader");
+        }
+        rt root;
+        readRoot(impl->file_id, root);
+        impl->layout = readLayout(impl->file_id);
+        if (impl->layout != stfio::hdf5_legacy && impl->layout != stfio::hdf5_chunked) {
+            throw std::runtime_error("Unknown layout in stfio::HDF5Reader");
+        }
+        for (int n_c = 0; n_c < root.channels; ++n_c) {
+            impl->names.push_back(readChannelName(impl->file_id, n_c));
+            std::string channel_path = "/" + impl->names.back();
+            hid_t channel_group = H5Gopen2(impl->file_id, channel_path.c_str(), H5P_DEFAULT);
+            if (channel_group < 0) {
+                throw std::runtime_error("Couldn't open " + channel_path + " in stfio::HDF5Reader");
+            }
+            try {
+                if (impl->layout == stfio::hdf5_chunked) {
+                    impl->chunked.push_back(chunked_channel());
+                    openChunked(channel_group, impl->chunked.back());
+                } else {
+                    int n_sections = readSectionCount(channel_group);
+                    impl->lengths.push_back(std::vector<std::size_t>(n_sections));
+                    for (int n_s = 0; n_s < n_sections; ++n_s) {
+                        std::string data_path = sectionPath(channel_path, n_s, n_sections) + "/data";
+                        hsize_t sdims;
+                        H5T_class_t sclass_id;
+                        size_t stype_size;
+                        if (H5LTget_dataset_info(impl->file_id, data_path.c_str(), &sdims, &sclass_id, &stype_size) < 0) {
+                            throw std::runtime_error("Exception while reading data information in stfio::HDF5Reader");
+                        }
+                        impl->lengths.back()[n_s] = sdims;
+                    }
+                }
+            }
+            catch (...) {
+                if (impl->layout == stfio::hdf5_chunked) {
+                    // openChunked has closed the dataset already:
+                    impl->chunked.pop_back();
+                }
+                H5Gclose(channel_group);
+                throw;
+            }
+            H5Gclose(channel_group);
+        }
+    }
+    catch (...) {
+        impl->close();
+        delete impl;
+        throw;
     }
-    
 }
 
+stfio::HDF5Reader::~HDF5Reader() {
+    impl->close();
+    delete impl;
+}
 
+stfio::hdf5_layout stfio::HDF5Reader::GetLayout() const {
+    return stfio::hdf5_layout(impl->layout);
+}
+
+std::size_t stfio::HDF5Reader::size() const {
+    return impl->names.size();
+}
+
+std::size_t stfio::HDF5Reader::size(std::size_t channel) const {
+    if (channel >= impl->names.size()) {
+        throw std::out_of_range("channel index out of range in stfio::HDF5Reader::size");
+    }
+    if (impl->layout == stfio::hdf5_chunked) {
+        return impl->chunked[channel].lengths.size();
+    }
+    return impl->lengths[channel].size();
+}
+
+std::size_t stfio::HDF5Reader::size(std::size_t channel, std::size_t section) const {
+    if (section >= size(channel)) {
+        throw std::out_of_range("section index out of range in stfio::HDF5Reader::size");
+    }
+    if (impl->layout == stfio::hdf5_chunked) {
+        return impl->chunked[channel].lengths[section];
+    }
+    return impl->lengths[channel][section];
+}
+
+const std::string& stfio::HDF5Reader::GetChannelName(std::size_t channel) const {
+    if (channel >= impl->names.size()) {
+        throw std::out_of_range("channel index out of range in stfio::HDF5Reader::GetChannelName");
+    }
+    return impl->names[channel];
+}
+
+Vector_double stfio::HDF5Reader::read(std::size_t channel, std::size_t section,
+                                      std::size_t start, std::size_t n) const
+{
+    std::size_t length = size(channel, section);
+    if (start > length) {
+        throw std::out_of_range("start index out of range in stfio::HDF5Reader::read");
+    }
+    if (n == std::size_t(-1)) {
+        n = length - start;
+    }
+    if (n > length - start) {
+        throw std::out_of_range("window exceeds section in stfio::HDF5Reader::read");
+    }
+    Vector_double samples(n);
+    if (n == 0) {
+        return samples;
+    }
+    if (impl->layout == stfio::hdf5_chunked) {
+        readRows(impl->chunked[channel], section, 1, start, n, &samples[0]);
+        return samples;
+    }
+
+    // legacy layout, one dataset per section:
+    std::string data_path = sectionPath("/" + impl->names[channel], (int)section,
+                                        (int)impl->lengths[channel].size()) + "/data";
+    hid_t dataset = H5Dopen2(impl->file_id, data_path.c_str(), H5P_DEFAULT);
+    if (dataset < 0) {
+        throw std::runtime_error("Exception while opening " + data_path + " in stfio::HDF5Reader::read");
+    }
+    hsize_t offset = start, count = n;
+    hid_t file_space = H5Dget_space(dataset);
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &offset, NULL, &count, NULL);
+    hid_t mem_space = H5Screate_simple(1, &count, NULL);
+    herr_t status = H5Dread(dataset, H5T_NATIVE_DOUBLE, mem_space, file_space, H5P_DEFAULT, &samples[0]);
+    H5Sclose(mem_space);
+    H5Sclose(file_space);
+    H5Dclose(dataset);
+    if (status < 0) {
+        throw std::runtime_error("Exception while reading " + data_path + " in stfio::HDF5Reader::read");
+    }
+    return samples;
+}
@@ -26,8 +26,27 @@ class Recording;
 
 namespace stfio {
 
+//! Layouts of the samples in a HDF5 file.
+enum hdf5_layout {
+    hdf5_legacy = 1, /*!< A group with a float32 dataset and a description table for each section. */
+    hdf5_chunked = 2 /*!< A 2-D dataset (sections x samples) for each channel, in the type of the samples
+                          (16- or 32-bit integers with scale and offset, or float32), and a table of
+                          the lengths and descriptions of the sections. */
+};
+
+//! Options for writing HDF5 files.
+struct StfioDll HDF5Options {
+    //! Default constructor: stfio::hdf5_chunked without compression.
+    HDF5Options();
+
+    hdf5_layout layout; /*!< Layout of the samples. */
+    int deflate;        /*!< Deflate (gzip) level from 1 to 9, or 0 for no compression. Only for stfio::hdf5_chunked. */
+    bool shuffle;       /*!< Apply the byte shuffle filter, which improves compression. Only for stfio::hdf5_chunked. */
+};
+
 //! Open a HDF5 file and store its contents to a Recording object.
-/*! \param fName Full path to the file to be read.
+/*! Reads both layouts.
+ *  \param fName Full path to the file to be read.
  *  \param ReturnData On entry, an empty Recording object. On exit,
  *         the data stored in \e fName.
  *  \param progress True if the progress dialog should be updated.
@@ -37,9 +56,63 @@ void importHDF5File(const std::string& fName, Recording& ReturnData, ProgressInf
 //! Export a Recording to a HDF5 file.
 /*! \param fName Full path to the file to be written.
  *  \param WData The data to be exported.
+ *  \param options Layout and compression.
  *  \return The HDF5 file handle.
  */
-StfioDll  bool exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg);
+StfioDll  bool exportHDF5File(const std::string& fName, const Recording& WData, ProgressInfo& progDlg,
+                              const HDF5Options& options = HDF5Options());
+
+//! Reads single sections, or time windows of sections, from a HDF5 file.
+/*! Only the requested samples are read from the file. Reads both layouts.
+ *  Like the other HDF5 functions, it must not be used from several threads at once.
+ */
+class StfioDll HDF5Reader {
+public:
+    //! Opens a file.
+    /*! Throws std::runtime_error if the file can't be read.
+     *  \param fName Full path to the file.
+     */
+    explicit HDF5Reader(const std::string& fName);
+
+    //! Closes the file.
+    ~HDF5Reader();
+
+    //! The layout of the file.
+    hdf5_layout GetLayout() const;
+
+    //! The number of channels.
+    std::size_t size() const;
+
+    //! The number of sections of a channel.
+    /*! Throws std::out_of_range if the channel doesn't exist. */
+    std::size_t size(std::size_t channel) const;
+
+    //! The number of samples of a section.
+    /*! Throws std::out_of_range if the section doesn't exist. */
+    std::size_t size(std::size_t channel, std::size_t section) const;
+
+    //! The name of a channel.
+    const std::string& GetChannelName(std::size_t channel) const;
+
+    //! Reads a window of a section.
+    /*! Throws std::out_of_range if the window exceeds the section.
+     *  \param channel Index of the channel.
+     *  \param section Index of the section.
+     *  \param start Index of the first sample.
+     *  \param n Number of samples; by default, up to the end of the section.
+     *  \return The samples in physical units.
+     */
+    Vector_double read(std::size_t channel, std::size_t section,
+                       std::size_t start = 0, std::size_t n = std::size_t(-1)) const;
+
+private:
+    // not copyable:
+    HDF5Reader(const HDF5Reader&);
+    HDF5Reader& operator=(const HDF5Reader&);
+
+    struct Impl;
+    Impl* impl;
+};
 
 }
 
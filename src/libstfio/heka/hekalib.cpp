@@ -727,8 +727,54 @@ std::string time2date(double t) {
     return datestr;
 }
 
+// A trace that is converted from the memory-mapped file to its section:
+struct TraceJob {
+    TraceJob(const stfio::RawSamples& raw_, double* dest_) : raw(raw_), dest(dest_) {}
+
+    stfio::RawSamples raw;
+    double* dest;
+};
+
+bool traceBefore(const TraceJob& lhs, const TraceJob& rhs) {
+    return lhs.raw.offset < rhs.raw.offset;
+}
+
+// Converts the traces in the order of their file offsets, so that the file
+// is read sequentially. Batches of traces are converted in parallel;
+// returns false if the user has cancelled.
+bool ConvertTraces(std::vector<TraceJob>& jobs, stfio::ProgressInfo& progDlg) {
+    // bytes of samples per batch between progress updates:
+    const std::size_t batch_bytes = 32*1024*1024;
+    std::sort(jobs.begin(), jobs.end(), traceBefore);
+    int njobs = (int)jobs.size();
+    int last = 0;
+    for (int first=0; first<njobs; first=last) {
+        std::size_t bytes = 0;
+        for (last=first; last<njobs && bytes<batch_bytes; ++last) {
+            bytes += jobs[last].raw.size*jobs[last].raw.stride;
+        }
+        std::ostringstream progStr;
+        progStr << "Reading trace #" << first + 1 << " of " << njobs;
+        bool skip = false;
+        progDlg.Update((int)((double)first/(double)njobs*100.0), progStr.str(), &skip);
+        if (skip) {
+            return false;
+        }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int nj=first; nj<last; ++nj) {
+            jobs[nj].raw.convert(0, jobs[nj].raw.size, jobs[nj].dest);
+        }
+    }
+    return true;
+}
+
+// If file is not empty, the samples are converted from the memory-mapped
+// file instead of being read from fh. If lazy is true, they stay in the
+// mapping until they are needed.
 void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
-              stfio::ProgressInfo& progDlg)
+              stfio::ProgressInfo& progDlg, const stfio::MappedFilePtr& file, bool lazy)
 {
 
     int nsweeps = tree.SweepList.size();
@@ -737,28 +783,68 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
     int nchannels = ntraces/nsweeps;
     RecordingInOut.resize(nchannels);
     int res = 0;
+    std::vector<TraceJob> jobs;
     for (int nc=0; nc<nchannels; ++nc) {
         RecordingInOut[nc].resize(nsweeps);
         for (int ns=0; ns<nsweeps; ++ns) {
             // nstree=nc; nstree<ntraces; nstree += nchannels) {
             // int ns = nstree/nchannels;
             int nstree = (ns*nchannels)+nc;
-            int progbar =
-                // Channel contribution:
-                (int)(((double)nc/(double)nchannels)*100.0+
-                      // Section contribution:
-                      (double)ns/(double)nsweeps*(100.0/nchannels));
-            std::ostringstream progStr;
-            progStr << "Reading channel #" << nc + 1 << " of " << nchannels
-                    << ", Section #" << ns + 1 << " of " << nsweeps;
-            bool skip = false;
-            progDlg.Update(progbar, progStr.str(), &skip);
-            if (skip) {
-                RecordingInOut.resize(0);
-                return;
+            // converted traces show their progress in ConvertTraces():
+            if (!file || lazy) {
+                int progbar =
+                    // Channel contribution:
+                    (int)(((double)nc/(double)nchannels)*100.0+
+                          // Section contribution:
+                          (double)ns/(double)nsweeps*(100.0/nchannels));
+                std::ostringstream progStr;
+                progStr << "Reading channel #" << nc + 1 << " of " << nchannels
+                        << ", Section #" << ns + 1 << " of " << nsweeps;
+                bool skip = false;
+                progDlg.Update(progbar, progStr.str(), &skip);
+                if (skip) {
+                    RecordingInOut.resize(0);
+                    return;
+                }
             }
 
+            double factor = 1.0;
+            if (std::string(tree.TraceList[nc].TrYUnit) == "V") {
+                RecordingInOut[nc].SetYUnits("mV");
+                factor = 1.0e3;
+            } else if (std::string(tree.TraceList[nc].TrYUnit) == "A") {
+                RecordingInOut[nc].SetYUnits("pA");
+                factor = 1.0e12;
+            } else {
+                RecordingInOut[nc].SetYUnits(tree.TraceList[nc].TrYUnit);
+            }
+            factor *=  tree.TraceList[nc].TrDataScaler;
+
             int npoints = tree.TraceList[nstree].TrDataPoints;
+            if (file) {
+                stfio::sample_type type;
+                std::size_t width;
+                switch (int(tree.TraceList[nstree].TrDataFormat)) {
+                 case 0: type = stfio::sample_int16; width = sizeof(short); break;
+                 case 1: type = stfio::sample_int32; width = sizeof(int); break;
+                 case 2: type = stfio::sample_float32; width = sizeof(float); break;
+                 case 3: type = stfio::sample_float64; width = sizeof(double); break;
+                 default:
+                     throw std::runtime_error("Unknown data format while reading heka file");
+                }
+                stfio::RawSamples raw(file, tree.TraceList[nstree].TrData, width, npoints,
+                                      type, tree.needsByteSwap, factor,
+                                      tree.TraceList[nc].TrZeroData);
+                if (lazy) {
+                    RecordingInOut[nc][ns] = Section(raw);
+                } else {
+                    RecordingInOut[nc][ns].resize(npoints);
+                    if (npoints > 0) {
+                        jobs.push_back(TraceJob(raw, &RecordingInOut[nc][ns].get_w()[0]));
+                    }
+                }
+                continue;
+            }
             RecordingInOut[nc][ns].resize(npoints);
 
             fseek(fh, tree.TraceList[nstree].TrData, SEEK_SET);
@@ -811,23 +897,15 @@ void ReadData(FILE* fh, const Tree& tree, Recording& RecordingInOut,
              default:
                  throw std::runtime_error("Unknown data format while reading heka file");
             }
-            double factor = 1.0;
-            if (std::string(tree.TraceList[nc].TrYUnit) == "V") {
-                RecordingInOut[nc].SetYUnits("mV");
-                factor = 1.0e3;
-            } else if (std::string(tree.TraceList[nc].TrYUnit) == "A") {
-                RecordingInOut[nc].SetYUnits("pA");
-                factor = 1.0e12;
-            } else {
-                RecordingInOut[nc].SetYUnits(tree.TraceList[nc].TrYUnit);
-            }
-            factor *=  tree.TraceList[nc].TrDataScaler;
-            RecordingInOut[nc][ns].get_w() = stfio::vec_scal_mul(RecordingInOut[nc][ns].get(), factor);
-            RecordingInOut[nc][ns].get_w() = stfio::vec_scal_plus(RecordingInOut[nc][ns].get(), tree.TraceList[nc].TrZeroData);
+            stfio::TraceOps().mul(factor).plus(tree.TraceList[nc].TrZeroData).apply(RecordingInOut[nc][ns].get_w());
         }
         RecordingInOut[nc].SetChannelName(tree.TraceList[nc].TrLabel);
         
     }
+    if (!ConvertTraces(jobs, progDlg)) {
+        RecordingInOut.resize(0);
+        return;
+    }
     double tsc = 1.0;
     std::string xunits(tree.TraceList[0].TrXUnit);
     if (xunits == "s") {
@@ -920,8 +998,19 @@ void stfio::importHEKAFile(const std::string &fName, Recording &ReturnData, Prog
     // Now set pointer to the start of the data
     fseek(dat_fh, start, SEEK_SET);
 
+    // Samples are converted from a memory mapping of the file; large files
+    // keep their samples in the mapping until they are needed:
+    stfio::MappedFilePtr file;
+    bool lazy = stfio::UseMapping(fName);
+    try {
+        file.reset(new stfio::MappedFile(fName));
+    }
+    catch (const std::exception&) {
+        file.reset();
+    }
+
     // NOW IMPORT
-    ReadData(dat_fh, tree, ReturnData, progDlg);
+    ReadData(dat_fh, tree, ReturnData, progDlg, file, lazy);
 
     // Close file
     fclose(dat_fh);
@@ -165,8 +165,6 @@ stfio::exportIGORFile(const std::string& fileBase,const Recording& Data, Progres
         // Write the data:
         Vector_double cpData(wh.npnts);
 
-        // One unnecessary copy operation due to const-correctness (couldn't const_cast<>)
-        Channel TempChannel(Data[n_c]);
         for (std::size_t n_s=0;n_s<Data[n_c].size();++n_s) {
             std::ostringstream progStr;
             progStr << "Writing channel #" << (int)n_c + 1 << " of " << (int)Data.size()
@@ -180,12 +178,12 @@ stfio::exportIGORFile(const std::string& fileBase,const Recording& Data, Progres
             );
 
             // std::copy is faster than explicitly assigning to cpData[c][s][p]
-            if (n_s*wh.nDim[0]+Data[n_c][n_s].size() > cpData.size() ||
-                Data[n_c][n_s].size() > TempChannel[n_s].size()) {
+            if (n_s*wh.nDim[0]+Data[n_c][n_s].size() > cpData.size()) {
                     throw std::out_of_range("Out of range exception in WriteVersion5NumericWave");
             }
-            std::copy( TempChannel[n_s].get_w().begin(), 
-                       TempChannel[n_s].get_w().begin()+Data[n_c][n_s].size(),
+            stfio::SharedSamplesPtr samples = Data[n_c][n_s].get_shared();
+            std::copy( samples->begin(),
+                       samples->end(),
                        &cpData[n_s*wh.nDim[0]] );
         }
         err=WriteVersion5NumericWave( fr, &wh, &cpData[0], waveNote.c_str(),
@@ -24,6 +24,8 @@ http://www.intantech.com/files/Intan_CLAMP_software_compiled_v1_0.zip
 as of 2016-11-05
 */
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "intanlib.h"
@@ -185,52 +187,88 @@ IntanHeader read_header(BinaryReader& binreader) {
     return hIntan;
 }
 
-std::vector<std::vector<float> > read_data(BinaryReader& binreader, const IntanHeader& hIntan) {
+// Data records are read in blocks of about this size:
+static const std::size_t block_bytes = 1 << 20;
+
+static bool is_big_endian() {
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 0;
+}
+
+// Little-endian fields of a data record:
+static inline uint16_t get_uint16(const unsigned char* data) {
+    return data[0] | (data[1] << 8);
+}
+
+static inline float get_float(const unsigned char* data, bool swap) {
+    unsigned char tmp[4] = { data[0], data[1], data[2], data[3] };
+    if (swap) {
+        std::swap(tmp[0], tmp[3]);
+        std::swap(tmp[1], tmp[2]);
+    }
+    float value;
+    std::memcpy(&value, tmp, sizeof(value));
+    return value;
+}
+
+std::vector<Vector_double> read_data(BinaryReader& binreader, const IntanHeader& hIntan) {
+    // Each record holds a timestamp, the applied value and both channels:
+    const std::size_t record_bytes = 4+4+4+4;
     uint64_t bytes_remaining = binreader.bytesRemaining();
-    uint64_t length = bytes_remaining / (4+4+4+4);
-    std::vector<uint32_t> timestamps(length);
-    std::vector<float> applied(length);
-    std::vector<float> totalClamp(length);
-    std::vector<std::vector<float> > channels(2);
+    uint64_t length = bytes_remaining / record_bytes;
+    std::vector<Vector_double> channels(2);
     channels[0].resize(length);
     channels[1].resize(length);
-    for (unsigned int idata = 0; idata < length; ++idata) {
-        binreader >> timestamps[idata];
-        binreader >> applied[idata]; 
-        binreader >> channels[1][idata];
-        binreader >> channels[0][idata];
-        float vfactor = 1e3; // V -> mV
-        float ifactor = 1e12; // A -> pA
-        if (hIntan.Settings.isVoltageClamp) {
-            channels[0][idata] *= ifactor;
-            channels[1][idata] *= vfactor;
-        } else {
-            channels[1][idata] *= ifactor;
-            channels[0][idata] *= vfactor;
+
+    float vfactor = 1e3; // V -> mV
+    float ifactor = 1e12; // A -> pA
+    float factor0 = ifactor, factor1 = vfactor;
+    if (!hIntan.Settings.isVoltageClamp) {
+        factor0 = vfactor;
+        factor1 = ifactor;
+    }
+    // Samples are rounded to float as in the file; timestamps and
+    // applied values are not used:
+    const bool swap = is_big_endian();
+    const std::size_t block_records = block_bytes / record_bytes;
+    std::vector<unsigned char> block(std::min<uint64_t>(length, block_records) * record_bytes);
+    for (uint64_t first = 0; first < length; first += block_records) {
+        std::size_t n = std::min<uint64_t>(length - first, block_records);
+        binreader.read(reinterpret_cast<char*>(&block[0]), n * record_bytes);
+        const unsigned char* record = &block[0];
+        double* ch0 = &channels[0][first];
+        double* ch1 = &channels[1][first];
+        for (std::size_t idata = 0; idata < n; ++idata, record += record_bytes) {
+            ch1[idata] = float(get_float(record + 8, swap) * factor1);
+            ch0[idata] = float(get_float(record + 12, swap) * factor0);
         }
     }
 
     return channels;
 }
 
-std::vector<std::vector<float> > read_aux_data(BinaryReader& binreader, uint16_t numADCs) {
+std::vector<Vector_double> read_aux_data(BinaryReader& binreader, uint16_t numADCs) {
+    // Each record holds a timestamp, digital in and out and the ADC samples:
+    const std::size_t record_bytes = 4+2+2+2*numADCs;
     uint64_t bytes_remaining = binreader.bytesRemaining();
-    uint64_t length = bytes_remaining / (4+2+2+2*numADCs);
-    std::vector<uint32_t> timestamps(length);
-    std::vector<uint16_t> digitalIn(length);
-    std::vector<uint16_t> digitalOut(length);
-    std::vector<std::vector<float> > adc(numADCs);
+    uint64_t length = bytes_remaining / record_bytes;
+    std::vector<Vector_double> adc(numADCs);
     for (unsigned int iadc = 0; iadc < numADCs; ++iadc) {
         adc[iadc].resize(length);
     }
-    for (unsigned int idata = 0; idata < length; ++idata) {
-        binreader >> timestamps[idata];
-        binreader >> digitalIn[idata]; 
-        binreader >> digitalOut[idata];
+
+    // timestamps and digital lines are not used:
+    const std::size_t block_records = std::max<std::size_t>(1, block_bytes / record_bytes);
+    std::vector<unsigned char> block(std::min<uint64_t>(length, block_records) * record_bytes);
+    for (uint64_t first = 0; first < length; first += block_records) {
+        std::size_t n = std::min<uint64_t>(length - first, block_records);
+        binreader.read(reinterpret_cast<char*>(&block[0]), n * record_bytes);
         for (unsigned int iadc = 0; iadc < numADCs; ++iadc) {
-            uint16_t tmpui;
-            binreader >> tmpui;
-            adc[iadc][idata] = tmpui*0.0003125 - (1<<15);
+            const unsigned char* sample = &block[0] + 8 + 2*iadc;
+            double* dest = &adc[iadc][first];
+            for (std::size_t idata = 0; idata < n; ++idata, sample += record_bytes) {
+                dest[idata] = float(get_uint16(sample)*0.0003125 - (1<<15));
+            }
         }
     }
 
@@ -252,7 +290,7 @@ void stfio::importIntanFile(const std::string &fName, Recording &ReturnData, Pro
 
     IntanHeader hIntan = read_header(*binreader);
     if (hIntan.datatype == 0) {
-        std::vector<std::vector<float> > channels = read_data(*binreader, hIntan);
+        std::vector<Vector_double> channels = read_data(*binreader, hIntan);
         ReturnData.resize(channels.size());
         ReturnData.SetXScale(1e3/hIntan.Settings.samplingRate);
         ReturnData.SetXUnits("ms");
@@ -273,9 +311,7 @@ void stfio::importIntanFile(const std::string &fName, Recording &ReturnData, Pro
         }
         unsigned int nsec = 0;
         for (unsigned int nchan = 0; nchan < channels.size(); ++nchan) {
-            ReturnData[nchan][nsec].resize(channels[nchan].size());
-            std::copy(channels[nchan].begin(), channels[nchan].end(),
-                      ReturnData[nchan][nsec].get_w().begin());
+            ReturnData[nchan][nsec].get_w().swap(channels[nchan]);
         }
 
         // for (std::vector<Segment>::const_iterator it = hIntan.Settings.waveform.begin();
@@ -291,11 +327,10 @@ void stfio::importIntanFile(const std::string &fName, Recording &ReturnData, Pro
         // }
 
     } else {
-        std::vector<std::vector<float> > aux_data = read_aux_data(*binreader, hIntan.numADCs);
+        std::vector<Vector_double> aux_data = read_aux_data(*binreader, hIntan.numADCs);
         ReturnData.resize(1);
         ReturnData[0].resize(1);
-        ReturnData[0][0].resize(aux_data[0].size());
-        std::copy(aux_data[0].begin(), aux_data[0].end(), ReturnData[0][0].get_w().begin());
+        ReturnData[0][0].get_w().swap(aux_data[0]);
     }
 
 }
@@ -111,6 +111,16 @@ int FileInStream::read(char* data, int len) {
 BinaryReader::~BinaryReader() {
 }
 
+void BinaryReader::read(char* data, uint64_t len) {
+    const int max_len = 1 << 30;
+    while (len > 0) {
+        int n = (len > (uint64_t)max_len) ? max_len : static_cast<int>(len);
+        other->read(data, n);
+        data += n;
+        len -= n;
+    }
+}
+
 BinaryReader& operator>>(BinaryReader& istream, int32_t& value) {
     unsigned char data[4];
     istream.other->read(reinterpret_cast<char*>(data), 4);
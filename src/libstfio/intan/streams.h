@@ -92,6 +92,9 @@ public:
     uint64_t bytesRemaining() { return other->bytesRemaining();  }
     std::istream::pos_type currentPos() { return other->currentPos(); }
 
+    // Reads len raw bytes, e.g. a block of data records:
+    void read(char* data, uint64_t len);
+
 protected:
     friend BinaryReader& operator>>(BinaryReader& istream, int32_t& value);
     friend BinaryReader& operator>>(BinaryReader& istream, uint32_t& value);
@@ -0,0 +1,280 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#include "./stfio.h"
+
+namespace {
+
+    // Files from this size on are mapped rather than read:
+    std::size_t mapping_threshold = std::size_t(512)*1024*1024;
+
+    template <typename T>
+    inline double load(const char* src, bool swap) {
+        char buf[sizeof(T)];
+        if (swap) {
+            for (std::size_t nb=0; nb<sizeof(T); ++nb)
+                buf[nb] = src[sizeof(T)-1-nb];
+        } else {
+            memcpy(buf, src, sizeof(T));
+        }
+        T raw;
+        memcpy(&raw, buf, sizeof(T));
+        return (double)raw;
+    }
+
+    template <typename T>
+    void load_n(const char* src, std::size_t stride, std::size_t n, bool swap,
+                double scale, double shift, double* dest)
+    {
+        // One loop without branches for each case, so that the
+        // compiler can vectorize the contiguous ones:
+        if (swap) {
+            for (std::size_t ns=0; ns<n; ++ns, src+=stride)
+                dest[ns] = load<T>(src, true)*scale + shift;
+        } else if (stride == sizeof(T)) {
+            for (std::size_t ns=0; ns<n; ++ns) {
+                T raw;
+                memcpy(&raw, src + ns*sizeof(T), sizeof(T));
+                dest[ns] = (double)raw*scale + shift;
+            }
+        } else {
+            for (std::size_t ns=0; ns<n; ++ns, src+=stride)
+                dest[ns] = load<T>(src, false)*scale + shift;
+        }
+    }
+}
+
+stfio::MappedFile::MappedFile(const std::string& fName)
+    : base(NULL), length(0), owns_mapping(true)
+#ifdef _WIN32
+    , hFile(INVALID_HANDLE_VALUE), hMapping(NULL)
+#endif
+{
+#ifdef _WIN32
+    hFile = CreateFileA(fName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error(std::string("Couldn't open ") + fName);
+    }
+    LARGE_INTEGER fsize;
+    if (!GetFileSizeEx(hFile, &fsize)) {
+        CloseHandle(hFile);
+        throw std::runtime_error(std::string("Couldn't get size of ") + fName);
+    }
+    length = (std::size_t)fsize.QuadPart;
+    if (length == 0) {
+        return;
+    }
+    hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL) {
+        CloseHandle(hFile);
+        throw std::runtime_error(std::string("Couldn't map ") + fName);
+    }
+    base = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (base == NULL) {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        throw std::runtime_error(std::string("Couldn't map ") + fName);
+    }
+#else
+    int fd = open(fName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Couldn't open ") + fName);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error(std::string("Couldn't get size of ") + fName);
+    }
+    length = (std::size_t)st.st_size;
+    if (length == 0) {
+        close(fd);
+        return;
+    }
+    void* addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor has been closed:
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error(std::string("Couldn't map ") + fName);
+    }
+    base = (const char*)addr;
+#endif
+}
+
+stfio::MappedFile::MappedFile(const char* data_, std::size_t size_)
+    : base(data_), length(size_), owns_mapping(false)
+#ifdef _WIN32
+    , hFile(INVALID_HANDLE_VALUE), hMapping(NULL)
+#endif
+{}
+
+stfio::SharedSamplesFile::SharedSamplesFile(const SharedSamplesPtr& samples_)
+    : MappedFile(samples_->empty() ? NULL : (const char*)&(*samples_)[0],
+                 samples_->size()*sizeof(double)),
+      samples(samples_)
+{}
+
+stfio::MappedFile::~MappedFile() {
+    if (!owns_mapping) {
+        return;
+    }
+#ifdef _WIN32
+    if (base != NULL) UnmapViewOfFile(base);
+    if (hMapping != NULL) CloseHandle(hMapping);
+    if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+#else
+    if (base != NULL) munmap((void*)base, length);
+#endif
+}
+
+stfio::RawSamples::RawSamples(const MappedFilePtr& file_, std::size_t offset_, std::size_t stride_,
+                              std::size_t size_, sample_type type_, bool swap_,
+                              double scale_, double shift_)
+    : file(file_), offset(offset_), stride(stride_), size(size_), type(type_),
+      swap(swap_), scale(scale_), shift(shift_)
+{
+    std::size_t width = 2;
+    switch (type) {
+     case sample_int16: width = 2; break;
+     case sample_int32: width = 4; break;
+     case sample_float32: width = 4; break;
+     case sample_float64: width = 8; break;
+    }
+    if (!file) {
+        throw std::runtime_error("RawSamples: no file");
+    }
+    if (size > 0 && offset + (size-1)*stride + width > file->size()) {
+        throw std::out_of_range("RawSamples: samples exceed the end of the file");
+    }
+}
+
+double stfio::RawSamples::value(std::size_t at) const {
+    const char* src = file->data() + offset + at*stride;
+    double raw = 0;
+    switch (type) {
+     case sample_int16: raw = load<short>(src, swap); break;
+     case sample_int32: raw = load<int>(src, swap); break;
+     case sample_float32: raw = load<float>(src, swap); break;
+     case sample_float64: raw = load<double>(src, swap); break;
+    }
+    return raw*scale + shift;
+}
+
+void stfio::RawSamples::convert(std::size_t start, std::size_t n, double* dest) const {
+    if (start > size || n > size-start) {
+        throw std::out_of_range("RawSamples::convert: window out of range");
+    }
+    if (n == 0) {
+        return;
+    }
+    const char* src = file->data() + offset + start*stride;
+    switch (type) {
+     case sample_int16: load_n<short>(src, stride, n, swap, scale, shift, dest); break;
+     case sample_int32: load_n<int>(src, stride, n, swap, scale, shift, dest); break;
+     case sample_float32: load_n<float>(src, stride, n, swap, scale, shift, dest); break;
+     case sample_float64: load_n<double>(src, stride, n, swap, scale, shift, dest); break;
+    }
+}
+
+stfio::MappedSamples::MappedSamples(const RawSamples& raw_)
+    : parts(1, raw_), starts(2, 0), cache()
+{
+    starts[1] = raw_.size;
+}
+
+stfio::MappedSamples::MappedSamples(const std::vector<RawSamples>& parts_)
+    : parts(parts_), starts(1, 0), cache()
+{
+    for (std::size_t np=0; np<parts.size(); ++np) {
+        starts.push_back(starts.back() + parts[np].size);
+    }
+}
+
+double stfio::MappedSamples::part_value(std::size_t at) const {
+    // the last part whose first sample is not after at:
+    std::size_t np = std::upper_bound(starts.begin(), starts.end()-1, at) - starts.begin() - 1;
+    return parts[np].value(at - starts[np]);
+}
+
+void stfio::MappedSamples::convert(std::size_t start, std::size_t n, double* dest) const {
+    if (start > size() || n > size()-start) {
+        throw std::out_of_range("MappedSamples::convert: window out of range");
+    }
+    if (n == 0) {
+        return;
+    }
+    std::size_t np = std::upper_bound(starts.begin(), starts.end()-1, start) - starts.begin() - 1;
+    for (; n > 0; ++np) {
+        std::size_t offset = start - starts[np];
+        std::size_t count = std::min(n, parts[np].size - offset);
+        parts[np].convert(offset, count, dest);
+        start += count;
+        dest += count;
+        n -= count;
+    }
+}
+
+stfio::SharedSamplesPtr stfio::MappedSamples::values() const {
+    SharedSamplesPtr samples;
+#if (__cplusplus < 201103)
+    #pragma omp critical (stfio_mapped_samples)
+#else
+    std::lock_guard<std::mutex> lock(cache_mutex);
+#endif
+    {
+        samples = cache.lock();
+        if (!samples) {
+            samples.reset(new Vector_double(size()));
+            if (size()) convert(0, size(), &(*samples)[0]);
+            cache = samples;
+        }
+    }
+    return samples;
+}
+
+std::size_t stfio::GetMappingThreshold() {
+    return mapping_threshold;
+}
+
+void stfio::SetMappingThreshold(std::size_t bytes) {
+    mapping_threshold = bytes;
+}
+
+bool stfio::UseMapping(const std::string& fName) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!GetFileAttributesExA(fName.c_str(), GetFileExInfoStandard, &fad))
+        return false;
+    unsigned long long fsize = ((unsigned long long)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(fName.c_str(), &st) != 0)
+        return false;
+    unsigned long long fsize = (unsigned long long)st.st_size;
+#endif
+    return fsize > 0 && fsize >= (unsigned long long)mapping_threshold;
+}
@@ -0,0 +1,262 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file mappedfile.h
+ *  \brief Declares memory-mapped sample storage for sections.
+ */
+
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#if (__cplusplus < 201103)
+#  include <boost/shared_ptr.hpp>
+#  include <boost/weak_ptr.hpp>
+#else
+#  include <memory>
+#  include <mutex>
+#endif
+
+namespace stfio {
+
+/*! \addtogroup stfio
+ *  @{
+ */
+
+//! A read-only memory mapping of a whole file.
+/*! Throws std::runtime_error if the file can't be mapped.
+ *  The mapping is released when the object is destroyed.
+ *  Derived classes can provide memory that is owned by someone else,
+ *  such as the buffer of a NumPy array.
+ */
+class StfioDll MappedFile {
+public:
+    //! Constructor
+    /*! \param fName The full path of the file to be mapped.
+     */
+    explicit MappedFile(const std::string& fName);
+
+    //! Destructor
+    virtual ~MappedFile();
+
+    //! Pointer to the first byte of the file.
+    const char* data() const { return base; }
+
+    //! Size of the file in bytes.
+    std::size_t size() const { return length; }
+
+protected:
+    //! Constructor for memory that is owned by a derived class
+    /*! The memory is not released by this class and has to stay valid
+     *  until the object is destroyed.
+     *  \param data_ Pointer to the first byte.
+     *  \param size_ Size in bytes.
+     */
+    MappedFile(const char* data_, std::size_t size_);
+
+private:
+    // not copyable:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* base;
+    std::size_t length;
+    // false if the memory is owned by a derived class:
+    bool owns_mapping;
+#ifdef _WIN32
+    void* hFile;
+    void* hMapping;
+#endif
+};
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<MappedFile> MappedFilePtr;
+typedef boost::shared_ptr<Vector_double> SharedSamplesPtr;
+#else
+typedef std::shared_ptr<MappedFile> MappedFilePtr;
+//! Samples in memory that are shared by several sections until one of them writes to them.
+typedef std::shared_ptr<Vector_double> SharedSamplesPtr;
+#endif
+
+//! Presents samples that are shared with a section as a mapped file.
+/*! Lets views such as a concatenation refer to sections in memory in the
+ *  same way as to sections in a file. The samples are kept alive, and are
+ *  never written to: a section that shares them copies them before write access.
+ */
+class StfioDll SharedSamplesFile : public MappedFile {
+public:
+    //! Constructor
+    /*! \param samples_ The shared samples.
+     */
+    explicit SharedSamplesFile(const SharedSamplesPtr& samples_);
+
+private:
+    SharedSamplesPtr samples;
+};
+
+//! Data types of samples that can be read from a memory-mapped file.
+enum sample_type {
+    sample_int16,   /*!< 16-bit signed integer. */
+    sample_int32,   /*!< 32-bit signed integer. */
+    sample_float32, /*!< 32-bit IEEE floating point. */
+    sample_float64  /*!< 64-bit IEEE floating point. */
+};
+
+//! Describes where and how the samples of a section are stored in a file.
+/*! Sample \e i is read from byte offset + i*stride of the file and
+ *  converted to raw*scale + shift.
+ */
+struct StfioDll RawSamples {
+    //! Constructor
+    /*! \param file_ The memory-mapped file.
+     *  \param offset_ Byte offset of the first sample.
+     *  \param stride_ Bytes from one sample to the next; larger than the sample
+     *         size for multiplexed data.
+     *  \param size_ Number of samples.
+     *  \param type_ Data type of the samples in the file.
+     *  \param swap_ True if the byte order of the file differs from the host's.
+     *  \param scale_ Factor that converts a raw value to physical units.
+     *  \param shift_ Offset that is added after scaling.
+     */
+    RawSamples(const MappedFilePtr& file_, std::size_t offset_, std::size_t stride_,
+               std::size_t size_, sample_type type_, bool swap_ = false,
+               double scale_ = 1.0, double shift_ = 0.0);
+
+    //! Converts a single sample.
+    /*! \param at Sample index. Not range-checked.
+     *  \return The converted value.
+     */
+    double value(std::size_t at) const;
+
+    //! Converts a window of samples.
+    /*! Throws std::out_of_range if the window exceeds the samples.
+     *  \param start Index of the first sample.
+     *  \param n Number of samples.
+     *  \param dest Array of at least \e n doubles that will contain the converted values.
+     */
+    void convert(std::size_t start, std::size_t n, double* dest) const;
+
+    MappedFilePtr file;  /*!< The memory-mapped file. */
+    std::size_t offset;  /*!< Byte offset of the first sample. */
+    std::size_t stride;  /*!< Bytes from one sample to the next. */
+    std::size_t size;    /*!< Number of samples. */
+    sample_type type;    /*!< Data type of the samples in the file. */
+    bool swap;           /*!< True if the byte order needs to be swapped. */
+    double scale;        /*!< Factor that converts a raw value to physical units. */
+    double shift;        /*!< Offset that is added after scaling. */
+};
+
+//! Samples that stay in the file until they are needed.
+/*! The complete converted array is only built by values(), and only kept
+ *  as long as someone holds it. Single samples and windows are converted directly from the file, so
+ *  callers that only need a part of the samples should use value() or
+ *  convert() instead.
+ *  The samples can be made up of several parts that follow each other,
+ *  possibly in different files.
+ */
+class StfioDll MappedSamples {
+public:
+    //! Constructor
+    /*! \param raw_ Location and type of the samples.
+     */
+    explicit MappedSamples(const RawSamples& raw_);
+
+    //! Constructor for samples that are made up of several parts
+    /*! \param parts_ Location and type of the parts, in order.
+     */
+    explicit MappedSamples(const std::vector<RawSamples>& parts_);
+
+    //! Number of samples.
+    std::size_t size() const { return starts.back(); }
+
+    //! Tells whether the samples consist of a single part.
+    bool contiguous() const { return parts.size() == 1; }
+
+    //! Location and type of the samples.
+    /*! Only valid if contiguous() is true.
+     */
+    const RawSamples& get_raw() const { return parts.front(); }
+
+    //! Location and type of all parts.
+    const std::vector<RawSamples>& get_parts() const { return parts; }
+
+    //! Converts a single sample.
+    /*! \param at Sample index. Not range-checked.
+     *  \return The converted value.
+     */
+    double value(std::size_t at) const {
+        return contiguous() ? parts.front().value(at) : part_value(at);
+    }
+
+    //! Converts a window of samples, which may span several parts.
+    /*! Throws std::out_of_range if the window exceeds the samples.
+     *  \param start Index of the first sample.
+     *  \param n Number of samples.
+     *  \param dest Array of at least \e n doubles that will contain the converted values.
+     */
+    void convert(std::size_t start, std::size_t n, double* dest) const;
+
+    //! All converted samples; safe to call from several threads.
+    /*! Callers that ask while an earlier copy is still held get the same
+     *  copy. The copy is freed when the last holder releases it, and
+     *  converted again on the next call.
+     *  \return The converted samples.
+     */
+    SharedSamplesPtr values() const;
+
+private:
+    // not copyable:
+    MappedSamples(const MappedSamples&);
+    MappedSamples& operator=(const MappedSamples&);
+
+    // Looks up the part that contains a sample:
+    double part_value(std::size_t at) const;
+
+    std::vector<RawSamples> parts;
+    // Index of the first sample of each part, followed by the total size:
+    std::vector<std::size_t> starts;
+    // The converted copy while anyone holds it:
+#if (__cplusplus < 201103)
+    mutable boost::weak_ptr<Vector_double> cache;
+#else
+    mutable std::weak_ptr<Vector_double> cache;
+    mutable std::mutex cache_mutex;
+#endif
+};
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<MappedSamples> MappedSamplesPtr;
+#else
+typedef std::shared_ptr<MappedSamples> MappedSamplesPtr;
+#endif
+
+//! Returns the file size from which importers map samples instead of reading them.
+StfioDll std::size_t GetMappingThreshold();
+
+//! Sets the file size from which importers map samples instead of reading them.
+/*! Supported by the ABF2, HEKA and HDF5 importers.
+ *  \param bytes The threshold in bytes. 0 maps every file that can be mapped.
+ */
+StfioDll void SetMappingThreshold(std::size_t bytes);
+
+//! Tells an importer whether the samples of a file should be mapped.
+/*! \param fName The full path of the file.
+ *  \return True if the file size is at least GetMappingThreshold().
+ */
+StfioDll bool UseMapping(const std::string& fName);
+
+/*@}*/
+
+} // end of namespace
+
+#endif
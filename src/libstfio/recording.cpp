@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <ctime>
 #include <sstream>
+#include <algorithm>
 
 Recording::Recording(void)
     : ChannelArray(0)
@@ -32,6 +33,15 @@ Recording::Recording(const Channel& c_Channel)
     init();
 }
 
+#if (__cplusplus >= 201103)
+Recording::Recording(Channel&& c_Channel)
+    : ChannelArray(1)
+{
+    ChannelArray[0] = std::move(c_Channel);
+    init();
+}
+#endif
+
 Recording::Recording(const std::deque<Channel>& ChannelList)
     : ChannelArray(ChannelList)
 {
@@ -155,25 +165,16 @@ void Recording::SetDateTime(int year, int month, int mday,int hour, int minute,
 }
 
 void Recording::InsertChannel(Channel& c_Channel, std::size_t pos) {
-    try {
-        if ( ChannelArray.at(pos).size() <= c_Channel.size() ) {
-            ChannelArray.at(pos).resize( c_Channel.size() );
-        }
-        // Resize sections if necessary:
-        std::size_t n_sec = 0;
-        for ( sec_it sit = c_Channel.get().begin(); sit != c_Channel.get().end(); ++sit ) {
-            if ( ChannelArray.at(pos).at(n_sec).size() <= sit->size() ) {
-                ChannelArray.at(pos).at(n_sec).get_w().resize( sit->size() );
-            }
-            n_sec++;
-        }
-    }
-    catch (...) {
-        throw;
-    }
+    // assignment replaces the sections; resizing them first would only fill them with zeros:
     ChannelArray.at(pos) = c_Channel;
 }
 
+#if (__cplusplus >= 201103)
+void Recording::InsertChannel(Channel&& c_Channel, std::size_t pos) {
+    ChannelArray.at(pos) = std::move(c_Channel);
+}
+#endif
+
 void Recording::CopyAttributes(const Recording& c_Recording) {
     file_description=c_Recording.file_description;
     global_section_description=c_Recording.global_section_description;
@@ -290,51 +291,167 @@ void Recording::SetXScale(double value) {
     }
 }
 
+namespace {
+
+    // Data points per block of the mean; the running sums of a block stay
+    // in the cache while the sections are read one after the other:
+    const std::size_t average_block = 4096;
+
+    // Data points of all sections that are sorted at a time for the median:
+    const std::size_t median_scratch = std::size_t(1) << 20;
+
+    // Median of a, which is reordered:
+    double median(double* a, std::size_t n) {
+        double* mid = a + n/2;
+        std::nth_element(a, mid, a+n);
+        if (n % 2 == 1) {
+            return *mid;
+        }
+        // the lower middle is the largest value of the lower half:
+        return 0.5 * (*mid + *std::max_element(a, mid));
+    }
+
+}
+
 void Recording::MakeAverage(Section& AverageReturn,
         Section& SigReturn,
         std::size_t channel,
         const std::vector<std::size_t>& section_index,
         bool isSig,
-        const std::vector<int>& shift) const
+        const std::vector<int>& shift,
+        stfio::average_method method,
+        const Vector_double& weights) const
 {
     if (channel >= ChannelArray.size()) {
         throw std::out_of_range("Channel number out of range in Recording::MakeAverage");
     }
-    unsigned int n_sections = section_index.size();
+    std::size_t n_sections = section_index.size();
+    if (n_sections == 0) {
+        throw std::out_of_range("No sections selected in Recording::MakeAverage");
+    }
     if (shift.size() != n_sections) {
         throw std::out_of_range("Shift out of range in Recording::MakeAverage");
     }
-    for (unsigned int l = 0; l < n_sections; ++l) {
-        if (section_index[l] >= ChannelArray[channel].size()) {
+    if (method == stfio::average_weighted && weights.size() != n_sections) {
+        throw std::out_of_range("Weights out of range in Recording::MakeAverage");
+    }
+    const Channel& ch = ChannelArray[channel];
+    std::size_t n_points = AverageReturn.size();
+    if (isSig && SigReturn.size() != n_points) {
+        throw std::out_of_range("Standard deviation out of range in Recording::MakeAverage");
+    }
+    // sections and their first data points; each block is read with
+    // get_window(), so that memory-mapped samples are only converted one
+    // block at a time:
+    std::vector<const Section*> src;
+    std::vector<std::size_t> first;
+    src.reserve(n_sections);
+    first.reserve(n_sections);
+    // weight of each section, and the coefficients of the weighted Welford update:
+    Vector_double frac, m2frac;
+    frac.reserve(n_sections);
+    m2frac.reserve(n_sections);
+    double sum_w = 0, sum_w2 = 0;
+    for (std::size_t l = 0; l < n_sections; ++l) {
+        if (section_index[l] >= ch.size()) {
             throw std::out_of_range("Section number out of range in Recording::MakeAverage");
         }
-        if (AverageReturn.size() + shift[l] > ChannelArray[channel][section_index[l]].size()) {
+        if (shift[l] < 0 || n_points + shift[l] > ch[section_index[l]].size()) {
             throw std::out_of_range("Sampling point out of range in Recording::MakeAverage");
         }
+        double w = (method == stfio::average_weighted) ? weights[l] : 1.0;
+        if (w < 0) {
+            throw std::runtime_error("Negative weight in Recording::MakeAverage");
+        }
+        if (w == 0) {
+            continue;
+        }
+        src.push_back(&ch[section_index[l]]);
+        first.push_back(shift[l]);
+        double sum_w_last = sum_w;
+        sum_w += w;
+        sum_w2 += w*w;
+        frac.push_back(w/sum_w);
+        m2frac.push_back(w*sum_w_last/sum_w);
+    }
+    if (sum_w == 0) {
+        throw std::runtime_error("All weights are zero in Recording::MakeAverage");
     }
 
-    for (unsigned int k=0; k < AverageReturn.size(); ++k) {
-        AverageReturn[k]=0.0;
-        //Calculate average
-        for (unsigned int l = 0; l < n_sections; ++l) {
-            AverageReturn[k] += 
-                ChannelArray[channel][section_index[l]][k+shift[l]];
+    // set sample interval of averaged traces
+    AverageReturn.SetXScale(ch[section_index[0]].GetXScale());
+    if (n_points == 0) {
+        return;
+    }
+    double* avg = &AverageReturn.get_w()[0];
+    double* sig = isSig ? &SigReturn.get_w()[0] : NULL;
+    int n_used = (int)src.size();
+
+    if (method == stfio::average_median) {
+        // transpose a block of data points of all sections at a time, so that
+        // every section is still read sequentially:
+        std::size_t block = std::max(std::size_t(16), median_scratch/n_used);
+        int n_blocks = (int)((n_points + block - 1)/block);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int nb = 0; nb < n_blocks; ++nb) {
+            std::size_t start = nb*block;
+            std::size_t n = std::min(block, n_points-start);
+            Vector_double scratch(n*n_used);
+            for (int l = 0; l < n_used; ++l) {
+                Vector_double x(src[l]->get_window(first[l]+start, n));
+                for (std::size_t k = 0; k < n; ++k) {
+                    scratch[k*n_used + l] = x[k];
+                }
+            }
+            for (std::size_t k = 0; k < n; ++k) {
+                double* row = &scratch[k*n_used];
+                avg[start+k] = median(row, n_used);
+                if (isSig) {
+                    for (int l = 0; l < n_used; ++l) {
+                        row[l] = fabs(row[l] - avg[start+k]);
+                    }
+                    sig[start+k] = 1.4826 * median(row, n_used);
+                }
+            }
+        }
+        return;
+    }
+
+    // Bessel's correction for reliability weights; n-1 if all weights are 1:
+    double denom = sum_w - sum_w2/sum_w;
+    int n_blocks = (int)((n_points + average_block - 1)/average_block);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int nb = 0; nb < n_blocks; ++nb) {
+        std::size_t start = nb*average_block;
+        std::size_t n = std::min(average_block, n_points-start);
+        double* mean = avg + start;
+        std::fill(mean, mean+n, 0.0);
+        if (!isSig) {
+            for (int l = 0; l < n_used; ++l) {
+                Vector_double x(src[l]->get_window(first[l]+start, n));
+                double f = frac[l];
+                for (std::size_t k = 0; k < n; ++k) {
+                    mean[k] += f*(x[k] - mean[k]);
+                }
+            }
+            continue;
         }
-        AverageReturn[k] /= n_sections;
-
-        // set sample interval of averaged traces
-        AverageReturn.SetXScale(ChannelArray[channel][section_index[0]].GetXScale());
-
-        if (isSig) {
-            SigReturn[k]=0.0;
-            //Calculate variance
-            for (unsigned int l=0; l < n_sections; ++l) {
-                SigReturn[k] += 
-                    pow(ChannelArray[channel][section_index[l]][k+shift[l]] -
-                            AverageReturn[k], 2);
+        Vector_double m2(n, 0.0);
+        for (int l = 0; l < n_used; ++l) {
+            Vector_double x(src[l]->get_window(first[l]+start, n));
+            double f = frac[l], c = m2frac[l];
+            for (std::size_t k = 0; k < n; ++k) {
+                double delta = x[k] - mean[k];
+                mean[k] += f*delta;
+                m2[k] += c*delta*delta;
             }
-            SigReturn[k] /= (n_sections - 1);
-            SigReturn[k]=sqrt(SigReturn[k]);
+        }
+        for (std::size_t k = 0; k < n; ++k) {
+            sig[start+k] = (denom > 0) ? sqrt(m2[k]/denom) : 0.0;
         }
     }
 }
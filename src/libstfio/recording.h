@@ -33,6 +33,17 @@
 
 class Section;
 
+namespace stfio {
+
+//! Methods to average sections
+enum average_method {
+    average_mean     = 0, /*!< Mean and s.d. of the sections. */
+    average_weighted = 1, /*!< Weighted mean and s.d. of the sections. */
+    average_median   = 2  /*!< Median of the sections; the spread is estimated from the median absolute deviation. */
+};
+
+}
+
 //! Represents the data within a file.
 /*! Contains an array of channels that can be accessed either via at() (range-checked,
  *  will throw an exception if out of range) or the []-operator (range unchecked). Moreover
@@ -50,6 +61,13 @@ class StfioDll Recording {
      */
     explicit Recording(const Channel& c_Channel); 
 
+#if (__cplusplus >= 201103)
+    //! Constructor
+    /*! \param c_Channel The Channel that is moved into a new Recording.
+     */
+    explicit Recording(Channel&& c_Channel); 
+#endif
+
     //! Constructor
     /*! \param ChannelList A vector of channels from which to construct a new Recording.
      */
@@ -64,9 +82,25 @@ class StfioDll Recording {
      */
     explicit Recording( std::size_t c_n_channels, std::size_t c_n_sections = 0, std::size_t c_n_points = 0 );
 
+#if (__cplusplus >= 201103)
+    //! Copy constructor
+    Recording(const Recording& c_Recording) = default;
+
+    //! Move constructor; takes over the channels without copying them.
+    Recording(Recording&& c_Recording) = default;
+#endif
+
     //! Destructor
     virtual ~Recording();
 
+#if (__cplusplus >= 201103)
+    //! Copy assignment
+    Recording& operator=(const Recording& c_Recording) = default;
+
+    //! Move assignment; takes over the channels without copying them.
+    Recording& operator=(Recording&& c_Recording) = default;
+#endif
+
     //member access functions: read-----------------------------------
     
     //! Retrieves the number of sections in a channel.
@@ -300,6 +334,16 @@ class StfioDll Recording {
      */
     virtual void InsertChannel(Channel& c_Channel, std::size_t pos);
 
+#if (__cplusplus >= 201103)
+    //! Move a Channel to a given position.
+    /*! Same as InsertChannel(Channel&, std::size_t), but the sections are
+     *  taken over instead of being copied.
+     *  \param c_Channel The Channel to be inserted. Its contents are unspecified on return.
+     *  \param pos The position at which to insert the channel (0-based).
+     */
+    virtual void InsertChannel(Channel&& c_Channel, std::size_t pos);
+#endif
+
     //! Copy descriptive attributes from another Recording to this Recording.
     /*! This will copy the file and global section decription, the scaling, time, date, 
      *  comment and global y units strings and the x-scale.
@@ -308,7 +352,11 @@ class StfioDll Recording {
     void CopyAttributes(const Recording& c_Recording);
 
     //! Calculates an average of several traces.
-    /*! \param AverageReturn The average will be returned in this variable by passing 
+    /*! The sections are read one after the other in blocks of data points, so
+     *  that each section is only traversed once. Mean and standard deviation are
+     *  updated with Welford's method; blocks are processed in parallel if OpenMP
+     *  is available.
+     *  \param AverageReturn The average will be returned in this variable by passing 
      *         a reference. AverageReturn has to have the correct size upon entering 
      *         this function already, it won't be resized.
      *  \param SigReturn The standard deviation will be returned in this variable by 
@@ -320,10 +368,17 @@ class StfioDll Recording {
      *  \param isSig Set to true if the standard deviation should be calculated as well.
      *  \param shift A vector indicating by how many data points each section should be
      *         shifted before averaging.
+     *  \param method The kind of average. For stfio::average_median, SigReturn contains
+     *         1.4826 times the median absolute deviation, an estimate of the standard
+     *         deviation that is insensitive to outliers.
+     *  \param weights One non-negative weight per section for stfio::average_weighted.
+     *         The standard deviation treats them as reliability weights.
      */
     void MakeAverage( Section& AverageReturn, Section& SigReturn, std::size_t channel,
                       const std::vector<std::size_t>& section_index, bool isSig,
-                      const std::vector<int>& shift) const;
+                      const std::vector<int>& shift,
+                      stfio::average_method method = stfio::average_mean,
+                      const Vector_double& weights = Vector_double() ) const;
 
     //! Add a Recording at the end of this Recording.
     /*! \param toAdd The Recording to be added.
@@ -21,15 +21,31 @@
 // within the constructor, see [1]248 and [2]28
 
 Section::Section(void)
-    : section_description(), x_scale(1.0), data(0)
+    : section_description(), x_scale(1.0), data(new Vector_double(0))
 {}
 
 Section::Section( const Vector_double& valA, const std::string& label )
-    : section_description(label), x_scale(1.0), data(valA)
+    : section_description(label), x_scale(1.0), data(new Vector_double(valA))
 {}
 
+#if (__cplusplus >= 201103)
+Section::Section( Vector_double&& valA, const std::string& label )
+    : section_description(label), x_scale(1.0), data(new Vector_double(std::move(valA)))
+{}
+#endif
+
 Section::Section(std::size_t size, const std::string& label)
-    : section_description(label), x_scale(1.0), data(size)
+    : section_description(label), x_scale(1.0), data(new Vector_double(size))
+{}
+
+Section::Section(const stfio::RawSamples& raw, const std::string& label)
+    : section_description(label), x_scale(1.0), data(),
+      mapped(new stfio::MappedSamples(raw))
+{}
+
+Section::Section(const std::vector<stfio::RawSamples>& parts, const std::string& label)
+    : section_description(label), x_scale(1.0), data(),
+      mapped(new stfio::MappedSamples(parts))
 {}
 
 Section::~Section(void) {
@@ -37,19 +53,153 @@ Section::~Section(void) {
 
 
 double Section::at(std::size_t at_) const {
-    if (at_>=data.size()) {
+    if (at_>=size()) {
         std::out_of_range e("subscript out of range in class Section");
         throw (e);
     }
-    return data[at_];
+    return (*this)[at_];
 }
 
 double& Section::at(std::size_t at_) {
-    if (at_>=data.size()) {
+    prepare_write();
+    if (at_>=data->size()) {
         std::out_of_range e("subscript out of range in class Section");
         throw (e);
     }
-    return data[at_];
+    return (*data)[at_];
+}
+
+const Vector_double& Section::get() const {
+    if (!mapped) {
+        return data ? *data : empty();
+    }
+    // Concurrent callers get the same copy from the mapped samples:
+#if (__cplusplus < 201103)
+    stfio::SharedSamplesPtr values;
+    #pragma omp critical (stfio_section_converted)
+    {
+        if (!converted) {
+            converted = mapped->values();
+        }
+        values = converted;
+    }
+#else
+    stfio::SharedSamplesPtr values = std::atomic_load(&converted);
+    if (!values) {
+        values = mapped->values();
+        std::atomic_store(&converted, values);
+    }
+#endif
+    return *values;
+}
+
+stfio::SharedSamplesPtr Section::get_shared() const {
+    if (mapped) {
+        return mapped->values();
+    }
+    return data ? data : stfio::SharedSamplesPtr(new Vector_double(0));
+}
+
+Vector_double Section::get_window(std::size_t start, std::size_t n) const {
+    if (start>size() || n>size()-start) {
+        std::out_of_range e("window out of range in class Section");
+        throw (e);
+    }
+    Vector_double window(n);
+    if (n==0) {
+        return window;
+    }
+    if (mapped) {
+        mapped->convert(start, n, &window[0]);
+    } else {
+        std::copy(data->begin()+start, data->begin()+start+n, window.begin());
+    }
+    return window;
+}
+
+std::vector<stfio::RawSamples> Section::get_parts() const {
+    if (mapped) {
+        return mapped->get_parts();
+    }
+    std::vector<stfio::RawSamples> parts;
+    if (size() > 0) {
+        stfio::MappedFilePtr file(new stfio::SharedSamplesFile(data));
+        parts.push_back(stfio::RawSamples(file, 0, sizeof(double), data->size(), stfio::sample_float64));
+    }
+    return parts;
+}
+
+void Section::minmax(std::size_t start, std::size_t end, double& min, double& max) const {
+    if (start>=end || end>size()) {
+        std::out_of_range e("range out of range in class Section");
+        throw (e);
+    }
+    const std::size_t block = stfio::Envelope::block_size;
+    // short ranges are scanned directly:
+    if (end-start < 2*block) {
+        min = max = (*this)[start];
+        for (std::size_t n=start+1; n<end; ++n) {
+            double val = (*this)[n];
+            if (val < min) min = val;
+            if (val > max) max = val;
+        }
+        return;
+    }
+    // whole blocks are looked up in the envelope, the remainder at both ends is scanned:
+    std::size_t first_block = (start+block-1)/block;
+    std::size_t last_block = end/block;
+    get_envelope()->minmax(first_block, last_block, min, max);
+    for (std::size_t n=start; n<first_block*block; ++n) {
+        double val = (*this)[n];
+        if (val < min) min = val;
+        if (val > max) max = val;
+    }
+    for (std::size_t n=last_block*block; n<end; ++n) {
+        double val = (*this)[n];
+        if (val < min) min = val;
+        if (val > max) max = val;
+    }
+}
+
+stfio::EnvelopePtr Section::get_envelope() const {
+    // Several threads may ask for the envelope of the same section; at worst,
+    // it is built more than once.
+#if (__cplusplus < 201103)
+    stfio::EnvelopePtr env;
+    #pragma omp critical (stfio_section_envelope)
+    {
+        if (!envelope) {
+            envelope.reset(mapped ? new stfio::Envelope(*mapped) : new stfio::Envelope(get()));
+        }
+        env = envelope;
+    }
+#else
+    stfio::EnvelopePtr env = std::atomic_load(&envelope);
+    if (!env) {
+        env.reset(mapped ? new stfio::Envelope(*mapped) : new stfio::Envelope(get()));
+        std::atomic_store(&envelope, env);
+    }
+#endif
+    return env;
+}
+
+void Section::materialize() {
+    if (!mapped) {
+        return;
+    }
+    // a copy that is only held by this section is taken over, otherwise it is copied by detach():
+    data = converted ? converted : mapped->values();
+    converted.reset();
+    mapped.reset();
+}
+
+void Section::detach() {
+    data.reset(data ? new Vector_double(*data) : new Vector_double(0));
+}
+
+const Vector_double& Section::empty() {
+    static const Vector_double no_data;
+    return no_data;
 }
 
 void Section::SetXScale( double value ) {
@@ -32,6 +32,12 @@
  */
 
 //! Represents a continuously sampled sweep of data points
+/*! Copies of a section share its data points until one of them is written
+ *  to, which then copies the data points first. References that were
+ *  obtained with get_w() or operator[] therefore become invalid when a copy
+ *  of the section is written to, or when the section is written to after it
+ *  has been copied.
+ */
 class StfioDll Section {
 public:
     // Construction/Destruction-----------------------------------------------
@@ -47,6 +53,19 @@ public:
             const std::string& label="\0"
     );
 
+#if (__cplusplus >= 201103)
+    //! Constructor that takes over a vector of values
+    /*! Importers can decode into a vector and hand it over to the section
+     *  without copying the values.
+     *  \param valA A vector of values that will make up the section. It is empty on return.
+     *  \param label An optional section label string.
+     */
+    explicit Section(
+            Vector_double&& valA,
+            const std::string& label="\0"
+    );
+#endif
+
     //! Yet another constructor
     /*! \param size Number of data points.
      *  \param label An optional section label string.
@@ -56,21 +75,62 @@ public:
             const std::string& label="\0"
     );
 
+    //! Constructor for samples that stay in a memory-mapped file
+    /*! The samples are only converted to double when they are accessed.
+     *  Write access copies all samples into memory first.
+     *  \param raw Location and type of the samples in the file.
+     *  \param label An optional section label string.
+     */
+    explicit Section(
+            const stfio::RawSamples& raw,
+            const std::string& label="\0"
+    );
+
+    //! Constructor for a section that consists of parts of other storage
+    /*! Presents the parts as one section without copying them, for
+     *  example to concatenate sections. Write access copies all samples
+     *  into memory first.
+     *  \param parts Location and type of the parts, in order.
+     *  \param label An optional section label string.
+     */
+    explicit Section(
+            const std::vector<stfio::RawSamples>& parts,
+            const std::string& label="\0"
+    );
+
+#if (__cplusplus >= 201103)
+    //! Copy constructor; shares the data points until one of the sections is written to.
+    Section(const Section& c_Section) = default;
+
+    //! Move constructor; takes over the data points without copying them.
+    Section(Section&& c_Section) = default;
+#endif
+
     //! Destructor
     ~Section();
 
+#if (__cplusplus >= 201103)
+    //! Copy assignment; shares the data points until one of the sections is written to.
+    Section& operator=(const Section& c_Section) = default;
+
+    //! Move assignment; takes over the data points without copying them.
+    Section& operator=(Section&& c_Section) = default;
+#endif
+
     // Operators--------------------------------------------------------------
-    //! Unchecked access. Returns a non-const reference.
-    /*! \param at Data point index.
-     *  \return Copy of the data point with index at.
+    //! Unchecked write access. Returns a non-const reference.
+    /*! Copies memory-mapped or shared data points into memory first.
+     *  Read through a const Section& to avoid this.
+     *  \param at Data point index.
+     *  \return Reference to the data point with index at.
      */
-    double& operator[](std::size_t at) { return data[at]; }
+    double& operator[](std::size_t at) { prepare_write(); return (*data)[at]; }
 
     //! Unchecked access. Returns a copy.
     /*! \param at Data point index.
-     *  \return Reference to the data point with index at.
+     *  \return Copy of the data point with index at.
      */
-    double operator[](std::size_t at) const { return data[at]; }
+    double operator[](std::size_t at) const { return mapped ? mapped->value(at) : (*data)[at]; }
 
     // Public member functions------------------------------------------------
 
@@ -81,8 +141,9 @@ public:
      */
     double at(std::size_t at_) const;
 
-    //! Range-checked access. Returns a non-const reference.
-    /*! Throws std::out_of_range if out of range.
+    //! Range-checked write access. Returns a non-const reference.
+    /*! Throws std::out_of_range if out of range. Copies memory-mapped or
+     *  shared data points into memory first, like operator[].
      *  \param at_ Data point index.
      *  \return Reference to the data point at index at_
      */
@@ -90,29 +151,88 @@ public:
 
     //! Low-level access to the valarray (read-only).
     /*! An explicit function is used instead of implicit type conversion
-     *  to access the valarray.
+     *  to access the valarray. If the samples are memory-mapped, the first
+     *  call converts all of them, and the section keeps the converted copy
+     *  until release() is called or the section is written to. Use
+     *  get_window(), minmax() or the const operator[] to read only a part
+     *  of the section, or get_shared() to hold the copy only while it is needed.
      *  \return The valarray containing the data points.
      */
-    const Vector_double& get() const { return data; }
+    const Vector_double& get() const;
+
+    //! Shares all data points without keeping a copy in the section.
+    /*! Memory-mapped samples are converted into a copy that is freed when
+     *  the last holder of the pointer releases it. Data points in memory
+     *  are shared until the section is written to.
+     *  \return The data points.
+     */
+    stfio::SharedSamplesPtr get_shared() const;
+
+    //! Frees the copy of memory-mapped samples that get() keeps.
+    /*! References that were returned by get() are invalid afterwards.
+     */
+    void release() { converted.reset(); }
 
     //! Low-level access to the valarray (read and write).
     /*! An explicit function is used instead of implicit type conversion
      *  to access the valarray.
      *  \return The valarray containing the data points.
      */
-    Vector_double& get_w() { return data; }
+    Vector_double& get_w() { prepare_write(); return *data; }
 
     //! Resize the Section to a new number of data points; deletes all previously stored data when gcc is used.
     /*! Note that in the gcc implementation of std::vector, resizing will
      *  delete all the original data. This is different from std::vector::resize().
      *  \param new_size The new number of data points.
      */
-    void resize(std::size_t new_size) { data.resize(new_size); }
+    void resize(std::size_t new_size) { prepare_write(); data->resize(new_size); }
 
     //! Retrieve the number of data points.
     /*! \return The number of data points.
      */
-    size_t size() const { return data.size(); }
+    size_t size() const { return mapped ? mapped->size() : data ? data->size() : 0; }
+
+    //! Converts a range of data points.
+    /*! Only the requested window is read if the samples are memory-mapped.
+     *  Throws std::out_of_range if out of range.
+     *  \param start Index of the first data point.
+     *  \param n Number of data points.
+     *  \return A vector containing the data points.
+     */
+    Vector_double get_window(std::size_t start, std::size_t n) const;
+
+    //! Tells whether the samples are still in a memory-mapped file.
+    /*! \return True if the samples haven't been copied into memory yet.
+     */
+    bool is_mapped() const { return (bool)mapped; }
+
+    //! The memory-mapped samples.
+    /*! Holding a copy of the pointer keeps the mapping alive after write
+     *  access to the section.
+     *  \return The memory-mapped samples, or an empty pointer if the samples are in memory.
+     */
+    const stfio::MappedSamplesPtr& get_mapped() const { return mapped; }
+
+    //! Describes the data points as parts of files or of shared memory.
+    /*! The data points in memory are shared with the parts until the
+     *  section is written to. Used to build a section from other sections
+     *  without copying them.
+     *  \return Location and type of the parts, in order.
+     */
+    std::vector<stfio::RawSamples> get_parts() const;
+
+    //! Finds the extrema of a range of data points.
+    /*! Uses a min/max envelope of the section that is built on the first call
+     *  and dropped on the next write access, so that repeated calls only take
+     *  O(log(n)) time. Data points that are changed through a reference that
+     *  was obtained before the envelope was built are not seen by the envelope.
+     *  Throws std::out_of_range if the range is empty or out of range.
+     *  \param start Index of the first data point.
+     *  \param end Index past the last data point.
+     *  \param min On return, the smallest data point in the range.
+     *  \param max On return, the largest data point in the range.
+     */
+    void minmax(std::size_t start, std::size_t end, double& min, double& max) const;
 
     //! Sets the x scaling.
     /*! \param value The x scaling.
@@ -137,14 +257,42 @@ public:
  private:
     //Private members-------------------------------------------------------
 
+    // Copies memory-mapped or shared samples into data and drops the envelope before write access:
+    void prepare_write() {
+        if (mapped) materialize();
+        if (!data || data.use_count() > 1) detach();
+        if (envelope) envelope.reset();
+    }
+
+    // Moves memory-mapped samples into data, reusing a converted copy if there is one:
+    void materialize();
+
+    // Gives the section its own copy of shared data:
+    void detach();
+
+    // The data of a section that has been moved from:
+    static const Vector_double& empty();
+
+    // Returns the min/max envelope, building it if necessary:
+    stfio::EnvelopePtr get_envelope() const;
+
     // A description that is specific to this section:
     std::string section_description;
 
     // The sampling interval:
     double x_scale;
 
-    // The data:
-    Vector_double data;
+    // The data, shared with copies of the section, or empty if the section has been moved from:
+    stfio::SharedSamplesPtr data;
+
+    // Samples that are still in a memory-mapped file, or empty:
+    stfio::MappedSamplesPtr mapped;
+
+    // The copy of the memory-mapped samples that get() returns, or empty:
+    mutable stfio::SharedSamplesPtr converted;
+
+    // Min/max envelope of the data, or empty if it hasn't been built since the last write access:
+    mutable stfio::EnvelopePtr envelope;
 };
 
 /*@}*/
@@ -25,6 +25,16 @@
 
 
 #include <sstream>
+#include <fstream>
+#include <deque>
+#include <ctime>
+#if (__cplusplus >= 201103)
+#  include <mutex>
+#  include <condition_variable>
+#  include <thread>
+#  include <chrono>
+#  include <memory>
+#endif
 
 #include "stfio.h"
 
@@ -41,6 +51,7 @@
 #endif
 #include "./cfs/cfslib.h"
 #include "./intan/intanlib.h"
+#include "./tdms/tdmslib.h"
 
 #ifdef _MSC_VER
     StfioDll long int lround(double x) {
@@ -53,6 +64,29 @@
     }
 #endif
 
+namespace {
+
+    // Importers and exporters that rely on library-global state (file tables,
+    // the hdf5 library) must not run concurrently.
+    bool isReentrant(stfio::filetype type) {
+        switch (type) {
+         case stfio::abf:
+         case stfio::axg:
+         case stfio::heka:
+         case stfio::intan:
+         case stfio::tdms:
+         case stfio::biosig:
+             return true;
+         default:
+             return false;
+        }
+    }
+
+#if (__cplusplus >= 201103)
+    std::mutex io_mutex;
+#endif
+}
+
 stfio::StdoutProgressInfo::StdoutProgressInfo(const std::string& title, const std::string& message, int maximum, bool verbose)
     : ProgressInfo(title, message, maximum, verbose),
       verbosity(verbose)
@@ -159,6 +193,12 @@ bool stfio::importFile(
         }
 #endif
 
+#if (__cplusplus >= 201103)
+        std::unique_lock<std::mutex> lock(io_mutex, std::defer_lock);
+        if (!isReentrant(type)) {
+            lock.lock();
+        }
+#endif
         switch (type) {
         case stfio::hdf5: {
             stfio::importHDF5File(fName, ReturnData, progDlg);
@@ -184,6 +224,10 @@ bool stfio::importFile(
             stfio::importCFSFile(fName, ReturnData, progDlg);
             break;
            }
+        case stfio::tdms: {
+            stfio::importTDMSFile(fName, ReturnData, progDlg);
+            break;
+        }
         default:
             throw std::runtime_error("Unknown or unsupported file type");
 	}
@@ -197,8 +241,20 @@ bool stfio::importFile(
 
 bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Recording& Data,
                        ProgressInfo& progDlg)
+{
+    return stfio::exportFile(fName, type, Data, progDlg, stfio::HDF5Options());
+}
+
+bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Recording& Data,
+                       ProgressInfo& progDlg, const HDF5Options& hdf5Options)
 {
     try {
+#if (__cplusplus >= 201103)
+        std::unique_lock<std::mutex> lock(io_mutex, std::defer_lock);
+        if (!isReentrant(type)) {
+            lock.lock();
+        }
+#endif
         switch (type) {
         case stfio::atf: {
             stfio::exportATFFile(fName, Data);
@@ -215,7 +271,7 @@ bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Rec
             break;
         }
         case stfio::hdf5: {
-            stfio::exportHDF5File(fName, Data, progDlg);
+            stfio::exportHDF5File(fName, Data, progDlg, hdf5Options);
             break;
         }
         case stfio::igor: {
@@ -232,6 +288,251 @@ bool stfio::exportFile(const std::string& fName, stfio::filetype type, const Rec
     return true;
 }
 
+namespace {
+
+    double fileSize(const std::string& fName) {
+        std::ifstream file(fName.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file) {
+            return 0;
+        }
+        return (double)file.tellg();
+    }
+
+    // Reads a file for stfio::convertFiles; returns an error message or an empty string.
+    std::string decodeFile(const std::string& fName, stfio::filetype type,
+                           const stfio::txtImportSettings& txtImport, Recording& Data)
+    {
+        stfio::StdoutProgressInfo progDlg("File import", "Starting file import", 100, false);
+        try {
+            stfio::importFile(fName, type, Data, txtImport, progDlg);
+        }
+        catch (const std::exception& e) {
+            return std::string("Couldn't read ") + fName + ":\n" + e.what();
+        }
+        catch (...) {
+            return std::string("Couldn't read ") + fName;
+        }
+        if (Data.size() == 0) {
+            return std::string("Couldn't read ") + fName + ":\nFile is probably empty";
+        }
+        return std::string();
+    }
+
+    // Writes a file for stfio::convertFiles; returns an error message or an empty string.
+    std::string encodeFile(const std::string& fName, stfio::filetype type, const Recording& Data) {
+        stfio::StdoutProgressInfo progDlg("File export", "Writing file", 100, false);
+        try {
+            stfio::exportFile(fName, type, Data, progDlg);
+        }
+        catch (const std::exception& e) {
+            return std::string("Couldn't write ") + fName + ":\n" + e.what();
+        }
+        catch (...) {
+            return std::string("Couldn't write ") + fName;
+        }
+        return std::string();
+    }
+
+    std::string conversionStatus(const stfio::ConversionStats& stats, std::size_t nDone,
+                                 std::size_t nFiles, double seconds)
+    {
+        std::ostringstream msg;
+        msg << "Finished " << nDone << " of " << nFiles << " files ("
+            << (int)(stats.bytes/1048576.0) << " MB";
+        if (seconds > 0) {
+            msg << ", " << std::fixed;
+            msg.precision(1);
+            msg << stats.bytes/1048576.0/seconds << " MB/s";
+        }
+        msg << ")";
+        return msg.str();
+    }
+
+#if (__cplusplus >= 201103)
+    // State shared by the worker threads of stfio::convertFiles.
+    struct ConversionJob {
+        ConversionJob(const std::vector<std::string>& srcNames_, stfio::filetype srcType_,
+                      const std::vector<std::string>& destNames_, stfio::filetype destType_,
+                      const stfio::txtImportSettings& txtImport_, std::size_t queueSize_,
+                      stfio::ConversionStats& stats_, int nRunning_)
+            : srcNames(srcNames_), srcType(srcType_), destNames(destNames_), destType(destType_),
+              txtImport(txtImport_), queueSize(queueSize_), stats(stats_), mutex(), changed(),
+              decoded(), next(0), nDecoding(0), nDone(0), nRunning(nRunning_), cancelled(false)
+        {}
+
+        const std::vector<std::string>& srcNames;
+        stfio::filetype srcType;
+        const std::vector<std::string>& destNames;
+        stfio::filetype destType;
+        const stfio::txtImportSettings& txtImport;
+        std::size_t queueSize;
+        stfio::ConversionStats& stats;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        // Decoded recordings waiting to be written:
+        std::deque<std::pair<std::size_t, std::shared_ptr<Recording> > > decoded;
+        std::size_t next;       // next file to be read
+        std::size_t nDecoding;  // files that are being read
+        std::size_t nDone;      // files that have been written or failed
+        int nRunning;           // worker threads that haven't finished
+        bool cancelled;
+    };
+
+    void conversionWorker(ConversionJob& job) {
+        for (;;) {
+            std::size_t n = 0;
+            std::shared_ptr<Recording> rec;
+            {
+                std::unique_lock<std::mutex> lock(job.mutex);
+                for (;;) {
+                    // Writing a decoded recording takes precedence so that memory is released:
+                    if (!job.decoded.empty()) {
+                        n = job.decoded.front().first;
+                        rec = job.decoded.front().second;
+                        job.decoded.pop_front();
+                        break;
+                    }
+                    bool moreFiles = (job.next < job.srcNames.size() && !job.cancelled);
+                    if (moreFiles && job.decoded.size() + job.nDecoding < job.queueSize) {
+                        n = job.next++;
+                        job.nDecoding++;
+                        break;
+                    }
+                    if (!moreFiles && job.nDecoding == 0) {
+                        job.nRunning--;
+                        job.changed.notify_all();
+                        return;
+                    }
+                    job.changed.wait(lock);
+                }
+            }
+            if (rec) {
+                std::string error = encodeFile(job.destNames[n], job.destType, *rec);
+                double bytes = fileSize(job.srcNames[n]);
+                rec.reset();
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.stats.errors[n] = error;
+                if (error.empty()) {
+                    job.stats.nConverted++;
+                    job.stats.bytes += bytes;
+                }
+                job.nDone++;
+                job.changed.notify_all();
+            } else {
+                rec.reset(new Recording());
+                std::string error = decodeFile(job.srcNames[n], job.srcType, job.txtImport, *rec);
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.nDecoding--;
+                if (error.empty()) {
+                    job.decoded.push_back(std::make_pair(n, rec));
+                } else {
+                    job.stats.errors[n] = error;
+                    job.nDone++;
+                }
+                job.changed.notify_all();
+            }
+        }
+    }
+#endif
+}
+
+stfio::ConversionStats
+stfio::convertFiles(const std::vector<std::string>& srcNames, stfio::filetype srcType,
+                    const std::vector<std::string>& destNames, stfio::filetype destType,
+                    const stfio::txtImportSettings& txtImport, ProgressInfo& progDlg,
+                    int nThreads, std::size_t queueSize)
+{
+    if (srcNames.size() != destNames.size()) {
+        throw std::out_of_range("Number of source and destination files differ in stfio::convertFiles");
+    }
+    std::size_t nFiles = srcNames.size();
+    ConversionStats stats;
+    stats.errors.assign(nFiles, std::string());
+    if (nFiles == 0) {
+        return stats;
+    }
+
+#if (__cplusplus >= 201103)
+    if (nThreads <= 0) {
+        nThreads = (int)std::thread::hardware_concurrency();
+        if (nThreads <= 0) {
+            nThreads = 1;
+        }
+    }
+    if (nThreads > (int)nFiles) {
+        nThreads = (int)nFiles;
+    }
+    if (queueSize == 0) {
+        queueSize = nThreads;
+    }
+
+    ConversionJob job(srcNames, srcType, destNames, destType, txtImport, queueSize, stats, nThreads);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int nt = 0; nt < nThreads; ++nt) {
+        workers.push_back(std::thread(conversionWorker, std::ref(job)));
+    }
+
+    // Report the progress from this thread only:
+    for (;;) {
+        std::string msg;
+        int progbar = 0;
+        {
+            std::unique_lock<std::mutex> lock(job.mutex);
+            if (job.nRunning == 0) {
+                break;
+            }
+            job.changed.wait_for(lock, std::chrono::milliseconds(100));
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            msg = conversionStatus(stats, job.nDone, nFiles, seconds);
+            progbar = (int)((double)job.nDone/(double)nFiles*100.0);
+        }
+        if (!progDlg.Update(progbar, msg)) {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.cancelled = true;
+            job.changed.notify_all();
+        }
+    }
+    for (std::size_t nt = 0; nt < workers.size(); ++nt) {
+        workers[nt].join();
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    for (std::size_t n = job.next; n < nFiles; ++n) {
+        stats.errors[n] = std::string("Conversion of ") + srcNames[n] + " was cancelled";
+    }
+#else
+    // Without C++11 threads, the files are converted one after another:
+    time_t start = time(NULL);
+    std::size_t n = 0;
+    for (; n < nFiles; ++n) {
+        double seconds = difftime(time(NULL), start);
+        if (!progDlg.Update((int)((double)n/(double)nFiles*100.0),
+                            conversionStatus(stats, n, nFiles, seconds)))
+        {
+            break;
+        }
+        Recording Data;
+        std::string error = decodeFile(srcNames[n], srcType, txtImport, Data);
+        if (error.empty()) {
+            error = encodeFile(destNames[n], destType, Data);
+        }
+        stats.errors[n] = error;
+        if (error.empty()) {
+            stats.nConverted++;
+            stats.bytes += fileSize(srcNames[n]);
+        }
+    }
+    stats.seconds = difftime(time(NULL), start);
+    for (; n < nFiles; ++n) {
+        stats.errors[n] = std::string("Conversion of ") + srcNames[n] + " was cancelled";
+    }
+#endif
+    progDlg.Update(100, conversionStatus(stats, nFiles, nFiles, stats.seconds));
+    return stats;
+}
+
 Vector_double stfio::vec_scal_plus(const Vector_double& vec, double scalar) {
     Vector_double ret_vec(vec.size(), scalar);
     std::transform(vec.begin(), vec.end(), ret_vec.begin(), ret_vec.begin(), std::plus<double>());
@@ -288,12 +589,9 @@ stfio::concatenate(const Recording& src, const std::vector<std::size_t>& section
     Recording Concatenated(NC, 1);
 
     for (nc = 0; nc < NC; nc++) {
-        int new_size=0;
-        for (c_st_it cit = sections.begin(); cit != sections.end(); cit++) {
-            new_size += (int)src[nc][*cit].size();
-        }
-        Section TempSection(new_size);
-        std::size_t n_new=0;
+        // the parts of the source sections in order:
+        std::vector<RawSamples> parts;
+        double x_scale = 1.0;
         std::size_t n_s=0;
         for (c_st_it cit = sections.begin(); cit != sections.end(); cit++) {
             std::ostringstream progStr;
@@ -304,29 +602,24 @@ stfio::concatenate(const Recording& src, const std::vector<std::size_t>& section
             );
 
             if (cit == sections.begin()) {
-                TempSection.SetXScale(src[nc][*cit].GetXScale());
+                x_scale = src[nc][*cit].GetXScale();
             }
-            else if (TempSection.GetXScale() != src[nc][*cit].GetXScale()) {
+            else if (x_scale != src[nc][*cit].GetXScale()) {
                 Concatenated.resize(0);
                 throw std::runtime_error("can not concatanate because sampling frequency differs");
             }
 
-            std::size_t secSize=src[nc][*cit].size();
-            if (n_new+secSize>TempSection.size()) {
-                Concatenated.resize(0);
-                throw std::runtime_error("memory allocation error");
-            }
-            std::copy(src[nc][*cit].get().begin(),
-                      src[nc][*cit].get().end(),
-                      &TempSection[n_new]);
-            n_new += secSize;
+            std::vector<RawSamples> secParts = src[nc][*cit].get_parts();
+            parts.insert(parts.end(), secParts.begin(), secParts.end());
             n_s++;
         }
+        Section TempSection(parts);
+        TempSection.SetXScale(x_scale);
         TempSection.SetSectionDescription(src[nc][0].GetSectionDescription() + ", concatenated");
-        Channel TempChannel(TempSection);
+        Channel TempChannel(std::move(TempSection));
 	TempChannel.SetChannelName(src[nc].GetChannelName());
 	TempChannel.SetYUnits(src[nc].GetYUnits());
-	Concatenated.InsertChannel(TempChannel, nc);
+	Concatenated.InsertChannel(std::move(TempChannel), nc);
     }
 
     // Recording Concatenated(TempChannel);
@@ -339,30 +632,106 @@ Recording
 stfio::multiply(const Recording& src, const std::vector<std::size_t>& sections,
                 std::size_t channel, double factor)
 {
-    Channel TempChannel(sections.size(), src[channel][sections[0]].size());
-    std::size_t n = 0;
-    for (c_st_it cit = sections.begin(); cit != sections.end(); cit++) {
-        // Multiply the valarray in Data:
-        Section TempSection(stfio::vec_scal_mul(src[channel][*cit].get(),factor));
-        TempSection.SetXScale(src[channel][*cit].GetXScale());
-        TempSection.SetSectionDescription(
-                src[channel][*cit].GetSectionDescription()+
-                ", multiplied"
-        );
-        try {
-            TempChannel.InsertSection(TempSection, n);
+    if (sections.empty()) {
+        throw std::runtime_error("Channel empty in stfio::multiply");
+    }
+    TraceOps ops;
+    ops.mul(factor);
+    return transform(src, sections, channel, std::vector<TraceOps>(1, ops), ", multiplied");
+}
+
+Recording
+stfio::transform(const Recording& src, const std::vector<std::size_t>& sections,
+                 std::size_t channel, const std::vector<TraceOps>& ops,
+                 const std::string& suffix)
+{
+    if (channel >= src.size()) {
+        throw std::out_of_range("Channel number out of range in stfio::transform");
+    }
+    if (sections.empty()) {
+        throw std::runtime_error("No sections selected in stfio::transform");
+    }
+    if (ops.size() != 1 && ops.size() != sections.size()) {
+        throw std::out_of_range("Number of operations doesn't match number of sections in stfio::transform");
+    }
+    const Channel& ch = src[channel];
+    // pointers to the source data points, collected before the parallel loop:
+    std::vector<const double*> srcData(sections.size(), (const double*)NULL);
+    for (std::size_t n = 0; n < sections.size(); ++n) {
+        if (sections[n] >= ch.size()) {
+            throw std::out_of_range("Section number out of range in stfio::transform");
         }
-        catch (const std::out_of_range e) {
-            throw e;
+        if (ch[sections[n]].size() > 0) {
+            srcData[n] = &ch[sections[n]].get()[0];
         }
-        n++;
     }
-    if (TempChannel.size()>0) {
-        Recording Multiplied(TempChannel);
-        Multiplied.CopyAttributes(src);
-        Multiplied[0].SetYUnits( src.at( channel ).GetYUnits() );
-        return Multiplied;
-    } else {
-        throw std::runtime_error("Channel empty in stfio::multiply");
+
+    Channel TempChannel(sections.size());
+    int n_sections = (int)sections.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int n = 0; n < n_sections; ++n) {
+        const Section& srcSection = ch[sections[n]];
+        Section& TempSection = TempChannel[n];
+        TempSection.resize(srcSection.size());
+        TempSection.SetXScale(srcSection.GetXScale());
+        TempSection.SetSectionDescription(srcSection.GetSectionDescription() + suffix);
+        if (srcSection.size() > 0) {
+            const TraceOps& secOps = (ops.size() == 1) ? ops[0] : ops[n];
+            secOps.apply(srcData[n], &TempSection.get_w()[0], srcSection.size());
+        }
+    }
+
+    Recording Transformed(std::move(TempChannel));
+    Transformed.CopyAttributes(src);
+    Transformed[0].SetChannelName( ch.GetChannelName() );
+    Transformed[0].SetYUnits( ch.GetYUnits() );
+    return Transformed;
+}
+
+Recording
+stfio::subtract_base(const Recording& src, const std::vector<std::size_t>& sections,
+                     std::size_t channel, const Vector_double& base)
+{
+    if (base.size() != sections.size()) {
+        throw std::out_of_range("Number of baselines doesn't match number of sections in stfio::subtract_base");
+    }
+    std::vector<TraceOps> ops(sections.size());
+    for (std::size_t n = 0; n < sections.size(); ++n) {
+        ops[n].minus(base[n]);
+    }
+    return transform(src, sections, channel, ops, ", baseline subtracted");
+}
+
+Recording
+stfio::p_over_n(const Recording& src, std::size_t channel, int n, int direction)
+{
+    if (channel >= src.size()) {
+        throw std::out_of_range("Channel number out of range in stfio::p_over_n");
+    }
+    if (n < 0) {
+        throw std::runtime_error("Negative number of leak pulses in stfio::p_over_n");
+    }
+    const Channel& ch = src[channel];
+    std::size_t new_sections = ch.size()/(n+1);
+    if (new_sections < 1) {
+        throw std::runtime_error("Not enough traces for P/n correction");
+    }
+    std::vector<std::size_t> sections(new_sections);
+    std::vector<TraceOps> ops(new_sections);
+    for (std::size_t n_section = 0; n_section < new_sections; ++n_section) {
+        sections[n_section] = n_section*(n+1);
+        std::size_t size = ch[sections[n_section]].size();
+        std::vector<const double*> leaks(n);
+        for (int n_PoN = 0; n_PoN < n; ++n_PoN) {
+            const Section& leak = ch[sections[n_section]+n_PoN+1];
+            if (leak.size() < size) {
+                throw std::out_of_range("Leak pulse is shorter than test pulse in stfio::p_over_n");
+            }
+            leaks[n_PoN] = (size > 0) ? &leak.get()[0] : NULL;
+        }
+        ops[n_section].minus_sum(leaks, (double)direction);
     }
+    return transform(src, sections, channel, ops, ", P over N");
 }
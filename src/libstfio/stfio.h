@@ -68,6 +68,9 @@ typedef std::vector<float > Vector_float;
     #define snprintf _snprintf
 #endif
 
+#include "./mappedfile.h"
+#include "./envelope.h"
+#include "./tracemath.h"
 #include "./recording.h"
 #include "./channel.h"
 #include "./section.h"
@@ -187,7 +190,9 @@ StfioDll std::string
 findExtension(stfio::filetype ftype);
 
 //! Generic file import.
-/*! \param fName The full path name of the file. 
+/*! Can be called from several threads at the same time; importers that
+ *  depend on library-global state are run one at a time.
+ *  \param fName The full path name of the file. 
  *  \param type The file type. 
  *  \param ReturnData Will contain the file data on return.
  *  \param txtImport The text import filter settings.
@@ -214,8 +219,59 @@ StfioDll bool
 exportFile(const std::string& fName, stfio::filetype type, const Recording& Data,
            ProgressInfo& progDlg);
 
+struct HDF5Options;
+
+//! Generic file export with options for HDF5 files.
+/*! Same as the function above, but HDF5 files are written with the given
+ *  layout and compression. The options are ignored for other file types.
+ *  \param hdf5Options Layout and compression of HDF5 files, see hdf5/hdf5lib.h.
+ */
+StfioDll bool
+exportFile(const std::string& fName, stfio::filetype type, const Recording& Data,
+           ProgressInfo& progDlg, const HDF5Options& hdf5Options);
+
+//! Summary of a batch conversion
+struct StfioDll ConversionStats {
+    ConversionStats() : errors(), nConverted(0), bytes(0), seconds(0) {}
+
+    //! Aggregate throughput.
+    /*! \return Size of the converted source files in MB per second.
+     */
+    double throughput() const { return (seconds > 0) ? bytes/1048576.0/seconds : 0; }
+
+    std::vector<std::string> errors; /*!< Error message for each file, or an empty string if it was converted. */
+    std::size_t nConverted;          /*!< Number of files that were converted successfully. */
+    double bytes;                    /*!< Total size of the converted source files in bytes. */
+    double seconds;                  /*!< Wall-clock duration of the conversion in seconds. */
+};
+
+//! Converts a batch of files.
+/*! The files are converted by a pool of worker threads. Decoded recordings wait in a
+ *  bounded queue until a worker writes them, so that reading one file overlaps with
+ *  writing another while memory use stays limited. An error in one file is recorded
+ *  and doesn't stop the conversion of the others.
+ *  \param srcNames Full paths of the source files.
+ *  \param srcType File type of the source files.
+ *  \param destNames Full paths of the destination files, one per source file.
+ *  \param destType File type of the destination files.
+ *  \param txtImport The text import filter settings.
+ *  \param progDlg Progress indicator. It is only updated from the calling thread.
+ *         No further files are started once Update() returns false.
+ *  \param nThreads Number of worker threads; 0 uses one thread per CPU.
+ *  \param queueSize Maximal number of decoded recordings waiting to be written; 0 uses nThreads.
+ *  \return The conversion statistics.
+ */
+StfioDll ConversionStats
+convertFiles(const std::vector<std::string>& srcNames, stfio::filetype srcType,
+             const std::vector<std::string>& destNames, stfio::filetype destType,
+             const stfio::txtImportSettings& txtImport, ProgressInfo& progDlg,
+             int nThreads=0, std::size_t queueSize=0);
+
 //! Produce new recording with concatenated sections
-/*! \param src Source recording
+/*! The concatenated sections refer to the data points of the source
+ *  sections instead of copying them; they are only copied when the
+ *  new sections are written to.
+ *  \param src Source recording
  *  \param sections Indices of selected sections
  *  \param ProgressInfo Progress indicator
  *  \return New recording with concatenated selected sections
@@ -234,6 +290,44 @@ concatenate(const Recording& src, const std::vector<std::size_t>& sections,
 StfioDll Recording
 multiply(const Recording& src, const std::vector<std::size_t>& sections,
          std::size_t channel, double factor);
+
+//! Produce new recording by applying chains of point-wise operations to sections
+/*! The sections are processed in parallel. The channel name and units
+ *  are taken from the source channel.
+ *  \param src Source recording
+ *  \param sections Indices of selected sections
+ *  \param channel Channel index
+ *  \param ops Either one chain for every selected section, or a single chain for all of them
+ *  \param suffix Appended to the section descriptions
+ *  \return New recording with the transformed selected sections
+ */
+StfioDll Recording
+transform(const Recording& src, const std::vector<std::size_t>& sections,
+          std::size_t channel, const std::vector<TraceOps>& ops,
+          const std::string& suffix);
+
+//! Produce new recording with baseline-subtracted sections
+/*! \param src Source recording
+ *  \param sections Indices of selected sections
+ *  \param channel Channel index
+ *  \param base Baseline of each selected section
+ *  \return New recording with baseline-subtracted selected sections
+ */
+StfioDll Recording
+subtract_base(const Recording& src, const std::vector<std::size_t>& sections,
+              std::size_t channel, const Vector_double& base);
+
+//! Produce new recording with P/N leak-subtracted sections
+/*! Every group of n+1 consecutive sections consists of a test pulse followed
+ *  by n leak pulses; the sum of the leak pulses is subtracted from the test pulse.
+ *  \param src Source recording
+ *  \param channel Channel index
+ *  \param n Number of leak pulses per test pulse
+ *  \param direction Sign of the leak pulses relative to the test pulse (1 or -1)
+ *  \return New recording with one leak-subtracted section per group
+ */
+StfioDll Recording
+p_over_n(const Recording& src, std::size_t channel, int n, int direction);
 /*@}*/
 
 } // end of namespace
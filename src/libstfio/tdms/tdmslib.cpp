@@ -0,0 +1,733 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file tdmslib.cpp
+ *  \brief Import National Instruments TDMS files.
+ */
+
+/*
+A TDMS file is a sequence of segments. Each segment starts with a lead-in
+of 28 bytes, followed by metadata that describes the objects ("/", groups
+and channels) and the layout of their raw data in this segment, followed
+by the raw data. Segments without metadata repeat the layout of the
+previous segment. The raw data of a segment consists of chunks that hold
+the values of every object once, either one object after another or
+interleaved value by value.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "./tdmslib.h"
+#include "./../recording.h"
+
+namespace {
+
+    // Flags of the table of contents in the lead-in:
+    const uint32_t kTocMetaData = 1<<1;
+    const uint32_t kTocNewObjList = 1<<2;
+    const uint32_t kTocRawData = 1<<3;
+    const uint32_t kTocInterleavedData = 1<<5;
+    const uint32_t kTocBigEndian = 1<<6;
+    const uint32_t kTocDAQmxRawData = 1<<7;
+
+    const std::size_t lead_in_size = 28;
+
+    // Raw data indices with a special meaning:
+    const uint32_t no_raw_data = 0xFFFFFFFF;
+    const uint32_t same_raw_data = 0x00000000;
+    const uint32_t daqmx_format_changing = 0x69120000;
+    const uint32_t daqmx_digital_line = 0x69130000;
+
+    // Data types:
+    enum tdsDataType {
+        tdsTypeI8 = 0x01,
+        tdsTypeI16 = 0x02,
+        tdsTypeI32 = 0x03,
+        tdsTypeI64 = 0x04,
+        tdsTypeU8 = 0x05,
+        tdsTypeU16 = 0x06,
+        tdsTypeU32 = 0x07,
+        tdsTypeU64 = 0x08,
+        tdsTypeSingleFloat = 0x09,
+        tdsTypeDoubleFloat = 0x0A,
+        tdsTypeSingleFloatWithUnit = 0x19,
+        tdsTypeDoubleFloatWithUnit = 0x1A,
+        tdsTypeString = 0x20,
+        tdsTypeBoolean = 0x21,
+        tdsTypeTimeStamp = 0x44,
+        tdsTypeComplexSingleFloat = 0x08000c,
+        tdsTypeComplexDoubleFloat = 0x10000d
+    };
+
+    // Samples are converted a block of this size at a time when the file isn't mapped:
+    const std::size_t block_bytes = std::size_t(8)*1024*1024;
+
+    // Size of a value in bytes, or 0 for strings and unsupported types:
+    std::size_t typeWidth(uint32_t type) {
+        switch (type) {
+         case tdsTypeI8: case tdsTypeU8: case tdsTypeBoolean:
+             return 1;
+         case tdsTypeI16: case tdsTypeU16:
+             return 2;
+         case tdsTypeI32: case tdsTypeU32: case tdsTypeSingleFloat: case tdsTypeSingleFloatWithUnit:
+             return 4;
+         case tdsTypeI64: case tdsTypeU64: case tdsTypeDoubleFloat: case tdsTypeDoubleFloatWithUnit:
+         case tdsTypeComplexSingleFloat:
+             return 8;
+         case tdsTypeTimeStamp: case tdsTypeComplexDoubleFloat:
+             return 16;
+         default:
+             return 0;
+        }
+    }
+
+    // Tells whether values of a type can be converted to samples:
+    bool isNumeric(uint32_t type) {
+        switch (type) {
+         case tdsTypeTimeStamp: case tdsTypeComplexSingleFloat: case tdsTypeComplexDoubleFloat:
+         case tdsTypeString:
+             return false;
+         default:
+             return typeWidth(type) > 0;
+        }
+    }
+
+    // Tells whether values of a type can stay in a memory-mapped file until they are needed:
+    bool toSampleType(uint32_t type, stfio::sample_type& sample) {
+        switch (type) {
+         case tdsTypeI16: sample = stfio::sample_int16; return true;
+         case tdsTypeI32: sample = stfio::sample_int32; return true;
+         case tdsTypeSingleFloat: case tdsTypeSingleFloatWithUnit: sample = stfio::sample_float32; return true;
+         case tdsTypeDoubleFloat: case tdsTypeDoubleFloatWithUnit: sample = stfio::sample_float64; return true;
+         default: return false;
+        }
+    }
+
+    bool hostIsBigEndian() {
+        const uint16_t one = 1;
+        return *(const unsigned char*)&one == 0;
+    }
+
+    template <typename T>
+    inline T load(const char* src, bool swap) {
+        char buf[sizeof(T)];
+        if (swap) {
+            for (std::size_t nb=0; nb<sizeof(T); ++nb)
+                buf[nb] = src[sizeof(T)-1-nb];
+        } else {
+            memcpy(buf, src, sizeof(T));
+        }
+        T raw;
+        memcpy(&raw, buf, sizeof(T));
+        return raw;
+    }
+
+    template <typename T>
+    void load_n(const char* src, std::size_t stride, std::size_t n, bool swap, double* dest) {
+        if (!swap && stride == sizeof(T)) {
+            for (std::size_t ns=0; ns<n; ++ns) {
+                T raw;
+                memcpy(&raw, src + ns*sizeof(T), sizeof(T));
+                dest[ns] = (double)raw;
+            }
+        } else {
+            for (std::size_t ns=0; ns<n; ++ns, src+=stride)
+                dest[ns] = (double)load<T>(src, swap);
+        }
+    }
+
+    // Converts n values of a numeric type that are stride bytes apart:
+    void decode(const char* src, std::size_t stride, std::size_t n, uint32_t type, bool swap, double* dest) {
+        switch (type) {
+         case tdsTypeI8: load_n<int8_t>(src, stride, n, swap, dest); break;
+         case tdsTypeI16: load_n<int16_t>(src, stride, n, swap, dest); break;
+         case tdsTypeI32: load_n<int32_t>(src, stride, n, swap, dest); break;
+         case tdsTypeI64: load_n<int64_t>(src, stride, n, swap, dest); break;
+         case tdsTypeU8: case tdsTypeBoolean: load_n<uint8_t>(src, stride, n, swap, dest); break;
+         case tdsTypeU16: load_n<uint16_t>(src, stride, n, swap, dest); break;
+         case tdsTypeU32: load_n<uint32_t>(src, stride, n, swap, dest); break;
+         case tdsTypeU64: load_n<uint64_t>(src, stride, n, swap, dest); break;
+         case tdsTypeSingleFloat: case tdsTypeSingleFloatWithUnit:
+             load_n<float>(src, stride, n, swap, dest); break;
+         case tdsTypeDoubleFloat: case tdsTypeDoubleFloatWithUnit:
+             load_n<double>(src, stride, n, swap, dest); break;
+         default:
+             throw std::runtime_error("Unsupported data type in TDMS file");
+        }
+    }
+
+    // The bytes of a file, either memory-mapped or read a block at a time:
+    class Source {
+    public:
+        Source(const std::string& fName, bool mapping)
+            : file(), stream(), length(0), buffer(), buf_start(0), buf_len(0)
+        {
+            if (mapping) {
+                // files that can't be mapped are read a block at a time:
+                try {
+                    file.reset(new stfio::MappedFile(fName));
+                    length = file->size();
+                    return;
+                }
+                catch (const std::exception&) {
+                    file.reset();
+                }
+            }
+            stream.open(fName.c_str(), std::ios::in | std::ios::binary);
+            if (!stream) {
+                throw std::runtime_error(std::string("Couldn't open ") + fName);
+            }
+            stream.seekg(0, std::ios::end);
+            length = (uint64_t)stream.tellg();
+        }
+
+        uint64_t size() const { return length; }
+
+        // The memory-mapped file, or an empty pointer:
+        const stfio::MappedFilePtr& mapping() const { return file; }
+
+        // Bytes pos to pos+n of the file; valid until the next call:
+        const char* get(uint64_t pos, uint64_t n) {
+            if (pos > length || n > length-pos) {
+                throw std::runtime_error("Unexpected end of TDMS file");
+            }
+            if (file) {
+                return file->data() + pos;
+            }
+            if (pos < buf_start || pos+n > buf_start+buf_len) {
+                // read ahead, so that the following requests are served from the buffer:
+                std::size_t len = (std::size_t)std::min(length-pos, std::max(n, (uint64_t)block_bytes));
+                if (buffer.size() < len) {
+                    buffer.resize(len);
+                }
+                stream.clear();
+                stream.seekg((std::streamoff)pos);
+                stream.read(&buffer[0], (std::streamsize)len);
+                if ((std::size_t)stream.gcount() != len) {
+                    throw std::runtime_error("Couldn't read TDMS file");
+                }
+                buf_start = pos;
+                buf_len = len;
+            }
+            return &buffer[0] + (pos-buf_start);
+        }
+
+    private:
+        stfio::MappedFilePtr file;
+        std::ifstream stream;
+        uint64_t length;
+        std::vector<char> buffer;
+        uint64_t buf_start;
+        std::size_t buf_len;
+    };
+
+    // Reads the metadata of a segment:
+    class Cursor {
+    public:
+        Cursor(const char* begin, const char* end_, bool swap_)
+            : p(begin), end(end_), swap(swap_) {}
+
+        const char* take(std::size_t n) {
+            if ((std::size_t)(end-p) < n) {
+                throw std::runtime_error("Corrupt metadata in TDMS file");
+            }
+            const char* q = p;
+            p += n;
+            return q;
+        }
+        uint32_t u32() { return load<uint32_t>(take(4), swap); }
+        uint64_t u64() { return load<uint64_t>(take(8), swap); }
+        std::string str() {
+            uint32_t n = u32();
+            return std::string(take(n), n);
+        }
+
+    private:
+        const char* p;
+        const char* end;
+        bool swap;
+    };
+
+    // A group, channel or the file object ("/"):
+    struct Object {
+        Object(const std::string& path_)
+            : path(path_), text(), numbers(), type(0), n_values(0), n_bytes(0),
+              has_index(false), mappable(true), wanted(false), total(0) {}
+
+        std::string path;
+        std::map<std::string, std::string> text;   // string properties
+        std::map<std::string, double> numbers;     // numeric properties
+        // raw data index of the last segment that had one:
+        uint32_t type;
+        uint64_t n_values;
+        uint64_t n_bytes;
+        bool has_index;
+        // true if all raw data can stay in a memory-mapped file:
+        bool mappable;
+        // true if the raw data are imported:
+        bool wanted;
+        // number of values in the file:
+        uint64_t total;
+    };
+
+    // The raw data of an object in a chunk of a segment:
+    struct SegmentObject {
+        std::size_t object;
+        uint32_t type;
+        uint64_t n_bytes;
+    };
+
+    struct Segment {
+        uint64_t data_pos;      // file offset of the raw data
+        uint64_t data_size;     // bytes of raw data
+        bool interleaved;
+        bool swap;              // true if the byte order differs from the host's
+        std::size_t layout;     // index of the objects that have raw data in this segment
+    };
+
+    struct TDMSFile {
+        std::vector<Object> objects;
+        std::map<std::string, std::size_t> paths;
+        std::vector<Segment> segments;
+        // objects with raw data, shared by consecutive segments without new metadata:
+        std::vector< std::vector<SegmentObject> > layouts;
+    };
+
+    std::size_t findObject(TDMSFile& tdms, const std::string& path) {
+        std::map<std::string, std::size_t>::const_iterator it = tdms.paths.find(path);
+        if (it != tdms.paths.end()) {
+            return it->second;
+        }
+        tdms.objects.push_back(Object(path));
+        tdms.paths[path] = tdms.objects.size()-1;
+        return tdms.objects.size()-1;
+    }
+
+    void readProperty(Cursor& cur, Object& obj, bool swap) {
+        std::string name = cur.str();
+        uint32_t type = cur.u32();
+        if (type == tdsTypeString) {
+            obj.text[name] = cur.str();
+        } else if (isNumeric(type)) {
+            double value = 0;
+            decode(cur.take(typeWidth(type)), typeWidth(type), 1, type, swap, &value);
+            obj.numbers[name] = value;
+        } else if (typeWidth(type) > 0) {
+            cur.take(typeWidth(type));
+        } else {
+            throw std::runtime_error("Unsupported property type in TDMS file");
+        }
+    }
+
+    // Updates the objects and the objects with raw data from the metadata of a segment:
+    void readMetaData(Cursor& cur, TDMSFile& tdms, std::vector<SegmentObject>& layout, bool swap) {
+        uint32_t n_objects = cur.u32();
+        for (uint32_t no=0; no<n_objects; ++no) {
+            std::size_t idx = findObject(tdms, cur.str());
+            Object& obj = tdms.objects[idx];
+            uint32_t index = cur.u32();
+            std::vector<SegmentObject>::iterator it = layout.begin();
+            while (it != layout.end() && it->object != idx) {
+                ++it;
+            }
+            if (index == daqmx_format_changing || index == daqmx_digital_line) {
+                throw std::runtime_error("DAQmx raw data in TDMS files are not supported");
+            }
+            if (index == no_raw_data) {
+                if (it != layout.end()) {
+                    it->n_bytes = 0;
+                }
+            } else {
+                if (index != same_raw_data) {
+                    // the length of the index includes the length itself:
+                    if (index < 20) {
+                        throw std::runtime_error("Corrupt raw data index in TDMS file");
+                    }
+                    const char* idx = cur.take(index-4);
+                    Cursor idxCur(idx, idx+index-4, swap);
+                    obj.type = idxCur.u32();
+                    if (idxCur.u32() != 1) {
+                        throw std::runtime_error("Only one-dimensional raw data are supported in TDMS files");
+                    }
+                    obj.n_values = idxCur.u64();
+                    if (obj.type == tdsTypeString) {
+                        obj.n_bytes = idxCur.u64();
+                    } else if (typeWidth(obj.type) > 0) {
+                        obj.n_bytes = obj.n_values*typeWidth(obj.type);
+                    } else {
+                        throw std::runtime_error("Unsupported data type in TDMS file");
+                    }
+                    obj.has_index = true;
+                    stfio::sample_type sample;
+                    if (!toSampleType(obj.type, sample)) {
+                        obj.mappable = false;
+                    }
+                } else if (!obj.has_index) {
+                    throw std::runtime_error("Missing raw data index in TDMS file");
+                }
+                SegmentObject so;
+                so.object = idx;
+                so.type = obj.type;
+                so.n_bytes = obj.n_bytes;
+                if (it != layout.end()) {
+                    *it = so;
+                } else {
+                    layout.push_back(so);
+                }
+            }
+            uint32_t n_props = cur.u32();
+            for (uint32_t np=0; np<n_props; ++np) {
+                readProperty(cur, obj, swap);
+            }
+        }
+    }
+
+    // Reads the lead-ins and metadata of all segments:
+    void readIndex(Source& src, TDMSFile& tdms) {
+        const bool host_big = hostIsBigEndian();
+        std::vector<SegmentObject> layout;
+        // true if the layout has changed since it was last stored:
+        bool changed = true;
+        uint64_t pos = 0;
+        while (pos < src.size()) {
+            if (src.size()-pos < lead_in_size) {
+                throw std::runtime_error("Unexpected end of TDMS file");
+            }
+            const char* lead = src.get(pos, lead_in_size);
+            if (memcmp(lead, "TDSm", 4) != 0) {
+                throw std::runtime_error("Not a TDMS file, or corrupt segment");
+            }
+            // the table of contents is always little-endian:
+            uint32_t toc = load<uint32_t>(lead+4, host_big);
+            bool swap = ((toc & kTocBigEndian) != 0) != host_big;
+            uint64_t next = load<uint64_t>(lead+12, swap);
+            uint64_t raw_offset = load<uint64_t>(lead+20, swap);
+            uint64_t start = pos + lead_in_size;
+            // the last segment of a file that wasn't closed properly may be incomplete:
+            uint64_t end = (next > src.size()-start) ? src.size() : start+next;
+            if (raw_offset > end-start) {
+                throw std::runtime_error("Corrupt segment in TDMS file");
+            }
+            if (toc & kTocDAQmxRawData) {
+                throw std::runtime_error("DAQmx raw data in TDMS files are not supported");
+            }
+            if (toc & kTocMetaData) {
+                if (toc & kTocNewObjList) {
+                    layout.clear();
+                }
+                const char* meta = src.get(start, raw_offset);
+                Cursor cur(meta, meta+raw_offset, swap);
+                readMetaData(cur, tdms, layout, swap);
+                changed = true;
+            }
+            if ((toc & kTocRawData) && end > start+raw_offset) {
+                if (changed) {
+                    tdms.layouts.push_back(layout);
+                    changed = false;
+                }
+                Segment seg;
+                seg.data_pos = start+raw_offset;
+                seg.data_size = end-seg.data_pos;
+                seg.interleaved = (toc & kTocInterleavedData) != 0;
+                seg.swap = swap;
+                seg.layout = tdms.layouts.size()-1;
+                tdms.segments.push_back(seg);
+            }
+            pos = end;
+        }
+    }
+
+    // Calls visit(object, pos, stride, n, type, swap) for each run of values of the
+    // wanted objects in a segment, in the order of the file. Runs are split into
+    // pieces of at most max_bytes.
+    template <typename Visitor>
+    void forEachRun(const TDMSFile& tdms, const Segment& seg, uint64_t max_bytes, Visitor& visit) {
+        const std::vector<SegmentObject>& layout = tdms.layouts[seg.layout];
+        uint64_t chunk = 0;
+        for (std::size_t no=0; no<layout.size(); ++no) {
+            chunk += layout[no].n_bytes;
+        }
+        if (chunk == 0) {
+            return;
+        }
+        if (seg.interleaved) {
+            uint64_t row = 0;
+            for (std::size_t no=0; no<layout.size(); ++no) {
+                if (layout[no].n_bytes == 0) {
+                    continue;
+                }
+                if (layout[no].type == tdsTypeString) {
+                    throw std::runtime_error("Interleaved strings in TDMS file");
+                }
+                row += typeWidth(layout[no].type);
+            }
+            uint64_t rows = seg.data_size/row;
+            uint64_t piece = std::max(uint64_t(1), max_bytes/row);
+            for (uint64_t r0=0; r0<rows; r0+=piece) {
+                uint64_t n = std::min(piece, rows-r0);
+                uint64_t col = 0;
+                for (std::size_t no=0; no<layout.size(); ++no) {
+                    const SegmentObject& so = layout[no];
+                    if (so.n_bytes == 0) {
+                        continue;
+                    }
+                    if (tdms.objects[so.object].wanted && isNumeric(so.type)) {
+                        visit(so.object, seg.data_pos + r0*row + col, row, n, so.type, seg.swap);
+                    }
+                    col += typeWidth(so.type);
+                }
+            }
+            return;
+        }
+        // the last chunk of an incomplete segment may be cut short:
+        for (uint64_t start=0; start<seg.data_size; start+=chunk) {
+            uint64_t pos = seg.data_pos + start;
+            uint64_t remaining = seg.data_size - start;
+            for (std::size_t no=0; no<layout.size() && remaining > 0; ++no) {
+                const SegmentObject& so = layout[no];
+                uint64_t bytes = std::min(so.n_bytes, remaining);
+                if (bytes > 0 && tdms.objects[so.object].wanted && isNumeric(so.type)) {
+                    uint64_t width = typeWidth(so.type);
+                    uint64_t n = bytes/width;
+                    uint64_t piece = std::max(uint64_t(1), max_bytes/width);
+                    for (uint64_t n0=0; n0<n; n0+=piece) {
+                        visit(so.object, pos + n0*width, width, std::min(piece, n-n0), so.type, seg.swap);
+                    }
+                }
+                pos += bytes;
+                remaining -= bytes;
+            }
+        }
+    }
+
+    // Counts the values of each object:
+    struct Counter {
+        Counter(TDMSFile& tdms_) : tdms(tdms_) {}
+        void operator()(std::size_t object, uint64_t, uint64_t, uint64_t n, uint32_t, bool) {
+            tdms.objects[object].total += n;
+        }
+        TDMSFile& tdms;
+    };
+
+    // Converts the values of each object, or collects their location in a memory-mapped file:
+    struct Loader {
+        Loader(TDMSFile& tdms_, Source& src_)
+            : tdms(tdms_), src(src_), values(tdms_.objects.size()), filled(tdms_.objects.size(), 0),
+              parts(tdms_.objects.size())
+        {
+            for (std::size_t no=0; no<tdms.objects.size(); ++no) {
+                if (tdms.objects[no].wanted && !lazy(no)) {
+                    values[no].resize((std::size_t)tdms.objects[no].total);
+                }
+            }
+        }
+
+        bool lazy(std::size_t object) const {
+            return src.mapping() && tdms.objects[object].mappable;
+        }
+
+        void operator()(std::size_t object, uint64_t pos, uint64_t stride, uint64_t n,
+                        uint32_t type, bool swap)
+        {
+            if (lazy(object)) {
+                stfio::sample_type sample = stfio::sample_float64;
+                toSampleType(type, sample);
+                std::vector<stfio::RawSamples>& p = parts[object];
+                // values that follow the previous run in the file are added to it:
+                if (!p.empty() && p.back().type == sample && p.back().swap == swap &&
+                    p.back().stride == stride && p.back().offset + p.back().size*stride == pos)
+                {
+                    p.back().size += n;
+                } else {
+                    p.push_back(stfio::RawSamples(src.mapping(), pos, stride, n, sample, swap));
+                }
+                return;
+            }
+            const char* data = src.get(pos, (n-1)*stride + typeWidth(type));
+            decode(data, stride, n, type, swap, &values[object][filled[object]]);
+            filled[object] += n;
+        }
+
+        // The samples of an object:
+        Section section(std::size_t object) {
+            if (lazy(object)) {
+                return Section(parts[object]);
+            }
+            return Section(std::move(values[object]));
+        }
+
+        TDMSFile& tdms;
+        Source& src;
+        std::vector<Vector_double> values;
+        std::vector<std::size_t> filled;
+        std::vector< std::vector<stfio::RawSamples> > parts;
+    };
+
+    // Splits an object path such as /'group'/'channel' into its names:
+    std::vector<std::string> splitPath(const std::string& path) {
+        std::vector<std::string> names;
+        std::size_t pos = 0;
+        while (pos+1 < path.size() && path[pos] == '/' && path[pos+1] == '\'') {
+            std::string name;
+            pos += 2;
+            while (pos < path.size()) {
+                if (path[pos] == '\'') {
+                    // quotes within names are doubled:
+                    if (pos+1 < path.size() && path[pos+1] == '\'') {
+                        name += '\'';
+                        pos += 2;
+                        continue;
+                    }
+                    ++pos;
+                    break;
+                }
+                name += path[pos++];
+            }
+            names.push_back(name);
+        }
+        return names;
+    }
+
+    std::string lower(std::string str) {
+        std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+        return str;
+    }
+
+    // A channel of the recording and the TDMS channels that make up its sections:
+    struct ChannelLayout {
+        std::string name;
+        std::vector<std::size_t> objects;
+    };
+}
+
+void stfio::importTDMSFile(const std::string &fName, Recording &ReturnData, ProgressInfo& progDlg) {
+    Source src(fName, stfio::UseMapping(fName));
+    progDlg.Update(0, "Reading TDMS index");
+    TDMSFile tdms;
+    readIndex(src, tdms);
+
+    // Mantis writes one group per analog channel, the sweeps being the channels of the group:
+    std::vector<ChannelLayout> channels;
+    std::vector<std::string> groups;
+    std::map<std::string, std::size_t> mantis;
+    std::size_t time_object = tdms.objects.size();
+    for (std::size_t no=0; no<tdms.objects.size(); ++no) {
+        std::vector<std::string> names = splitPath(tdms.objects[no].path);
+        if (names.size() != 2 || !tdms.objects[no].has_index || !isNumeric(tdms.objects[no].type)) {
+            continue;
+        }
+        std::string group = lower(names[0]);
+        if (group == "time" && time_object == tdms.objects.size()) {
+            time_object = no;
+        } else if (group.compare(0, 2, "ai") == 0 || group.compare(0, 2, "ao") == 0) {
+            if (mantis.find(names[0]) == mantis.end()) {
+                mantis[names[0]] = channels.size();
+                channels.push_back(ChannelLayout());
+                channels.back().name = names[0];
+            }
+            channels[mantis[names[0]]].objects.push_back(no);
+        }
+    }
+    if (channels.empty()) {
+        // every channel of the file is a channel with one section:
+        for (std::size_t no=0; no<tdms.objects.size(); ++no) {
+            std::vector<std::string> names = splitPath(tdms.objects[no].path);
+            if (names.size() == 2 && no != time_object &&
+                tdms.objects[no].has_index && isNumeric(tdms.objects[no].type))
+            {
+                channels.push_back(ChannelLayout());
+                channels.back().name = names[1];
+                channels.back().objects.push_back(no);
+            }
+        }
+    }
+    for (std::size_t nc=0; nc<channels.size(); ++nc) {
+        for (std::size_t ns=0; ns<channels[nc].objects.size(); ++ns) {
+            tdms.objects[channels[nc].objects[ns]].wanted = true;
+        }
+    }
+    if (time_object < tdms.objects.size()) {
+        tdms.objects[time_object].wanted = true;
+    }
+
+    Counter counter(tdms);
+    for (std::size_t nseg=0; nseg<tdms.segments.size(); ++nseg) {
+        forEachRun(tdms, tdms.segments[nseg], tdms.segments[nseg].data_size, counter);
+    }
+    Loader loader(tdms, src);
+    for (std::size_t nseg=0; nseg<tdms.segments.size(); ++nseg) {
+        const Segment& seg = tdms.segments[nseg];
+        std::ostringstream progStr;
+        progStr << "Reading segment #" << nseg+1 << " of " << tdms.segments.size();
+        bool skip = false;
+        progDlg.Update((int)(100.0*(double)seg.data_pos/(double)src.size()), progStr.str(), &skip);
+        if (skip) {
+            ReturnData.resize(0);
+            return;
+        }
+        forEachRun(tdms, seg, block_bytes, loader);
+    }
+
+    ReturnData.resize(channels.size());
+    for (std::size_t nc=0; nc<channels.size(); ++nc) {
+        const ChannelLayout& cl = channels[nc];
+        Channel ch(cl.objects.size());
+        for (std::size_t ns=0; ns<cl.objects.size(); ++ns) {
+            const Object& obj = tdms.objects[cl.objects[ns]];
+            Section sec(loader.section(cl.objects[ns]));
+            sec.SetSectionDescription(splitPath(obj.path)[1]);
+            ch.InsertSection(std::move(sec), ns);
+        }
+        ch.SetChannelName(cl.name);
+        std::map<std::string, std::string>::const_iterator unit =
+            tdms.objects[cl.objects[0]].text.find("unit_string");
+        if (unit != tdms.objects[cl.objects[0]].text.end()) {
+            ch.SetYUnits(unit->second);
+        }
+        ReturnData.InsertChannel(std::move(ch), nc);
+    }
+
+    // The sampling interval is taken from the time channel, the sampling rate of the file,
+    // or the waveform increment of the first channel, in this order:
+    double dt = 1.0;
+    std::map<std::string, double> props;
+    if (tdms.paths.find("/") != tdms.paths.end()) {
+        props = tdms.objects[tdms.paths["/"]].numbers;
+    }
+    std::map<std::string, double>::const_iterator rate = props.find("Sampling Rate");
+    if (rate == props.end()) {
+        rate = props.find("Sampling Rate(AI)");
+    }
+    if (time_object < tdms.objects.size() && tdms.objects[time_object].total > 1) {
+        const Section times(loader.section(time_object));
+        dt = (times[times.size()-1]-times[0])/(double)(times.size()-1);
+    } else if (rate != props.end()) {
+        dt = rate->second > 0 ? 1.0e3/rate->second : 1.0/25.0;
+    } else if (!channels.empty()) {
+        const std::map<std::string, double>& chprops = tdms.objects[channels[0].objects[0]].numbers;
+        std::map<std::string, double>::const_iterator incr = chprops.find("wf_increment");
+        if (incr != chprops.end() && incr->second > 0) {
+            dt = incr->second*1.0e3;
+        }
+    }
+    ReturnData.SetXScale(dt);
+    ReturnData.SetXUnits("ms");
+    progDlg.Update(100, "Reading TDMS file");
+}
@@ -0,0 +1,45 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file tdmslib.h
+ *  \brief Import National Instruments TDMS files.
+ */
+
+#ifndef _TDMSLIB_H
+#define _TDMSLIB_H
+
+#include "./../stfio.h"
+
+class Recording;
+
+namespace stfio {
+
+//! Open a TDMS file and store its contents to a Recording object.
+/*! Groups whose names start with "ai" or "ao", as written by Mantis, become
+ *  channels whose sections are the channels of the group. In other files,
+ *  every channel of the file becomes a channel with a single section.
+ *  The samples are decoded a block at a time. Files of at least
+ *  GetMappingThreshold() bytes are memory-mapped instead, and their samples
+ *  are only converted when they are accessed.
+ *  Throws std::runtime_error if the file can't be read.
+ *  \param fName The full path to the file to be opened.
+ *  \param ReturnData On entry, an empty Recording object. On exit,
+ *         the data stored in \e fName.
+ *  \param progDlg Progress indicator.
+ */
+    void importTDMSFile(const std::string& fName, Recording& ReturnData, ProgressInfo& progDlg);
+
+}
+
+#endif
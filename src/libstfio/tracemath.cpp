@@ -0,0 +1,132 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+
+#include "./stfio.h"
+
+const std::size_t stfio::TraceOps::block_size;
+
+stfio::TraceOps::TraceOps()
+    : ops()
+{
+}
+
+stfio::TraceOps& stfio::TraceOps::plus(double scalar) {
+    Op op;
+    op.type = op_plus;
+    op.value = scalar;
+    ops.push_back(op);
+    return *this;
+}
+
+stfio::TraceOps& stfio::TraceOps::minus(double scalar) {
+    // x + (-a) is exactly x - a:
+    return plus(-scalar);
+}
+
+stfio::TraceOps& stfio::TraceOps::mul(double scalar) {
+    Op op;
+    op.type = op_mul;
+    op.value = scalar;
+    ops.push_back(op);
+    return *this;
+}
+
+stfio::TraceOps& stfio::TraceOps::div(double scalar) {
+    // not replaced by a multiplication with the reciprocal, which would round differently:
+    Op op;
+    op.type = op_div;
+    op.value = scalar;
+    ops.push_back(op);
+    return *this;
+}
+
+stfio::TraceOps& stfio::TraceOps::minus_sum(const std::vector<const double*>& traces, double factor) {
+    Op op;
+    op.type = op_minus_sum;
+    op.value = factor;
+    op.traces = traces;
+    ops.push_back(op);
+    return *this;
+}
+
+void stfio::TraceOps::apply_block(const Op& op, const double* src, double* dest,
+                                  std::size_t start, std::size_t n)
+{
+    // the loops are kept simple so that the compiler can vectorize them:
+    double a = op.value;
+    switch (op.type) {
+     case op_plus:
+         for (std::size_t k = 0; k < n; ++k) {
+             dest[k] = src[k] + a;
+         }
+         break;
+     case op_mul:
+         for (std::size_t k = 0; k < n; ++k) {
+             dest[k] = src[k] * a;
+         }
+         break;
+     case op_div:
+         for (std::size_t k = 0; k < n; ++k) {
+             dest[k] = src[k] / a;
+         }
+         break;
+     case op_minus_sum: {
+         double sum[block_size];
+         std::fill(sum, sum+n, 0.0);
+         for (std::size_t l = 0; l < op.traces.size(); ++l) {
+             const double* x = op.traces[l] + start;
+             for (std::size_t k = 0; k < n; ++k) {
+                 sum[k] += x[k];
+             }
+         }
+         for (std::size_t k = 0; k < n; ++k) {
+             dest[k] = src[k] - sum[k]*a;
+         }
+         break;
+     }
+    }
+}
+
+void stfio::TraceOps::apply(const double* src, double* dest, std::size_t n) const {
+    if (ops.empty()) {
+        if (src != dest) {
+            std::copy(src, src+n, dest);
+        }
+        return;
+    }
+    for (std::size_t start = 0; start < n; start += block_size) {
+        std::size_t n_block = std::min(block_size, n-start);
+        // the first operation reads the source, all others work on the block in dest:
+        apply_block(ops[0], src+start, dest+start, start, n_block);
+        for (std::size_t n_op = 1; n_op < ops.size(); ++n_op) {
+            apply_block(ops[n_op], dest+start, dest+start, start, n_block);
+        }
+    }
+}
+
+void stfio::TraceOps::apply(Vector_double& data) const {
+    if (!data.empty()) {
+        apply(&data[0], &data[0], data.size());
+    }
+}
+
+Vector_double stfio::TraceOps::operator()(const Vector_double& data) const {
+    Vector_double ret_vec(data.size());
+    if (!data.empty()) {
+        apply(&data[0], &ret_vec[0], data.size());
+    }
+    return ret_vec;
+}
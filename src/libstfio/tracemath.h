@@ -0,0 +1,118 @@
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*! \file tracemath.h
+ *  \brief Declares chains of point-wise operations on traces.
+ */
+
+#ifndef _TRACEMATH_H
+#define _TRACEMATH_H
+
+namespace stfio {
+
+/*! \addtogroup stfio
+ *  @{
+ */
+
+//! A chain of point-wise operations on a trace.
+/*! The operations are applied in the order in which they were added, to a
+ *  block of data points at a time, so that a chain such as subtracting
+ *  the baseline, scaling and subtracting leak traces reads and writes
+ *  every data point only once. The results are the same as those of
+ *  applying the operations one after another to the whole trace.
+ */
+class StfioDll TraceOps {
+public:
+    //! Number of data points that are processed at a time.
+    static const std::size_t block_size = 1024;
+
+    //! Constructs an empty chain that copies the data points.
+    TraceOps();
+
+    //! Adds a scalar to every data point.
+    /*! \param scalar The scalar.
+     *  \return This chain.
+     */
+    TraceOps& plus(double scalar);
+
+    //! Subtracts a scalar from every data point.
+    /*! \param scalar The scalar.
+     *  \return This chain.
+     */
+    TraceOps& minus(double scalar);
+
+    //! Multiplies every data point by a scalar.
+    /*! \param scalar The scalar.
+     *  \return This chain.
+     */
+    TraceOps& mul(double scalar);
+
+    //! Divides every data point by a scalar.
+    /*! \param scalar The scalar.
+     *  \return This chain.
+     */
+    TraceOps& div(double scalar);
+
+    //! Subtracts a multiple of the sum of several traces, as in P/N leak subtraction.
+    /*! The traces are not copied; they have to stay alive and contain at
+     *  least as many data points as the chain is applied to.
+     *  \param traces Pointers to the first data point of each trace.
+     *  \param factor The sum of the traces is multiplied by this factor.
+     *  \return This chain.
+     */
+    TraceOps& minus_sum(const std::vector<const double*>& traces, double factor=1.0);
+
+    //! Number of operations in the chain.
+    std::size_t size() const { return ops.size(); }
+
+    //! Applies the chain to an array of data points.
+    /*! \param src The data points.
+     *  \param dest Array of at least \e n doubles that will contain the result.
+     *         May be the same as \e src.
+     *  \param n Number of data points.
+     */
+    void apply(const double* src, double* dest, std::size_t n) const;
+
+    //! Applies the chain in place.
+    /*! \param data The data points.
+     */
+    void apply(Vector_double& data) const;
+
+    //! Applies the chain to a copy.
+    /*! \param data The data points.
+     *  \return The result.
+     */
+    Vector_double operator()(const Vector_double& data) const;
+
+private:
+    enum op_type { op_plus, op_mul, op_div, op_minus_sum };
+
+    struct Op {
+        op_type type;
+        double value;
+        std::vector<const double*> traces;
+    };
+
+    // Applies op to the n data points of a block that starts at index start:
+    static void apply_block(const Op& op, const double* src, double* dest,
+                            std::size_t start, std::size_t n);
+
+    std::vector<Op> ops;
+};
+
+/*@}*/
+
+} // end of namespace
+
+#endif
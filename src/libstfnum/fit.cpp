@@ -23,10 +23,6 @@ namespace stfnum {
 void c_func_lour(double *p, double* hx, int m, int n, void *adata);
 void c_jac_lour(double *p, double *j, int m, int n, void *adata);
 
-// Helper functions for lmFit to store the function at global scope:
-void saveFunc(stfnum::Func func);
-void saveJac(stfnum::Jac jac);
-
 // A struct that will be passed as a pointer to
 // Lourakis' C-functions. It is used to:
 // (1) specify which parameters are to be fitted, and
@@ -51,72 +47,106 @@ struct fitInfo {
     // sampling interval
     double dt;
 };
-}
 
-// Functions stored at global scope to be called by c_func_lour
-// and c_jac_lour
-stfnum::Func func_lour;
-stfnum::Jac jac_lour; 
+// Everything that a single fit needs, passed to Lourakis' routines
+// through the adata pointer. Since there is no state at global scope,
+// several fits can run concurrently, each with its own context.
+struct fitContext {
+    fitContext(const stfnum::storedFunc& fitFunc, const fitInfo& fInfo_arg,
+               std::size_t worksz)
+        :   func(fitFunc.func), jac(fitFunc.jac),
+            funcBatch(fitFunc.funcBatch), jacBatch(fitFunc.jacBatch),
+            fInfo(fInfo_arg), p_f(fInfo_arg.fit_p.size()), jac_f(), work(worksz)
+    {}
 
-void stfnum::saveFunc(stfnum::Func func) {
-    func_lour=func;
-}
+    // The function to be fitted and its Jacobian:
+    stfnum::Func func;
+    stfnum::Jac jac;
+
+    // Optional versions of func and jac that evaluate all x-values at once:
+    stfnum::FuncBatch funcBatch;
+    stfnum::JacBatch jacBatch;
+
+    // Fitted and constant parameters, sampling interval:
+    fitInfo fInfo;
+
+    // Scratch space for all parameters, including constants:
+    Vector_double p_f;
+
+    // Scratch space for the derivatives of all parameters from jacBatch:
+    Vector_double jac_f;
+
+    // levmar work space; avoids a large allocation in every pass:
+    Vector_double work;
 
-void stfnum::saveJac(stfnum::Jac jac) {
-    jac_lour=jac;
+    // Fills p_f with the fitted parameters from p and the constants
+    // from fInfo:
+    void merge_pars(const double* p) {
+        // total number of parameters, including constants:
+        int tot_p=(int)fInfo.fit_p.size();
+        for (int n_tp=0, n_p=0, n_f=0;n_tp<tot_p;++n_tp) {
+            // if the parameter needs to be fitted...
+            if (fInfo.fit_p[n_tp]) {
+                // ... take it from *p, ...
+                p_f[n_tp] = p[n_p++];
+            } else {
+                // ... otherwise, take it from the fInfo struct:
+                p_f[n_tp] = fInfo.const_p[n_f++];
+            }
+        }
+    }
+};
 }
 
 void stfnum::c_func_lour(double *p, double* hx, int m, int n, void *adata) {
     // m: the number of parameters that are to be fitted
-    // adata: pointer to a struct that (1) specifies which parameters are to be fitted
-    //		  and (2) contains the constant parameters
-    fitInfo *fInfo=static_cast<fitInfo*>(adata);
-    // total number of parameters, including constants:
-    int tot_p=(int)fInfo->fit_p.size();
-    // all parameters, including constants:
-    Vector_double p_f(tot_p);
-    for (int n_tp=0, n_p=0, n_f=0;n_tp<tot_p;++n_tp) {
-        // if the parameter needs to be fitted...
-        if (fInfo->fit_p[n_tp]) {
-            // ... take it from *p, ...
-            p_f[n_tp] = p[n_p++];
-        } else {
-            // ... otherwise, take it from the fInfo struct:
-            p_f[n_tp] = fInfo->const_p[n_f++];
-        }
+    // adata: pointer to the fit context that (1) specifies which parameters are to be fitted,
+    //		  (2) contains the constant parameters and (3) the function
+    fitContext *ctx=static_cast<fitContext*>(adata);
+    ctx->merge_pars(p);
+    if (ctx->funcBatch) {
+        ctx->funcBatch( ctx->fInfo.dt, ctx->p_f, hx, (std::size_t)n );
+        return;
     }
     for (int n_x=0;n_x<n;++n_x) {
-        hx[n_x]=func_lour( (double)n_x*fInfo->dt, p_f);
+        hx[n_x]=ctx->func( (double)n_x*ctx->fInfo.dt, ctx->p_f);
     }	
 }
 
 void stfnum::c_jac_lour(double *p, double *jac, int m, int n, void *adata) {
     // m: the number of parameters that are to be fitted
-    // adata: pointer to a struct that (1) specifies which parameters are to be fitted
-    //		  and (2) contains the constant parameters
-    fitInfo *fInfo=static_cast<fitInfo*>(adata);
+    // adata: pointer to the fit context that (1) specifies which parameters are to be fitted,
+    //		  (2) contains the constant parameters and (3) the Jacobian
+    fitContext *ctx=static_cast<fitContext*>(adata);
+    ctx->merge_pars(p);
     // total number of parameters, including constants:
-    int tot_p=(int)fInfo->fit_p.size();
-    // all parameters, including constants:
-    Vector_double p_f(tot_p);
-    for (int n_tp=0,n_p=0,n_f=0;n_tp<tot_p;++n_tp) {
-        // if the parameter needs to be fitted...
-        if (fInfo->fit_p[n_tp]) {
-            // ... take it from *p, ...
-            p_f[n_tp] = p[n_p++];
-        } else {
-            // ... otherwise, take it from the fInfo struct:
-            p_f[n_tp] = fInfo->const_p[n_f++];
+    int tot_p=(int)ctx->fInfo.fit_p.size();
+    if (ctx->jacBatch) {
+        // if all parameters are fitted, the layout is the same as levmar's:
+        if (m==tot_p) {
+            ctx->jacBatch( ctx->fInfo.dt, ctx->p_f, jac, (std::size_t)n );
+            return;
         }
+        ctx->jac_f.resize((std::size_t)n*tot_p);
+        ctx->jacBatch( ctx->fInfo.dt, ctx->p_f, &ctx->jac_f[0], (std::size_t)n );
+        for (int n_x=0,n_j=0;n_x<n;++n_x) {
+            const double* row=&ctx->jac_f[(std::size_t)n_x*tot_p];
+            for (int n_tp=0;n_tp<tot_p;++n_tp) {
+                if (ctx->fInfo.fit_p[n_tp]) {
+                    jac[n_j++]=row[n_tp];
+                }
+            }
+        }
+        return;
     }
     for (int n_x=0,n_j=0;n_x<n;++n_x) {
         // jac_f will calculate the derivatives of all parameters,
         // including the constants...
-        Vector_double jac_f(jac_lour((double)n_x*fInfo->dt,p_f));
+        Vector_double jac_f(ctx->jac((double)n_x*ctx->fInfo.dt,ctx->p_f));
         // ... but we only need the derivatives of the non-constants...
         for (int n_tp=0;n_tp<tot_p;++n_tp) {
             // ... hence, we will eliminate the derivatives of the constants:
-            if (fInfo->fit_p[n_tp]) {
+            if (ctx->fInfo.fit_p[n_tp]) {
                 jac[n_j++]=jac_f[n_tp];
             }
         }
@@ -197,10 +227,6 @@ double stfnum::lmFit( const Vector_double& data, double dt,
         }
     }
 
-    // Store the functions at global scope:
-    saveFunc(fitFunc.func);
-    saveJac(fitFunc.jac);
-
     double info_id[LM_INFO_SZ];
     Vector_double data_ptr(data);
     Vector_double xyscale(4);
@@ -245,7 +271,16 @@ double stfnum::lmFit( const Vector_double& data, double dt,
     if (can_scale)
         dt_finfo = 1.0/data_ptr.size();
 
-    fitInfo fInfo( p_fit_bool, p_const, dt_finfo );
+    // levmar work space for the selected algorithm:
+    std::size_t worksz = 0;
+    if ( !fitFunc.hasJac ) {
+        worksz = constrained ? LM_BC_DIF_WORKSZ(n_fitted, data.size()) :
+                               LM_DIF_WORKSZ(n_fitted, data.size());
+    } else {
+        worksz = constrained ? LM_BC_DER_WORKSZ(n_fitted, data.size()) :
+                               LM_DER_WORKSZ(n_fitted, data.size());
+    }
+    fitContext ctx( fitFunc, fitInfo( p_fit_bool, p_const, dt_finfo ), worksz );
 
     // make l-value of opts:
     Vector_double opts_l(5);
@@ -289,22 +324,22 @@ double stfnum::lmFit( const Vector_double& data, double dt,
                 if ( !constrained ) {
                     dlevmar_dif( c_func_lour, &p_toFit[0], &data_ptr[0], n_fitted, 
                             (int)data.size(), (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );
+                            &ctx.work[0], NULL, &ctx );
                 } else {
                     dlevmar_bc_dif( c_func_lour, &p_toFit[0], &data_ptr[0], n_fitted, 
                             (int)data.size(), &constrains_lm_lb[0], &constrains_lm_ub[0], NULL,
-                            (int)opts[4], &opts_l[0], info_id, NULL, NULL, &fInfo );
+                            (int)opts[4], &opts_l[0], info_id, &ctx.work[0], NULL, &ctx );
                 }
             } else {
                 if ( !constrained ) {
                     dlevmar_der( c_func_lour, c_jac_lour, &p_toFit[0], &data_ptr[0], 
                             n_fitted, (int)data.size(), (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );                
+                            &ctx.work[0], NULL, &ctx );                
                 } else {
                     dlevmar_bc_der( c_func_lour,  c_jac_lour, &p_toFit[0], 
                             &data_ptr[0], n_fitted, (int)data.size(), &constrains_lm_lb[0], 
                             &constrains_lm_ub[0], NULL, (int)opts[4], &opts_l[0], info_id,
-                            NULL, NULL, &fInfo );
+                            &ctx.work[0], NULL, &ctx );
                 }
             }
             it++;
@@ -403,6 +438,44 @@ double stfnum::lmFit( const Vector_double& data, double dt,
     return info_id[1];
 }
 
+Vector_double stfnum::lmFitBatch( const std::vector<Vector_double>& data, double dt,
+                                  const stfnum::storedFunc& fitFunc, const Vector_double& opts,
+                                  bool use_scaling, std::vector<Vector_double>& p,
+                                  std::vector<std::string>& info, std::vector<int>& warning )
+{
+    if ( p.size() != data.size() ) {
+        throw std::out_of_range("Number of parameter sets doesn't match number of traces in stfnum::lmFitBatch");
+    }
+    for ( std::size_t n_s = 0; n_s < p.size(); ++n_s ) {
+        if ( p[n_s].size() != fitFunc.pInfo.size() ) {
+            throw std::out_of_range("Number of parameters doesn't match function in stfnum::lmFitBatch");
+        }
+    }
+
+    Vector_double chisqr(data.size(), NAN);
+    info.assign(data.size(), std::string());
+    warning.assign(data.size(), 0);
+
+    // Each fit runs on its own fitContext, so the traces can be
+    // fitted concurrently:
+    int n_traces = (int)data.size();
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for ( int n_s = 0; n_s < n_traces; ++n_s ) {
+        // exceptions must not leave the parallel region:
+        try {
+            chisqr[n_s] = lmFit( data[n_s], dt, fitFunc, opts, use_scaling,
+                                 p[n_s], info[n_s], warning[n_s] );
+        }
+        catch (const std::exception& e) {
+            info[n_s] = e.what();
+            warning[n_s] = -1;
+        }
+    }
+    return chisqr;
+}
+
 double stfnum::flin(double x, const Vector_double& p) { return p[0]*x + p[1]; }
 
 //! Dummy function to be passed to stfnum::storedFunc for linear functions.
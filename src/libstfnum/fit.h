@@ -66,6 +66,27 @@ double StfioDll lmFit(const Vector_double& data, double dt,
                       const stfnum::storedFunc& fitFunc, const Vector_double& opts,
                       bool use_scaling, Vector_double& p, std::string& info, int& warning );
 
+//! Fits a function to a number of traces, using several threads if available.
+/*! Each trace is fitted independently with stfnum::lmFit(). \e fitFunc's
+ *  function, Jacobian and initialiser may be called concurrently and
+ *  must therefore be re-entrant.
+ *  \param data The traces that are to be fitted.
+ *  \param dt The sampling interval of \e data.
+ *  \param fitFunc An stfnum::storedFunc to be fitted to \e data.
+ *  \param opts Options controlling Lourakis' implementation of the algorithm.
+ *  \param use_scaling Whether to scale x and y-amplitudes to 1.0
+ *  \param p One set of parameters per trace. Should be set to an initial guess
+ *         on entry. Will contain the best-fit values on exit.
+ *  \param info On exit, information about why each fit stopped iterating,
+ *         or the error message if a fit failed.
+ *  \param warning On exit, a warning code for each fit; -1 if the fit failed.
+ *  \return The sum of squared errors for each trace; NaN if the fit failed.
+ */
+Vector_double StfioDll lmFitBatch(const std::vector<Vector_double>& data, double dt,
+                                  const stfnum::storedFunc& fitFunc, const Vector_double& opts,
+                                  bool use_scaling, std::vector<Vector_double>& p,
+                                  std::vector<std::string>& info, std::vector<int>& warning );
+
 //! Linear function.
 /*! \f[f(x)=p_0 x + p_1\f]
  *  \param x Function argument.
@@ -12,6 +12,7 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 #include <sstream>
@@ -25,12 +26,14 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     
     // Monoexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoMExp=getParInfoExp(1);
-    funcList.push_back(stfnum::storedFunc("Monoexponential",parInfoMExp,fexp,fexp_init,fexp_jac,true));
+    funcList.push_back(stfnum::storedFunc("Monoexponential",parInfoMExp,fexp,fexp_init,fexp_jac,true,
+                                         defaultOutput,fexp_batch,fexp_jac_batch));
 
     // Monoexponential function, offset fixed to baseline:
     parInfoMExp[2].toFit=false;
     funcList.push_back(stfnum::storedFunc("Monoexponential, offset fixed to baseline",
-                                         parInfoMExp,fexp,fexp_init,fexp_jac,true));
+                                         parInfoMExp,fexp,fexp_init,fexp_jac,true,
+                                         defaultOutput,fexp_batch,fexp_jac_batch));
 
     // Monoexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoMExpDe(4);
@@ -39,17 +42,20 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoMExpDe[2].toFit=true; parInfoMExpDe[2].desc="tau"; parInfoMExpDe[0].scale=stfnum::xscale; parInfoMExpDe[0].unscale=stfnum::xunscale;
     parInfoMExpDe[3].toFit=true; parInfoMExpDe[3].desc="Peak"; parInfoMExpDe[0].scale=stfnum::yscale; parInfoMExpDe[0].unscale=stfnum::yunscale;
     funcList.push_back(stfnum::storedFunc("Monoexponential with delay, start fixed to baseline",
-                                         parInfoMExpDe,fexpde,fexpde_init,stfnum::nojac,false));
+                                         parInfoMExpDe,fexpde,fexpde_init,stfnum::nojac,false,
+                                         defaultOutput,fexpde_batch));
 
     // Biexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoBExp=getParInfoExp(2);
     funcList.push_back(stfnum::storedFunc(
-                                       "Biexponential",parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Biexponential",parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Biexponential function, offset fixed to baseline:
     parInfoBExp[4].toFit=false;
     funcList.push_back(stfnum::storedFunc("Biexponential, offset fixed to baseline",
-                                         parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                         parInfoBExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                         fexp_batch,fexp_jac_batch));
 
     // Biexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoBExpDe(5);
@@ -63,21 +69,25 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     // parInfoBExpDe[4].constrained = true; parInfoBExpDe[4].constr_lb = 1.0e-16; parInfoBExpDe[4].constr_ub = DBL_MAX;
     funcList.push_back(stfnum::storedFunc(
                                        "Biexponential with delay, start fixed to baseline, delay constrained to > 0",
-                                       parInfoBExpDe,fexpbde,fexpbde_init,stfnum::nojac,false));
+                                       parInfoBExpDe,fexpbde,fexpbde_init,stfnum::nojac,false,
+                                       defaultOutput,fexpbde_batch));
 
     // Triexponential function, free fit:
     std::vector<stfnum::parInfo> parInfoTExp=getParInfoExp(3);
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Triexponential",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Triexponential function, free fit, different initialization:
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential, initialize for PSCs/PSPs",parInfoTExp,fexp,fexp_init2,fexp_jac,true,outputWTau));
+                                       "Triexponential, initialize for PSCs/PSPs",parInfoTExp,fexp,fexp_init2,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Triexponential function, offset fixed to baseline:
     parInfoTExp[6].toFit=false;
     funcList.push_back(stfnum::storedFunc(
-                                       "Triexponential, offset fixed to baseline",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau));
+                                       "Triexponential, offset fixed to baseline",parInfoTExp,fexp,fexp_init,fexp_jac,true,outputWTau,
+                                       fexp_batch,fexp_jac_batch));
 
     // Alpha function:
     std::vector<stfnum::parInfo> parInfoAlpha(3);
@@ -85,7 +95,8 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoAlpha[1].toFit=true; parInfoAlpha[1].desc="Rate";
     parInfoAlpha[2].toFit=true; parInfoAlpha[2].desc="Offset";
     funcList.push_back(stfnum::storedFunc(
-                                       "Alpha function", parInfoAlpha,falpha,falpha_init,falpha_jac,true));
+                                       "Alpha function", parInfoAlpha,falpha,falpha_init,falpha_jac,true,
+                                       defaultOutput,falpha_batch,falpha_jac_batch));
 
     // HH gNa function:
     std::vector<stfnum::parInfo> parInfoHH(4);
@@ -94,7 +105,8 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoHH[2].toFit=true; parInfoHH[2].desc="tau_h";
     parInfoHH[3].toFit=false; parInfoHH[3].desc="offset";
     funcList.push_back(stfnum::storedFunc(
-                                         "Hodgkin-Huxley g_Na function, offset fixed to baseline", parInfoHH, fHH, fHH_init, stfnum::nojac, false));
+                                         "Hodgkin-Huxley g_Na function, offset fixed to baseline", parInfoHH, fHH, fHH_init, stfnum::nojac, false,
+                                         defaultOutput, fHH_batch));
 
     // power of 1 gNa function:
     funcList.push_back(stfnum::storedFunc(
@@ -110,7 +122,8 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoGauss[2].desc="width"; parInfoGauss[2].scale = stfnum::xscale; parInfoGauss[2].unscale = stfnum::xunscale;
 
     funcList.push_back(stfnum::storedFunc(
-                                       "Gaussian", parInfoGauss, fgauss, fgauss_init, fgauss_jac, true));
+                                       "Gaussian", parInfoGauss, fgauss, fgauss_init, fgauss_jac, true,
+                                       defaultOutput, fgauss_batch, fgauss_jac_batch));
 
     // Triexponential function, starting with a delay, start fixed to baseline:
     std::vector<stfnum::parInfo> parInfoTExpDe(7);
@@ -125,7 +138,8 @@ std::vector< stfnum::storedFunc > stfnum::GetFuncLib() {
     parInfoTExpDe[6].toFit=true;  parInfoTExpDe[6].desc="ptau1b"; parInfoTExpDe[6].scale=stfnum::noscale; parInfoTExpDe[6].unscale=stfnum::noscale;
     funcList.push_back(stfnum::storedFunc(
                                        "Triexponential with delay, start fixed to baseline, delay constrained to > 0",
-                                       parInfoTExpDe,fexptde,fexptde_init,stfnum::nojac,false));
+                                       parInfoTExpDe,fexptde,fexptde_init,stfnum::nojac,false,
+                                       defaultOutput,fexptde_batch));
 
     return funcList;
 }
@@ -508,6 +522,135 @@ void stfnum::fgnabiexp_init(const Vector_double& data, double base, double peak,
     pInit[0] = (peak-base)/norm;
 }
 
+namespace {
+// Index of the first grid point x = i*dx that is not smaller than x0:
+std::size_t first_not_before(double dx, double x0, std::size_t n) {
+    std::size_t n_x = 0;
+    while (n_x < n && (double)n_x*dx < x0) {
+        ++n_x;
+    }
+    return n_x;
+}
+}
+
+// The batch evaluators below compute the same expressions as their
+// per-point counterparts, but without allocating and with the loop over
+// the x-values innermost wherever possible, so that it can be vectorized.
+// Exponentials that are needed more than once are only computed once.
+void stfnum::fexp_batch(double dx, const Vector_double& p, double* hx, std::size_t n) {
+    std::fill(hx, hx+n, 0.0);
+    for (std::size_t n_p=0;n_p<p.size()-1;n_p+=2) {
+        const double amp=p[n_p], tau=p[n_p+1];
+        for (std::size_t n_x=0;n_x<n;++n_x) {
+            hx[n_x]+=amp*exp(-((double)n_x*dx)/tau);
+        }
+    }
+    const double offset=p[p.size()-1];
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        hx[n_x]+=offset;
+    }
+}
+
+void stfnum::fexp_jac_batch(double dx, const Vector_double& p, double* jac, std::size_t n) {
+    const std::size_t n_par=p.size();
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        const double x=(double)n_x*dx;
+        double* row=jac+n_x*n_par;
+        for (std::size_t n_p=0;n_p<n_par-1;n_p+=2) {
+            double e=exp(-x/p[n_p+1]);
+            row[n_p]=e;
+            row[n_p+1]=p[n_p]*x*e/(p[n_p+1]*p[n_p+1]);
+        }
+        row[n_par-1]=1.0;
+    }
+}
+
+void stfnum::fexpde_batch(double dx, const Vector_double& p, double* hx, std::size_t n) {
+    std::size_t n_start=first_not_before(dx, p[1], n);
+    std::fill(hx, hx+n_start, p[0]);
+    for (std::size_t n_x=n_start;n_x<n;++n_x) {
+        double e1=exp((p[1]-(double)n_x*dx)/p[2]);
+        hx[n_x]=(p[0]-p[3])*e1 + p[3];
+    }
+}
+
+void stfnum::fexpbde_batch(double dx, const Vector_double& p, double* hx, std::size_t n) {
+    std::size_t n_start=first_not_before(dx, p[1], n);
+    std::fill(hx, hx+n_start, p[0]);
+    for (std::size_t n_x=n_start;n_x<n;++n_x) {
+        const double x=(double)n_x*dx;
+        double e1=exp((p[1]-x)/p[2]);
+        double e2=exp((p[1]-x)/p[4]);
+        hx[n_x]=p[3]*e1 - p[3]*e2 + p[0];
+    }
+}
+
+void stfnum::fexptde_batch(double dx, const Vector_double& p, double* hx, std::size_t n) {
+    std::size_t n_start=first_not_before(dx, p[1], n);
+    std::fill(hx, hx+n_start, p[0]);
+    for (std::size_t n_x=n_start;n_x<n;++n_x) {
+        const double x=(double)n_x*dx;
+        double e1=exp((p[1]-x)/p[2]);
+        double e2=exp((p[1]-x)/p[4]);
+        double e3=exp((p[1]-x)/p[5]);
+        hx[n_x]=p[6]*p[3]*e1 + (1.0-p[6])*p[3]*e3 - p[3]*e2 + p[0];
+    }
+}
+
+void stfnum::falpha_batch(double dx, const Vector_double& p, double* hx, std::size_t n) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        const double x=(double)n_x*dx;
+        hx[n_x]=p[0]*x/p[1]*exp(1-x/p[1]) + p[2];
+    }
+}
+
+void stfnum::falpha_jac_batch(double dx, const Vector_double& p, double* jac, std::size_t n) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        const double x=(double)n_x*dx;
+        double* row=jac+n_x*3;
+        row[0] = x*exp(1-x/p[1])/p[1];
+        row[1] = row[0]*( x*p[0]/(p[1]*p[1]) - p[0]/p[1] );
+        row[2] = 1.0;
+    }
+}
+
+void stfnum::fHH_batch(double dx, const Vector_double& p, double* hx, std::size_t n) {
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        const double x=(double)n_x*dx;
+        double m = 1 - exp(-x/p[1]);
+        double h = exp(-x/p[2]);
+        hx[n_x] = p[0] * (m*m*m) * h + p[3];
+    }
+}
+
+void stfnum::fgauss_batch(double dx, const Vector_double& pars, double* hx, std::size_t n) {
+    std::fill(hx, hx+n, 0.0);
+    int npars=static_cast<int>(pars.size());
+    for (int i=0; i < npars-1; i += 3) {
+        const double amp=pars[i], mean=pars[i+1], width=pars[i+2];
+        for (std::size_t n_x=0;n_x<n;++n_x) {
+            double arg=((double)n_x*dx-mean)/width;
+            hx[n_x] += amp * exp(-arg*arg);
+        }
+    }
+}
+
+void stfnum::fgauss_jac_batch(double dx, const Vector_double& pars, double* jac, std::size_t n) {
+    int npars=static_cast<int>(pars.size());
+    std::fill(jac, jac+n*npars, 0.0);
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        const double x=(double)n_x*dx;
+        double* row=jac+n_x*npars;
+        for (int i=0; i < npars-1; i += 3) {
+            double arg=(x-pars[i+1])/pars[i+2];
+            double ex=exp(-arg*arg);
+            row[i] = ex;
+            row[i+1] = 2.0*ex*pars[i]*(x-pars[i+1]) / (pars[i+2]*pars[i+2]);
+            row[i+2] = 2.0*ex*pars[i]*(x-pars[i+1])*(x-pars[i+1]) / (pars[i+2]*pars[i+2]*pars[i+2]);
+        }
+    }
+}
+
 std::vector<stfnum::parInfo> stfnum::getParInfoExp(int n_exp) {
     std::vector<stfnum::parInfo> retParInfo(n_exp*2+1);
     for (int n_e=0; n_e<n_exp*2; n_e+=2) {
@@ -396,6 +396,46 @@ namespace stfnum {
      */
     void fgnabiexp_init(const Vector_double& data, double base, double peak, double RTLoHi, double HalfWidth, double dt, Vector_double& pInit );
 
+    //! Evaluates stfnum::fexp() at x = i*dx for i = 0, ..., n-1.
+    /*! \param dx Sampling interval.
+     *  \param p Function parameters, see stfnum::fexp().
+     *  \param hx On exit, the \e n function values.
+     *  \param n Number of points.
+     */
+    void fexp_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
+    //! Evaluates stfnum::fexp_jac() at x = i*dx for i = 0, ..., n-1.
+    /*! \param dx Sampling interval.
+     *  \param p Function parameters, see stfnum::fexp().
+     *  \param jac On exit, \e n rows of p.size() derivatives each.
+     *  \param n Number of points.
+     */
+    void fexp_jac_batch(double dx, const Vector_double& p, double* jac, std::size_t n);
+
+    //! Evaluates stfnum::fexpde() at x = i*dx for i = 0, ..., n-1.
+    void fexpde_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
+    //! Evaluates stfnum::fexpbde() at x = i*dx for i = 0, ..., n-1.
+    void fexpbde_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
+    //! Evaluates stfnum::fexptde() at x = i*dx for i = 0, ..., n-1.
+    void fexptde_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
+    //! Evaluates stfnum::falpha() at x = i*dx for i = 0, ..., n-1.
+    void falpha_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
+    //! Evaluates stfnum::falpha_jac() at x = i*dx for i = 0, ..., n-1.
+    void falpha_jac_batch(double dx, const Vector_double& p, double* jac, std::size_t n);
+
+    //! Evaluates stfnum::fHH() at x = i*dx for i = 0, ..., n-1.
+    void fHH_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
+    //! Evaluates stfnum::fgauss() at x = i*dx for i = 0, ..., n-1.
+    void fgauss_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
+    //! Evaluates stfnum::fgauss_jac() at x = i*dx for i = 0, ..., n-1.
+    void fgauss_jac_batch(double dx, const Vector_double& p, double* jac, std::size_t n);
+
     //! Scales a parameter that linearly depends on x
     /*! \param The parameter to scale
      *  \param xscale x scaling factor
@@ -433,7 +433,9 @@ LM_REAL tmin=LM_CNST(1e-12), tming=LM_CNST(1e-18); /* minimum step length for LS
 const LM_REAL tini=LM_CNST(1.0); /* initial step length for LS and PG steps */
 int nLMsteps=0, nLSsteps=0, nPGsteps=0, gprevtaken=0;
 int numactive;
+#ifdef LINSOLVERS_RETAIN_MEMORY
 int (*linsolver)(LM_REAL *A, LM_REAL *B, LM_REAL *x, int m)=NULL;
+#endif
 
   mu=jacTe_inf=t=0.0;  tmin=tmin; /* -Wall */
 
@@ -688,7 +690,10 @@ if(!(k%100)){
        * slower than LDLt; LDLt offers a good tradeoff between robustness and speed
        */
 
-      issolved=AX_EQ_B_BK(jacTjac, jacTe, Dp, m); ++nlss; linsolver=AX_EQ_B_BK;
+      issolved=AX_EQ_B_BK(jacTjac, jacTe, Dp, m); ++nlss;
+#ifdef LINSOLVERS_RETAIN_MEMORY
+      linsolver=AX_EQ_B_BK;
+#endif
       //issolved=AX_EQ_B_LU(jacTjac, jacTe, Dp, m); ++nlss; linsolver=AX_EQ_B_LU;
       //issolved=AX_EQ_B_CHOL(jacTjac, jacTe, Dp, m); ++nlss; linsolver=AX_EQ_B_CHOL;
 #ifdef HAVE_PLASMA
@@ -700,7 +705,10 @@ if(!(k%100)){
 
 #else
       /* use the LU included with levmar */
-      issolved=AX_EQ_B_LU(jacTjac, jacTe, Dp, m); ++nlss; linsolver=AX_EQ_B_LU;
+      issolved=AX_EQ_B_LU(jacTjac, jacTe, Dp, m); ++nlss;
+#ifdef LINSOLVERS_RETAIN_MEMORY
+      linsolver=AX_EQ_B_LU;
+#endif
 #endif /* HAVE_LAPACK */
 
       if(issolved){
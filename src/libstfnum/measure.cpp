@@ -26,6 +26,10 @@
  */
 
 #include <stdexcept>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <cfloat>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -33,9 +37,111 @@
 #include "./stfnum.h"
 #include "./measure.h"
 
-int compareDouble(const void *a, const void *b)
-{
-    return ( ( *(double*)a >  *(double*)b ) - ( *(double*)a < *(double*)b ) );
+namespace {
+
+    // Returns a scratch buffer of at least n doubles. The buffer is kept for the
+    // next call on the same thread, so that repeated measurements don't allocate
+    // memory. Without thread_local (before C++11), local is used instead.
+    double* scratch(std::size_t n, std::vector<double>& local) {
+#if (__cplusplus < 201103)
+        std::vector<double>& buf = local;
+#else
+        (void)local;
+        static thread_local std::vector<double> buf;
+#endif
+        if (buf.size() < n) {
+            buf.resize(n);
+        }
+        return &buf[0];
+    }
+
+    // Median and inter-quartile range of a, which is reordered. Only the
+    // order statistics that are needed are selected, largest first, each within
+    // the part of a that is left of the previous one.
+    double quartiles(double* a, std::size_t n, double& iqr) {
+        std::size_t ranks[6] = {
+            (n-1)/2, n/2,
+            (std::size_t)std::min<long>((long)(n-1), (long)ceil(3*n/4.0-1)),
+            (std::size_t)std::max<long>(0l, (long)floor(3*n/4.0-1)),
+            (std::size_t)std::min<long>((long)(n-1), (long)ceil(  n/4.0-1)),
+            (std::size_t)std::max<long>(0l, (long)floor(  n/4.0-1))
+        };
+        std::size_t sorted[6];
+        std::copy(ranks, ranks+6, sorted);
+        std::sort(sorted, sorted+6);
+        std::size_t end = n;
+        for (int k=5; k>=0; --k) {
+            if (sorted[k] < end) {
+                std::nth_element(a, a+sorted[k], a+end);
+                end = sorted[k];
+            }
+        }
+
+        /*
+         *  inter-quartile range (IQR),
+         *  interpolated as average of upper and lower bound
+         */
+        double Q32 = a[ranks[2]] + a[ranks[3]];
+        double Q12 = a[ranks[4]] + a[ranks[5]];
+        iqr = (Q32 - Q12) / 2;
+
+        return (a[ranks[0]] + a[ranks[1]]) / 2;
+    }
+
+    // Width of the running median of stfnum::median_running for a baseline
+    // window of n points:
+    std::size_t running_width(std::size_t n) {
+        return std::min(n, std::max<std::size_t>(3, n/10));
+    }
+
+    // The median of a window into which values enter and from which they leave
+    // in O(log(n)) time. The lower half of the values is kept in lo, the upper
+    // half in hi; lo holds one value more than hi if the number is odd.
+    class MedianWindow {
+    public:
+        void insert(double val) {
+            if (lo.empty() || val <= *lo.rbegin()) {
+                lo.insert(val);
+            } else {
+                hi.insert(val);
+            }
+            balance();
+        }
+
+        // val must be in the window:
+        void erase(double val) {
+            // values equal to the largest one in lo may also be in hi, but lo has one:
+            if (val <= *lo.rbegin()) {
+                lo.erase(lo.find(val));
+            } else {
+                hi.erase(hi.find(val));
+            }
+            balance();
+        }
+
+        // The window must not be empty:
+        double median() const {
+            if (lo.size() > hi.size()) {
+                return *lo.rbegin();
+            }
+            return (*lo.rbegin() + *hi.begin()) / 2;
+        }
+
+    private:
+        void balance() {
+            if (lo.size() > hi.size()+1) {
+                std::multiset<double>::iterator last = --lo.end();
+                hi.insert(*last);
+                lo.erase(last);
+            } else if (hi.size() > lo.size()) {
+                std::multiset<double>::iterator first = hi.begin();
+                lo.insert(*first);
+                hi.erase(first);
+            }
+        }
+
+        std::multiset<double> lo, hi;
+    };
 }
 
 double stfnum::base(enum stfnum::baseline_method base_method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb)
@@ -50,33 +156,27 @@ double stfnum::base(enum stfnum::baseline_method base_method, double& var, const
     assert(n <= data.size());
 
     if (base_method == stfnum::median_iqr) {
-	// make  copy of the data for sorting
-        double *a = (double*)malloc(n * sizeof(double));
-        for (size_t i = 0; i < n; ++i) {
-            a[i] = data[i + llb];
-        }
-        qsort(a,n,sizeof(double),&compareDouble);
+        // make a copy of the data for the selection
+        std::vector<double> local;
+        double* a = scratch(n, local);
+        std::copy(data.begin()+llb, data.begin()+ulb+1, a);
+        return quartiles(a, n, var);
+    }
 
-	// get the median
-        if (n % 2)
-            base = a[(n-1)/2];
-        else {
-            n /=2;
-            base = (a[n-1] + a[n]) / 2;
+    if (base_method == stfnum::median_running) {
+        // the baseline at the end of the window, closest to the event:
+        Vector_double running = stfnum::running_median(data, llb, ulb, running_width(n));
+        base = running[n-1];
+        // the IQR of the data around the running median:
+        std::vector<double> local;
+        double* a = scratch(n, local);
+        for (std::size_t i = 0; i < n; ++i) {
+            a[i] = data[i + llb] - running[i];
         }
-
-        /*
-         *  compute inter-quartile range (IQR) and return in "var"
-         *  interpolate as average of upper and lower bound
-         *  and make sure that indices are within [0,n-1] interval
-         */
-	double Q32 = a[std::min<long>((long)(n-1), (long)ceil(3*n/4.0-1))] + a[std::max<long>(0l, (long)floor(3*n/4.0-1))];
-	double Q12 = a[std::min<long>((long)(n-1), (long)ceil(  n/4.0-1))] + a[std::max<long>(0l, (long)floor(  n/4.0-1))];
-	var = (Q32 - Q12) / 2;
-
-        free(a);
+        quartiles(a, n, var);
         return base;
     }
+
     // else  if (method == mean_baseline)
 
     double sumY=0.0;
@@ -108,6 +208,187 @@ double stfnum::base(enum stfnum::baseline_method base_method, double& var, const
     return base;
 }
 
+Vector_double stfnum::running_median(const std::vector<double>& data, std::size_t llb, std::size_t ulb,
+                                     std::size_t width)
+{
+    if (llb>ulb || ulb>=data.size() || width==0) {
+        throw std::out_of_range("Window out of range in stfnum::running_median()");
+    }
+    std::size_t n = ulb - llb + 1;
+    std::size_t before = (width-1)/2, after = width/2;
+    Vector_double running(n);
+
+    // from one point to the next, one value enters and one value leaves the window:
+    MedianWindow window;
+    std::size_t start = llb, end = llb;
+    for (std::size_t i = llb; i <= ulb; ++i) {
+        std::size_t new_start = i-llb > before ? i-before : llb;
+        std::size_t new_end = std::min(i+after, ulb) + 1;
+        for (; end < new_end; ++end) {
+            window.insert(data[end]);
+        }
+        for (; start < new_start; ++start) {
+            window.erase(data[start]);
+        }
+        running[i-llb] = window.median();
+    }
+    return running;
+}
+
+namespace {
+
+    // The first and the last (exclusive) index of the pM data points
+    // that are averaged around index i:
+    inline void peak_window(std::size_t i, int pM, std::size_t size,
+                            std::size_t& start, std::size_t& end)
+    {
+        std::size_t half = (std::size_t)(pM-1)/2;
+        start = i>half ? i-half : 0;
+        end = std::min(start+(std::size_t)pM, size);
+    }
+
+    // The pM-point average around index i, summed up in the same order as
+    // in the original peak search:
+    double exact_mean(const std::vector<double>& data, std::size_t i, int pM) {
+        std::size_t start, end;
+        peak_window(i, pM, data.size(), start, end);
+        double sum=0.0;
+        for (std::size_t n=start; n<end; ++n)
+            sum+=data[n];
+        return sum/(double)(end-start);
+    }
+
+    // Same comparison as in the original peak search:
+    inline bool is_larger(double peak, double max, double base, stfnum::direction dir) {
+        switch (dir) {
+         case stfnum::both: return fabs(peak-base) > fabs(max-base);
+         case stfnum::up: return peak-base > max-base;
+         case stfnum::down: return peak-base < max-base;
+         default: return false;
+        }
+    }
+
+    // Distance of a peak from the baseline in the direction of the search:
+    inline double score(double peak, double base, stfnum::direction dir) {
+        switch (dir) {
+         case stfnum::both: return fabs(peak-base);
+         case stfnum::up: return peak-base;
+         case stfnum::down: return base-peak;
+         default: return -INFINITY;
+        }
+    }
+
+    // Slides a pM-point window over the data by adding the points that
+    // enter and subtracting the points that leave the window:
+    class RunningMean {
+    public:
+        RunningMean(const std::vector<double>& data_, int pM_)
+            : data(data_), pM(pM_), start(0), end(0), sum(0.0), maxabs(0.0)
+        {}
+
+        // The average around index i; i must not decrease between calls:
+        double at(std::size_t i) {
+            std::size_t new_start, new_end;
+            peak_window(i, pM, data.size(), new_start, new_end);
+            if (new_start >= end) {
+                sum = 0.0;
+                add(new_start, new_end);
+            } else {
+                add(end, new_end);
+                for (std::size_t n=start; n<new_start; ++n)
+                    sum-=data[n];
+            }
+            start = new_start;
+            end = new_end;
+            return sum/(double)(end-start);
+        }
+
+        // False if the sum has overflowed or has seen a non-finite value,
+        // which it keeps until the end (x-x is NaN if x is infinite or NaN):
+        bool finite() const { return sum-sum == 0.0 && maxabs-maxabs == 0.0; }
+
+        // Bound of the difference between the running means and
+        // exact_mean() after n steps:
+        double tolerance(std::size_t n, double base) const {
+            return 8.0*(double)(n+pM+2)*DBL_EPSILON*(maxabs+fabs(base));
+        }
+
+    private:
+        void add(std::size_t from, std::size_t to) {
+            for (std::size_t n=from; n<to; ++n) {
+                sum+=data[n];
+                maxabs=std::max(maxabs, fabs(data[n]));
+            }
+        }
+
+        const std::vector<double>& data;
+        int pM;
+        std::size_t start, end;
+        double sum, maxabs;
+    };
+
+    // Picks the peak among data[llp] and the running means of the candidates
+    // llp+1...ulp. The largest mean is found in a tight loop first. Running sums
+    // may differ from a fresh sum in the last bits, so the candidates that come
+    // within rounding error of the largest mean are then compared again with
+    // exact_mean(), in the order of the original search. This yields the same
+    // peak and maxT as the original search.
+    double pick_peak(const std::vector<double>& data, double base, std::size_t llp,
+                     int pM, stfnum::direction dir, const std::vector<double>& means,
+                     double tol, double& maxT)
+    {
+        double max=data[llp];
+        maxT=(double)llp;
+        if (dir != stfnum::both && dir != stfnum::up && dir != stfnum::down)
+            return max;
+
+        double best=max;
+        std::size_t n=means.size();
+        if (dir == stfnum::up) {
+            for (std::size_t k=0; k<n; ++k)
+                best = means[k]>best ? means[k] : best;
+        } else if (dir == stfnum::down) {
+            for (std::size_t k=0; k<n; ++k)
+                best = means[k]<best ? means[k] : best;
+        } else {
+            double lo=best, hi=best;
+            for (std::size_t k=0; k<n; ++k) {
+                lo = means[k]<lo ? means[k] : lo;
+                hi = means[k]>hi ? means[k] : hi;
+            }
+            best = fabs(lo-base)>fabs(hi-base) ? lo : hi;
+        }
+        double cutoff = score(best, base, dir)-tol;
+        for (std::size_t k=0; k<n; ++k) {
+            if (score(means[k], base, dir) >= cutoff) {
+                double peak = exact_mean(data, llp+1+k, pM);
+                if (is_larger(peak, max, base, dir)) {
+                    max = peak;
+                    maxT = (double)(llp+1+k);
+                }
+            }
+        }
+        return max;
+    }
+
+    // The original O(window*pM) peak search, for data that the running
+    // sum can't handle:
+    double slow_peak(const std::vector<double>& data, double base, std::size_t llp, std::size_t ulp,
+                     int pM, stfnum::direction dir, double& maxT)
+    {
+        double max=data[llp];
+        maxT=(double)llp;
+        for (std::size_t i=llp+1; i <=ulp; i++) {
+            double peak = exact_mean(data, i, pM);
+            if (is_larger(peak, max, base, dir)) {
+                max = peak;
+                maxT = (double)i;
+            }
+        }
+        return max;
+    }
+}
+
 double stfnum::peak(const std::vector<double>& data, double base, std::size_t llp, std::size_t ulp,
             int pM, stfnum::direction dir, double& maxT)
 {
@@ -115,44 +396,23 @@ double stfnum::peak(const std::vector<double>& data, double base, std::size_t ll
         maxT = NAN;
         return NAN;
     }
-    
-    double max=data[llp];
+
     maxT=(double)llp;
     double peak=0.0;
 
     if (pM > 0) {
+        //Calculate peak as the average over pM points around each point
+        std::vector<double> means(ulp-llp);
+        RunningMean running(data, pM);
         for (std::size_t i=llp+1; i <=ulp; i++) {
-            //Calculate peak as the average over pM points around the point i
-            peak=0.0;
-            div_t Div1=div((int)pM-1, 2);
-            int counter = 0;
-            int start = i-Div1.quot;
-            if (start < 0)
-                start = 0;
-            for (counter=start; counter <= start+pM-1 && counter < (int)data.size(); counter++)
-                peak+=data[counter];
-            peak /= (counter-start);
-            
-            //Set peak for BOTH
-            if (dir == stfnum::both && fabs(peak-base) > fabs (max-base))
-            {
-                max = peak;
-                maxT = (double)i;
-            }
-            //Set peak for UP
-            if (dir == stfnum::up && peak-base > max-base)
-            {
-                max = peak;
-                maxT = (double)i;
-            }
-            //Set peak for DOWN
-            if (dir == stfnum::down && peak-base < max-base)
-            {
-                max = peak;
-                maxT = (double)i;
-            }
-        }	//End loop: data points
-        peak = max;
+            means[i-llp-1] = running.at(i);
+        }
+        if (running.finite()) {
+            peak = pick_peak(data, base, llp, pM, dir, means,
+                             running.tolerance(ulp-llp, base), maxT);
+        } else {
+            peak = slow_peak(data, base, llp, ulp, pM, dir, maxT);
+        }
         //End peak and base calculation
         //-------------------------------
     } else {
@@ -521,6 +781,76 @@ double stfnum::maxDecay(const std::vector<double>& data,
     return maxDecay/windowLength;
 }
 
+stfnum::PeakScan::PeakScan()
+    : peak(NAN), maxT(NAN), threshold(NAN), thrT(NAN), maxRise(NAN), maxRiseT(NAN), maxRiseY(NAN)
+{}
+
+stfnum::PeakScan stfnum::scan_peak(const std::vector<double>& data, double base, std::size_t llp, std::size_t ulp,
+                                   int pM, stfnum::direction dir, double slope, std::size_t windowLength)
+{
+    PeakScan res;
+    std::size_t size = data.size();
+    if (pM <= 0 || llp > ulp || ulp >= size || windowLength < 1 ||
+        windowLength >= size || llp >= size-windowLength)
+    {
+        // cases that the single pass doesn't cover:
+        res.peak = stfnum::peak(data, base, llp, ulp, pM, dir, res.maxT);
+        res.threshold = stfnum::threshold(data, llp, ulp, slope, res.thrT, windowLength);
+        res.maxRise = stfnum::maxRise(data, llp, res.maxT, res.maxRiseT, res.maxRiseY, windowLength);
+        return res;
+    }
+
+    // the threshold is only searched if the slope window fits into the data:
+    bool find_threshold = (ulp + windowLength <= size);
+    if (find_threshold) {
+        res.threshold = 0.0;
+        res.thrT = -1;
+    }
+    // right ends of the slopes of rise that are steeper than all previous ones:
+    std::vector<std::size_t> rise_ends;
+    double rise = -INFINITY;
+    std::vector<double> means(ulp-llp);
+    RunningMean running(data, pM);
+    for (std::size_t i=llp; i <= ulp; ++i) {
+        if (find_threshold && i < ulp &&
+            data[i + windowLength] - data[i] > slope * windowLength)
+        {
+            res.threshold=(data[i+windowLength] + data[i]) / 2.0;
+            res.thrT = i + windowLength/2.0;
+            find_threshold = false;
+        }
+        if (i >= llp+windowLength) {
+            double diff = fabs( data[i-windowLength] - data[i] );
+            if (rise<diff) {
+                rise=diff;
+                rise_ends.push_back(i);
+            }
+        }
+        if (i > llp) {
+            means[i-llp-1] = running.at(i);
+        }
+    }
+    if (running.finite()) {
+        res.peak = pick_peak(data, base, llp, pM, dir, means,
+                             running.tolerance(ulp-llp, base), res.maxT);
+    } else {
+        res.peak = slow_peak(data, base, llp, ulp, pM, dir, res.maxT);
+    }
+
+    // the steepest rise before the peak is the last one that ends there:
+    std::vector<std::size_t>::const_iterator it =
+        std::upper_bound(rise_ends.begin(), rise_ends.end(), (std::size_t)res.maxT);
+    if (it == rise_ends.begin()) {
+        res.maxRise = -INFINITY;
+    } else {
+        std::size_t j = *(it-1), i = j-windowLength;
+        res.maxRise = fabs( data[i] - data[j] )/windowLength;
+        res.maxRiseY = (data[i]+data[j])/2.0;
+        res.maxRiseT = (i+windowLength/2.0);
+    }
+    return res;
+}
+
 #ifdef WITH_PSLOPE
 double stfnum::pslope(const std::vector<double>& data, std::size_t left, std::size_t right) {
 
@@ -545,3 +875,321 @@ double stfnum::pslope(const std::vector<double>& data, std::size_t left, std::si
 #endif // WITH_PSLOPE
 
 
+
+stfnum::MeasureSpec::MeasureSpec()
+    : baseBeg(0), baseEnd(0), peakBeg(0), peakEnd(0), peakAtEnd(true), pM(1),
+      direction(stfnum::up), baselineMethod(stfnum::mean_sd), RTFactor(20),
+      fromBase(true), slopeForThreshold(20.0),
+      latencyStartMode(stfnum::manualMode), latencyEndMode(stfnum::footMode),
+      latencyBeg(0.0), latencyEnd(0.0)
+#ifdef WITH_PSLOPE
+    , pslopeBegMode(stfnum::psBeg_manualMode), pslopeEndMode(stfnum::psEnd_manualMode),
+      PSlopeBeg(0), PSlopeEnd(0), DeltaT(0)
+#endif
+{}
+
+stfnum::MeasureResult::MeasureResult()
+    : base(0), baseSD(0), threshold(0), thrT(0), peak(0), maxT(0), rtLoHi(0),
+      tLoReal(0), tHiReal(0), tLoIndex(0), tHiIndex(0),
+      InnerLoRT(0), InnerHiRT(0), OuterLoRT(0), OuterHiRT(0),
+      halfDuration(0), t50LeftReal(0), t50RightReal(0), t50LeftIndex(0), t50RightIndex(0),
+      t50Y(0), t0Real(0), maxRise(0), maxRiseT(0), maxRiseY(0),
+      maxDecay(0), maxDecayT(0), maxDecayY(0), slopeRatio(0),
+      APBase(0), APPeak(0), APMaxT(0), APMaxRiseT(0), APMaxRiseY(0), APt50LeftReal(0),
+      APt50LeftIndex(0), APt50RightIndex(0), APrtLoHi(0), APtLoReal(0), APtHiReal(0),
+      APtLoIndex(0), APtHiIndex(0), APt0Real(0),
+      latencyBeg(0), latencyEnd(0), latency(0)
+#ifdef WITH_PSLOPE
+    , PSlopeBeg(0), PSlopeEnd(0), PSlope(0)
+#endif
+{}
+
+const stfnum::MeasureColumn stfnum::measure_columns[] = {
+    {"base", &stfnum::MeasureResult::base, false},
+    {"base_sd", &stfnum::MeasureResult::baseSD, false},
+    {"threshold", &stfnum::MeasureResult::threshold, false},
+    {"threshold_time", &stfnum::MeasureResult::thrT, true},
+    {"peak", &stfnum::MeasureResult::peak, false},
+    {"peak_time", &stfnum::MeasureResult::maxT, true},
+    {"rt_lohi", &stfnum::MeasureResult::rtLoHi, false},
+    {"half_duration", &stfnum::MeasureResult::halfDuration, false},
+    {"t50_left", &stfnum::MeasureResult::t50LeftReal, true},
+    {"t50_right", &stfnum::MeasureResult::t50RightReal, true},
+    {"max_rise", &stfnum::MeasureResult::maxRise, false},
+    {"max_rise_time", &stfnum::MeasureResult::maxRiseT, true},
+    {"max_decay", &stfnum::MeasureResult::maxDecay, false},
+    {"max_decay_time", &stfnum::MeasureResult::maxDecayT, true},
+    {"slope_ratio", &stfnum::MeasureResult::slopeRatio, false},
+    {"onset", &stfnum::MeasureResult::t0Real, true},
+    {"latency", &stfnum::MeasureResult::latency, true},
+#ifdef WITH_PSLOPE
+    {"pslope", &stfnum::MeasureResult::PSlope, false},
+#endif
+    {NULL, NULL, false}
+};
+
+namespace {
+    // Keeps a cursor position within the data, like wxStfDoc::SetLatencyBeg():
+    double clamp_cursor(double value, std::size_t size) {
+        if (value < 0.0) {
+            value = 0.0;
+        }
+        if (value >= (double)size) {
+            value = size-1.0;
+        }
+        return value;
+    }
+}
+
+stfnum::MeasureResult stfnum::measure( const Vector_double& data, double dt, const MeasureSpec& spec,
+                                       const Vector_double* reference )
+{
+    MeasureResult res;
+    if (data.size() == 0) {
+        throw std::out_of_range("Empty section in stfnum::measure()");
+    }
+    double SR = 1.0/dt;
+    std::size_t peakEnd = spec.peakAtEnd ? data.size()-1 : spec.peakEnd;
+
+    // window for computing slopes: about 0.05 ms, with a minimum of 1 sample
+    // (see wxStfDoc::Measure()):
+    long windowLength = lround(0.05 * SR);
+    if (windowLength < 1) windowLength = 1;
+
+    //Begin peak and base calculation
+    //-------------------------------
+    double var=0.0;
+    res.base=stfnum::base(spec.baselineMethod,var,data,spec.baseBeg,spec.baseEnd);
+    res.baseSD=sqrt(var);
+    // peak, threshold and maximal slope of rise in a single pass over the peak window:
+    stfnum::PeakScan scan = stfnum::scan_peak( data, res.base, spec.peakBeg, peakEnd, spec.pM,
+                                               spec.direction, spec.slopeForThreshold/SR, windowLength );
+    res.peak=scan.peak;
+    res.maxT=scan.maxT;
+    res.threshold=scan.threshold;
+    res.thrT=scan.thrT;
+
+    //Begin Lo to Hi% Rise Time calculation
+    //-------------------------------------
+    // reference is either from baseline or from threshold
+    double ref = res.base;
+    if (!spec.fromBase && res.thrT >= 0) {
+        ref = res.threshold;
+    }
+    double ampl=res.peak-ref;
+    double factor=spec.RTFactor*0.01; /* normalized value */
+    res.InnerLoRT=NAN;
+    res.InnerHiRT=NAN;
+    res.OuterLoRT=NAN;
+    res.OuterHiRT=NAN;
+    stfnum::risetime2(data,ref,ampl,(double)0,res.maxT,factor,
+                      res.InnerLoRT,res.InnerHiRT,res.OuterLoRT,res.OuterHiRT);
+    res.InnerLoRT/=SR;
+    res.InnerHiRT/=SR;
+    res.OuterLoRT/=SR;
+    res.OuterHiRT/=SR;
+    res.rtLoHi=stfnum::risetime(data,ref,ampl,(double)0,res.maxT,factor,
+                                res.tLoIndex,res.tHiIndex,res.tLoReal);
+    res.tHiReal=res.tLoReal+res.rtLoHi;
+    res.rtLoHi/=SR;
+
+    //Begin Half Duration calculation
+    //-------------------------------
+    res.halfDuration = stfnum::t_half(data, ref, ampl, (double)0, (double)data.size()-1,
+                                      res.maxT, res.t50LeftIndex, res.t50RightIndex, res.t50LeftReal);
+    res.t50RightReal=res.t50LeftReal+res.halfDuration;
+    res.halfDuration/=SR;
+    res.t50Y=0.5*ampl + ref;
+
+    //Calculate the beginning of the event by linear extrapolation:
+    if (spec.latencyEndMode==stfnum::footMode) {
+        res.t0Real=res.tLoReal-(res.tHiReal-res.tLoReal)/3.0; // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
+    } else {
+        res.t0Real=res.t50LeftReal;
+    }
+
+    //Begin Ratio of slopes rise/decay calculation
+    //--------------------------------------------
+    res.maxRise=scan.maxRise;
+    res.maxRiseT=scan.maxRiseT;
+    res.maxRiseY=scan.maxRiseY;
+    double t_half_3=res.t50RightIndex+2.0*(res.t50RightIndex-res.t50LeftIndex);
+    double right_decay=peakEnd<=t_half_3 ? peakEnd : t_half_3+1;
+    res.maxDecay=stfnum::maxDecay(data,res.maxT,right_decay,res.maxDecayT,res.maxDecayY,windowLength);
+
+    //Slope ratio
+    if (res.maxDecay !=0) res.slopeRatio=res.maxRise/res.maxDecay;
+    else res.slopeRatio=0.0;
+    res.maxRise *= SR;
+    res.maxDecay *= SR;
+
+    if (reference != NULL) {
+        //Calculate the absolute peak of the (AP) reference channel inbetween the peak boundaries
+        const Vector_double& APdata = *reference;
+        const int searchRange=100;
+        double APVar=0.0;
+        res.APBase=stfnum::base(spec.baselineMethod,APVar,APdata,spec.baseBeg,spec.baseEnd);
+        res.APPeak=stfnum::peak(APdata,res.APBase,spec.peakBeg,peakEnd,spec.pM,spec.direction,res.APMaxT);
+
+        //Maximal slope in the rise before the peak
+        //----------------------------
+        double left_APRise= res.APMaxT-searchRange>2.0 ? res.APMaxT-searchRange : 2.0;
+        try {
+            stfnum::maxRise(APdata,left_APRise,res.APMaxT,res.APMaxRiseT,res.APMaxRiseY,windowLength);
+        }
+        catch (const std::out_of_range&) {
+            res.APMaxRiseT=0.0;
+            res.APMaxRiseY=0.0;
+            left_APRise = spec.peakBeg;
+        }
+
+        //Half-maximal amplitude
+        //----------------------------
+        stfnum::t_half(APdata, res.APBase, res.APPeak-res.APBase, left_APRise,
+                       (double)APdata.size(), res.APMaxT, res.APt50LeftIndex,
+                       res.APt50RightIndex, res.APt50LeftReal);
+
+        // Get onset in reference channel
+        res.APrtLoHi=stfnum::risetime(APdata, res.APBase, res.APPeak-res.APBase, (double)0,
+                                      res.APMaxT, 0.2, res.APtLoIndex, res.APtHiIndex, res.APtLoReal);
+        res.APtHiReal = res.APtLoReal + res.APrtLoHi;
+    }
+
+    // start of latency measurement:
+    double latStart=0.0;
+    switch (spec.latencyStartMode) {
+    case stfnum::peakMode:
+        latStart=res.APMaxT;
+        break;
+    case stfnum::riseMode:
+        latStart=res.APMaxRiseT;
+        break;
+    case stfnum::halfMode:
+        latStart=res.APt50LeftReal;
+        break;
+    case stfnum::manualMode:
+    default:
+        latStart=spec.latencyBeg;
+        break;
+    }
+    res.latencyBeg=clamp_cursor(latStart, data.size());
+
+    res.APt0Real = res.tLoReal-(res.tHiReal-res.tLoReal)/3.0;  // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
+    // end of latency measurement:
+    double latEnd=0.0;
+    switch (spec.latencyEndMode) {
+    case stfnum::footMode:
+        latEnd=res.tLoReal-(res.tHiReal-res.tLoReal)/3.0; // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
+        break;
+    case stfnum::riseMode:
+        latEnd=res.maxRiseT;
+        break;
+    case stfnum::halfMode:
+        latEnd=res.t50LeftReal;
+        break;
+    case stfnum::peakMode:
+        latEnd=res.maxT;
+        break;
+    case stfnum::manualMode:
+    default:
+        latEnd=spec.latencyEnd;
+        break;
+    }
+    res.latencyEnd=clamp_cursor(latEnd, data.size());
+    res.latency=res.latencyEnd-res.latencyBeg;
+
+#ifdef WITH_PSLOPE
+    //-------------------------------------
+    // Begin PSlope calculation (PSP Slope)
+    //-------------------------------------
+    int PSlopeBegVal;
+    switch (spec.pslopeBegMode) {
+     case stfnum::psBeg_footMode:   // Left PSlope to commencement
+         PSlopeBegVal = (int)(res.tLoReal-(res.tHiReal-res.tLoReal)/3.0);
+         break;
+     case stfnum::psBeg_thrMode:   // Left PSlope to threshold
+         PSlopeBegVal = (int)res.thrT;
+         break;
+     case stfnum::psBeg_t50Mode:   // Left PSlope to the t50
+         PSlopeBegVal = (int)res.t50LeftReal;
+         break;
+     case stfnum::psBeg_manualMode: // Left PSlope cursor manual
+     default:
+         PSlopeBegVal = (int)spec.PSlopeBeg;
+    }
+    res.PSlopeBeg = (std::size_t)clamp_cursor(PSlopeBegVal, data.size());
+
+    int PSlopeEndVal;
+    switch (spec.pslopeEndMode) {
+     case stfnum::psEnd_t50Mode:    // Right PSlope to t50rigth
+         PSlopeEndVal = (int)res.t50LeftReal;
+         break;
+     case stfnum::psEnd_peakMode:   // Right PSlope to peak
+         PSlopeEndVal = (int)res.maxT;
+         break;
+     case stfnum::psEnd_DeltaTMode: // Right PSlope to DeltaT time from first peak
+         PSlopeEndVal = (int)(res.PSlopeBeg + spec.DeltaT);
+         break;
+     case stfnum::psEnd_manualMode:
+     default:
+         PSlopeEndVal = (int)spec.PSlopeEnd;
+    }
+    res.PSlopeEnd = (std::size_t)clamp_cursor(PSlopeEndVal, data.size());
+    res.PSlope = stfnum::pslope(data, res.PSlopeBeg, res.PSlopeEnd)*SR;
+#endif // WITH_PSLOPE
+
+    return res;
+}
+
+std::vector< std::vector<stfnum::MeasureResult> >
+stfnum::measure( const Recording& data, const std::vector<std::size_t>& channels,
+                 const std::vector<std::size_t>& sections, const MeasureSpec& spec, int reference )
+{
+    for (std::size_t n_c = 0; n_c < channels.size(); ++n_c) {
+        if (channels[n_c] >= data.size()) {
+            throw std::out_of_range("Channel index out of range in stfnum::measure()");
+        }
+        for (std::size_t n_s = 0; n_s < sections.size(); ++n_s) {
+            if (sections[n_s] >= data[channels[n_c]].size()) {
+                throw std::out_of_range("Section index out of range in stfnum::measure()");
+            }
+        }
+    }
+    if (reference >= (int)data.size()) {
+        throw std::out_of_range("Reference channel index out of range in stfnum::measure()");
+    }
+
+    std::vector< std::vector<MeasureResult> > results(channels.size(),
+                                                      std::vector<MeasureResult>(sections.size()));
+    // One error message per task; exceptions must not leave the parallel region:
+    int n_sections = (int)sections.size();
+    int n_tasks = (int)channels.size()*n_sections;
+    std::vector<std::string> errors(n_tasks);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int n_t = 0; n_t < n_tasks; ++n_t) {
+        std::size_t n_c = n_t / n_sections, n_s = n_t % n_sections;
+        try {
+            // memory-mapped samples are only converted while they are measured:
+            stfio::SharedSamplesPtr samples = data[channels[n_c]][sections[n_s]].get_shared();
+            stfio::SharedSamplesPtr refsamples;
+            if (reference >= 0 && sections[n_s] < data[reference].size()) {
+                refsamples = data[reference][sections[n_s]].get_shared();
+            }
+            results[n_c][n_s] = measure(*samples, data.GetXScale(), spec, refsamples.get());
+        }
+        catch (const std::exception& e) {
+            errors[n_t] = e.what();
+        }
+    }
+    for (int n_t = 0; n_t < n_tasks; ++n_t) {
+        if (!errors[n_t].empty()) {
+            std::ostringstream msg;
+            msg << errors[n_t] << "\nChannel " << channels[n_t / n_sections]
+                << ", section " << sections[n_t % n_sections];
+            throw std::out_of_range(msg.str());
+        }
+    }
+    return results;
+}
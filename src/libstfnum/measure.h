@@ -32,6 +32,7 @@
 #include <vector>
 
 #include "../libstfio/stfio.h"
+#include "./stfnum.h"
 
 namespace stfnum {
 
@@ -40,8 +41,11 @@ namespace stfnum {
  */
 
 //! Calculate the average of all sampling points between and including \e llb and \e ulb.
-/*! \param method: 0: mean and s.d.; 1: median
- *  \param var Will contain the variance on exit (only when method=0).
+/*! \param method: 0: mean and s.d.; 1: median; 2: running median, for a
+ *         drifting baseline. The baseline is then the running median at \e ulb,
+ *         with a width of a tenth of the window (at least 3 points).
+ *  \param var Will contain the variance on exit for method 0, or the IQR for methods 1 and 2
+ *         (of the data around the running median for method 2).
  *  \param data The data waveform to be analysed.
  *  \param llb Averaging will be started at this index.
  *  \param ulb Index of the last data point included in the average (legacy of the PASCAL version).
@@ -52,6 +56,21 @@ namespace stfnum {
 StfioDll
 double base(enum stfnum::baseline_method method, double& var, const std::vector<double>& data, std::size_t llb, std::size_t ulb);
 
+//! Running median of all sampling points between and including \e llb and \e ulb.
+/*! The median is updated incrementally from one point to the next, taking
+ *  O(log(\e width)) time per point.
+ *  Throws std::out_of_range if the window is empty or out of range.
+ *  \param data The data waveform to be analysed.
+ *  \param llb Index of the first data point.
+ *  \param ulb Index of the last data point.
+ *  \param width Number of data points of which the median is taken, centered
+ *         on each point. Shorter at the borders of the window.
+ *  \return The running median, with ulb-llb+1 points.
+ */
+StfioDll
+Vector_double running_median(const std::vector<double>& data, std::size_t llb, std::size_t ulb,
+                             std::size_t width);
+
 
 //! Find the peak value of \e data between \e llp and \e ulp.
 /*! Note that peaks will be detected by measuring from \e base, but the return value
@@ -68,6 +87,8 @@ double base(enum stfnum::baseline_method method, double& var, const std::vector<
  *         stfnum::down for negative-going peaks or \n
  *         stfnum::both for negative- or positive-going peaks, whichever is larger.
  *  \param maxT On exit, the index of the peak value. May be interpolated if \e pM > 1.
+ *  The sliding average is updated with a running sum, so that the search takes
+ *  O(\e ulp - \e llp + \e pM) time for any \e pM.
  *  \return The peak value, measured from 0.
  */
 StfioDll
@@ -184,6 +205,39 @@ StfioDll
 double  maxDecay( const std::vector<double>& data, double left, double right, double& maxDecayT,
                   double& maxDecayY, std::size_t windowLength);
 
+//! Results of stfnum::scan_peak().
+struct StfioDll PeakScan {
+    //! Default constructor, sets all values to NAN.
+    PeakScan();
+
+    double peak;      /*!< Peak value, see stfnum::peak(). */
+    double maxT;      /*!< Index of the peak. */
+    double threshold; /*!< Threshold value, see stfnum::threshold(). */
+    double thrT;      /*!< Threshold crossing, or a negative value if there is none. */
+    double maxRise;   /*!< Maximal slope of rise between \e llp and the peak, see stfnum::maxRise(). */
+    double maxRiseT;  /*!< Time point of the maximal slope of rise. */
+    double maxRiseY;  /*!< Value of the data at \e maxRiseT. */
+};
+
+//! Measures the peak, the threshold and the maximal slope of rise in a single pass over the peak window.
+/*! Gives the same results as calling stfnum::peak(), stfnum::threshold() and
+ *  stfnum::maxRise() (between \e llp and the peak) one after the other, but only
+ *  reads the peak window once. The other measurements depend on the amplitude of the
+ *  event and only look at the data around the peak.
+ *  \param data The data waveform to be analysed.
+ *  \param base The baseline value.
+ *  \param llp Lower limit of the peak window.
+ *  \param ulp Upper limit of the peak window.
+ *  \param pM Number of points to average around the peak, see stfnum::peak().
+ *  \param dir Direction of the peak, see stfnum::peak().
+ *  \param slope Slope that defines the threshold, see stfnum::threshold().
+ *  \param windowLength Distance (in number of samples) used to compute slopes.
+ *  \return The results of the three measurements.
+ */
+StfioDll
+PeakScan scan_peak( const std::vector<double>& data, double base, std::size_t llp, std::size_t ulp,
+                    int pM, stfnum::direction dir, double slope, std::size_t windowLength );
+
 #ifdef WITH_PSLOPE
 //! Find the slope an event within \e data.
 /*! \param data The data waveform to be analysed.
@@ -194,6 +248,149 @@ double  maxDecay( const std::vector<double>& data, double left, double right, do
 double pslope( const std::vector<double>& data, std::size_t left, std::size_t right);
 
 #endif
+
+//! Cursor settings for measuring events, independent of a document.
+/*! Positions are indices of sampling points within a section.
+ */
+struct StfioDll MeasureSpec {
+    //! Default constructor.
+    /*! Measures positive-going peaks between the first and the last
+     *  sampling point from a baseline at the first sampling point.
+     */
+    MeasureSpec();
+
+    std::size_t baseBeg;                /*!< Index of the first point of the baseline window. */
+    std::size_t baseEnd;                /*!< Index of the last point of the baseline window. */
+    std::size_t peakBeg;                /*!< Index of the first point of the peak window. */
+    std::size_t peakEnd;                /*!< Index of the last point of the peak window. */
+    bool peakAtEnd;                     /*!< If true, the peak window extends to the end of each section. */
+    int pM;                             /*!< Number of points for the sliding average of the peak (see stfnum::peak()). */
+    stfnum::direction direction;        /*!< Direction of the peak. */
+    stfnum::baseline_method baselineMethod; /*!< Baseline method. */
+    int RTFactor;                       /*!< Lower limit of the rise time in percent; the upper limit is 100-RTFactor. */
+    bool fromBase;                      /*!< Measure amplitudes from the baseline rather than from the slope threshold. */
+    double slopeForThreshold;           /*!< Slope that defines the threshold, in y-units per x-unit. */
+    stfnum::latency_mode latencyStartMode; /*!< Mode of the latency start cursor. */
+    stfnum::latency_mode latencyEndMode;   /*!< Mode of the latency end cursor. */
+    double latencyBeg;                  /*!< Position of the latency start cursor in manual mode. */
+    double latencyEnd;                  /*!< Position of the latency end cursor in manual mode. */
+#ifdef WITH_PSLOPE
+    stfnum::pslope_mode_beg pslopeBegMode; /*!< Mode of the left PSlope cursor. */
+    stfnum::pslope_mode_end pslopeEndMode; /*!< Mode of the right PSlope cursor. */
+    std::size_t PSlopeBeg;              /*!< Position of the left PSlope cursor in manual mode. */
+    std::size_t PSlopeEnd;              /*!< Position of the right PSlope cursor in manual mode. */
+    int DeltaT;                         /*!< Distance of the right from the left PSlope cursor in DeltaT mode. */
+#endif
+};
+
+//! Results of measuring an event within a section.
+/*! Positions (members ending with T, Real or Index) are given in units of
+ *  sampling points; durations and slopes are given in x-units.
+ */
+struct StfioDll MeasureResult {
+    //! Default constructor. Sets all values to 0.
+    MeasureResult();
+
+    double base;          /*!< Baseline. */
+    double baseSD;        /*!< Baseline s.d. (or IQR, depending on the baseline method). */
+    double threshold;     /*!< Value at which the slope threshold is crossed. */
+    double thrT;          /*!< Position of the slope threshold, or a negative value if it wasn't found. */
+    double peak;          /*!< Peak, measured from 0. */
+    double maxT;          /*!< Position of the peak. */
+    double rtLoHi;        /*!< Lo-Hi% rise time. */
+    double tLoReal;       /*!< Position of the Lo% point. */
+    double tHiReal;       /*!< Position of the Hi% point. */
+    std::size_t tLoIndex; /*!< Index closest to the Lo% point. */
+    std::size_t tHiIndex; /*!< Index closest to the Hi% point. */
+    double InnerLoRT;     /*!< Start of the inner rise time, in x-units. */
+    double InnerHiRT;     /*!< End of the inner rise time, in x-units. */
+    double OuterLoRT;     /*!< Start of the outer rise time, in x-units. */
+    double OuterHiRT;     /*!< End of the outer rise time, in x-units. */
+    double halfDuration;  /*!< Full width at half-maximal amplitude. */
+    double t50LeftReal;   /*!< Position of the left half-maximal amplitude point. */
+    double t50RightReal;  /*!< Position of the right half-maximal amplitude point. */
+    std::size_t t50LeftIndex;  /*!< Index closest to the left half-maximal amplitude point. */
+    std::size_t t50RightIndex; /*!< Index closest to the right half-maximal amplitude point. */
+    double t50Y;          /*!< Value at half-maximal amplitude. */
+    double t0Real;        /*!< Position of the beginning of the event. */
+    double maxRise;       /*!< Maximal slope of rise, in y-units per x-unit. */
+    double maxRiseT;      /*!< Position of the maximal slope of rise. */
+    double maxRiseY;      /*!< Value at the maximal slope of rise. */
+    double maxDecay;      /*!< Maximal slope of decay, in y-units per x-unit. */
+    double maxDecayT;     /*!< Position of the maximal slope of decay. */
+    double maxDecayY;     /*!< Value at the maximal slope of decay. */
+    double slopeRatio;    /*!< Ratio of the maximal slopes of rise and decay. */
+    double APBase;        /*!< Baseline of the reference channel. */
+    double APPeak;        /*!< Peak of the reference channel. */
+    double APMaxT;        /*!< Position of the peak of the reference channel. */
+    double APMaxRiseT;    /*!< Position of the maximal slope of rise of the reference channel. */
+    double APMaxRiseY;    /*!< Value at the maximal slope of rise of the reference channel. */
+    double APt50LeftReal; /*!< Position of the left half-maximal amplitude point of the reference channel. */
+    std::size_t APt50LeftIndex;  /*!< Index closest to APt50LeftReal. */
+    std::size_t APt50RightIndex; /*!< Index closest to the right half-maximal amplitude point of the reference channel. */
+    double APrtLoHi;      /*!< 20-80% rise time of the reference channel, in sampling points. */
+    double APtLoReal;     /*!< Position of the 20% point of the reference channel. */
+    double APtHiReal;     /*!< Position of the 80% point of the reference channel. */
+    std::size_t APtLoIndex; /*!< Index closest to APtLoReal. */
+    std::size_t APtHiIndex; /*!< Index closest to APtHiReal. */
+    double APt0Real;      /*!< Beginning of the event, extrapolated from the 20-80% rise time. */
+    double latencyBeg;    /*!< Position of the latency start cursor. */
+    double latencyEnd;    /*!< Position of the latency end cursor. */
+    double latency;       /*!< Latency, in sampling points. */
+#ifdef WITH_PSLOPE
+    std::size_t PSlopeBeg; /*!< Position of the left PSlope cursor. */
+    std::size_t PSlopeEnd; /*!< Position of the right PSlope cursor. */
+    double PSlope;         /*!< Slope between the PSlope cursors, in y-units per x-unit. */
+#endif
+};
+
+//! A member of MeasureResult under the name that the Python modules give it.
+struct MeasureColumn {
+    const char* name;              /*!< Name of the result, as in stfio.measure(). */
+    double MeasureResult::* value; /*!< The result. */
+    bool in_samples;               /*!< True if the result is given in sampling points. */
+};
+
+//! The results that stfio.measure() and stf.measure_batch() return.
+/*! The list ends with an entry whose name is NULL. Callers convert results
+ *  that are given in sampling points to x-units.
+ */
+extern StfioDll const MeasureColumn measure_columns[];
+
+//! Measures an event within \e data.
+/*! This is what Stimfit shows in its results table. The function has no side
+ *  effects and can be called from several threads at once. As with the
+ *  functions above, cursors that are out of range give NaN results.
+ *  Throws std::out_of_range if \e data is empty.
+ *  \param data The data waveform to be analysed.
+ *  \param dt The sampling interval in x-units.
+ *  \param spec The cursor settings.
+ *  \param reference A second channel that is used for the AP* results and for
+ *         latencies that start at the reference channel, or NULL.
+ *  \return The results.
+ */
+StfioDll
+MeasureResult measure( const Vector_double& data, double dt, const MeasureSpec& spec,
+                       const Vector_double* reference = NULL );
+
+//! Measures events within several sections and channels of a recording.
+/*! The sections are measured concurrently. Throws std::out_of_range if a
+ *  channel or a section doesn't exist or if a section is empty.
+ *  \param data The recording.
+ *  \param channels Indices of the channels to be measured.
+ *  \param sections Indices of the sections to be measured in each channel.
+ *  \param spec The cursor settings.
+ *  \param reference Index of the reference channel (see above), or a negative
+ *         value if there is none.
+ *  \return The results; \e result[n_c][n_s] belongs to section
+ *          \e sections[n_s] of channel \e channels[n_c].
+ */
+StfioDll
+std::vector< std::vector<MeasureResult> > measure( const Recording& data,
+                                                   const std::vector<std::size_t>& channels,
+                                                   const std::vector<std::size_t>& sections,
+                                                   const MeasureSpec& spec, int reference = -1 );
+
 /*@}*/
 
 }
@@ -20,6 +20,15 @@
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <list>
+#include <map>
+#include <sstream>
+#if (__cplusplus < 201103)
+#  include <boost/shared_ptr.hpp>
+#else
+#  include <memory>
+#  include <mutex>
+#endif
 
 #include "stfnum.h"
 #include "fit.h"
@@ -142,6 +151,14 @@ double stfnum::fboltz(double x, const Vector_double& pars) {
     return 1/(1+ex);
 }
 
+void stfnum::fboltz_batch(double dx, const Vector_double& pars, double* hx, std::size_t n) {
+    const double mid=pars[0], slope=pars[1];
+    for (std::size_t n_x=0;n_x<n;++n_x) {
+        double ex=exp((mid-(double)n_x*dx)/slope);
+        hx[n_x]=1/(1+ex);
+    }
+}
+
 double stfnum::fbessel(double x, int n) {
     double sum=0.0;
     for (int k=0;k<=n;++k) {
@@ -170,29 +187,151 @@ int stfnum::fac(int arg) {
     }
 }
 
-Vector_double
-stfnum::filter( const Vector_double& data, std::size_t filter_start,
+namespace {
+
+// The fftw planner is not thread-safe; plans are made and destroyed under this lock.
+// Before C++11, only OpenMP threads are serialized.
+#if (__cplusplus >= 201103)
+std::mutex& fft_planner_mutex() {
+    static std::mutex planner_mutex;
+    return planner_mutex;
+}
+#endif
+
+// Destroys the plan when neither the cache nor a caller holds it any more:
+class fftPlanHandle {
+public:
+    explicit fftPlanHandle(fftw_plan plan_) : plan(plan_) {}
+    ~fftPlanHandle() {
+#if (__cplusplus >= 201103)
+        std::lock_guard<std::mutex> lock(fft_planner_mutex());
+#elif defined(_OPENMP)
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+        {
+            fftw_destroy_plan(plan);
+        }
+    }
+
+    fftw_plan plan;
+
+private:
+    fftPlanHandle(const fftPlanHandle&);
+    fftPlanHandle& operator=(const fftPlanHandle&);
+};
+
+#if (__cplusplus < 201103)
+typedef boost::shared_ptr<fftPlanHandle> fftPlanPtr;
+#else
+typedef std::shared_ptr<fftPlanHandle> fftPlanPtr;
+#endif
+
+// Number of plans that are kept for later calls:
+const std::size_t max_fft_plans = 32;
+
+// Longest transform that is planned with FFTW_MEASURE; measuring longer ones
+// can take longer than the transforms it saves:
+const std::size_t max_measured_size = 1 << 18;
+
+// FFTW plans, cached by transform length and direction. The plans are made on
+// scratch arrays and executed on other (equally aligned) arrays with fftw's
+// new-array execute functions, so that several threads can share them.
+// A length is planned with FFTW_ESTIMATE when it is used for the first time,
+// and with FFTW_MEASURE once it is used again, or when the caller already
+// knows that it will be used repeatedly. The least recently used plans are
+// dropped from the cache.
+struct fftPlan {
+    fftPlan(std::size_t n_, bool forward_) : n(n_), forward(forward_), plan(), measured(false) {}
+    std::size_t n;
+    bool forward;
+    fftPlanPtr plan;
+    bool measured;
+};
+
+fftPlanPtr get_fft_plan(std::size_t n, bool forward, bool repeated=false) {
+    fftPlanPtr plan;
+    // Plans that leave the cache are released after the lock, since
+    // destroying them takes it again:
+    std::vector<fftPlanPtr> dropped;
+#if (__cplusplus >= 201103)
+    std::lock_guard<std::mutex> lock(fft_planner_mutex());
+#elif defined(_OPENMP)
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+    {
+        // Most recently used first:
+        static std::list<fftPlan> plans;
+        std::list<fftPlan>::iterator cached = plans.begin();
+        while (cached != plans.end() && (cached->n != n || cached->forward != forward)) {
+            ++cached;
+        }
+        if (cached == plans.end()) {
+            plans.push_front(fftPlan(n, forward));
+        } else {
+            plans.splice(plans.begin(), plans, cached);
+        }
+        cached = plans.begin();
+        if (!cached->plan || !cached->measured) {
+            bool measure = (cached->plan || repeated) && n <= max_measured_size;
+            if (!cached->plan || measure) {
+                double* in = (double*)fftw_malloc(sizeof(double) * n);
+                fftw_complex* out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (n/2+1));
+                unsigned flags = measure ? FFTW_MEASURE : FFTW_ESTIMATE;
+                fftw_plan newPlan = forward ?
+                    fftw_plan_dft_r2c_1d((int)n, in, out, flags) :
+                    fftw_plan_dft_c2r_1d((int)n, out, in, flags);
+                fftw_free(in);
+                fftw_free(out);
+                // Other threads may still be executing the replaced plan:
+                dropped.push_back(cached->plan);
+                cached->plan = fftPlanPtr(new fftPlanHandle(newPlan));
+                cached->measured = measure;
+            }
+        }
+        plan = cached->plan;
+        while (plans.size() > max_fft_plans) {
+            dropped.push_back(plans.back().plan);
+            plans.pop_back();
+        }
+    }
+    return plan;
+}
+
+// Aligned arrays for a real-to-complex transform of length n and back.
+// Each thread uses its own workspace, and reuses it for all of its traces.
+class fftWorkspace {
+public:
+    explicit fftWorkspace(std::size_t n) :
+        real((double*)fftw_malloc(sizeof(double) * n)),
+        spec((fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (n/2+1)))
+    {}
+    ~fftWorkspace() {
+        fftw_free(real);
+        fftw_free(spec);
+    }
+
+    double* real;
+    //fftw_complex is a double[2]; hence, spec is an array of
+    //double[2] with spec[n][0] being the real and spec[n][1] being
+    //the imaginary part.
+    fftw_complex* spec;
+
+private:
+    fftWorkspace(const fftWorkspace&);
+    fftWorkspace& operator=(const fftWorkspace&);
+};
+
+void filter_trace( const Vector_double& data, std::size_t filter_start,
         std::size_t filter_end, const Vector_double &a, int SR,
-        stfnum::Func func, bool inverse ) {
+        stfnum::Func func, bool inverse, fftw_plan r2c, fftw_plan c2r,
+        fftWorkspace& ws, Vector_double& data_return ) {
     if (data.size()<=0 || filter_start>=data.size() || filter_end > data.size()) {
         std::out_of_range e("subscript out of range in stfnum::filter()");
         throw e;
     }
     std::size_t filter_size=filter_end-filter_start+1;
-    Vector_double data_return(filter_size);
     double SI=1.0/SR; //the sampling interval
 
-    double *in;
-    //fftw_complex is a double[2]; hence, out is an array of
-    //double[2] with out[n][0] being the real and out[n][1] being
-    //the imaginary part.
-    fftw_complex *out;
-    fftw_plan p1, p2;
-
-    //memory allocation as suggested by fftw:
-    in =(double *)fftw_malloc(sizeof(double) * filter_size);
-    out=(fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(filter_size/2)+1));
-
     // calculate the offset (a straight line between the first and last points):
     double offset_0=data[filter_start];
     double offset_1=data[filter_end]-offset_0;
@@ -200,91 +339,279 @@ stfnum::filter( const Vector_double& data, std::size_t filter_start,
 
     //fill the input array with data removing the offset:
     for (std::size_t n_point=0;n_point<filter_size;++n_point) {
-        in[n_point]=data[n_point+filter_start]-(offset_0 + offset_step*n_point);
+        ws.real[n_point]=data[n_point+filter_start]-(offset_0 + offset_step*n_point);
     }
 
-    //plan the fft and execute it:
-    p1 =fftw_plan_dft_r2c_1d((int)filter_size,in,out,FFTW_ESTIMATE);
-    fftw_execute(p1);
+    //execute the fft:
+    fftw_execute_dft_r2c(r2c, ws.real, ws.spec);
 
     for (std::size_t n_point=0; n_point < (unsigned int)(filter_size/2)+1; ++n_point) {
         //calculate the frequency (in kHz) which corresponds to the index:
         double f=n_point / (filter_size*SI);
         double rslt= (!inverse? func(f,a) : 1.0-func(f,a));
-        out[n_point][0] *= rslt;
-        out[n_point][1] *= rslt;
+        ws.spec[n_point][0] *= rslt;
+        ws.spec[n_point][1] *= rslt;
     }
 
     //do the reverse fft:
-    p2=fftw_plan_dft_c2r_1d((int)filter_size,out,in,FFTW_ESTIMATE);
-    fftw_execute(p2);
+    fftw_execute_dft_c2r(c2r, ws.spec, ws.real);
 
     //fill the return array, adding the offset, and scaling by filter_size
     //(because fftw computes an unnormalized transform):
     data_return.resize(filter_size);
     for (std::size_t n_point=0; n_point < filter_size; ++n_point) {
-        data_return[n_point]=(in[n_point]/filter_size + offset_0 + offset_step*n_point);
+        data_return[n_point]=(ws.real[n_point]/filter_size + offset_0 + offset_step*n_point);
+    }
+}
+
+}
+
+Vector_double
+stfnum::filter( const Vector_double& data, std::size_t filter_start,
+        std::size_t filter_end, const Vector_double &a, int SR,
+        stfnum::Func func, bool inverse ) {
+    if (data.size()<=0 || filter_start>=data.size() || filter_end > data.size()) {
+        std::out_of_range e("subscript out of range in stfnum::filter()");
+        throw e;
+    }
+    std::size_t filter_size=filter_end-filter_start+1;
+    fftWorkspace ws(filter_size);
+    Vector_double data_return(filter_size);
+    filter_trace(data, filter_start, filter_end, a, SR, func, inverse,
+                 get_fft_plan(filter_size, true)->plan, get_fft_plan(filter_size, false)->plan,
+                 ws, data_return);
+    return data_return;
+}
+
+std::vector<Vector_double>
+stfnum::filter( const Recording& data, std::size_t channel,
+        const std::vector<std::size_t>& sections, std::size_t filter_start,
+        std::size_t filter_end, const Vector_double &a, int SR,
+        stfnum::Func func, bool inverse ) {
+    if (channel >= data.size() || filter_end < filter_start) {
+        throw std::out_of_range("subscript out of range in stfnum::filter()");
+    }
+    std::vector<Vector_double> data_return(sections.size());
+    if (sections.empty()) {
+        return data_return;
+    }
+    std::size_t filter_size=filter_end-filter_start+1;
+    // All sections are transformed with the same plans:
+    bool repeated = (sections.size() > 1);
+    fftPlanPtr r2c = get_fft_plan(filter_size, true, repeated);
+    fftPlanPtr c2r = get_fft_plan(filter_size, false, repeated);
+
+    // One error message per section; exceptions must not leave the parallel region:
+    int n_sections = (int)sections.size();
+    std::vector<std::string> errors(n_sections);
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        fftWorkspace ws(filter_size);
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for (int n_s = 0; n_s < n_sections; ++n_s) {
+            try {
+                // Only the filtered window is read, so that memory-mapped samples stay in the file:
+                Vector_double window =
+                    data[channel].at(sections[n_s]).get_window(filter_start, filter_size);
+                filter_trace(window, 0, filter_size-1,
+                             a, SR, func, inverse, r2c->plan, c2r->plan, ws, data_return[n_s]);
+            }
+            catch (const std::exception& e) {
+                errors[n_s] = e.what();
+            }
+        }
+    }
+    for (int n_s = 0; n_s < n_sections; ++n_s) {
+        if (!errors[n_s].empty()) {
+            std::ostringstream msg;
+            msg << errors[n_s] << "\nSection " << sections[n_s];
+            throw std::out_of_range(msg.str());
+        }
     }
-    fftw_destroy_plan(p1);
-    fftw_destroy_plan(p2);
-    fftw_free(in);fftw_free(out);
     return data_return;
 }
 
+bool stfnum::importFFTWisdom(const std::string& filename) {
+    bool success = false;
+#if (__cplusplus >= 201103)
+    std::lock_guard<std::mutex> lock(fft_planner_mutex());
+#elif defined(_OPENMP)
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+    success = (fftw_import_wisdom_from_filename(filename.c_str()) != 0);
+    return success;
+}
+
+bool stfnum::exportFFTWisdom(const std::string& filename) {
+    bool success = false;
+#if (__cplusplus >= 201103)
+    std::lock_guard<std::mutex> lock(fft_planner_mutex());
+#elif defined(_OPENMP)
+#pragma omp critical(stfnum_fftw_planner)
+#endif
+    success = (fftw_export_wisdom_to_filename(filename.c_str()) != 0);
+    return success;
+}
+
+namespace {
+
+std::size_t xcorr_fft_size(std::size_t templ_size) {
+    // Use transforms ~8 times the template length so that most of each
+    // block yields valid output (block overlap is templ_size-1):
+    std::size_t nfft = 256;
+    while (nfft < 8*templ_size) {
+        nfft <<= 1;
+    }
+    return nfft;
+}
+
+// Running sums of the data and of its square over windows of width templ_size,
+// computed from prefix sums. The data are centred on their mean beforehand
+// to limit cancellation errors in long recordings.
+void window_sums(const Vector_double& data, std::size_t templ_size,
+                 Vector_double& sum_data, Vector_double& sum_data_sqr)
+{
+    std::size_t n_out = data.size()-templ_size;
+    double mean = 0.0;
+    for (std::size_t n=0; n<data.size(); ++n) {
+        mean += data[n];
+    }
+    mean /= data.size();
+
+    Vector_double cum(data.size()+1), cum2(data.size()+1);
+    cum[0] = 0.0;
+    cum2[0] = 0.0;
+    for (std::size_t n=0; n<data.size(); ++n) {
+        double y = data[n]-mean;
+        cum[n+1] = cum[n] + y;
+        cum2[n+1] = cum2[n] + y*y;
+    }
+    sum_data.resize(n_out);
+    sum_data_sqr.resize(n_out);
+    for (std::size_t n=0; n<n_out; ++n) {
+        sum_data[n] = cum[n+templ_size]-cum[n];
+        sum_data_sqr[n] = cum2[n+templ_size]-cum2[n];
+    }
+}
+
+}
+
 Vector_double
-stfnum::detectionCriterion(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
+stfnum::slidingDotProduct(const Vector_double& data, const Vector_double& templ,
+                          stfio::ProgressInfo& progDlg, const std::string& progMsg)
 {
-    bool skipped=false;
-    // variable names are taken from Clements & Bekkers (1997) as long
-    // as they don't interfere with C++ keywords (such as "template")
-    Vector_double detection_criterion(data.size()-templ.size());
-    // avoid redundant computations:
-    double sum_templ_data=0.0, sum_templ=0.0, sum_templ_sqr=0.0, sum_data=0.0, sum_data_sqr=0.0;
-    for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-        sum_templ_data+=templ[n_templ]*data[0+n_templ];
-        sum_data+=data[0+n_templ];
-        sum_data_sqr+=data[0+n_templ]*data[0+n_templ];
-        sum_templ+=templ[n_templ];
-        sum_templ_sqr+=templ[n_templ]*templ[n_templ];
-    }
-    double y_old=0.0;
-    double y2_old=0.0;
+    if (data.size()==0 || templ.size()==0) {
+        throw std::runtime_error("Array of size 0 in stfnum::slidingDotProduct");
+    }
+    if (data.size()<templ.size()) {
+        throw std::runtime_error("Template larger than data in stfnum::slidingDotProduct");
+    }
+    bool skipped = false;
+    std::size_t n_out = data.size()-templ.size();
+    Vector_double dot(n_out);
+    if (n_out==0) {
+        return dot;
+    }
+
+    std::size_t nfft = xcorr_fft_size(templ.size());
+    std::size_t nfreq = nfft/2+1;
+    // number of valid output points per block:
+    std::size_t step = nfft-templ.size()+1;
+    // The same plans are used for all blocks:
+    fftPlanPtr r2c = get_fft_plan(nfft, true, true);
+    fftPlanPtr c2r = get_fft_plan(nfft, false, true);
+
+    fftWorkspace ws_data(nfft), ws_templ(nfft);
+    double* in = ws_data.real;
+    fftw_complex* spec_data = ws_data.spec;
+    fftw_complex* spec_templ = ws_templ.spec;
+
+    // Template spectrum, computed once:
+    std::copy(templ.begin(), templ.end(), in);
+    std::fill(in+templ.size(), in+nfft, 0.0);
+    fftw_execute_dft_r2c(r2c->plan, in, spec_templ);
+
     int progCounter=0;
-    double progFraction=(data.size()-templ.size())/100.0;
-    for (unsigned n_data=0; n_data<data.size()-templ.size(); ++n_data) {
-        if (n_data/progFraction>progCounter) {
-            progDlg.Update( (int)((double)n_data/(double)(data.size()-templ.size())*100.0),
-                            "Calculating detection criterion", &skipped );
+    for (std::size_t n_block=0; n_block<n_out; n_block+=step) {
+        if ((double)n_block/(double)n_out*100.0 >= progCounter) {
+            progDlg.Update( (int)((double)n_block/(double)n_out*100.0), progMsg, &skipped );
             if (skipped) {
-                detection_criterion.resize(0);
-                return detection_criterion;
+                dot.resize(0);
+                break;
             }
-            progCounter++;
+            progCounter = (int)((double)n_block/(double)n_out*100.0)+1;
         }
-        if (n_data!=0) {
-            sum_templ_data=0.0;
-            // The product has to be computed in full length:
-            for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-                sum_templ_data+=templ[n_templ]*data[n_data+n_templ];
-            }
-            // The new value that will be added is:
-            double y_new=data[n_data+templ.size()-1];
-            double y2_new=data[n_data+templ.size()-1]*data[n_data+templ.size()-1];
-            sum_data+=y_new-y_old;
-            sum_data_sqr+=y2_new-y2_old;
+        // Overlap-save: take nfft data points, zero-padded beyond the end:
+        std::size_t n_in = std::min(nfft, data.size()-n_block);
+        std::copy(&data[n_block], &data[n_block]+n_in, in);
+        std::fill(in+n_in, in+nfft, 0.0);
+        fftw_execute_dft_r2c(r2c->plan, in, spec_data);
+
+        // Correlation corresponds to multiplication with the complex conjugate:
+        for (std::size_t n_f=0; n_f<nfreq; ++n_f) {
+            double a = spec_data[n_f][0];
+            double b = spec_data[n_f][1];
+            double c = spec_templ[n_f][0];
+            double d = spec_templ[n_f][1];
+            spec_data[n_f][0] = a*c + b*d;
+            spec_data[n_f][1] = b*c - a*d;
+        }
+        fftw_execute_dft_c2r(c2r->plan, spec_data, in);
+
+        // The first step points are free of circular wrap-around;
+        // fftw computes an unnormalized transform:
+        std::size_t n_valid = std::min(step, n_out-n_block);
+        for (std::size_t n=0; n<n_valid; ++n) {
+            dot[n_block+n] = in[n]/nfft;
         }
-        // The first value that was added (and will have to be subtracted during
-        // the next loop):
-        y_old=data[n_data+0];
-        y2_old=data[n_data+0]*data[n_data+0];
-
-        double scale=(sum_templ_data-sum_templ*sum_data/templ.size())/
-            (sum_templ_sqr-sum_templ*sum_templ/templ.size());
-        double offset=(sum_data-scale*sum_templ)/templ.size();
-        double sse=sum_data_sqr+scale*scale*sum_templ_sqr+templ.size()*offset*offset -
-            2.0*(scale*sum_templ_data +
-                 offset*sum_data-scale*offset*sum_templ);
-        double standard_error=sqrt(sse/(templ.size()-1));
+    }
+
+    return dot;
+}
+
+Vector_double
+stfnum::detectionCriterion(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
+{
+    if (data.size()==0 || templ.size()==0) {
+        throw std::runtime_error("Array of size 0 in stfnum::detectionCriterion");
+    }
+    if (data.size()<templ.size()) {
+        throw std::runtime_error("Template larger than data in stfnum::detectionCriterion");
+    }
+    // variable names are taken from Clements & Bekkers (1997) as long
+    // as they don't interfere with C++ keywords (such as "template")
+    double n_templ = (double)templ.size();
+    double sum_templ=0.0;
+    for (std::size_t n=0; n<templ.size(); ++n) {
+        sum_templ+=templ[n];
+    }
+    // The criterion does not depend on constant offsets of the template
+    // or of the data; centring both improves numerical accuracy.
+    Vector_double templ_c(stfio::vec_scal_minus(templ, sum_templ/n_templ));
+    double sum_templ_sqr=0.0;
+    for (std::size_t n=0; n<templ_c.size(); ++n) {
+        sum_templ_sqr+=templ_c[n]*templ_c[n];
+    }
+
+    Vector_double sum_templ_data(
+        slidingDotProduct(data, templ_c, progDlg, "Calculating detection criterion"));
+    if (sum_templ_data.size()==0) {
+        return sum_templ_data;
+    }
+    Vector_double sum_data, sum_data_sqr;
+    window_sums(data, templ.size(), sum_data, sum_data_sqr);
+
+    Vector_double detection_criterion(data.size()-templ.size());
+    for (std::size_t n_data=0; n_data<detection_criterion.size(); ++n_data) {
+        double ss_data = sum_data_sqr[n_data]-sum_data[n_data]*sum_data[n_data]/n_templ;
+        double scale = sum_templ_data[n_data]/sum_templ_sqr;
+        // Sum of squared errors between the data and the optimally scaled template:
+        double sse = ss_data - scale*scale*sum_templ_sqr;
+        double standard_error=sqrt(sse/(n_templ-1));
         detection_criterion[n_data]=(scale/standard_error);
     }
     return detection_criterion;
@@ -337,7 +664,6 @@ stfnum::peakIndices(const Vector_double& data, double threshold,
 Vector_double
 stfnum::linCorr(const Vector_double& data, const Vector_double& templ, stfio::ProgressInfo& progDlg)
 {
-    bool skipped = false;
     // the template has to be smaller than the data waveform:
     if (data.size()<templ.size()) {
         throw std::runtime_error("Template larger than data in stfnum::crossCorr");
@@ -345,74 +671,38 @@ stfnum::linCorr(const Vector_double& data, const Vector_double& templ, stfio::Pr
     if (data.size()==0 || templ.size()==0) {
         throw std::runtime_error("Array of size 0 in stfnum::crossCorr");
     }
-    Vector_double Corr(data.size()-templ.size());
+    double n_templ = (double)templ.size();
+    double sum_templ=0.0;
+    for (std::size_t n=0; n<templ.size(); ++n) {
+        sum_templ+=templ[n];
+    }
+    // Centre the template; see stfnum::detectionCriterion().
+    Vector_double templ_c(stfio::vec_scal_minus(templ, sum_templ/n_templ));
+    double sum_templ_sqr=0.0;
+    for (std::size_t n=0; n<templ_c.size(); ++n) {
+        sum_templ_sqr+=templ_c[n]*templ_c[n];
+    }
 
-    // Optimal scaling & offset:
-    // avoid redundant computations:
-    double sum_templ_data=0.0, sum_templ=0.0, sum_templ_sqr=0.0, sum_data=0.0;
-    for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-        sum_templ_data+=templ[n_templ]*data[0+n_templ];
-        sum_data+=data[0+n_templ];
-        sum_templ+=templ[n_templ];
-        sum_templ_sqr+=templ[n_templ]*templ[n_templ];
+    Vector_double sum_templ_data(
+        slidingDotProduct(data, templ_c, progDlg, "Calculating correlation coefficient"));
+    if (sum_templ_data.size()==0) {
+        return sum_templ_data;
     }
-    double y_old=0.0;
-    int progCounter=0;
-    double progFraction=(data.size()-templ.size())/100.0;
-    for (unsigned n_data=0; n_data<data.size()-templ.size(); ++n_data) {
-        if (n_data/progFraction>progCounter) {
-            progDlg.Update( (int)((double)n_data/(double)(data.size()-templ.size())*100.0),
-                            "Calculating correlation coefficient", &skipped );
-            if (skipped) {
-                Corr.resize(0);
-                return Corr;
-            }
-            progCounter++;
-        }
-        if (n_data!=0) {
-            sum_templ_data=0.0;
-            // The product has to be computed in full length:
-            for (int n_templ=0; n_templ<(int)templ.size();++n_templ) {
-                sum_templ_data+=templ[n_templ]*data[n_data+n_templ];
-            }
-            // The new value that will be added is:
-            double y_new=data[n_data+templ.size()-1];
-            sum_data+=y_new-y_old;
-        }
-        // The first value that was added (and will have to be subtracted during
-        // the next loop):
-        y_old=data[n_data+0];
-
-        double scale=(sum_templ_data-sum_templ*sum_data/templ.size())/
-        (sum_templ_sqr-sum_templ*sum_templ/templ.size());
-        double offset=(sum_data-scale*sum_templ)/templ.size();
-
-        // Now that the optimal template has been found,
-        // compute the correlation between data and optimal template.
-        // The correlation coefficient is computed in a way that avoids
-        // numerical instability; therefore, the sum of squares
-        // computed above can't be re-used.
-        // Get the means:
-        double mean_data=sum_data/templ.size();
-        double sum_optTempl=sum_templ*scale+offset*templ.size();
-        double mean_optTempl=sum_optTempl/templ.size();
-
-        // Get SDs:
-        double sd_data=0.0;
-        double sd_templ=0.0;
-        for (int i=0;i<(int)templ.size();++i) {
-            sd_data+=SQR(data[i+n_data]-mean_data);
-            sd_templ+=SQR(templ[i]*scale+offset-mean_optTempl);
-        }
-        sd_data=sqrt(sd_data/templ.size());
-        sd_templ=sqrt(sd_templ/templ.size());
+    Vector_double sum_data, sum_data_sqr;
+    window_sums(data, templ.size(), sum_data, sum_data_sqr);
 
-        // Get correlation:
-        double r=0.0;
-        for (int i=0;i<(int)templ.size();++i) {
-            r+=(data[i+n_data]-mean_data)*(templ[i]*scale+offset-mean_optTempl);
-        }
-        r/=((templ.size()-1)*sd_data*sd_templ);
+    Vector_double Corr(data.size()-templ.size());
+    for (std::size_t n_data=0; n_data<Corr.size(); ++n_data) {
+        // Optimal scaling of the template:
+        double scale = sum_templ_data[n_data]/sum_templ_sqr;
+
+        // Correlation between the data and the optimally scaled and shifted
+        // template. The deviations of the optimal template from its mean are
+        // scale*templ_c, so that all sums reduce to the running sums above.
+        double sd_data = sqrt((sum_data_sqr[n_data]-sum_data[n_data]*sum_data[n_data]/n_templ)/n_templ);
+        double sd_templ = fabs(scale)*sqrt(sum_templ_sqr/n_templ);
+        double r = scale*sum_templ_data[n_data];
+        r/=((n_templ-1)*sd_data*sd_templ);
         Corr[n_data]=r;
     }
     return Corr;
@@ -716,7 +1006,8 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
         throw e;
     }
     /* pad templ */
-    double* in_templ_padded =(double *)fftw_malloc(sizeof(double) * data.size());
+    fftWorkspace ws_templ(data.size());
+    double* in_templ_padded = ws_templ.real;
     std::copy(templ.begin(), templ.end(), in_templ_padded);
     if (templ.size() < data.size()) {
         for (size_t kp=templ.size(); kp<data.size(); ++kp)
@@ -729,28 +1020,24 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
         return data_return;
     }
 
-    //fftw_complex is a double[2]; hence, out is an array of
-    //double[2] with out[n][0] being the real and out[n][1] being
-    //the imaginary part.
-    fftw_plan p_data, p_templ, p_inv;
+    // The data and the template are transformed with the same plan. The
+    // length of the trace is rarely used again, so it isn't measured:
+    fftPlanPtr r2c = get_fft_plan(data.size(), true);
+    fftPlanPtr c2r = get_fft_plan(data.size(), false);
 
-    //memory allocation as suggested by fftw:
-    double* in_data =(double *)fftw_malloc(sizeof(double) * data.size());
+    fftWorkspace ws_data(data.size());
+    double* in_data = ws_data.real;
     std::copy(data.begin(), data.end(), in_data);
-    fftw_complex* out_data = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(data.size()/2)+1));
+    fftw_complex* out_data = ws_data.spec;
 
-    //plan the ffts and execute them:
-    p_data =fftw_plan_dft_r2c_1d((int)data.size(), in_data, out_data,
-                                 FFTW_ESTIMATE);
-    fftw_execute(p_data);
+    //execute the ffts:
+    fftw_execute_dft_r2c(r2c->plan, in_data, out_data);
     if (isnan(out_data[0][0]) || isinf(out_data[0][0])) {
         data_return.resize(0);
         throw std::runtime_error("Unstable fft; try again avoiding any test pulses (if present)");
     }
-    fftw_complex* out_templ_padded = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * ((int)(data.size()/2)+1));
-    p_templ =fftw_plan_dft_r2c_1d((int)data.size(),
-                                  in_templ_padded, out_templ_padded, FFTW_ESTIMATE);
-    fftw_execute(p_templ);
+    fftw_complex* out_templ_padded = ws_templ.spec;
+    fftw_execute_dft_r2c(r2c->plan, in_templ_padded, out_templ_padded);
 
     double SI=1.0/SR; //the sampling interval
     progDlg.Update( 25, "Performing deconvolution...", &skipped );
@@ -788,8 +1075,7 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
     }
 
     //do the reverse fft:
-    p_inv = fftw_plan_dft_c2r_1d((int)data.size(),out_data, in_data, FFTW_ESTIMATE);
-    fftw_execute(p_inv);
+    fftw_execute_dft_c2r(c2r->plan, out_data, in_data);
 
     //fill the return array, adding the offset, and scaling by data.size()
     //(because fftw computes an unnormalized transform):
@@ -797,15 +1083,6 @@ stfnum::deconvolve(const Vector_double& dataIn, const Vector_double& templ,
         data_return[n_point]= in_data[n_point]/data.size();
     }
 
-    fftw_destroy_plan(p_data);
-    fftw_destroy_plan(p_templ);
-    fftw_destroy_plan(p_inv);
-
-    fftw_free(in_data);
-    fftw_free(out_data);
-    fftw_free(in_templ_padded);
-    fftw_free(out_templ_padded);
-
     progDlg.Update( 50, "Computing data histogram...", &skipped );
     if (skipped) {
         data_return.resize(0);
@@ -79,6 +79,19 @@ typedef boost::function<Vector_double(double, const Vector_double&)> Jac;
 //! Scaling function for fit parameters
 typedef boost::function<double(double, double, double, double, double)> Scale;
 
+//! Evaluates a stfnum::Func on a whole grid of x-values.
+/*! Arguments are the sampling interval dx, the parameters, the output
+ *  array and the number of points; the function is evaluated at
+ *  x = i*dx for i = 0, ..., n-1.
+ */
+typedef boost::function<void(double, const Vector_double&, double*, std::size_t)> FuncBatch;
+
+//! Evaluates a stfnum::Jac on a whole grid of x-values.
+/*! Same arguments as stfnum::FuncBatch. The output array holds n rows of
+ *  p.size() derivatives each (row-major).
+ */
+typedef boost::function<void(double, const Vector_double&, double*, std::size_t)> JacBatch;
+
 #else
 
 typedef std::function<double(double, const Vector_double&)> Func;
@@ -89,6 +102,19 @@ typedef std::function<Vector_double(double, const Vector_double&)> Jac;
 //! Scaling function for fit parameters
 typedef std::function<double(double, double, double, double, double)> Scale;
 
+//! Evaluates a stfnum::Func on a whole grid of x-values.
+/*! Arguments are the sampling interval dx, the parameters, the output
+ *  array and the number of points; the function is evaluated at
+ *  x = i*dx for i = 0, ..., n-1.
+ */
+typedef std::function<void(double, const Vector_double&, double*, std::size_t)> FuncBatch;
+
+//! Evaluates a stfnum::Jac on a whole grid of x-values.
+/*! Same arguments as stfnum::FuncBatch. The output array holds n rows of
+ *  p.size() derivatives each (row-major).
+ */
+typedef std::function<void(double, const Vector_double&, double*, std::size_t)> JacBatch;
+
 #endif
 //! Dummy function, serves as a placeholder to initialize functions without a Jacobian.
 Vector_double nojac( double x, const Vector_double& p);
@@ -253,6 +279,9 @@ typedef std::function<void(const Vector_double&, double, double, double, double,
  *  to data. The client supplies a function (func), its 
  *  jacobian (jac), information about the function's parameters 
  *  (pInfo) and a function to initialize the parameters (init).
+ *  Optionally, funcBatch and jacBatch evaluate func and jac on a
+ *  whole grid of x-values in a single call; fits fall back to
+ *  func and jac for every point if they are empty.
  */
 struct StfioDll storedFunc {
 
@@ -264,12 +293,16 @@ struct StfioDll storedFunc {
      *  \param hasJac_ true if a Jacobian is available.
      *  \param init_ A function for initialising the parameters.
      *  \param output_ Output of the fit.
+     *  \param funcBatch_ Evaluates func_ on a grid of x-values; may be empty.
+     *  \param jacBatch_ Evaluates jac_ on a grid of x-values; may be empty.
      */
     storedFunc( const std::string& name_, const std::vector<parInfo>& pInfo_,
             const Func& func_, const Init& init_, const Jac& jac_, bool hasJac_ = true,
-            const Output& output_ = defaultOutput /*,
+            const Output& output_ = defaultOutput,
+            const FuncBatch& funcBatch_ = FuncBatch(), const JacBatch& jacBatch_ = JacBatch() /*,
             bool hasId_ = true*/
-    ) : name(name_),pInfo(pInfo_),func(func_),init(init_),jac(jac_),hasJac(hasJac_),output(output_) /*, hasId(hasId_)*/
+    ) : name(name_),pInfo(pInfo_),func(func_),init(init_),jac(jac_),hasJac(hasJac_),output(output_),
+        funcBatch(funcBatch_), jacBatch(jacBatch_) /*, hasId(hasId_)*/
     {
 /*        if (hasId) {
             id = NextId();
@@ -292,6 +325,8 @@ struct StfioDll storedFunc {
     Jac jac;                     /*!< Jacobian of func. */
     bool hasJac;                 /*!< True if the function has an analytic Jacobian. */
     Output output;               /*!< Output of the fit. */
+    FuncBatch funcBatch;         /*!< Evaluates func on a grid of x-values; may be empty. */
+    JacBatch jacBatch;           /*!< Evaluates jac on a grid of x-values; may be empty. */
 //    bool hasId;                  /*!< Determines whether a function should have an id. */
 
 };
@@ -324,6 +359,48 @@ filter(
         bool inverse = false
 );
 
+//! Convolves several sections of a channel with a filter function.
+/*! The sections are filtered concurrently, and share the same FFTW plans.
+ *  Throws std::out_of_range if a section doesn't exist or is too short.
+ *  \param data The recording.
+ *  \param channel Index of the channel.
+ *  \param sections Indices of the sections to be filtered.
+ *  \param filter_start The index from which to start filtering.
+ *  \param filter_end The index at which to stop filtering.
+ *  \param a A valarray of parameters for the filter function.
+ *  \param SR The sampling rate.
+ *  \param func The filter function in the frequency domain.
+ *  \param inverse true if (1- \e func) should be used as the filter function, false otherwise
+ *  \return The convolved data sets; \e result[n_s] belongs to section \e sections[n_s].
+ */
+StfioDll std::vector<Vector_double>
+filter(
+        const Recording& data,
+        std::size_t channel,
+        const std::vector<std::size_t>& sections,
+        std::size_t filter_start,
+        std::size_t filter_end,
+        const Vector_double &a,
+        int SR,
+        stfnum::Func func,
+        bool inverse = false
+);
+
+//! Loads FFTW wisdom from a file.
+/*! The FFT plans of filter(), deconvolve() and the event detection are
+ *  measured when a transform length is used repeatedly. Wisdom that was
+ *  saved with exportFFTWisdom() in an earlier session makes this fast.
+ *  \param filename The full path to the file.
+ *  \return true if the wisdom could be read, false otherwise.
+ */
+StfioDll bool importFFTWisdom(const std::string& filename);
+
+//! Saves the FFTW wisdom that has been accumulated so far to a file.
+/*! \param filename The full path to the file.
+ *  \return true if the wisdom could be written, false otherwise.
+ */
+StfioDll bool exportFFTWisdom(const std::string& filename);
+
 //! Computes a histogram
 /*! \param data The signal
  *  \param nbins Number of bins in the histogram.
@@ -428,6 +505,25 @@ StfioDll Vector_double
 quad(const Vector_double& data, std::size_t begin, std::size_t end);
  
 
+//! Computes the dot product of a template with the data at every offset.
+/*! Uses overlap-save FFT cross-correlation, so that the cost is O(N log M)
+ *  rather than O(N M). FFTW plans are cached by template length.
+ *  \param data The data waveform.
+ *  \param templ The template waveform; must not be longer than \e data.
+ *  \param progDlg Progress indicator.
+ *  \param progMsg Message shown in the progress indicator.
+ *  \return A vector of size data.size()-templ.size() whose n-th element is
+ *          the sum over k of templ[k]*data[n+k], or an empty vector if
+ *          the user cancelled.
+ */
+StfioDll Vector_double
+slidingDotProduct(
+        const Vector_double& data,
+        const Vector_double& templ,
+        stfio::ProgressInfo& progDlg,
+        const std::string& progMsg = "Cross-correlating template"
+);
+
 //! Computes the event detection criterion according to Clements & Bekkers (1997).
 /*! \param data The valarray from which to extract events.
  *  \param templ A template waveform that is used for event detection.
@@ -478,6 +574,14 @@ double fgaussColqu(double x, const Vector_double& p);
  */
 double fboltz(double x, const Vector_double& p);
 
+//! Evaluates stfnum::fboltz() at x = i*dx for i = 0, ..., n-1.
+/*! \param dx Sampling interval.
+ *  \param p Function parameters, see stfnum::fboltz().
+ *  \param hx On exit, the n function values.
+ *  \param n Number of points.
+ */
+void fboltz_batch(double dx, const Vector_double& p, double* hx, std::size_t n);
+
 //! Computes a Bessel polynomial.
 /*! \f[
  *     f(x, n) = \sum_{k=0}^n \frac{ \left( 2n - k \right) ! }{ \left( n - k \right) ! k! } \frac{x^k}{ 2^{n-k} }
@@ -524,9 +628,41 @@ enum direction {
 //! Methods for Baseline computation 
 enum baseline_method {
     mean_sd   = 0, /*!< Compute mean and s.d. for Baseline and Base SD. */ 
-    median_iqr = 1  /*!< Compute median and IQR for Baseline and Base SD. */ 
+    median_iqr = 1, /*!< Compute median and IQR for Baseline and Base SD. */
+    median_running = 2 /*!< Compute a running median for Baseline and the IQR around it for Base SD,
+                            for recordings with a drifting baseline (see stfnum::base()). */
 };
- 
+
+//! Latency cursor settings
+enum latency_mode {
+    manualMode = 0, /*!< Set the corresponding latency cursor manually (by clicking on the graph). */
+    peakMode = 1,   /*!< Set the corresponding latency cursor to the peak. */
+    riseMode = 2,   /*!< Set the corresponding latency cursor to the maximal slope of rise. */
+    halfMode = 3,   /*!< Set the corresponding latency cursor to the half-maximal amplitude. */
+    footMode = 4,    /*!< Set the corresponding latency cursor to the beginning of an event. */
+    undefinedMode   /*!< undefined mode. */
+};
+
+#ifdef WITH_PSLOPE
+//! PSlope start cursor settings
+enum pslope_mode_beg {
+    psBeg_manualMode =0,    /*< Set the start Slope cursor manually. */
+    psBeg_footMode   =1,    /*< Set the start Slope cursor to the beginning of an event. */
+    psBeg_thrMode    =2,    /*< Set the start Slope cursor to a threshold. */
+    psBeg_t50Mode    =3,    /*< Set the start Slope cursor to the half-width of an event*/
+    psBeg_undefined
+};
+
+//! PSlope end cursor settings
+enum pslope_mode_end {
+    psEnd_manualMode =0,    /*< Set the end Slope cursor manually. */
+    psEnd_t50Mode    =1,    /*< Set the Slope cursor to the half-width of an event. */
+    psEnd_DeltaTMode =2,    /*< Set the Slope cursor to a given distance from the first cursor. */
+    psEnd_peakMode   =3,    /*< Set the Slope cursor to the peak. */
+    psEnd_undefined
+};
+#endif // WITH_PSLOPE
+
 /*@}*/
 
 }
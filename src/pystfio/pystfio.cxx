@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <algorithm>
+#include <stdexcept>
 
 #if 0 //def _WINDOWS
     #ifdef _DEBUG
@@ -109,6 +110,304 @@ bool _read(const std::string& filename, const std::string& ftype, bool verbose,
     return true;
 }
 
+PyObject* _convert(const std::vector<std::string>& srcNames, const std::string& srcType,
+                   const std::vector<std::string>& destNames, const std::string& destType,
+                   int nthreads, bool verbose)
+{
+    stfio::txtImportSettings tis;
+    stfio::ConversionStats stats;
+    std::string error;
+
+    // The conversion doesn't touch any Python objects:
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        stfio::StdoutProgressInfo progDlg("File conversion", "Starting file conversion", 100, verbose);
+        stats = stfio::convertFiles(srcNames, gettype(srcType), destNames, gettype(destType),
+                                    tis, progDlg, nthreads);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_ValueError, error.c_str());
+        return NULL;
+    }
+
+    PyObject* errors = PyList_New(stats.errors.size());
+    for (std::size_t n = 0; n < stats.errors.size(); ++n) {
+        if (stats.errors[n].empty()) {
+            Py_INCREF(Py_None);
+            PyList_SetItem(errors, n, Py_None);
+        } else {
+#if PY_MAJOR_VERSION >= 3
+            PyList_SetItem(errors, n, PyUnicode_FromString(stats.errors[n].c_str()));
+#else
+            PyList_SetItem(errors, n, PyString_FromString(stats.errors[n].c_str()));
+#endif
+        }
+    }
+
+    PyObject* retDict = PyDict_New();
+    PyObject* item = PyLong_FromSize_t(stats.nConverted);
+    PyDict_SetItemString(retDict, "converted", item);
+    Py_DECREF(item);
+    PyDict_SetItemString(retDict, "errors", errors);
+    Py_DECREF(errors);
+    item = PyFloat_FromDouble(stats.bytes);
+    PyDict_SetItemString(retDict, "bytes", item);
+    Py_DECREF(item);
+    item = PyFloat_FromDouble(stats.seconds);
+    PyDict_SetItemString(retDict, "seconds", item);
+    Py_DECREF(item);
+    item = PyFloat_FromDouble(stats.throughput());
+    PyDict_SetItemString(retDict, "MBps", item);
+    Py_DECREF(item);
+    return retDict;
+}
+
+namespace {
+    stfnum::latency_mode latency_mode(const std::string& mode) {
+        if (mode == "manual") return stfnum::manualMode;
+        if (mode == "peak") return stfnum::peakMode;
+        if (mode == "rise") return stfnum::riseMode;
+        if (mode == "half") return stfnum::halfMode;
+        if (mode == "foot") return stfnum::footMode;
+        throw std::invalid_argument("Unknown latency mode: " + mode);
+    }
+}
+
+PyObject* _measure(const Recording& rec, const std::vector<int>& channels, const std::vector<int>& sections,
+                   int reference, int base_start, int base_end, int peak_start, int peak_end, int peak_mean,
+                   const std::string& direction, const std::string& baseline, int rt_factor, bool from_base,
+                   double slope, const std::string& latency_start_mode, const std::string& latency_end_mode,
+                   double latency_start, double latency_end)
+{
+    wrap_array();
+
+    stfnum::MeasureSpec spec;
+    std::vector<std::size_t> chs, secs;
+    try {
+        if (base_start < 0 || base_end < 0 || peak_start < 0 || peak_mean < 1) {
+            throw std::invalid_argument("Cursor positions must not be negative");
+        }
+        spec.baseBeg = base_start;
+        spec.baseEnd = base_end;
+        spec.peakBeg = peak_start;
+        spec.peakAtEnd = (peak_end < 0);
+        spec.peakEnd = spec.peakAtEnd ? 0 : peak_end;
+        spec.pM = peak_mean;
+        if (direction == "up") {
+            spec.direction = stfnum::up;
+        } else if (direction == "down") {
+            spec.direction = stfnum::down;
+        } else if (direction == "both") {
+            spec.direction = stfnum::both;
+        } else {
+            throw std::invalid_argument("Unknown direction: " + direction);
+        }
+        if (baseline == "mean") {
+            spec.baselineMethod = stfnum::mean_sd;
+        } else if (baseline == "median") {
+            spec.baselineMethod = stfnum::median_iqr;
+        } else if (baseline == "running") {
+            spec.baselineMethod = stfnum::median_running;
+        } else {
+            throw std::invalid_argument("Unknown baseline method: " + baseline);
+        }
+        spec.RTFactor = rt_factor;
+        spec.fromBase = from_base;
+        spec.slopeForThreshold = slope;
+        spec.latencyStartMode = latency_mode(latency_start_mode);
+        spec.latencyEndMode = latency_mode(latency_end_mode);
+        spec.latencyBeg = latency_start;
+        spec.latencyEnd = latency_end;
+        for (std::size_t n = 0; n < channels.size(); ++n) {
+            if (channels[n] < 0) throw std::out_of_range("Channel index out of range");
+            chs.push_back(channels[n]);
+        }
+        for (std::size_t n = 0; n < sections.size(); ++n) {
+            if (sections[n] < 0) throw std::out_of_range("Section index out of range");
+            secs.push_back(sections[n]);
+        }
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return NULL;
+    }
+
+    std::vector< std::vector<stfnum::MeasureResult> > results;
+    std::string error;
+    // The measurement doesn't touch any Python objects:
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        results = stfnum::measure(rec, chs, secs, spec, reference);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_IndexError, error.c_str());
+        return NULL;
+    }
+
+    // One 2D array (channels x sections) per result:
+    double dt = rec.GetXScale();
+    npy_intp dims[2] = {(npy_intp)chs.size(), (npy_intp)secs.size()};
+    PyObject* retDict = PyDict_New();
+    for (const stfnum::MeasureColumn* col = stfnum::measure_columns; col->name != NULL; ++col) {
+        PyObject* np_array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+        double* gDataP = (double*)array_data(np_array);
+        for (std::size_t n_c = 0; n_c < chs.size(); ++n_c) {
+            for (std::size_t n_s = 0; n_s < secs.size(); ++n_s) {
+                double val = results[n_c][n_s].*(col->value);
+                *gDataP++ = col->in_samples ? val*dt : val;
+            }
+        }
+        PyDict_SetItemString(retDict, col->name, np_array);
+        Py_DECREF(np_array);
+    }
+    return retDict;
+}
+
+std::string _transform(const Recording& rec, int channel, const std::vector<int>& sections,
+                       const std::vector<double>& base, double factor, int pon, Recording& Data)
+{
+    try {
+        if (channel < 0 || channel >= (int)rec.size()) {
+            throw std::out_of_range("Channel index out of range");
+        }
+        if (base.size() != sections.size()) {
+            throw std::out_of_range("Number of baselines doesn't match number of sections");
+        }
+        const Channel& ch = rec[channel];
+        for (std::size_t n = 0; n < sections.size(); ++n) {
+            if (sections[n] < 0 || sections[n] >= (int)ch.size()) {
+                throw std::out_of_range("Section index out of range");
+            }
+        }
+        // every group holds a test pulse followed by |pon| leak pulses:
+        std::size_t group = std::abs(pon) + 1;
+        double direction = (pon < 0) ? -1.0 : 1.0;
+        std::size_t n_out = sections.size()/group;
+        if (n_out == 0) {
+            throw std::runtime_error("Not enough sections");
+        }
+        std::vector<std::size_t> secs(n_out);
+        std::vector<stfio::TraceOps> ops(n_out);
+        for (std::size_t n = 0; n < n_out; ++n) {
+            std::size_t first = n*group;
+            secs[n] = sections[first];
+            // (x-b)*f - direction*sum((l_k-b_k)*f) == (x - direction*sum(l_k) - (b - direction*sum(b_k)))*f,
+            // up to rounding:
+            double offset = base[first];
+            if (group > 1) {
+                std::size_t size = ch[secs[n]].size();
+                std::vector<const double*> leaks;
+                for (std::size_t k = first+1; k < first+group; ++k) {
+                    if (ch[sections[k]].size() < size) {
+                        throw std::out_of_range("Leak pulse is shorter than test pulse");
+                    }
+                    leaks.push_back(size > 0 ? &ch[sections[k]].get()[0] : NULL);
+                    offset -= direction*base[k];
+                }
+                ops[n].minus_sum(leaks, direction);
+            }
+            if (offset != 0) {
+                ops[n].minus(offset);
+            }
+            if (factor != 1.0) {
+                ops[n].mul(factor);
+            }
+        }
+        std::string error;
+        // The arithmetic doesn't touch any Python objects:
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            Data = stfio::transform(rec, secs, channel, ops, ", transformed");
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        Py_END_ALLOW_THREADS
+        return error;
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+}
+
+std::string _average(const Recording& rec, int channel, const std::vector<int>& sections,
+                     const std::vector<int>& shift, const std::string& method,
+                     const std::vector<double>& weights, bool sd, Recording& Data)
+{
+    try {
+        if (channel < 0 || channel >= (int)rec.size()) {
+            throw std::out_of_range("Channel index out of range");
+        }
+        stfio::average_method avg_method = stfio::average_mean;
+        std::string kind("average");
+        if (method == "weighted") {
+            avg_method = stfio::average_weighted;
+            kind = "weighted average";
+        } else if (method == "median") {
+            avg_method = stfio::average_median;
+            kind = "median";
+        } else if (method != "mean") {
+            throw std::runtime_error("Unknown average method: " + method);
+        }
+        if (sections.empty()) {
+            throw std::out_of_range("No sections selected");
+        }
+        if (shift.size() != sections.size()) {
+            throw std::out_of_range("Number of shifts doesn't match number of sections");
+        }
+        const Channel& ch = rec[channel];
+        std::vector<std::size_t> secs(sections.size());
+        std::size_t n_points = 0;
+        for (std::size_t n = 0; n < sections.size(); ++n) {
+            if (sections[n] < 0 || sections[n] >= (int)ch.size()) {
+                throw std::out_of_range("Section index out of range");
+            }
+            if (shift[n] < 0 || shift[n] > (int)ch[sections[n]].size()) {
+                throw std::out_of_range("Shift out of range");
+            }
+            secs[n] = sections[n];
+            // the average is as long as the shortest shifted section:
+            std::size_t size = ch[secs[n]].size() - shift[n];
+            if (n == 0 || size < n_points) {
+                n_points = size;
+            }
+        }
+        Section avg(n_points), sig(sd ? n_points : 0);
+        std::string error;
+        // The arithmetic doesn't touch any Python objects:
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            rec.MakeAverage(avg, sig, channel, secs, sd, shift, avg_method, weights);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        Py_END_ALLOW_THREADS
+        if (!error.empty()) {
+            return error;
+        }
+        // the spread follows the average as a second section:
+        Channel TempChannel(sd ? 2 : 1);
+        avg.SetSectionDescription(kind);
+        TempChannel.InsertSection(avg, 0);
+        if (sd) {
+            sig.SetXScale(avg.GetXScale());
+            sig.SetSectionDescription(method == "median" ? "1.4826 * median absolute deviation" : "standard deviation");
+            TempChannel.InsertSection(sig, 1);
+        }
+        Data = Recording(TempChannel);
+        Data.CopyAttributes(rec);
+        Data[0].SetChannelName(ch.GetChannelName());
+        Data[0].SetYUnits(ch.GetYUnits());
+        return std::string();
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+}
+
 PyObject* detect_events(double* data, int size_data, double* templ, int size_templ,
                         double dt, const std::string& mode, bool norm, double lowpass, double highpass)
 {
@@ -125,7 +424,7 @@ PyObject* detect_events(double* data, int size_data, double* templ, int size_tem
         } else {
             basel = fmin;
         }
-        vtempl = stfio::vec_scal_minus(vtempl, basel);
+        stfio::TraceOps().minus(basel).apply(vtempl);
         fmin = *std::min_element(vtempl.begin(), vtempl.end());
         fmax = *std::max_element(vtempl.begin(), vtempl.end());
         if (fabs(fmin) > fabs(fmax)) {
@@ -133,7 +432,7 @@ PyObject* detect_events(double* data, int size_data, double* templ, int size_tem
         } else {
             normval = fabs(fmax);
         }
-        vtempl = stfio::vec_scal_div(vtempl, normval);
+        stfio::TraceOps().div(normval).apply(vtempl);
     }
     Vector_double trace(data, &data[size_data]);
     Vector_double detect(size_data);
@@ -27,6 +27,19 @@ wrap_array();
 
 stfio::filetype gettype(const std::string& ftype);
 bool _read(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data);
+PyObject* _convert(const std::vector<std::string>& srcNames, const std::string& srcType,
+                   const std::vector<std::string>& destNames, const std::string& destType,
+                   int nthreads, bool verbose);
+PyObject* _measure(const Recording& rec, const std::vector<int>& channels, const std::vector<int>& sections,
+                   int reference, int base_start, int base_end, int peak_start, int peak_end, int peak_mean,
+                   const std::string& direction, const std::string& baseline, int rt_factor, bool from_base,
+                   double slope, const std::string& latency_start_mode, const std::string& latency_end_mode,
+                   double latency_start, double latency_end);
+std::string _transform(const Recording& rec, int channel, const std::vector<int>& sections,
+                       const std::vector<double>& base, double factor, int pon, Recording& Data);
+std::string _average(const Recording& rec, int channel, const std::vector<int>& sections,
+                     const std::vector<int>& shift, const std::string& method,
+                     const std::vector<double>& weights, bool sd, Recording& Data);
 PyObject* detect_events(double* data, int size_data, double* templ, int size_templ, double dt,
                         const std::string& mode="criterion",
                         bool norm=true, double lowpass=0.5, double highpass=0.0001);
@@ -19,6 +19,7 @@ common electrophysiology file formats"
 #include "./../libstfio/recording.h"
 #include "./../libstfio/channel.h"
 #include "./../libstfio/section.h"
+#include "./../libstfio/hdf5/hdf5lib.h"
 
 #include "pystfio.h"
 
@@ -26,12 +27,17 @@ static int myErr = 0; // flag to save error state
 %}
 %include "../stimfit/py/numpy.i"
 %include "std_string.i"
+%include "std_vector.i"
 %include "exception.i"
 %init %{
     import_array();
     PyDateTime_IMPORT;
 %}
 
+%template(StringVector) std::vector<std::string>;
+%template(IntVector) std::vector<int>;
+%template(DoubleVector) std::vector<double>;
+
 
 %define %apply_numpy_typemaps(TYPE)
 
@@ -88,6 +94,22 @@ class Section {
     }
 }
 
+// keep the parent alive while a channel or section is in use:
+%pythonappend Recording::__getitem__ %{
+    val._parent = self
+%}
+
+%pythonappend Channel::__getitem__ %{
+    val._parent = self
+%}
+
+%exception Section::Section {
+    $action
+    if (PyErr_Occurred()) {
+        SWIG_fail;
+    }
+}
+
 %exception Section::__getitem__ {
     assert(!myErr);
     $action
@@ -161,14 +183,31 @@ class Section {
     ftype  -- file type (string). At present, \"hdf5\", \"gdf\", \"cfs\" and \"ibw\" are supported.
 #endif // TEST_MINIMAL
     verbose-- Show info while writing
+    layout -- layout of HDF5 files: \"chunked\" (default) stores each
+              channel in one dataset, in the type of its samples;
+              \"legacy\" stores each section in a float32 dataset and
+              can be read by older versions.
+    deflate-- deflate (gzip) level of chunked HDF5 files from 1 to 9, or
+              0 (default) for no compression.
+    shuffle-- If True, apply the byte shuffle filter to chunked HDF5 files,
+              which improves compression.
 
     Returns:
     True upon successful completion.") write;
-    bool write(const std::string& fname, const std::string& ftype="hdf5", bool verbose=false) {
+    bool write(const std::string& fname, const std::string& ftype="hdf5", bool verbose=false,
+               const std::string& layout="chunked", int deflate=0, bool shuffle=false) {
         stfio::filetype stftype = gettype(ftype);
         stfio::StdoutProgressInfo progDlg("File export", "Writing file", 100, verbose);
         try {
-            return stfio::exportFile(fname, stftype, *($self), progDlg);
+            stfio::HDF5Options options;
+            if (layout == "legacy") {
+                options.layout = stfio::hdf5_legacy;
+            } else if (layout != "chunked") {
+                throw std::invalid_argument("Unknown HDF5 layout: " + layout);
+            }
+            options.deflate = deflate;
+            options.shuffle = shuffle;
+            return stfio::exportFile(fname, stftype, *($self), progDlg, options);
         } catch (const std::exception& e) {
             std::cerr << "Couldn't write to file:\n"
                       << e.what() << std::endl;
@@ -334,18 +373,131 @@ class Section {
 
 %}
 
+%{
+    // Keeps a NumPy array alive while a section uses its buffer:
+    class NumpyBuffer : public stfio::MappedFile {
+    public:
+        explicit NumpyBuffer(PyArrayObject* array_)
+            : stfio::MappedFile((const char*)PyArray_DATA(array_), PyArray_NBYTES(array_)),
+              array(array_)
+        {
+            Py_INCREF(array);
+        }
+        ~NumpyBuffer() {
+            // sections may be destroyed by threads that don't hold the GIL:
+            PyGILState_STATE state = PyGILState_Ensure();
+            Py_DECREF(array);
+            PyGILState_Release(state);
+        }
+    private:
+        PyArrayObject* array;
+    };
+
+    void release_mapped_samples(PyObject* capsule) {
+        delete (stfio::MappedSamplesPtr*)PyCapsule_GetPointer(capsule, NULL);
+    }
+
+    void release_shared_samples(PyObject* capsule) {
+        delete (stfio::SharedSamplesPtr*)PyCapsule_GetPointer(capsule, NULL);
+    }
+
+    void release_mapped_file(PyObject* capsule) {
+        delete (stfio::MappedFilePtr*)PyCapsule_GetPointer(capsule, NULL);
+    }
+
+    PyObject* _section_view(PyObject* pysec, bool writable) {
+        wrap_array();
+
+        void* argp;
+        if (!SWIG_IsOK(SWIG_ConvertPtr(pysec, &argp, SWIGTYPE_p_Section, 0))) {
+            PyErr_SetString(PyExc_TypeError, "Argument is not a section");
+            return NULL;
+        }
+        Section* sec = reinterpret_cast< Section * >(argp);
+
+        npy_intp dims[1] = {(npy_intp)sec->size()};
+        if (dims[0] == 0) {
+            return PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+        }
+
+        double* data = NULL;
+        PyObject* base = NULL;
+        if (writable) {
+            // copies memory-mapped samples into the section:
+            data = &(sec->get_w()[0]);
+            base = pysec;
+            Py_INCREF(base);
+        } else if (sec->get_mapped()) {
+            const stfio::MappedSamplesPtr& mapped = sec->get_mapped();
+            const stfio::RawSamples& raw = mapped->get_raw();
+            const char* first = mapped->contiguous() ? raw.file->data() + raw.offset : NULL;
+            if (first != NULL && raw.type == stfio::sample_float64 && raw.stride == sizeof(double) &&
+                !raw.swap && raw.scale == 1.0 && raw.shift == 0.0 &&
+                (std::size_t)first % sizeof(double) == 0)
+            {
+                // the samples can be used where they are; the array keeps
+                // the mapping alive, even if the section is changed:
+                data = (double*)first;
+                base = PyCapsule_New(new stfio::MappedSamplesPtr(mapped), NULL, release_mapped_samples);
+            } else {
+                // only the array holds the converted copy:
+                stfio::SharedSamplesPtr* values = new stfio::SharedSamplesPtr(mapped->values());
+                data = &(**values)[0];
+                base = PyCapsule_New(values, NULL, release_shared_samples);
+            }
+        } else {
+            // the array shares the samples with the section, and keeps them
+            // alive after the section has been changed or destroyed:
+            stfio::MappedFilePtr* shared = new stfio::MappedFilePtr(sec->get_parts().front().file);
+            data = (double*)(*shared)->data();
+            base = PyCapsule_New(shared, NULL, release_mapped_file);
+        }
+
+        PyObject* np_array = PyArray_New(&PyArray_Type, 1, dims, NPY_DOUBLE, NULL, data, 0,
+                                         writable ? NPY_ARRAY_CARRAY : NPY_ARRAY_CARRAY_RO, NULL);
+        if (np_array == NULL) {
+            Py_DECREF(base);
+            return NULL;
+        }
+        // steals the reference to base:
+        if (PyArray_SetBaseObject((PyArrayObject*)np_array, base) < 0) {
+            Py_DECREF(np_array);
+            return NULL;
+        }
+        return np_array;
+    }
+%}
+
 %extend Section {
 
-    Section(PyArrayObject* nparray) {
+    %feature("autodoc", "Creates a section from a 1D numpy array.
+
+    Arguments:
+    nparray -- 1D array of data points
+    adopt   -- If True, the section uses the buffer of nparray instead of
+               copying it, provided that it is a contiguous array of
+               doubles. Changes to nparray are then seen by the section.
+               The section copies the data once it is changed itself.") Section;
+    Section(PyObject* nparray, bool adopt=false) {
         wrap_array();
-        
-        npy_intp nplen = PyArray_DIM(nparray, 0);
 
-        // Note that array size is fixed by this allocation:
-        Section *sec = new Section(nplen, "");
+        PyArrayObject* array = (PyArrayObject*)PyArray_FROMANY(nparray, NPY_DOUBLE, 1, 1, NPY_ARRAY_CARRAY_RO);
+        if (array == NULL) {
+            return NULL;
+        }
+        npy_intp nplen = PyArray_DIM(array, 0);
 
-        double* npptr = (double*)PyArray_DATA(nparray);
-        std::copy(&npptr[0], &npptr[nplen], &(sec->get_w()[0]));
+        Section *sec = NULL;
+        if (adopt && nplen > 0) {
+            stfio::MappedFilePtr buffer(new NumpyBuffer(array));
+            sec = new Section(stfio::RawSamples(buffer, 0, sizeof(double), nplen, stfio::sample_float64), "");
+        } else {
+            // Note that array size is fixed by this allocation:
+            sec = new Section(nplen, "");
+            double* npptr = (double*)PyArray_DATA(array);
+            std::copy(&npptr[0], &npptr[nplen], sec->get_w().begin());
+        }
+        Py_DECREF(array);
 
         return sec;
     }
@@ -354,7 +506,8 @@ class Section {
     }
     double __getitem__(int at) {
         if (at >= 0 && at < (int)$self->size()) {
-            return (*($self))[at];
+            // reading must not copy memory-mapped, adopted or shared data points:
+            return static_cast<const Section&>(*($self))[at];
         } else {
             myErr = 1;
             return 0;
@@ -362,7 +515,7 @@ class Section {
     }
     int __len__() { return $self->size(); }
 
-    %feature("autodoc", "Returns the section as a numpy array.") asarray;
+    %feature("autodoc", "Returns a copy of the section as a numpy array.") asarray;
     PyArrayObject* asarray() {
         npy_intp dims[1] = {$self->size()};
         PyArrayObject* np_array = (PyArrayObject*) PyArray_SimpleNew(1, dims, NPY_DOUBLE);
@@ -373,8 +526,28 @@ class Section {
                    gDataP);
         return np_array;
     };
+
+    %pythoncode {
+        def view(self):
+            """Returns the section as a read-only numpy array that shares its
+            memory with the section. The array keeps this memory alive, so
+            it stays valid after the section has been changed or destroyed.
+            The section copies its data points before it is written to,
+            so the array doesn't see later changes to the section."""
+            return _section_view(self, False)
+
+        def view_w(self):
+            """Returns the section as a writable numpy array that shares its
+            memory with the section. Memory-mapped or adopted samples are
+            copied into the section first, as is memory that is shared with
+            a copy of the section. The array keeps the section alive. It
+            becomes invalid if the section is resized or copied."""
+            return _section_view(self, True)
+    }
 }
 
+PyObject* _section_view(PyObject* pysec, bool writable);
+
 //--------------------------------------------------------------------
 %feature("autodoc", 0) _read;
 %feature("docstring", "Reads a file and returns a recording object.
@@ -393,6 +566,24 @@ A recording object.") _read;
 bool _read(const std::string& filename, const std::string& ftype, bool verbose, Recording& Data);
 //--------------------------------------------------------------------
 
+//--------------------------------------------------------------------
+%feature("docstring", "Converts a batch of files with a pool of worker threads.
+
+Arguments:
+srcNames  -- source file names
+srcType   -- source file type
+destNames -- destination file names
+destType  -- destination file type
+nthreads  -- number of worker threads; 0 uses one per CPU
+verbose   -- Show progress
+
+Returns:
+A dictionary with the conversion statistics.") _convert;
+PyObject* _convert(const std::vector<std::string>& srcNames, const std::string& srcType,
+                   const std::vector<std::string>& destNames, const std::string& destType,
+                   int nthreads, bool verbose);
+//--------------------------------------------------------------------
+
 //--------------------------------------------------------------------
 %feature("autodoc", 0) detect_events;
 %feature("kwargs") detect_events;
@@ -425,6 +616,46 @@ Arguments:
 double risetime(double* invec, int size, double base, double amp, double frac=0.2);
 //--------------------------------------------------------------------
 
+//--------------------------------------------------------------------
+%feature("docstring", "Measures events in sections of a recording concurrently.
+
+Arguments:
+See measure().
+
+Returns:
+A dictionary of 2D arrays (channels x sections).") _measure;
+PyObject* _measure(const Recording& rec, const std::vector<int>& channels, const std::vector<int>& sections,
+                   int reference, int base_start, int base_end, int peak_start, int peak_end, int peak_mean,
+                   const std::string& direction, const std::string& baseline, int rt_factor, bool from_base,
+                   double slope, const std::string& latency_start_mode, const std::string& latency_end_mode,
+                   double latency_start, double latency_end);
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("docstring", "Subtracts baselines, scales and leak-subtracts sections in a single pass.
+
+Arguments:
+See transform().
+
+Returns:
+An error message, or an empty string on success.") _transform;
+std::string _transform(const Recording& rec, int channel, const std::vector<int>& sections,
+                       const std::vector<double>& base, double factor, int pon, Recording& Data);
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("docstring", "Averages sections of a recording.
+
+Arguments:
+See average().
+
+Returns:
+An error message, or an empty string on success.") _average;
+std::string _average(const Recording& rec, int channel, const std::vector<int>& sections,
+                     const std::vector<int>& shift, const std::string& method,
+                     const std::vector<double>& weights, bool sd, Recording& Data);
+//--------------------------------------------------------------------
+
 //--------------------------------------------------------------------
 %pythoncode {
 import os
@@ -444,7 +675,8 @@ filetype = {
     '.atf':'atf',
     '.axgd':'axg',
     '.axgx':'axg',
-    '.clp':'intan'}
+    '.clp':'intan',
+    '.tdms':'tdms'}
 
 def read(fname, ftype=None, verbose=False):
     """Reads a file and returns a Recording object.
@@ -460,6 +692,7 @@ def read(fname, ftype=None, verbose=False):
               "axg"  - Axograph X binary file
               "heka" - HEKA binary file
               "intan" - INTAN clamp binary file
+              "tdms" - National Instruments TDMS file
               if ftype is None (default), it will be guessed from the
               extension.
 #else
@@ -495,50 +728,222 @@ def read(fname, ftype=None, verbose=False):
     return rec
 
 
-def read_tdms(fn):
-    import numpy as np
-    import sys
-    try:
-        from nptdms import TdmsFile
-    except ImportError:
-        sys.stderr.write("nptdms module unavailable")
-        return None
-
-    tdms_file = TdmsFile(fn)
-
-    try:
-        times = np.array(
-            [[channel.data
-              for channel in tdms_file.group_channels(group)
-              if channel.data is not None]
-             for group in tdms_file.groups()
-             if group.lower() == "time"][0][0])
-        dt = np.mean(np.diff(times))
-    except IndexError:
-        if not "Sampling Rate" in tdms_file.object().properties.keys():
-            if not "Sampling Rate(AI)" in tdms_file.object().properties.keys():
-                dt = 1.0
-            else:
-                sr = float(tdms_file.object().properties['Sampling Rate(AI)'])
-                if sr > 0:
-                    dt = 1e3/sr
-                else:
-                    dt = 1.0/25.0
-        else:
-            sr = float(tdms_file.object().properties['Sampling Rate'])
-            if sr > 0:
-                dt = 1e3/sr
-            else:
-                dt = 1.0/25.0
+extension = {
+    'hdf5':'.h5',
+    'gdf':'.gdf',
+    'biosig':'.gdf',
+    'atf':'.atf',
+    'igor':'.ibw',
+    'cfs':'.dat'}
+
+def convert(src, dest, ftype=None, dest_ftype="hdf5", nthreads=0, verbose=False):
+    """Converts a batch of files.
+
+    Files are read and written concurrently by a pool of worker threads.
+    A file that can't be converted doesn't stop the conversion of the
+    others; its error message is returned instead.
+
+    Arguments:
+    src        -- list of source file names
+    dest       -- list of destination file names, or a directory into
+                  which the converted files will be written
+    ftype      -- file type of the source files (see read()); if None
+                  (default), it will be guessed from the extension.
+    dest_ftype -- file type of the destination files; can be one of
+                  "hdf5", "gdf", "atf", "igor" or "cfs"
+    nthreads   -- number of worker threads; 0 (default) uses one per CPU
+    verbose    -- Show progress
+
+    Returns:
+    A dictionary with the entries
+    "converted" -- number of files that were converted
+    "errors"    -- an error message for each source file, or None if it
+                   was converted
+    "bytes"     -- total size of the converted source files
+    "seconds"   -- duration of the conversion
+    "MBps"      -- throughput in MB/s
+    """
+    src = list(src)
+    if isinstance(dest, str):
+        try:
+            ext = extension[dest_ftype]
+        except KeyError:
+            raise StfIOException('Unsupported destination file type (%s)' % dest_ftype)
+        dest = [os.path.join(dest, os.path.splitext(os.path.basename(fname))[0] + ext)
+                for fname in src]
+    else:
+        dest = list(dest)
+    if len(src) != len(dest):
+        raise StfIOException('Number of source and destination files differ')
+
+#ifndef TEST_MINIMAL
+    if ftype is None and len(src):
+        exts = set([os.path.splitext(fname)[1] for fname in src])
+        if len(exts) != 1:
+            raise StfIOException('Source files have different extensions')
+        ext = exts.pop()
+        try:
+            ftype = filetype[ext]
+        except KeyError:
+            raise StfIOException('Couldn\'t guess file type from extension (%s)' % ext)
+#endif // TEST_MINIMAL
+    if ftype is None:
+        ftype = "none"
+
+    stats = _convert(src, ftype, dest, dest_ftype, nthreads, verbose)
+
+    if verbose:
+        print("")
+
+    return stats
+
+
+def measure(rec, base, peak, channel=0, sections=None, reference=None,
+            direction="up", baseline="mean", peak_mean=1, rt_factor=20,
+            from_base=True, slope=20.0, latency_start=("manual", 0.0),
+            latency_end=("foot", 0.0)):
+    """Measures events in sections of a recording without the GUI.
+
+    The measurements are the same as those of Stimfit's results table
+    and batch analysis. Sections are measured concurrently.
+
+    Arguments:
+    rec           -- a Recording object
+    base          -- (start, end) indices of the baseline window
+    peak          -- (start, end) indices of the peak window; if end is
+                     None, the window extends to the end of each section
+    channel       -- index of the channel, or a list of indices
+    sections      -- list of section indices; None (default) measures
+                     all sections
+    reference     -- index of a reference channel for the latency
+                     measurement (e.g. action potentials), or None
+    direction     -- direction of the peak: "up", "down" or "both"
+    baseline      -- "mean" (mean and s.d.), "median" (median and IQR) or
+                     "running" (running median and IQR, for a drifting
+                     baseline)
+    peak_mean     -- number of points for the sliding average of the peak
+    rt_factor     -- lower limit of the rise time in percent
+    from_base     -- measure amplitudes from the baseline (True) or
+                     from the slope threshold (False)
+    slope         -- slope that defines the threshold (y-units/x-units)
+    latency_start -- (mode, index) of the latency start cursor; mode
+                     can be "manual", "peak", "rise" or "half"; the
+                     index is only used in manual mode
+    latency_end   -- (mode, index) of the latency end cursor; mode
+                     can be "manual", "peak", "rise", "half" or "foot"
 
+    Returns:
+    A dictionary of numpy arrays with one value per section; arrays
+    have one row per channel if channel is a list. Times are given in
+    x-units, measured from the start of the section.
+    """
+    channels = channel if isinstance(channel, (list, tuple)) else [channel]
+    if sections is None:
+        sections = range(len(rec[channels[0]]))
+    if reference is None:
+        reference = -1
+    peak_end = peak[1]
+    if peak_end is None:
+        peak_end = -1
+    results = _measure(rec, [int(c) for c in channels], [int(s) for s in sections],
+                       int(reference), int(base[0]), int(base[1]),
+                       int(peak[0]), int(peak_end), int(peak_mean),
+                       direction, baseline, int(rt_factor), bool(from_base),
+                       float(slope), latency_start[0], latency_end[0],
+                       float(latency_start[1]), float(latency_end[1]))
+    if not isinstance(channel, (list, tuple)):
+        for key in results:
+            results[key] = results[key][0]
+    return results
+
+
+def transform(rec, channel=0, sections=None, base=0.0, factor=1.0, pon=0):
+    """Subtracts baselines, scales and P/N leak-subtracts sections.
+
+    The operations are fused into a single pass over the data points
+    of every section, and sections are processed concurrently. The
+    result equals, within floating-point rounding, that of subtracting
+    the baselines and scaling all sections first, and subtracting the
+    leak pulses afterwards. The baselines of the leak pulses are
+    combined with that of the test pulse before the scaling, so the
+    last bits may differ.
+
+    Arguments:
+    rec     -- a Recording object
+    channel -- index of the channel
+    sections -- list of section indices; None (default) uses all sections
+    base    -- baseline to be subtracted, either a single value or a
+               list with one value per section
+    factor  -- scaling factor
+    pon     -- number of leak pulses that follow each test pulse for
+               P/N leak subtraction; negative if the leak pulses have
+               the opposite polarity. 0 (default) doesn't subtract leak
+               pulses.
+
+    Returns:
+    A new Recording object with a single channel that contains one
+    section per test pulse.
+    """
+    if sections is None:
+        sections = range(len(rec[channel]))
+    sections = [int(s) for s in sections]
+    if isinstance(base, (list, tuple)) or hasattr(base, '__len__'):
+        base = [float(b) for b in base]
+    else:
+        base = [float(base)] * len(sections)
+    out = Recording()
+    error = _transform(rec, int(channel), sections, base, float(factor), int(pon), out)
+    if error:
+        raise StfIOException(error)
+    return out
+
+
+def average(rec, channel=0, sections=None, method="mean", weights=None,
+            shift=None, sd=False):
+    """Averages sections of a recording, like Stimfit's average commands.
+
+    Arguments:
+    rec      -- a Recording object
+    channel  -- index of the channel
+    sections -- list of section indices; None (default) uses all sections
+    method   -- "mean", "weighted" (weighted mean) or "median"; the
+                median is insensitive to outliers
+    weights  -- one non-negative weight per section for method="weighted",
+                e.g. the inverse variance of the baselines
+    shift    -- number of data points that are skipped at the start of
+                each section to align them, or None (default)
+    sd       -- also return the spread: the standard deviation, or 1.4826
+                times the median absolute deviation for the median
+
+    Returns:
+    A new Recording object with a single channel that contains the
+    average, followed by the spread if sd is True. The average is as
+    long as the shortest (shifted) section.
+    """
+    if sections is None:
+        sections = range(len(rec[channel]))
+    sections = [int(s) for s in sections]
+    if shift is None:
+        shift = [0] * len(sections)
+    if weights is None:
+        weights = []
+    out = Recording()
+    error = _average(rec, int(channel), sections, [int(s) for s in shift],
+                     method, [float(w) for w in weights], bool(sd), out)
+    if error:
+        raise StfIOException(error)
+    return out
+
+
+def read_tdms(fn):
+    """Reads a TDMS file and returns a dictionary with the sections of
+    each channel as read-only numpy arrays ("data") and the sampling
+    interval ("dt"). Kept for scripts that were written for the nptdms-based
+    reader; read() returns the same data as a Recording."""
+    rec = read(fn, "tdms")
     return_dict = {
-        "data": [
-            [channel.data.astype(np.float64)
-             for channel in tdms_file.group_channels(group)
-             if channel.data is not None]
-                 for group in tdms_file.groups()
-            if group.lower()[:2] == "ai" or group.lower()[:2] == "ao"],
-        "dt": dt,
+        "data": [[sec.view() for sec in ch] for ch in rec],
+        "dt": rec.dt,
     }
     return return_dict
 }
@@ -20,6 +20,7 @@ Number of traces = 3
 Sampling interval  = 0.05
  
 """
+import os
 import numpy as np
 import unittest
 
@@ -74,6 +75,21 @@ class DataListTest(unittest.TestCase):
         res = rec.write('new.abf', 'abf')
         self.assertEquals(False, res)
 
+    def testWriteHDF5Options(self):
+        """ testWriteHDF5Options() writes HDF5 files with different
+            layouts and compression """
+        for layout, deflate, shuffle in [('chunked', 0, False), ('chunked', 4, True),
+                                         ('legacy', 0, False)]:
+            self.assertTrue(rec.write('new.h5', 'hdf5', layout=layout,
+                                      deflate=deflate, shuffle=shuffle))
+            rec2 = stfio.read('new.h5')
+            self.assertEquals(len(rec), len(rec2))
+            self.assertEquals(len(rec[1]), len(rec2[1]))
+            self.assertEquals(rec[1][2][100], rec2[1][2][100])
+            self.assertEquals(rec[1].yunits, rec2[1].yunits)
+        os.remove('new.h5')
+        self.assertEquals(False, rec.write('new.h5', 'hdf5', layout='unknown'))
+
     def testNumberofChannels(self):
         """ testNumberofChannels() returns the number of channels """
         self.assertEquals(4,len(rec))
@@ -114,6 +130,99 @@ class DataListTest(unittest.TestCase):
         """ testTime() returns the creation time """
         self.assertEquals(rec.time, '23:24:42')
 
+    def testConvert(self):
+        """ testConvert() converts a batch of files and isolates errors """
+        stats = stfio.convert(['test.h5', 'missing.h5'], '.', dest_ftype='atf')
+        self.assertEquals(1, stats['converted'])
+        self.assertEquals(None, stats['errors'][0])
+        self.assertTrue(isinstance(stats['errors'][1], str))
+        os.remove('test.atf')
+
+    def testViews(self):
+        """ testViews() numpy arrays that share memory with sections """
+        sec = stfio.Section(np.arange(10.0))
+        view = sec.view()
+        self.assertEquals(5.0, view[5])
+        self.assertFalse(view.flags.writeable)
+        view_w = sec.view_w()
+        view_w[5] = -1.0
+        self.assertEquals(-1.0, sec[5])
+        # the read-only view keeps the data points it was made from:
+        self.assertEquals(5.0, view[5])
+        # and stays valid without the section:
+        del sec, view_w
+        self.assertEquals(5.0, view[5])
+
+        # views keep the recording alive:
+        view = stfio.read('test.h5')[0][0].view()
+        self.assertEquals(40000, len(view))
+        self.assertEquals(rec[0][0][100], view[100])
+
+    def testAdopt(self):
+        """ testAdopt() sections that use the buffer of a numpy array """
+        data = np.arange(10.0)
+        sec = stfio.Section(data, adopt=True)
+        self.assertTrue(np.shares_memory(data, sec.view()))
+        data[3] = 42.0
+        self.assertEquals(42.0, sec[3])
+        # reading doesn't copy the data, so later changes are still seen:
+        data[4] = 43.0
+        self.assertEquals(43.0, sec[4])
+        self.assertTrue(np.shares_memory(data, sec.view()))
+        # writing to the section copies the data:
+        sec.view_w()[3] = 0.0
+        self.assertEquals(42.0, data[3])
+        self.assertEquals(0.0, sec[3])
+        data[4] = 44.0
+        self.assertEquals(43.0, sec[4])
+        self.assertFalse(np.shares_memory(data, sec.view()))
+
+    def testMeasure(self):
+        """ testMeasure() measures sections without the GUI """
+        results = stfio.measure(rec, base=(0, 100), peak=(100, None),
+                                sections=[0, 1])
+        self.assertEquals(2, len(results['peak']))
+        data = rec[0][1].view()
+        self.assertAlmostEqual(np.mean(data[:101]), results['base'][1])
+        self.assertTrue(results['peak_time'][0] >= 100*rec.dt)
+
+        results = stfio.measure(rec, base=(0, 100), peak=(100, None),
+                                channel=[0, 0])
+        self.assertEquals((2, len(rec[0])), results['peak'].shape)
+
+    def testTransform(self):
+        """ testTransform() fused baseline subtraction, scaling and P/N """
+        data = [rec[0][n].view() for n in range(3)]
+        out = stfio.transform(rec, base=[1.0, 2.0, 3.0], factor=2.0)
+        self.assertEquals(3, len(out[0]))
+        self.assertTrue(np.allclose((data[1]-2.0)*2.0, out[0][1].view()))
+
+        out = stfio.transform(rec, base=[1.0, 2.0, 3.0], factor=2.0, pon=-2)
+        self.assertEquals(1, len(out[0]))
+        expected = (data[0]-1.0)*2.0 + (data[1]-2.0)*2.0 + (data[2]-3.0)*2.0
+        self.assertTrue(np.allclose(expected, out[0][0].view()))
+
+    def testAverage(self):
+        """ testAverage() mean, weighted mean and median of sections """
+        # the average is as long as the shortest section:
+        size = min([len(rec[0][n]) for n in range(3)])
+        data = np.array([rec[0][n].view()[:size] for n in range(3)])
+        out = stfio.average(rec, sections=range(3), sd=True)
+        self.assertEquals(2, len(out[0]))
+        self.assertTrue(np.allclose(np.mean(data, axis=0), out[0][0].view()))
+        self.assertTrue(np.allclose(np.std(data, axis=0, ddof=1), out[0][1].view()))
+
+        out = stfio.average(rec, sections=range(3), method="weighted",
+                            weights=[1.0, 0.0, 3.0])
+        self.assertTrue(np.allclose(0.25*data[0] + 0.75*data[2], out[0][0].view()))
+
+        out = stfio.average(rec, sections=range(3), method="median")
+        self.assertTrue(np.allclose(np.median(data, axis=0), out[0][0].view()))
+
+        out = stfio.average(rec, sections=[0, 1], shift=[10, 0])
+        self.assertTrue(np.allclose(0.5*(data[0][10:] + data[1][:size-10]),
+                                    out[0][0].view()[:size-10]))
+
 if __name__ == '__main__':
     # test all cases
     unittest.main()
@@ -29,6 +29,7 @@
 #include <wx/init.h>
 #include <wx/datetime.h>
 #include <wx/filename.h>
+#include <wx/stdpaths.h>
 #include <wx/stockitem.h>
 
 #ifdef __BORLANDC__
@@ -129,6 +130,14 @@ bool wxStfApp::OnCmdLineParsed(wxCmdLineParser& parser)
     return wxApp::OnCmdLineParsed(parser);
 }
 
+namespace {
+    // FFTW wisdom is kept between sessions, so that FFT plans
+    // only need to be measured once:
+    wxFileName fftw_wisdom_file() {
+        return wxFileName(wxStandardPaths::Get().GetUserDataDir(), wxT("fftw_wisdom"));
+    }
+}
+
 bool wxStfApp::OnInit(void)
 {
 #ifndef _STFDEBUG
@@ -159,6 +168,9 @@ bool wxStfApp::OnInit(void)
 #endif //WITH_PTYHON
     // Config:
     config.reset(new wxFileConfig(wxT("Stimfit")));
+    if (fftw_wisdom_file().FileExists()) {
+        stfnum::importFFTWisdom(stf::wx2std(fftw_wisdom_file().GetFullPath()));
+    }
 
     //// Create a document manager
     wxDocManager* docManager = new wxDocManager;
@@ -354,6 +366,11 @@ int wxStfApp::OnExit()
     GetDocManager()->FileHistorySave(*config);
 #endif // wxUSE_CONFIG
 
+    wxFileName wisdom(fftw_wisdom_file());
+    if (wisdom.DirExists() || wisdom.Mkdir(wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+        stfnum::exportFFTWisdom(stf::wx2std(wisdom.GetFullPath()));
+    }
+
     delete GetDocManager();
 
 #ifdef WITH_PYTHON
@@ -763,6 +780,28 @@ wxMenuBar *wxStfApp::CreateUnifiedMenuBar(wxStfDoc* doc) {
                    wxT("Fit a linear function to this trace between fit cursors")
                    );
     analysis_menu->AppendSubMenu(fitSub, wxT("&Fit"));
+    wxMenu *averageSub = new wxMenu;
+    averageSub->Append(
+                       ID_AVERAGE,
+                       wxT("&Mean"),
+                       wxT("Average of selected traces")
+                       );
+    averageSub->Append(
+                       ID_ALIGNEDAVERAGE,
+                       wxT("&Aligned mean..."),
+                       wxT("Aligned average of selected traces")
+                       );
+    averageSub->Append(
+                       ID_MEDIANAVERAGE,
+                       wxT("Me&dian"),
+                       wxT("Median of selected traces, insensitive to outliers")
+                       );
+    averageSub->Append(
+                       ID_WEIGHTEDAVERAGE,
+                       wxT("&Weighted mean"),
+                       wxT("Average of selected traces, weighted by the inverse variance of their baselines")
+                       );
+    analysis_menu->AppendSubMenu(averageSub, wxT("&Average"));
     wxMenu *transformSub = new wxMenu;
     transformSub->Append(
                          ID_LOG,
@@ -1258,23 +1297,22 @@ bool wxStfApp::OpenFileSeries(const wxArrayString& fNameArray) {
                                       wxYES_NO
                                       ).ShowModal() == wxID_YES);
     }
-    wxProgressDialog progDlg(
-                             wxT("Importing file series"),
-                             wxT("Starting file import"),
-                             100,
-                             (wxStfParentFrame*)GetTopWindow(),
-                             wxPD_SMOOTH | wxPD_AUTO_HIDE
-                             );
-    int n_opened=0;
-    Recording seriesRec;
-    while (n_opened!=nFiles) {
-        wxString progStr;
-        progStr << wxT("Reading file #") << n_opened + 1 << wxT(" of ") << nFiles;
-        progDlg.Update(
-                       (int)((double)n_opened/(double)nFiles*100.0),
-                       progStr
-                       );
-        if (!singleWindow) {
+    if (!singleWindow) {
+        wxProgressDialog progDlg(
+                                 wxT("Importing file series"),
+                                 wxT("Starting file import"),
+                                 100,
+                                 (wxStfParentFrame*)GetTopWindow(),
+                                 wxPD_SMOOTH | wxPD_AUTO_HIDE
+                                 );
+        int n_opened=0;
+        while (n_opened!=nFiles) {
+            wxString progStr;
+            progStr << wxT("Reading file #") << n_opened + 1 << wxT(" of ") << nFiles;
+            progDlg.Update(
+                           (int)((double)n_opened/(double)nFiles*100.0),
+                           progStr
+                           );
             wxDocTemplate* templ=GetDocManager()->FindTemplateForPath(fNameArray[n_opened]);
             wxStfDoc* NewDoc=(wxStfDoc*)templ->CreateDocument(fNameArray[n_opened],wxDOC_NEW);
             NewDoc->SetDocumentTemplate(templ);
@@ -1283,21 +1321,24 @@ bool wxStfApp::OpenFileSeries(const wxArrayString& fNameArray) {
                 GetDocManager()->CloseDocument(NewDoc);
                 return false;
             }
-        } else {
-            // Add to recording first:
+        }
+    } else {
+        // Add to recording first:
+        std::vector<std::string> fNames(nFiles);
+        std::vector<stfio::filetype> types(nFiles);
+        for (int n_f=0; n_f<nFiles; ++n_f) {
 #ifndef TEST_MINIMAL
             // Find a template:
-            wxDocTemplate* templ=GetDocManager()->FindTemplateForPath(fNameArray[n_opened]);
+            wxDocTemplate* templ=GetDocManager()->FindTemplateForPath(fNameArray[n_f]);
             // Use this template only for type recognition:
-            wxString filter(templ->GetFileFilter());
-            stfio::filetype type = stfio::findType(stf::wx2std(templ->GetFileFilter()));
+            types[n_f] = stfio::findType(stf::wx2std(templ->GetFileFilter()));
 #else
-            stfio::filetype type = stfio::none;
+            types[n_f] = stfio::none;
 #endif
 #if 0 // TODO: re-implement ascii
-            if (type==stfio::ascii) {
+            if (types[n_f]==stfio::ascii) {
                 if (!get_directTxtImport()) {
-                    wxStfTextImportDlg ImportDlg(NULL, stf::CreatePreview(fNameArray[n_opened]), 1,
+                    wxStfTextImportDlg ImportDlg(NULL, stf::CreatePreview(fNameArray[n_f]), 1,
                                                  true);
                     if (ImportDlg.ShowModal()!=wxID_OK) {
                         return false;
@@ -1308,20 +1349,46 @@ bool wxStfApp::OpenFileSeries(const wxArrayString& fNameArray) {
                 }
             }
 #endif
-            // add this file to the series recording:
-            Recording singleRec;
+            fNames[n_f] = stf::wx2std(fNameArray[n_f]);
+        }
+
+        // The files are read concurrently:
+        std::vector<Recording> recs;
+        std::vector<std::string> errors;
+        try {
+            if (!stf::importFilesAsync(fNames, types, txtImport, "Importing file series",
+                                       recs, errors)) {
+                return false;
+            }
+        }
+        catch (const std::exception& e) {
+            wxString errorMsg;
+            errorMsg << wxT("Couldn't open file, aborting file import:\n")
+                     << stf::std2wx(e.what());
+            ErrorMsg(errorMsg);
+            return false;
+        }
+
+        // add the files to the series recording in their original order:
+        Recording seriesRec;
+        for (int n_f=0; n_f<nFiles; ++n_f) {
+            if (!errors[n_f].empty()) {
+                wxString errorMsg;
+                errorMsg << wxT("Couldn't open file, aborting file import:\n")
+                         << stf::std2wx(errors[n_f]);
+                ErrorMsg(errorMsg);
+                return false;
+            }
             try {
-                stf::wxProgressInfo progDlg("Reading file", "Opening file", 100);
-                stfio::importFile(stf::wx2std(fNameArray[n_opened++]),type,singleRec,txtImport, progDlg);
-                if (n_opened==1) {
-                    seriesRec.resize(singleRec.size());
+                if (n_f==0) {
+                    seriesRec.resize(recs[n_f].size());
                     // reserve memory to avoid allocations:
-                    for (std::size_t n_c=0;n_c<singleRec.size();++n_c) {
-                        seriesRec[n_c].reserve(singleRec[n_c].size()*nFiles);
+                    for (std::size_t n_c=0;n_c<recs[n_f].size();++n_c) {
+                        seriesRec[n_c].reserve(recs[n_f][n_c].size()*nFiles);
                     }
-                    seriesRec.SetXScale(singleRec.GetXScale());
+                    seriesRec.SetXScale(recs[n_f].GetXScale());
                 }
-                seriesRec.AddRec(singleRec);
+                seriesRec.AddRec(recs[n_f]);
             }
             catch (const std::runtime_error& e) {
                 wxString errorMsg;
@@ -1337,11 +1404,10 @@ bool wxStfApp::OpenFileSeries(const wxArrayString& fNameArray) {
                 ErrorMsg(errorMsg);
                 return false;
             }
-            // check whether this was the last file in the queue:
-            if (n_opened==nFiles) {
-                NewChild(seriesRec,NULL,wxT("File series"));
-            }
+            // release the memory of this file as soon as it has been added:
+            recs[n_f].resize(0);
         }
+        NewChild(seriesRec,NULL,wxT("File series"));
     }
     // reset direct import:
     directTxtImport=false;
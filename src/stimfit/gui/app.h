@@ -92,6 +92,8 @@ enum {
     ID_CURSORS,
     ID_AVERAGE,
     ID_ALIGNEDAVERAGE,
+    ID_MEDIANAVERAGE,
+    ID_WEIGHTEDAVERAGE,
     ID_FIT,
     ID_LFIT,
     ID_LOG,
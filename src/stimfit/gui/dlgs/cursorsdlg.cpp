@@ -402,10 +402,11 @@ wxNotebookPage* wxStfCursorsDlg::CreateBasePage() {
     wxFlexGridSizer* BaseMethodSizer = new wxFlexGridSizer(1, 0, 0);
     wxString BaselineMethods[] = {
         wxT("Mean and Standard Deviation (SD)"),
-        wxT("Median and InterQuartil Ratio (IQR)")
+        wxT("Median and InterQuartil Ratio (IQR)"),
+        wxT("Running median and IQR (drifting baseline)")
     };
     int iBaselineMethods = sizeof(BaselineMethods) / sizeof(wxString);
-    //**** Radio options for baseline methods "mean, or median " ****
+    //**** Radio options for baseline methods "mean, median or running median" ****
     wxRadioBox* pBaselineMethod = new wxRadioBox( nbPage, wxRADIO_BASELINE_METHOD,
         wxT("Method to compute the baseline"), wxDefaultPosition, wxDefaultSize, 
         iBaselineMethods, BaselineMethods, 0, wxRA_SPECIFY_ROWS );    
@@ -897,6 +898,7 @@ bool wxStfCursorsDlg::LoadCursorConf(const wxString& filepath ){
     switch( base_method ) {
         case 0: mybase_method = stfnum::mean_sd; break;
         case 1: mybase_method = stfnum::median_iqr; break;
+        case 2: mybase_method = stfnum::median_running; break;
         default: mybase_method = stfnum::mean_sd;
     }
     SetBaselineMethod ( mybase_method );
@@ -1366,6 +1368,7 @@ enum stfnum::baseline_method wxStfCursorsDlg::GetBaselineMethod() const {
     switch( pBaselineMethod->GetSelection() ) {
         case 0: return stfnum::mean_sd;
         case 1: return stfnum::median_iqr;
+        case 2: return stfnum::median_running;
         default: return stfnum::mean_sd;
     }
 }
@@ -1381,6 +1384,9 @@ void wxStfCursorsDlg::SetBaselineMethod(stfnum::baseline_method base_method) {
         case stfnum::median_iqr:
             pBaselineMethod->SetSelection(1);
             break;
+        case stfnum::median_running:
+            pBaselineMethod->SetSelection(2);
+            break;
         case stfnum::mean_sd:
             pBaselineMethod->SetSelection(0);
             break;
@@ -290,11 +290,8 @@ void wxStfFitSelDlg::SetPars() {
             wxGetApp().ErrorMsg(wxT("Check fit cursor settings"));
             return;
         }
-        Vector_double x(fitSize);
         //fill array:
-        std::copy(&pDoc->cursec()[pDoc->GetFitBeg()],
-                  &pDoc->cursec()[pDoc->GetFitBeg()+fitSize],
-                  &x[0]);
+        Vector_double x(pDoc->cursec().get_window(pDoc->GetFitBeg(), fitSize));
         Vector_double initPars(wxGetApp().GetFuncLib().at(m_fselect).pInfo.size());
         wxGetApp().GetFuncLib().at(m_fselect).init( x, pDoc->GetBase(),
             pDoc->GetPeak(), pDoc->GetRTLoHi(), pDoc->GetHalfDuration(),
@@ -236,48 +236,47 @@ bool wxStfDoc::OnOpenDocument(const wxString& filename) {
             }
         }
 #endif
-        if (type == stfio::tdms) {
-#ifdef WITH_PYTHON
-            if (!LoadTDMS(stf::wx2std(filename), *this)) {
-                wxString errorMsg(wxT("Error opening file\n"));
-#else
-            {
-                wxString errorMsg(wxT("Error opening file - TDMS requires python \n"));
-#endif
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
-            }
-        } else {
-            try {
-                if (progress) {
-                    stf::wxProgressInfo progDlg("Reading file", "Opening file", 100);
-                    stfio::importFile(stf::wx2std(filename), type, *this, wxGetApp().GetTxtImport(), progDlg);
-                } else {
-                    stfio::StdoutProgressInfo progDlg("Reading file", "Opening file", 100, true);
-                    stfio::importFile(stf::wx2std(filename), type, *this, wxGetApp().GetTxtImport(), progDlg);
+        try {
+            if (progress) {
+                // Read the file in a worker thread so that the GUI stays responsive:
+                std::vector<std::string> fNames(1, stf::wx2std(filename));
+                std::vector<stfio::filetype> types(1, type);
+                std::vector<Recording> recs;
+                std::vector<std::string> errors;
+                if (!stf::importFilesAsync(fNames, types, wxGetApp().GetTxtImport(), "Reading file",
+                                           recs, errors)) {
+                    get().clear();
+                    return false;
                 }
+                if (!errors[0].empty()) {
+                    throw std::runtime_error(errors[0]);
+                }
+                // Take over the channels without copying the data:
+                Recording::operator=(std::move(recs[0]));
+            } else {
+                stfio::StdoutProgressInfo progDlg("Reading file", "Opening file", 100, true);
+                stfio::importFile(stf::wx2std(filename), type, *this, wxGetApp().GetTxtImport(), progDlg);
             }
-            catch (const std::runtime_error& e) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                errorMsg += wxString( e.what(),wxConvLocal );
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
-            }
-            catch (const std::exception& e) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                errorMsg += wxString( e.what(), wxConvLocal );
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
-            }
-            catch (...) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                wxGetApp().ExceptMsg(errorMsg);
-                get().clear();
-                return false;
-            }
+        }
+        catch (const std::runtime_error& e) {
+            wxString errorMsg(wxT("Error opening file\n"));
+            errorMsg += wxString( e.what(),wxConvLocal );
+            wxGetApp().ExceptMsg(errorMsg);
+            get().clear();
+            return false;
+        }
+        catch (const std::exception& e) {
+            wxString errorMsg(wxT("Error opening file\n"));
+            errorMsg += wxString( e.what(), wxConvLocal );
+            wxGetApp().ExceptMsg(errorMsg);
+            get().clear();
+            return false;
+        }
+        catch (...) {
+            wxString errorMsg(wxT("Error opening file\n"));
+            wxGetApp().ExceptMsg(errorMsg);
+            get().clear();
+            return false;
         }
         if (get().empty()) {
             wxGetApp().ErrorMsg(wxT("File is probably empty\n"));
@@ -289,7 +288,7 @@ bool wxStfDoc::OnOpenDocument(const wxString& filename) {
             get().clear();
             return false;
         }
-        if (get()[0][0].get().empty()) {
+        if (get()[0][0].size() == 0) {
             wxGetApp().ErrorMsg(wxT("File is probably empty\n"));
             get().clear();
             return false;
@@ -450,6 +449,7 @@ int wxStfDoc::InitCursors() {
     switch (ibase_method) {
         case 0: SetBaselineMethod(stfnum::mean_sd); break;
         case 1: SetBaselineMethod(stfnum::median_iqr); break;
+        case 2: SetBaselineMethod(stfnum::median_running); break;
         default: SetBaselineMethod(stfnum::mean_sd); 
     }
     SetPeakBeg(wxGetApp().wxGetProfileInt(wxT("Settings"),wxT("PeakBegin"), (int)cursec().size()-100));
@@ -998,7 +998,8 @@ void wxStfDoc::ConcatenateMultiChannel(wxCommandEvent &WXUNUSED(event)) {
 
 void wxStfDoc::CreateAverage(
         bool calcSD,
-        bool align	       //align to steepest rise of other channel?
+        bool align,	       //align to steepest rise of other channel?
+        stfio::average_method method
 ) {
     if(GetSelectedSections().empty()) {
         wxGetApp().ErrorMsg(wxT("Select traces first"));
@@ -1126,22 +1127,59 @@ void wxStfDoc::CreateAverage(
     }
     average_size -= shift_size;
 
+    //weight every trace by the inverse variance of its baseline in the active channel:
+    Vector_double weights;
+    if (method == stfio::average_weighted) {
+        if (GetBaseBeg() > GetBaseEnd()) {
+            wxGetApp().ErrorMsg(wxT("Baseline cursors are in the wrong order"));
+            return;
+        }
+        weights.reserve(GetSelectedSections().size());
+        for (c_st_it sit = GetSelectedSections().begin(); sit != GetSelectedSections().end(); sit++) {
+            double var = 0;
+            try {
+                Vector_double baseline(curch()[*sit].get_window(GetBaseBeg(), GetBaseEnd()-GetBaseBeg()+1));
+                stfnum::base(stfnum::mean_sd, var, baseline, 0, baseline.size()-1);
+            }
+            catch (const std::out_of_range& e) {
+                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+                return;
+            }
+            if (!(var > 0)) {
+                wxGetApp().ErrorMsg(wxT("The baseline of a selected trace has no variance"));
+                return;
+            }
+            weights.push_back(1.0/var);
+        }
+    }
+    std::string kind;
+    switch (method) {
+     case stfio::average_weighted:
+         kind = "weighted average";
+         break;
+     case stfio::average_median:
+         kind = "median";
+         break;
+     default:
+         kind = "average";
+    }
+
     //initialize temporary sections and channels:
     Average.resize(size());
     std::size_t n_c = 0;
     for (c_ch_it cit = get().begin(); cit != get().end(); cit++) {
         Section TempSection(average_size), TempSig(average_size);
         try {
-            MakeAverage(TempSection, TempSig, n_c, GetSelectedSections(), calcSD, shift);
+            MakeAverage(TempSection, TempSig, n_c, GetSelectedSections(), calcSD, shift, method, weights);
         }
-        catch (const std::out_of_range& e) {
+        catch (const std::exception& e) {
             Average.resize(0);
             wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
             return;
         }
         TempSection.SetXScale(get()[n_c][0].GetXScale());	// set xscale for channel n_c and the only section
         TempSection.SetSectionDescription(stf::wx2std(GetTitle())
-                                          +std::string(", average"));
+                                          +std::string(", ")+kind);
         Channel TempChannel(TempSection);
         TempChannel.SetChannelName(cit->GetChannelName());
         try {
@@ -1157,7 +1195,7 @@ void wxStfDoc::CreateAverage(
     Average.CopyAttributes(*this);
 
     wxString title;
-    title << GetFilename() << wxT(", average of ") << (int)GetSelectedSections().size() << wxT(" traces");
+    title << GetFilename() << wxT(", ") << stf::std2wx(kind) << wxT(" of ") << (int)GetSelectedSections().size() << wxT(" traces");
     wxGetApp().NewChild(Average,this,title);
 }	//End of CreateAverage(.,.,.)
 
@@ -1195,9 +1233,8 @@ void wxStfDoc::FitDecay(wxCommandEvent& WXUNUSED(event)) {
     int warning = 0;
     try {
         std::size_t fitSize = GetFitEnd() - GetFitBeg();
-        Vector_double x( fitSize );
         //fill array:
-        std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitBeg()+fitSize], &x[0]);
+        Vector_double x( cursec().get_window(GetFitBeg(), fitSize) );
         if (params.size() != n_params) {
             throw std::runtime_error("Wrong size of params in wxStfDoc::lmFit()");
         }
@@ -1254,8 +1291,14 @@ void wxStfDoc::LFit(wxCommandEvent& WXUNUSED(event)) {
     Vector_double params( n_params );
 
     //fill array:
-    Vector_double x(n_points);
-    std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitBeg()+n_points], &x[0]);
+    Vector_double x;
+    try {
+        x = cursec().get_window(GetFitBeg(), n_points);
+    }
+    catch (const std::out_of_range& e) {
+        wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+        return;
+    }
     Vector_double t(x.size());
     for (std::size_t n_t=0;n_t<x.size();++n_t) t[n_t]=n_t*GetXScale();
 
@@ -1295,8 +1338,9 @@ void wxStfDoc::LnTransform(wxCommandEvent& WXUNUSED(event)) {
     std::size_t n = 0;
     for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
         Section TempSection(size());
-        std::transform(get()[GetCurChIndex()][*cit].get().begin(), 
-                       get()[GetCurChIndex()][*cit].get().end(), 
+        stfio::SharedSamplesPtr samples = get()[GetCurChIndex()][*cit].get_shared();
+        std::transform(samples->begin(), 
+                       samples->end(), 
                        TempSection.get_w().begin(),
 #if defined(_WINDOWS) && !defined(__MINGW32__)
                        std::logl);
@@ -1366,30 +1410,14 @@ bool wxStfDoc::SubtractBase( ) {
         wxGetApp().ErrorMsg(wxT("Select traces first"));
         return false;
     }
-    Channel TempChannel(GetSelectedSections().size(), get()[GetCurChIndex()][GetSelectedSections()[0]].size());
-    std::size_t n = 0;
-    for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        Section TempSection(stfio::vec_scal_minus(get()[GetCurChIndex()][*cit].get(), GetSelectBase()[n]));
-        TempSection.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
-        TempSection.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
-                                           ", baseline subtracted");
-        try {
-            TempChannel.InsertSection(TempSection,n);
-        }
-        catch (const std::out_of_range& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-            return false;
-        }
-        n++;
-    }
-    if (TempChannel.size()>0) {
-        Recording SubBase(TempChannel);
-        SubBase.CopyAttributes(*this);
+    try {
+        Recording SubBase = stfio::subtract_base(*this, GetSelectedSections(), GetCurChIndex(), GetSelectBase());
         wxString title(GetTitle());
         title+=wxT(", baseline subtracted");
         wxGetApp().NewChild(SubBase,this,title);
-    } else {
-        wxGetApp().ErrorMsg( wxT("Channel is empty.") );
+    }
+    catch (const std::out_of_range& e) {
+        wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
         return false;
     }
 
@@ -1524,139 +1552,136 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
             return;
         }
     }
-    std::size_t n_s = 0;
-    for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        wxString progStr;
-        progStr << wxT("Processing trace # ") << (int)n_s+1 << wxT(" of ") << (int)GetSelectedSections().size();
-        progDlg.Update( (int)((double)n_s/ (double)GetSelectedSections().size()*100.0), progStr );
-        SetSection(*cit);
-        if (peakAtEnd)
-            SetPeakEnd((int)get()[GetCurChIndex()][*cit].size()-1);
-
-        //Calculate all variables for the current settings
-        try {
-            Measure();
-        }
-        catch (const std::out_of_range& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-            SetSection(section_old);
-            return;
-        }
 
-        // Set fit start cursor to new peak if necessary:
-        //if (wxGetApp().GetCursorsDialog() != NULL && wxGetApp().GetCursorsDialog()->GetStartFitAtPeak())
-        if ( startFitAtPeak )
-            SetFitBeg(GetMaxT());
+    // Measure all selected traces at once, without changing the current section:
+    progDlg.Update( 0, wxT("Measuring traces") );
+    const std::vector<std::size_t>& sections = GetSelectedSections();
+    std::vector<stfnum::MeasureResult> results;
+    try {
+        results = stfnum::measure(*this, std::vector<std::size_t>(1, GetCurChIndex()), sections,
+                                  GetMeasureSpec(), size()>1 ? (int)GetSecChIndex() : -1)[0];
+    }
+    catch (const std::out_of_range& e) {
+        wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+        SetSection(section_old);
+        return;
+    }
 
-        Vector_double params;
-        int fitWarning = 0;
-        if (SaveYtDialog.PrintFitResults()) {
-            try {
-                n_params=(int)wxGetApp().GetFuncLib().at(fselect).pInfo.size();
-            }
-            catch (const std::out_of_range& e) {
-                wxString msg(wxT("Could not retrieve function from library:\n"));
-                msg+=wxString( e.what(), wxConvLocal );
-                wxGetApp().ExceptMsg(msg);
+    // Fit all traces at once:
+    std::vector<Vector_double> params;
+    std::vector<int> fitWarning;
+    if (SaveYtDialog.PrintFitResults()) {
+        progDlg.Update( 50, wxT("Fitting traces") );
+        const stfnum::storedFunc& fitFunc = wxGetApp().GetFuncLib()[fselect];
+        std::vector<Vector_double> fitData(sections.size());
+        std::vector<std::size_t> fitBegs(sections.size()), fitEnds(sections.size());
+        params.resize(sections.size());
+        for (std::size_t n_s=0; n_s<sections.size(); ++n_s) {
+            const Section& sec = get()[GetCurChIndex()][sections[n_s]];
+            // Set fit start cursor to new peak if necessary:
+            std::size_t beg = startFitAtPeak ? (std::size_t)std::max(0.0, results[n_s].maxT) : GetFitBeg();
+            fitBegs[n_s] = std::min(beg, sec.size()-1);
+            fitEnds[n_s] = std::min(GetFitEnd(), sec.size()-1);
+            if (fitEnds[n_s] <= fitBegs[n_s]+1) {
+                wxGetApp().ErrorMsg(wxT("Check fit limits"));
+                SetSection(section_old);
                 return;
             }
+            fitData[n_s] = sec.get_window(fitBegs[n_s], fitEnds[n_s]-fitBegs[n_s]);
             // in this case, initialize parameters from init function,
             // not from user input:
-            Vector_double x(GetFitEnd()-GetFitBeg());
-            //fill array:
-            std::copy(&cursec()[GetFitBeg()], &cursec()[GetFitEnd()], &x[0]);
-            params.resize(n_params);
-            wxGetApp().GetFuncLib().at(fselect).init( x, GetBase(), GetPeak(), GetRTLoHi(),
-                    GetHalfDuration(), GetXScale(), params );
-
-            std::string fitInfo;
-            try {
-                double chisqr = stfnum::lmFit( x, GetXScale(), wxGetApp().GetFuncLib()[fselect],
-                                            FitSelDialog.GetOpts(), FitSelDialog.UseScaling(),
-                                            params, fitInfo, fitWarning );
-                SetIsFitted( GetCurChIndex(), GetCurSecIndex(), params, wxGetApp().GetFuncLibPtr(fselect),
-                             chisqr, GetFitBeg(), GetFitEnd() );
-            }
-
-            catch (const std::out_of_range& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
-            }
-            catch (const std::runtime_error& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
-            }
-            catch (const std::exception& e) {
-                wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-                SetSection(section_old);
-                return;
+            params[n_s].resize(n_params);
+            fitFunc.init( fitData[n_s], results[n_s].base, results[n_s].peak, results[n_s].rtLoHi,
+                          results[n_s].halfDuration, GetXScale(), params[n_s] );
+        }
+        std::vector<std::string> fitInfo;
+        Vector_double chisqr;
+        try {
+            chisqr = stfnum::lmFitBatch( fitData, GetXScale(), fitFunc, FitSelDialog.GetOpts(),
+                                         FitSelDialog.UseScaling(), params, fitInfo, fitWarning );
+            for (std::size_t n_s=0; n_s<sections.size(); ++n_s) {
+                if (fitWarning[n_s] == -1) {
+                    throw std::runtime_error(fitInfo[n_s]);
+                }
+                SetIsFitted( GetCurChIndex(), sections[n_s], params[n_s], wxGetApp().GetFuncLibPtr(fselect),
+                             chisqr[n_s], fitBegs[n_s], fitEnds[n_s] );
             }
         }
+        catch (const std::exception& e) {
+            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+            SetSection(section_old);
+            return;
+        }
+    }
+
+    progDlg.Update( 90, wxT("Writing results") );
+    double dt = GetXScale();
+    for (std::size_t n_s=0; n_s<sections.size(); ++n_s) {
+        const Section& sec = get()[GetCurChIndex()][sections[n_s]];
+        const stfnum::MeasureResult& res = results[n_s];
 
         // count number of threshold crossings if needed:
         std::size_t n_crossings=0;
         if (SaveYtDialog.PrintThr()) {
-            n_crossings= stfnum::peakIndices( cursec().get(), threshold, 0 ).size();
+            n_crossings= stfnum::peakIndices( *sec.get_shared(), threshold, 0 ).size();
         }
         std::size_t nCol=0;
         //Write the variables of the current channel in a string
         try {
-            table.SetRowLabel(n_s, cursec().GetSectionDescription());
+            table.SetRowLabel(n_s, sec.GetSectionDescription());
 
             if (SaveYtDialog.PrintBase())
-                table.at(n_s,nCol++)=GetBase();
+                table.at(n_s,nCol++)=res.base;
             if (SaveYtDialog.PrintBaseSD())
-                table.at(n_s,nCol++)=GetBaseSD();
+                table.at(n_s,nCol++)=res.baseSD;
             if (SaveYtDialog.PrintThreshold())
-                table.at(n_s,nCol++)=GetThreshold();
+                table.at(n_s,nCol++)=res.threshold;
             if (SaveYtDialog.PrintSlopeThresholdTime())
-                table.at(n_s,nCol++)=GetThrT()*GetXScale();
+                table.at(n_s,nCol++)=res.thrT*dt;
             if (SaveYtDialog.PrintPeakZero())
-                table.at(n_s,nCol++)=GetPeak();
+                table.at(n_s,nCol++)=res.peak;
             if (SaveYtDialog.PrintPeakBase())
-                table.at(n_s,nCol++)=GetPeak()-GetBase();
+                table.at(n_s,nCol++)=res.peak-res.base;
             if (SaveYtDialog.PrintPeakThreshold())
-                table.at(n_s,nCol++)=GetPeak()-GetThreshold();
+                table.at(n_s,nCol++)=res.peak-res.threshold;
             if (SaveYtDialog.PrintPeakTime())
-                table.at(n_s,nCol++)=GetPeakTime()*GetXScale();
+                table.at(n_s,nCol++)=res.maxT*dt;
             if (SaveYtDialog.PrintRTLoHi())
-                table.at(n_s,nCol++)=GetRTLoHi();
+                table.at(n_s,nCol++)=res.rtLoHi;
             if (SaveYtDialog.PrintInnerRTLoHi())
-                table.at(n_s,nCol++)=GetInnerRiseTime();
+                table.at(n_s,nCol++)=res.InnerHiRT-res.InnerLoRT;
             if (SaveYtDialog.PrintOuterRTLoHi())
-                table.at(n_s,nCol++)=GetOuterRiseTime();
+                table.at(n_s,nCol++)=res.OuterHiRT-res.OuterLoRT;
             if (SaveYtDialog.PrintT50())
-                table.at(n_s,nCol++)=GetHalfDuration();
+                table.at(n_s,nCol++)=res.halfDuration;
             if (SaveYtDialog.PrintT50SE()) {
-                table.at(n_s,nCol++)=GetT50LeftReal()*GetXScale();
-                table.at(n_s,nCol++)=GetT50RightReal()*GetXScale();
+                table.at(n_s,nCol++)=res.t50LeftReal*dt;
+                table.at(n_s,nCol++)=res.t50RightReal*dt;
             }
             if (SaveYtDialog.PrintSlopes()) {
-                table.at(n_s,nCol++)=GetMaxRise();
-                table.at(n_s,nCol++)=GetMaxDecay();
+                table.at(n_s,nCol++)=res.maxRise;
+                table.at(n_s,nCol++)=res.maxDecay;
             }
             if (SaveYtDialog.PrintSlopeTimes()) {
-                table.at(n_s,nCol++)=GetMaxRiseT()*GetXScale();
-                table.at(n_s,nCol++)=GetMaxDecayT()*GetXScale();
+                table.at(n_s,nCol++)=res.maxRiseT*dt;
+                table.at(n_s,nCol++)=res.maxDecayT*dt;
             }
             if (SaveYtDialog.PrintLatencies()) {
-                table.at(n_s,nCol++)=GetLatency()*GetXScale();
+                table.at(n_s,nCol++)=res.latency*dt;
             }
             if (SaveYtDialog.PrintFitResults()) {
                 for (std::size_t n_pf=0;n_pf<n_params;++n_pf) {
-                    table.at(n_s,nCol++)=params[n_pf];
+                    table.at(n_s,nCol++)=params[n_s][n_pf];
                 }
-                if (fitWarning != 0) {
-                    table.at(n_s,nCol++) = (double)fitWarning;
+                if (fitWarning[n_s] != 0) {
+                    table.at(n_s,nCol++) = (double)fitWarning[n_s];
                 } else {
                     table.SetEmpty(n_s,nCol++);
                 }
             }
 #ifdef WITH_PSLOPE
             if (SaveYtDialog.PrintPSlopes()) {
-                table.at(n_s,nCol++)=GetPSlope();
+                table.at(n_s,nCol++)=res.PSlope;
             }
 #endif
             if (SaveYtDialog.PrintThr()) {
@@ -1668,7 +1693,6 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
             SetSection(section_old);
             return;
         }
-        n_s++;
     }
     progDlg.Update(100,wxT("Finished"));
     SetSection(section_old);
@@ -1679,10 +1703,13 @@ void wxStfDoc::OnAnalysisBatch(wxCommandEvent &WXUNUSED(event)) {
 void wxStfDoc::OnAnalysisIntegrate(wxCommandEvent &WXUNUSED(event)) {
     double integral_s = 0.0, integral_t = 0.0;
     const std::string units = at(GetCurChIndex()).GetYUnits() + " * " + GetXUnits();
+    // only the data points up to the end of the integration window are read:
+    Vector_double trace;
     
     try {
-        integral_s = stfnum::integrate_simpson(cursec().get(),GetFitBeg(),GetFitEnd(),GetXScale());
-        integral_t = stfnum::integrate_trapezium(cursec().get(),GetFitBeg(),GetFitEnd(),GetXScale());
+        trace = cursec().get_window(0, GetFitEnd()+1);
+        integral_s = stfnum::integrate_simpson(trace,GetFitBeg(),GetFitEnd(),GetXScale());
+        integral_t = stfnum::integrate_trapezium(trace,GetFitBeg(),GetFitEnd(),GetXScale());
     }
     catch (const std::exception& e) {
         wxGetApp().ErrorMsg(wxString( e.what(), wxConvLocal ));
@@ -1714,7 +1741,7 @@ void wxStfDoc::OnAnalysisIntegrate(wxCommandEvent &WXUNUSED(event)) {
     wxStfChildFrame* pFrame=(wxStfChildFrame*)GetDocumentWindow();
     pFrame->ShowTable(integralTable,wxT("Integral"));
     try {
-        Vector_double quad_p = stfnum::quad(cursec().get(), GetFitBeg(), GetFitEnd());
+        Vector_double quad_p = stfnum::quad(trace, GetFitBeg(), GetFitEnd());
         SetIsIntegrated(GetCurChIndex(), GetCurSecIndex(), true,GetFitBeg(),GetFitEnd(), quad_p);
     }
     catch (const std::runtime_error& e) {
@@ -1733,7 +1760,7 @@ void wxStfDoc::OnAnalysisDifferentiate(wxCommandEvent &WXUNUSED(event)) {
     Channel TempChannel(GetSelectedSections().size(), get()[GetCurChIndex()][GetSelectedSections()[0]].size());
     std::size_t n = 0;
     for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        Section TempSection( stfnum::diff( get()[GetCurChIndex()][*cit].get(), GetXScale() ) );
+        Section TempSection( stfnum::diff( *get()[GetCurChIndex()][*cit].get_shared(), GetXScale() ) );
         TempSection.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
         TempSection.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
                 ", differentiated");
@@ -1766,7 +1793,7 @@ bool wxStfDoc::OnNewfromselectedThis( ) {
     std::size_t n = 0;
     for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
         // Multiply the valarray in Data:
-        Section TempSection(get()[GetCurChIndex()][*cit].get());
+        Section TempSection(*get()[GetCurChIndex()][*cit].get_shared());
         TempSection.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
         TempSection.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
                 ", new from selected");
@@ -2030,44 +2057,36 @@ void wxStfDoc::Filter(wxCommandEvent& WXUNUSED(event)) {
 
     /*sampling interval in ms*/
 
-    Channel TempChannel(GetSelectedSections().size(), get()[GetCurChIndex()][GetSelectedSections()[0]].size());
-    std::size_t n = 0;
-    for (c_st_it cit = GetSelectedSections().begin(); cit != GetSelectedSections().end(); cit++) {
-        try {
-            switch (fselect) {
-                case 3: {
-                    Section FftTemp(stfnum::filter(get()[GetCurChIndex()][*cit].get(),
-                            llf,ulf,a,(int)GetSR(),stfnum::fgaussColqu,false));
-		    FftTemp.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
-                    FftTemp.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
-                                                   ", filtered");
-                    TempChannel.InsertSection(FftTemp, n);
-                    break;
-                }
-                case 2: {
-                    Section FftTemp(stfnum::filter(get()[GetCurChIndex()][*cit].get(),
-                            llf,ulf,a,(int)GetSR(),stfnum::fbessel4,false));
-		    FftTemp.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
-                    FftTemp.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
-                                                   ", filtered" );
-                    TempChannel.InsertSection(FftTemp, n);
-                    break;
-                }
-                case 1: {
-                    Section FftTemp(stfnum::filter(get()[GetCurChIndex()][*cit].get(),
-                            llf,ulf,a,(int)GetSR(),stfnum::fgauss,inverse));
-		    FftTemp.SetXScale(get()[GetCurChIndex()][*cit].GetXScale());
-                    FftTemp.SetSectionDescription( get()[GetCurChIndex()][*cit].GetSectionDescription()+
-                                                   std::string(", filtered") );
-                    TempChannel.InsertSection(FftTemp, n);
-                    break;
-                }
-            }
-        }
-        catch (const std::exception& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
-        }
-        n++;
+    stfnum::Func func = stfnum::fgauss;
+    switch (fselect) {
+        case 2:
+            func = stfnum::fbessel4;
+            inverse = false;
+            break;
+        case 3:
+            func = stfnum::fgaussColqu;
+            inverse = false;
+            break;
+    }
+
+    // Filter all selected traces at once:
+    std::vector<Vector_double> filtered;
+    try {
+        filtered = stfnum::filter(*this, GetCurChIndex(), GetSelectedSections(),
+                                  llf, ulf, a, (int)GetSR(), func, inverse);
+    }
+    catch (const std::exception& e) {
+        wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+        return;
+    }
+
+    Channel TempChannel(filtered.size());
+    for (std::size_t n = 0; n < filtered.size(); ++n) {
+        const Section& sec = get()[GetCurChIndex()][GetSelectedSections()[n]];
+        Section FftTemp(filtered[n]);
+        FftTemp.SetXScale(sec.GetXScale());
+        FftTemp.SetSectionDescription( sec.GetSectionDescription()+", filtered" );
+        TempChannel.InsertSection(std::move(FftTemp), n);
     }
     if (TempChannel.size()>0) {
         Recording Fft(TempChannel);
@@ -2097,44 +2116,19 @@ void wxStfDoc::P_over_N(wxCommandEvent& WXUNUSED(event)){
         return;
     }
 
-    //File dialog box
     wxBusyCursor wc;
-    Channel TempChannel(new_sections);
-
-    //read and PoN
-    for (int n_section=0; n_section < new_sections; n_section++) {
-        //Section loop
-        Section TempSection(get()[GetCurChIndex()][n_section].size());
-        TempSection.SetXScale(get()[GetCurChIndex()][n_section].GetXScale());
-        for (int n_point=0; n_point < (int)get()[GetCurChIndex()][n_section].size(); n_point++)
-            TempSection[n_point]=0.0;
-
-        //Addition of the PoN-values:
-        for (int n_PoN=1; n_PoN < PoN+1; n_PoN++)
-            for (int n_point=0; n_point < (int)get()[GetCurChIndex()][n_section].size(); n_point++)
-                TempSection[n_point] += get()[GetCurChIndex()][n_PoN+(n_section*(PoN+1))][n_point];
-
-        //Subtraction from the original values:
-        for (int n_point=0; n_point < (int)get()[GetCurChIndex()][n_section].size(); n_point++)
-            TempSection[n_point] = get()[GetCurChIndex()][n_section*(PoN+1)][n_point]-
-                    TempSection[n_point]*ponDirection;
-        std::ostringstream povernLabel;
-        povernLabel << GetTitle() << ", #" << n_section << ", P over N";
-        TempSection.SetSectionDescription(povernLabel.str());
-        try {
-            TempChannel.InsertSection(TempSection,n_section);
-        }
-        catch (const std::out_of_range& e) {
-            wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+    try {
+        Recording DataPoN = stfio::p_over_n(*this, GetCurChIndex(), PoN, ponDirection);
+        for (std::size_t n_section=0; n_section < DataPoN[0].size(); n_section++) {
+            std::ostringstream povernLabel;
+            povernLabel << GetTitle() << ", #" << n_section << ", P over N";
+            DataPoN[0][n_section].SetSectionDescription(povernLabel.str());
         }
-    }
-    if (TempChannel.size()>0) {
-        Recording DataPoN(TempChannel);
-        DataPoN.CopyAttributes(*this);
-
         wxGetApp().NewChild(DataPoN,this,GetTitle()+wxT(", p over n subtracted"));
     }
-
+    catch (const std::exception& e) {
+        wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
+    }
 }
 
 void wxStfDoc::Plotextraction(stf::extraction_mode mode) {
@@ -2164,22 +2158,23 @@ void wxStfDoc::Plotextraction(stf::extraction_mode mode) {
 
         double fmax = *std::max_element(templateWave.begin(), templateWave.end());
         double fmin = *std::min_element(templateWave.begin(), templateWave.end());
-        templateWave = stfio::vec_scal_minus(templateWave, fmax);
         double minim=fabs(fmin);
-        templateWave = stfio::vec_scal_div(templateWave, minim);
+        stfio::TraceOps().minus(fmax).div(minim).apply(templateWave);
         std::string section_description, window_title;
-        Section TempSection(cursec().get().size());
+        // memory-mapped samples are only converted while they are needed:
+        stfio::SharedSamplesPtr trace = cursec().get_shared();
+        Section TempSection(trace->size());
         switch (mode) {
          case stf::criterion: {
              stf::wxProgressInfo progDlg("Computing detection criterion...", "Computing detection criterion...", 100);
-             TempSection = Section(stfnum::detectionCriterion( cursec().get(), templateWave, progDlg));
+             TempSection = Section(stfnum::detectionCriterion( *trace, templateWave, progDlg));
              section_description = "Detection criterion of ";
              window_title = ", detection criterion";
              break;
          }
          case stf::correlation: {
              stf::wxProgressInfo progDlg("Computing linear correlation...", "Computing linear correlation...", 100);
-             TempSection = Section(stfnum::linCorr(cursec().get(), templateWave, progDlg));
+             TempSection = Section(stfnum::linCorr(*trace, templateWave, progDlg));
              section_description = "Template correlation of ";
              window_title = ", linear correlation";
              break;
@@ -2193,7 +2188,7 @@ void wxStfDoc::Plotextraction(stf::extraction_mode mode) {
              if (myDlg.ShowModal()!=wxID_OK) return;
              Vector_double filter = myDlg.readInput();
              stf::wxProgressInfo progDlg("Computing deconvolution...", "Starting deconvolution...", 100);
-             TempSection = Section(stfnum::deconvolve(cursec().get(), templateWave,
+             TempSection = Section(stfnum::deconvolve(*trace, templateWave,
                                                    (int)GetSR(), filter[1], filter[0], progDlg));
              section_description = "Template deconvolution from ";
              window_title = ", deconvolution";
@@ -2255,19 +2250,20 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
         // subtract offset and normalize:
         double fmax = *std::max_element(templateWave.begin(), templateWave.end());
         double fmin = *std::min_element(templateWave.begin(), templateWave.end());
-        templateWave = stfio::vec_scal_minus(templateWave, fmax);
         double minim=fabs(fmin);
-        templateWave = stfio::vec_scal_div(templateWave, minim);
-        Vector_double detect( cursec().get().size() - templateWave.size() );
+        stfio::TraceOps().minus(fmax).div(minim).apply(templateWave);
+        // memory-mapped samples are only converted while they are needed:
+        stfio::SharedSamplesPtr trace = cursec().get_shared();
+        Vector_double detect( trace->size() - templateWave.size() );
         switch (MiniDialog.GetMode()) {
          case stf::criterion: {
              stf::wxProgressInfo progDlg("Computing detection criterion...", "Computing detection criterion...", 100);
-             detect=stfnum::detectionCriterion(cursec().get(), templateWave, progDlg);
+             detect=stfnum::detectionCriterion(*trace, templateWave, progDlg);
              break;
          }
          case stf::correlation: {
              stf::wxProgressInfo progDlg("Computing linear correlation...", "Computing linear correlation...", 100);
-             detect=stfnum::linCorr(cursec().get(), templateWave, progDlg);
+             detect=stfnum::linCorr(*trace, templateWave, progDlg);
              break;
          }
          case stf::deconvolution:
@@ -2279,7 +2275,7 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
              if (myDlg.ShowModal()!=wxID_OK) return;
              Vector_double filter = myDlg.readInput();
              stf::wxProgressInfo progDlg("Computing deconvolution...", "Starting deconvolution...", 100);
-             detect=stfnum::deconvolve(cursec().get(), templateWave, (int)GetSR(), filter[1], filter[0], progDlg);
+             detect=stfnum::deconvolve(*trace, templateWave, (int)GetSR(), filter[1], filter[0], progDlg);
              break;
         }
         if (detect.empty()) {
@@ -2299,35 +2295,36 @@ void wxStfDoc::MarkEvents(wxCommandEvent& WXUNUSED(event)) {
         wxStfView* pView = (wxStfView*)GetFirstView();
         wxStfGraph* pGraph = pView->GetGraph();
 
+        stf::EventList& eventList = sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList;
+        eventList.reserve(startIndices.size());
         for (c_int_it cit = startIndices.begin(); cit != startIndices.end(); ++cit ) {
-            sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.push_back(
-                stf::Event( *cit, 0, templateWave.size(), new wxCheckBox(
-                    pGraph, -1, wxEmptyString) ) );
+            std::size_t nevent = eventList.insert( *cit, 0, templateWave.size() );
             // Find peak in this event:
+            const Section& sec = cursec();
             double baselineMean=0;
             for ( int n_mean = *cit-baseline;
                   n_mean < *cit;
                   ++n_mean )
             {
                 if (n_mean < 0) {
-                    baselineMean += cursec().at(0);
+                    baselineMean += sec.at(0);
                 } else {
-                    baselineMean += cursec().at(n_mean);
+                    baselineMean += sec.at(n_mean);
                 }
             }
             baselineMean /= baseline;
             double peakIndex=0;
             size_t eventl = templateWave.size();
-            if (*cit + eventl >= cursec().get().size()) {
-                eventl = cursec().get().size()-1- (*cit);
+            if (*cit + eventl >= trace->size()) {
+                eventl = trace->size()-1- (*cit);
             }
-            stfnum::peak( cursec().get(), baselineMean, *cit, *cit + eventl,
+            stfnum::peak( *trace, baselineMean, *cit, *cit + eventl,
                           1, stfnum::both, peakIndex );
-            if (peakIndex != peakIndex || peakIndex < 0 || peakIndex >= cursec().get().size()) {
+            if (peakIndex != peakIndex || peakIndex < 0 || peakIndex >= trace->size()) {
                 throw std::runtime_error("Error during peak detection (result is NAN)\n");
             }
             // set peak index of this event:
-            sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.back().SetEventPeakIndex((int)peakIndex);
+            eventList.SetEventPeakIndex(nevent, (int)peakIndex);
         }
 
         if (pGraph != NULL) {
@@ -2354,35 +2351,35 @@ void wxStfDoc::Extract( wxCommandEvent& WXUNUSED(event) ) {
         // template matching), new sections are created:
 
         // count non-discarded events:
+        const stf::EventList& eventList = GetCurrentSectionAttributes().eventList;
         std::size_t n_real = 0;
-        for (c_event_it cit = GetCurrentSectionAttributes().eventList.begin();
-             cit != GetCurrentSectionAttributes().eventList.end(); ++cit) {
-            n_real += (int)(!cit->GetDiscard());
+        for (std::size_t n_event = 0; n_event < eventList.size(); ++n_event) {
+            n_real += (int)(!eventList.GetDiscard(n_event));
         }
         Channel TempChannel2(n_real);
         std::vector<int> peakIndices(n_real);
         n_real = 0;
-        c_event_it lastEventIt = GetCurrentSectionAttributes().eventList.begin();
-        for (c_event_it it = GetCurrentSectionAttributes().eventList.begin();
-             it != GetCurrentSectionAttributes().eventList.end(); ++it) {
-            if (!it->GetDiscard()) {
+        std::size_t lastEvent = 0;
+        for (std::size_t n_event = 0; n_event < eventList.size(); ++n_event) {
+            if (!eventList.GetDiscard(n_event)) {
                 wxString miniName; miniName << wxT( "Event #" ) << (int)n_real+1;
                 events.SetRowLabel(n_real, stf::wx2std(miniName));
-                events.at(n_real,0) = (double)it->GetEventStartIndex() / GetSR();
+                events.at(n_real,0) = (double)eventList.GetEventStartIndex(n_event) / GetSR();
                 events.at(n_real,1)=
-                    ((double)(it->GetEventStartIndex() -
-                            lastEventIt->GetEventStartIndex())) / GetSR();
+                    ((double)(eventList.GetEventStartIndex(n_event) -
+                            eventList.GetEventStartIndex(lastEvent))) / GetSR();
                 // add some baseline at the beginning and end:
-                std::size_t eventSize = it->GetEventSize() + 2*baseline;
+                std::size_t eventSize = eventList.GetEventSize(n_event) + 2*baseline;
                 Section TempSection2( eventSize );
+                const Section& sec = cursec();
                 for ( std::size_t n_new = 0; n_new < eventSize; ++n_new ) {
                     // make sure index is not out of range:
-                    int index = it->GetEventStartIndex() + n_new - baseline;
+                    int index = eventList.GetEventStartIndex(n_event) + n_new - baseline;
                     if (index < 0)
                         index = 0;
-                    if (index >= (int)cursec().size())
-                        index = cursec().size()-1;
-                    TempSection2[n_new] = cursec()[index];
+                    if (index >= (int)sec.size())
+                        index = sec.size()-1;
+                    TempSection2[n_new] = sec[index];
                 }
                 std::ostringstream eventDesc;
                 eventDesc << "Extracted event #" << (int)n_real;
@@ -2390,7 +2387,7 @@ void wxStfDoc::Extract( wxCommandEvent& WXUNUSED(event) ) {
                 TempSection2.SetXScale(get()[GetCurChIndex()][GetCurSecIndex()].GetXScale());
                 TempChannel2.InsertSection( TempSection2, n_real );
                 n_real++;
-                lastEventIt = it;
+                lastEvent = n_event;
             }
         }
         if (TempChannel2.size()>0) {
@@ -2437,42 +2434,33 @@ void wxStfDoc::AddEvent( wxCommandEvent& WXUNUSED(event) ) {
         wxStfView* pView = (wxStfView*)GetFirstView();
         wxStfGraph* pGraph = pView->GetGraph();
         int newStartPos = pGraph->get_eventPos();
-        stf::Event newEvent(newStartPos, 0, GetCurrentSectionAttributes().eventList.at(0).GetEventSize(),
-                            new wxCheckBox(pGraph, -1, wxEmptyString));
+        std::size_t eventSize = GetCurrentSectionAttributes().eventList.GetEventSize(0);
         // Find peak in this event:
+        const Section& sec = cursec();
         double baselineMean=0;
         for ( int n_mean = newStartPos - baseline;
               n_mean < newStartPos;
               ++n_mean )
         {
             if (n_mean < 0) {
-                baselineMean += cursec().at(0);
+                baselineMean += sec.at(0);
             } else {
-                baselineMean += cursec().at(n_mean);
+                baselineMean += sec.at(n_mean);
             }
         }
         baselineMean /= baseline;
-        double peakIndex=0;
-        stfnum::peak( cursec().get(), baselineMean, newStartPos,
-                newStartPos + GetCurrentSectionAttributes().eventList.at(0).GetEventSize(), 1,
-                stfnum::both, peakIndex );
-        // set peak index of last event:
-        newEvent.SetEventPeakIndex( (int)peakIndex );
-        // find the position in the current event list where the new
-        // event should be inserted:
-        bool found = false;
-        for (event_it it = sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.begin();
-             it != sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.end(); ++it) {
-            if ( (int)(it->GetEventStartIndex()) > newStartPos ) {
-                // insert new event before this event, then break:
-                sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.insert( it, newEvent );
-                found = true;
-                break;
-            }
-        }
-        // if we are at the end of the list, append the event:
-        if (!found)
-            sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.push_back( newEvent );
+        double peakIndex=NAN;
+        // only the event is read:
+        if (newStartPos >= 0 && newStartPos + eventSize < sec.size()) {
+            Vector_double event( sec.get_window(newStartPos, eventSize+1) );
+            stfnum::peak( event, baselineMean, 0, eventSize, 1,
+                    stfnum::both, peakIndex );
+            peakIndex += newStartPos;
+        }
+        // the new event is inserted at its position in the event list:
+        sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.insert(
+                newStartPos, (int)peakIndex, eventSize );
+        pGraph->Refresh();
     }
     catch (const std::out_of_range& e) {
         wxGetApp().ExceptMsg(wxString( e.what(), wxConvLocal ));
@@ -2499,7 +2487,7 @@ void wxStfDoc::Threshold(wxCommandEvent& WXUNUSED(event)) {
     threshold=myDlg.readInput();
 
     std::vector<int> startIndices(
-            stfnum::peakIndices( cursec().get(), threshold[0], 0 )
+            stfnum::peakIndices( *cursec().get_shared(), threshold[0], 0 )
     );
     if (startIndices.empty()) {
         wxGetApp().ErrorMsg(
@@ -2507,29 +2495,24 @@ void wxStfDoc::Threshold(wxCommandEvent& WXUNUSED(event)) {
         );
     }
     // clear table from previous detection
-    wxStfView* pView=(wxStfView*)GetFirstView();
-    wxStfGraph* pGraph = pView->GetGraph();
-    sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.clear();
+    stf::EventList& eventList = sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList;
+    eventList.clear();
+    eventList.reserve(startIndices.size());
     for (c_int_it cit = startIndices.begin(); cit != startIndices.end(); ++cit) {
-        sec_attr.at(GetCurChIndex()).at(GetCurSecIndex()).eventList.push_back(
-            stf::Event(*cit, 0, baseline, new wxCheckBox(pGraph, -1, wxEmptyString)));
+        eventList.insert(*cit, 0, baseline);
     }
     // show results in a table:
-    stfnum::Table events(GetCurrentSectionAttributes().eventList.size(),2);
+    stfnum::Table events(eventList.size(),2);
     events.SetColLabel( 0, "Time of event peak");
     events.SetColLabel( 1, "Inter-event interval");
-    std::size_t n_event = 0;
-    c_event_it lastEventCit = GetCurrentSectionAttributes().eventList.begin();
-    for (c_event_it cit2 = GetCurrentSectionAttributes().eventList.begin();
-         cit2 != GetCurrentSectionAttributes().eventList.end(); ++cit2) {
+    for (std::size_t n_event = 0; n_event < eventList.size(); ++n_event) {
+        std::size_t lastEvent = (n_event > 0) ? n_event-1 : 0;
         wxString eventName; eventName << wxT("Event #") << (int)n_event+1;
         events.SetRowLabel(n_event, stf::wx2std(eventName));
-        events.at(n_event,0)= (double)cit2->GetEventStartIndex() / GetSR();
+        events.at(n_event,0)= (double)eventList.GetEventStartIndex(n_event) / GetSR();
         events.at(n_event,1)=
-            ((double)(cit2->GetEventStartIndex() -
-                    lastEventCit->GetEventStartIndex()) ) / GetSR();
-        n_event++;
-        lastEventCit = cit2;
+            ((double)(eventList.GetEventStartIndex(n_event) -
+                    eventList.GetEventStartIndex(lastEvent)) ) / GetSR();
     }
     wxStfChildFrame* pChild=(wxStfChildFrame*)GetDocumentWindow();
     if (pChild!=NULL) {
@@ -2539,40 +2522,50 @@ void wxStfDoc::Threshold(wxCommandEvent& WXUNUSED(event)) {
 
 //Function calculates the peak and respective measures: base, Lo/Hi rise time
 //half duration, ratio of rise/slope and maximum slope
+stfnum::MeasureSpec wxStfDoc::GetMeasureSpec() const {
+    stfnum::MeasureSpec spec;
+    spec.baseBeg=baseBeg;
+    spec.baseEnd=baseEnd;
+    spec.peakBeg=peakBeg;
+    spec.peakEnd=peakEnd;
+    spec.peakAtEnd=peakAtEnd;
+    spec.pM=pM;
+    spec.direction=direction;
+    spec.baselineMethod=baselineMethod;
+    spec.RTFactor=RTFactor;
+    spec.fromBase=fromBase;
+    spec.slopeForThreshold=slopeForThreshold;
+    spec.latencyStartMode=latencyStartMode;
+    spec.latencyEndMode=latencyEndMode;
+    spec.latencyBeg=latencyStartCursor;
+    spec.latencyEnd=latencyEndCursor;
+#ifdef WITH_PSLOPE
+    spec.pslopeBegMode=pslopeBegMode;
+    spec.pslopeEndMode=pslopeEndMode;
+    spec.PSlopeBeg=PSlopeBeg;
+    spec.PSlopeEnd=PSlopeEnd;
+    spec.DeltaT=DeltaT;
+#endif
+    return spec;
+}
+
 void wxStfDoc::Measure( )
 {
-    double var=0.0;
-    if (cursec().get().size() == 0) return;
-    try {
-        cursec().at(0);
-    }
-    catch (const std::out_of_range&) {
-        return;
-    }
-
-    long windowLength = 1;
-    /*
-       windowLength (defined in samples) determines the size of the window for computing slopes.
-       if the window length larger than 1 is used, a kind of smoothing and low pass filtering is applied.
-       If slope estimates from data with different sampling rates should be compared, the
-       window should be choosen in such a way that the length in milliseconds is approximately the same.
-       This reduces some variability, the slope estimates are more robust and comparible.
-
-       Set window length to 0.05 ms, with a minimum of 1 sample. In this way, all data
-       sampled with 20 kHz or lower, will use a 1 sample window, data with a larger sampling rate
-       use a window of 0.05 ms for computing the slope.
-    */
-    windowLength = lround(0.05 * GetSR());    // use window length of about 0.05 ms.
-    if (windowLength < 1) windowLength = 1;   // use a minimum window length of 1 sample
-
+    if (cursec().size() == 0) return;
 
-    //Begin peak and base calculation
-    //-------------------------------
+    // The measurement itself doesn't depend on the document, see stfnum::measure():
+    stfnum::MeasureSpec spec = GetMeasureSpec();
+    // The peak window is only moved to the end of the trace when a section is selected:
+    spec.peakAtEnd=false;
+    stfnum::MeasureResult res;
     try {
-        base=stfnum::base(baselineMethod,var,cursec().get(),baseBeg,baseEnd);
-        baseSD=sqrt(var);
-        peak=stfnum::peak(cursec().get(),base,
-                       peakBeg,peakEnd,pM,direction,maxT);
+        // memory-mapped samples are only converted while they are measured:
+        stfio::SharedSamplesPtr samples = cursec().get_shared();
+        stfio::SharedSamplesPtr refsamples;
+        if (size()>1) {
+            refsamples = secsec().get_shared();
+        }
+        res=stfnum::measure(*samples, GetXScale(), spec, refsamples.get());
     }
     catch (const std::out_of_range& e) {
         base=0.0;
@@ -2580,259 +2573,60 @@ void wxStfDoc::Measure( )
         peak=0.0;
         throw e;
     }
-    try {
-        threshold = stfnum::threshold( cursec().get(), peakBeg, peakEnd, slopeForThreshold/GetSR(), thrT, windowLength );
-    } catch (const std::out_of_range& e) {
-        threshold = 0;
-        throw e;
-    }
-    //Begin Lo to Hi% Rise Time calculation
-    //-------------------------------------
-    // 2009-06-05: reference is either from baseline or from threshold
-    double reference = base;
-    if (!fromBase && thrT >= 0) {
-        reference = threshold;
-    }
-    double ampl=peak-reference;
-    
-    tLoReal=0.0;
-    double factor= RTFactor*0.01; /* normalized value */
-    InnerLoRT=NAN;
-    InnerHiRT=NAN;
-    OuterLoRT=NAN;
-    OuterHiRT=NAN;
-
-    try {
-        // 2008-04-27: changed limits to start from the beginning of the trace
-        // 2013-06-16: changed to accept different rise-time proportions
-        rtLoHi=stfnum::risetime2(cursec().get(),reference,ampl, (double)0/*(double)baseEnd*/,
-                             maxT, factor/*0.2*/, InnerLoRT, InnerHiRT, OuterLoRT, OuterHiRT);
-        InnerLoRT/=GetSR();
-        InnerHiRT/=GetSR();
-        OuterLoRT/=GetSR();
-        OuterHiRT/=GetSR();
-    }
-    catch (const std::out_of_range& e) {
-        throw e;
-    }
-
-
-    try {
-        // 2008-04-27: changed limits to start from the beginning of the trace
-        // 2013-06-16: changed to accept different rise-time proportions 
-        rtLoHi=stfnum::risetime(cursec().get(),reference,ampl, (double)0/*(double)baseEnd*/,
-                             maxT, factor/*0.2*/, tLoIndex, tHiIndex, tLoReal);
-    }
-    catch (const std::out_of_range& e) {
-        rtLoHi=0.0;
-        throw e;
-    }
-
-    tHiReal=tLoReal+rtLoHi;
-    rtLoHi/=GetSR();
-
-    //Begin Half Duration calculation
-    //-------------------------------
-    //t50LeftReal=0.0;
-    // 2008-04-27: changed limits to start from the beginning of the trace
-    //             and to stop at the end of the trace
-    halfDuration = stfnum::t_half(cursec().get(), reference, ampl, (double)0 /*(double)baseBeg*/,
-            (double)cursec().size()-1 /*(double)peakEnd*/,maxT, t50LeftIndex, t50RightIndex, t50LeftReal);
-
-    t50RightReal=t50LeftReal+halfDuration;
-    halfDuration/=GetSR();
-    t50Y=0.5*ampl + reference;
-
-    //Calculate the beginning of the event by linear extrapolation:
-    if (latencyEndMode==stf::footMode) {
-        t0Real=tLoReal-(tHiReal-tLoReal)/3.0; // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
-    } else {
-        t0Real=t50LeftReal;
-    }
-
-    //Begin Ratio of slopes rise/decay calculation
-    //--------------------------------------------
-    double left_rise = peakBeg;
-    maxRise=stfnum::maxRise(cursec().get(),left_rise,maxT,maxRiseT,maxRiseY,windowLength);
-    double t_half_3=t50RightIndex+2.0*(t50RightIndex-t50LeftIndex);
-    double right_decay=peakEnd<=t_half_3 ? peakEnd : t_half_3+1;
-    maxDecay=stfnum::maxDecay(cursec().get(),maxT,right_decay,maxDecayT,maxDecayY,windowLength);
-
-    //Slope ratio
-    if (maxDecay !=0) slopeRatio=maxRise/maxDecay;
-    else slopeRatio=0.0;
-    maxRise *= GetSR();
-    maxDecay *= GetSR();
 
+    base=res.base;
+    baseSD=res.baseSD;
+    threshold=res.threshold;
+    thrT=res.thrT;
+    peak=res.peak;
+    maxT=res.maxT;
+    rtLoHi=res.rtLoHi;
+    tLoReal=res.tLoReal;
+    tHiReal=res.tHiReal;
+    tLoIndex=res.tLoIndex;
+    tHiIndex=res.tHiIndex;
+    InnerLoRT=res.InnerLoRT;
+    InnerHiRT=res.InnerHiRT;
+    OuterLoRT=res.OuterLoRT;
+    OuterHiRT=res.OuterHiRT;
+    halfDuration=res.halfDuration;
+    t50LeftReal=res.t50LeftReal;
+    t50RightReal=res.t50RightReal;
+    t50LeftIndex=res.t50LeftIndex;
+    t50RightIndex=res.t50RightIndex;
+    t50Y=res.t50Y;
+    t0Real=res.t0Real;
+    maxRise=res.maxRise;
+    maxRiseT=res.maxRiseT;
+    maxRiseY=res.maxRiseY;
+    maxDecay=res.maxDecay;
+    maxDecayT=res.maxDecayT;
+    maxDecayY=res.maxDecayY;
+    slopeRatio=res.slopeRatio;
     if (size()>1) {
-        //Calculate the absolute peak of the (AP) Ch2 inbetween the peak boundaries
-        //A direction dependent evaluation of the peak as in Ch1 does NOT exist!!
-
-        // endResting is set to 100 points arbitrarily in the pascal version
-        // (see measlib.pas) assuming that the resting potential is stable
-        // during the first 100 sampling points.
-        // const int endResting=100;
-        const int searchRange=100;
-        double APBase=0.0, APVar=0.0;
-        try {
-            // in 2012-11-02: use baseline cursors and not arbitrarily 100 points
-            //APBase=stfnum::base(APVar,secsec().get(),0,endResting);
-            APBase=stfnum::base(baselineMethod,APVar,secsec().get(), baseBeg, baseEnd ); // use baseline cursors
-            //APPeak=stfnum::peak(secsec().get(),APBase,peakBeg,peakEnd,pM,stfnum::up,APMaxT);
-            APPeak=stfnum::peak( secsec().get(),APBase ,peakBeg ,peakEnd ,pM,direction ,APMaxT );
-        }
-        catch (const std::out_of_range& e) {
-            APBase=0.0;
-            APPeak=0.0;
-            throw e;
-        }
-        //-------------------------------
-        //Maximal slope in the rise before the peak
-        //----------------------------
-        APMaxRiseT=0.0;
-        APMaxRiseY=0.0;
-        double left_APRise = peakBeg; 
-        //if (GetLatencyWindowMode() == stf::defaultMode ) {
-        left_APRise= APMaxT-searchRange>2.0 ? APMaxT-searchRange : 2.0;
-        try {
-            stfnum::maxRise(secsec().get(),left_APRise,APMaxT,APMaxRiseT,APMaxRiseY,windowLength);
-        }
-        catch (const std::out_of_range&) {
-            APMaxRiseT=0.0;
-            APMaxRiseY=0.0;
-            left_APRise = peakBeg; 
-        }
-
-        //End determination of the region of maximal slope in the second channel
-        //----------------------------
-
-        //-------------------------------
-        //Half-maximal amplitude
-        //----------------------------
-        //APt50LeftReal=0.0;
-        //std::size_t APt50LeftIndex,APt50RightIndex;
-        stfnum::t_half(secsec().get(), APBase, APPeak-APBase, left_APRise,
-                      (double)secsec().get().size(), APMaxT, APt50LeftIndex,
-                      APt50RightIndex, APt50LeftReal);
-        //End determination of the region of maximal slope in the second channel
-        //----------------------------
-
-        // Get onset in 2nd channel
-        APrtLoHi=stfnum::risetime(secsec().get(), APBase, APPeak-APBase, (double)0,
-                                  APMaxT, 0.2, APtLoIndex, APtHiIndex, APtLoReal);
-        APtHiReal = APtLoReal + APrtLoHi;
-        APt0Real = APtLoReal-(APtHiReal-APtLoReal)/3.0;  // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
-    }
-
-    // get and set start of latency measurement:
-    double latStart=0.0;
-    switch (latencyStartMode) {
-    // Interestingly, latencyCursor is an int in pascal, although
-    // the maxTs aren't. That's why there are double type casts
-    // here.
-    case stf::peakMode: //Latency cursor is set to the peak						
-        latStart=APMaxT;
-        break;
-    case stf::riseMode:
-        latStart=APMaxRiseT;
-        break;
-    case stf::halfMode:
-        latStart=APt50LeftReal;
-        break;
-    case stf::manualMode:
-    default:
-        latStart=GetLatencyBeg();
-        break;
-    }
-    SetLatencyBeg(latStart);
-
-    APt0Real = tLoReal-(tHiReal-tLoReal)/3.0;  // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
-    // get and set end of latency measurement:
-    double latEnd=0.0;
-    switch (latencyEndMode) {
-    // Interestingly, latencyCursor is an int in pascal, although
-    // the maxTs aren't. That's why there are double type casts
-    // here.
-    case stf::footMode:
-        latEnd=tLoReal-(tHiReal-tLoReal)/3.0; // using 20-80% rise time (f/(1-2f) = 0.2/(1-0.4) = 1/3.0)
-        break;
-    case stf::riseMode:
-        latEnd=maxRiseT;
-        break;
-    case stf::halfMode:
-        latEnd=t50LeftReal;
-        break;
-    case stf::peakMode:
-        latEnd=maxT;
-        break;
-    case stf::manualMode:
-    default:
-        latEnd=GetLatencyEnd();
-        break;
-    }
-    SetLatencyEnd(latEnd);
-
-    SetLatency(GetLatencyEnd()-GetLatencyBeg());
-
+        APBase=res.APBase;
+        APPeak=res.APPeak;
+        APMaxT=res.APMaxT;
+        APMaxRiseT=res.APMaxRiseT;
+        APMaxRiseY=res.APMaxRiseY;
+        APt50LeftReal=res.APt50LeftReal;
+        APt50LeftIndex=res.APt50LeftIndex;
+        APt50RightIndex=res.APt50RightIndex;
+        APrtLoHi=res.APrtLoHi;
+        APtLoReal=res.APtLoReal;
+        APtHiReal=res.APtHiReal;
+        APtLoIndex=res.APtLoIndex;
+        APtHiIndex=res.APtHiIndex;
+    }
+    APt0Real=res.APt0Real;
+    latencyStartCursor=res.latencyBeg;
+    latencyEndCursor=res.latencyEnd;
+    latency=res.latency;
 #ifdef WITH_PSLOPE
-    //-------------------------------------
-    // Begin PSlope calculation (PSP Slope)
-    //-------------------------------------
-
-    //
-    int PSlopeBegVal; 
-    switch (pslopeBegMode) {
-
-        case stf::psBeg_footMode:   // Left PSlope to commencement
-            PSlopeBegVal = (int)(tLoReal-(tHiReal-tLoReal)/3.0);
-            break;
-
-        case stf::psBeg_thrMode:   // Left PSlope to threshold
-            PSlopeBegVal = (int)thrT;
-            break;
-
-        case stf::psBeg_t50Mode:   // Left PSlope to the t50
-            PSlopeBegVal = (int)t50LeftReal;
-            break;
-
-        case stf::psBeg_manualMode: // Left PSlope cursor manual
-        default:
-            PSlopeBegVal = PSlopeBeg;
-    }
-    SetPSlopeBeg(PSlopeBegVal);
-    
-    int PSlopeEndVal;
-    switch (pslopeEndMode) {
-
-        case stf::psEnd_t50Mode:    // Right PSlope to t50rigth
-            PSlopeEndVal = (int)t50LeftReal;
-            break;
-        case stf::psEnd_peakMode:   // Right PSlope to peak
-            PSlopeEndVal = (int)maxT;
-            break;
-        case stf::psEnd_DeltaTMode: // Right PSlope to DeltaT time from first peak
-            PSlopeEndVal = (int)(PSlopeBeg + DeltaT);
-            break;
-        case stf::psEnd_manualMode:
-        default:
-            PSlopeEndVal = PSlopeEnd;
-    }
-    SetPSlopeEnd(PSlopeEndVal);
-
-    try {
-        PSlope = (stfnum::pslope(cursec().get(), PSlopeBeg, PSlopeEnd))*GetSR();
-    }
-    catch (const std::out_of_range& e) {
-        PSlope = 0.0;
-        throw e;
-    }
-
-    //-----------------------------------
-    // End PSlope calculation (PSP Slope)
-    //-----------------------------------
-
+    PSlopeBeg=res.PSlopeBeg;
+    PSlopeEnd=res.PSlopeEnd;
+    PSlope=res.PSlope;
 #endif // WITH_PSLOPE
-    //--------------------------
 
 }	//End of Measure(,,,,,)
 
@@ -2940,7 +2734,8 @@ double wxStfDoc::GetMeasValue() {
     if (measCursor>=curch().size()) {
         correctRangeR(measCursor);
     }
-    return cursec().at(measCursor);
+    const Section& sec = cursec();
+    return sec.at(measCursor);
 }
 
 void wxStfDoc::SetBaseBeg(int value) {
@@ -3264,6 +3059,15 @@ void wxStfDoc::InsertChannel(Channel& c_Channel, std::size_t pos) {
     }
 }
 
+void wxStfDoc::InsertChannel(Channel&& c_Channel, std::size_t pos) {
+    Recording::InsertChannel(std::move(c_Channel), pos);
+    yzoom.resize(size());
+    sec_attr.resize(size());
+    for (std::size_t nchannel = 0; nchannel < size(); ++nchannel) {
+        sec_attr[nchannel].resize(at(nchannel).size());
+    }
+}
+
 void wxStfDoc::SetIsFitted( std::size_t nchannel, std::size_t nsection,
                             const Vector_double& bestFitP_, stfnum::storedFunc* fitFunc_,
                             double chisqr, std::size_t fitBeg, std::size_t fitEnd )
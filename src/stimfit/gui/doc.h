@@ -26,6 +26,7 @@
  */
 
 #include "./../stf.h"
+#include "./../../libstfnum/measure.h"
 
 //! The document class, derived from both wxDocument and Recording.
 /*! The document class can be used to model an application’s file-based data.
@@ -246,8 +247,10 @@ public:
     /*! \param calcSD Set to true if the standard deviation should be calculated as well, false otherwise
      *  \param align Set to true if traces should be aligned to the point of steepest rise of the reference channel,
      *         false otherwise.
+     *  \param method The kind of average. stfio::average_weighted weights every trace by the
+     *         inverse variance of its baseline in the active channel.
      */
-    void CreateAverage( bool calcSD, bool align );
+    void CreateAverage( bool calcSD, bool align, stfio::average_method method = stfio::average_mean );
 
 #if 0
     //! Applies a user-defined function to the current data set
@@ -301,7 +304,12 @@ public:
      *  and the latency.
      */
     void Measure();
-    
+
+    //! The current cursor settings, to be used with stfnum::measure().
+    /*! \return The cursor settings.
+     */
+    stfnum::MeasureSpec GetMeasureSpec() const;
+
     //! Put the current measurement results into a text table.
     stfnum::Table CurResultsTable();
 
@@ -1010,6 +1018,13 @@ public:
      */
     virtual void InsertChannel(Channel& c_Channel, std::size_t pos);
 
+    //! Move a Channel to a given position.
+    /*! Will throw std::out_of_range if range check fails.
+     *  \param c_Channel The Channel to be inserted. Its contents are unspecified on return.
+     *  \param pos The position at which to insert the channel (0-based).
+     */
+    virtual void InsertChannel(Channel&& c_Channel, std::size_t pos);
+
     const stf::SectionAttributes& GetSectionAttributes(std::size_t nchannel, std::size_t nsection) const;
     const stf::SectionAttributes& GetCurrentSectionAttributes() const;
     stf::SectionAttributes& GetCurrentSectionAttributesW();
@@ -1040,7 +1055,6 @@ public:
 
     void correctRangeR(int& value);
     void correctRangeR(std::size_t& value);
-    bool LoadTDMS(const std::string& filename, Recording& ReturnData);
     
     DECLARE_EVENT_TABLE()
 };
@@ -28,6 +28,8 @@
 #include <wx/printdlg.h>
 #include <wx/paper.h>
 
+#include <algorithm>
+
 #include "./app.h"
 #include "./doc.h"
 #include "./view.h"
@@ -90,6 +92,7 @@ EVT_MENU(ID_ZOOMH,wxStfGraph::OnZoomH)
 EVT_MENU(ID_ZOOMV,wxStfGraph::OnZoomV)
 EVT_MOUSE_EVENTS(wxStfGraph::OnMouseEvent)
 EVT_KEY_DOWN( wxStfGraph::OnKeyDown )
+EVT_CHECKBOX( wxID_ANY, wxStfGraph::OnEventCheckBox )
 #if defined __WXMAC__ && !(wxCHECK_VERSION(2, 9, 0))
 EVT_PAINT( wxStfGraph::OnPaint )
 #endif
@@ -271,11 +274,11 @@ void wxStfGraph::OnDraw( wxDC& DC )
             //Draw current trace on display
             //For display use point to point drawing
             DC.SetPen(standardPen2);
-            PlotTrace(&DC,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get(), reference);
+            PlotTrace(&DC,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()], reference);
         } else {	//Draw second channel for print out
             //For print out use polyline tool
             DC.SetPen(standardPrintPen2);
-            PrintTrace(&DC,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get(), reference);
+            PrintTrace(&DC,*Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get_shared(), reference);
         }	// End display or print out
     }		//End plot of the second channel
 
@@ -285,7 +288,7 @@ void wxStfGraph::OnDraw( wxDC& DC )
                 //Draw current trace on display
                 //For display use point to point drawing
                 DC.SetPen(standardPen3);
-                PlotTrace(&DC,Doc()->get()[n][Doc()->GetCurSecIndex()].get(), background, n);
+                PlotTrace(&DC,Doc()->get()[n][Doc()->GetCurSecIndex()], background, n);
             }
         }
     }		//End plot of the second channel
@@ -296,11 +299,11 @@ void wxStfGraph::OnDraw( wxDC& DC )
 	//Draw current trace on display
         //For display use point to point drawing
         DC.SetPen(standardPen);
-        PlotTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()].get());
+        PlotTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()]);
     } else {
         //For print out use polyline tool
         DC.SetPen(standardPrintPen);
-        PrintTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()].get());
+        PrintTrace(&DC,*Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetCurSecIndex()].get_shared());
     }	// End display or print out
     //End plot of the current trace
 
@@ -374,7 +377,7 @@ void wxStfGraph::PlotSelected(wxDC& DC) {
             //For display use point to point drawing
             PlotTrace(
                       &DC,
-                      Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]].get()
+                      Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]]
                       );
         }
     }  //End draw traces on display
@@ -383,7 +386,7 @@ void wxStfGraph::PlotSelected(wxDC& DC) {
         DC.SetPen(selectPrintPen);
         for (unsigned m=0; m < Doc()->GetSelectedSections().size() && Doc()->GetSelectedSections().size()>0; ++m)
         {
-            PrintTrace(&DC,Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]].get());
+            PrintTrace(&DC,*Doc()->get()[Doc()->GetCurChIndex()][Doc()->GetSelectedSections()[m]].get_shared());
         }	//End draw for print out
     }	//End if display or print out
 }
@@ -394,13 +397,13 @@ void wxStfGraph::PlotAverage(wxDC& DC) {
     {	//Draw Average on display
         //For display use point to point drawing
         DC.SetPen(averagePen);
-        PlotTrace(&DC,Doc()->GetAverage()[0][0].get());
+        PlotTrace(&DC,Doc()->GetAverage()[0][0]);
     }	//End draw Average on display
     else
     {	//Draw average for print out
         //For print out use polyline tool
         DC.SetPen(averagePrintPen);
-        PrintTrace(&DC,Doc()->GetAverage()[0][0].get());
+        PrintTrace(&DC,*Doc()->GetAverage()[0][0].get_shared());
     }	//End draw average for print out
 }
 
@@ -497,7 +500,7 @@ void wxStfGraph::PlotGimmicks(wxDC& DC) {
     DrawCircle(&DC,Doc()->GetMaxDecayT(),Doc()->GetMaxDecayY(), rdPen, rdPrintPen);
     
     try {
-        stf::SectionAttributes sec_attr = Doc()->GetCurrentSectionAttributes();
+        const stf::SectionAttributes& sec_attr = Doc()->GetCurrentSectionAttributes();
         if (!sec_attr.eventList.empty()) {
             PlotEvents(DC);
         }
@@ -517,22 +520,40 @@ void wxStfGraph::PlotGimmicks(wxDC& DC) {
 }
 
 void wxStfGraph::PlotEvents(wxDC& DC) {
-    const int MAX_EVENTS_PLOT = 200;
+    const std::size_t MAX_EVENTS_PLOT = 200;
 
-    stf::SectionAttributes sec_attr;
+    const stf::EventList* events = NULL;
     try {
-        sec_attr = Doc()->GetCurrentSectionAttributes();
+        events = &Doc()->GetCurrentSectionAttributes().eventList;
     }
     catch (const std::out_of_range& e) {
         return;
     }
+    // read-only access keeps the envelope of the section:
+    const Section& cursec = Doc()->cursec();
+    wxRect WindowRect=GetRect();
+    if (isPrinted) WindowRect=wxRect(printRect);
+    int right=WindowRect.width;
+    if (XZ() <= 0) {
+        return;
+    }
+
+    // Only events that start on the screen, or whose peak may be on the
+    // screen, are drawn:
+    double leftIndex = -(double)SPX()/XZ();
+    std::size_t first = 0;
+    if (leftIndex > (double)events->GetMaxEventSize()) {
+        first = events->LowerBound((std::size_t)leftIndex - events->GetMaxEventSize());
+    }
     DC.SetPen(eventPen);
-    for (c_event_it it = sec_attr.eventList.begin(); it != sec_attr.eventList.end(); ++it) {
+    std::size_t last = first;
+    for (; last < events->size() && xFormat(events->GetEventStartIndex(last)) < right; ++last) {
         // Create small arrows indicating the start of an event:
-        eventArrow(&DC, (int)it->GetEventStartIndex());
+        eventArrow(&DC, (int)events->GetEventStartIndex(last));
         // Create circles indicating the peak of an event:
         try {
-            DrawCircle( &DC, it->GetEventPeakIndex(), Doc()->cursec().at(it->GetEventPeakIndex()), eventPen, eventPen );
+            DrawCircle( &DC, events->GetEventPeakIndex(last), cursec.at(events->GetEventPeakIndex(last)),
+                        eventPen, eventPen );
         }
         catch (const std::out_of_range& e) {
             wxGetApp().ExceptMsg( wxString( e.what(), wxConvLocal ) );
@@ -540,31 +561,31 @@ void wxStfGraph::PlotEvents(wxDC& DC) {
         }
     }
 
-    // Only draw check boxes if there are less than 1000 events (takes too long
-    // to draw them and it's impossible to check them anyway)
-    wxRect WindowRect=GetRect();
-    if (isPrinted) WindowRect=wxRect(printRect);
-    int right=WindowRect.width;
-    int nevents_plot = 0;
-    for (event_it it2 = sec_attr.eventList.begin(); it2 != sec_attr.eventList.end(); ++it2) {
-        nevents_plot += (xFormat(it2->GetEventStartIndex()) < right &&
-                         xFormat(it2->GetEventStartIndex()) > 0);
-    }
-
-    if (nevents_plot < MAX_EVENTS_PLOT) {
-        for (event_it it2 = sec_attr.eventList.begin(); it2 != sec_attr.eventList.end(); ++it2) {
-            if (xFormat(it2->GetEventStartIndex()) < right &&
-                xFormat(it2->GetEventStartIndex()) > 0)
-            {
-                it2->GetCheckBox()->Move(wxPoint(xFormat(it2->GetEventStartIndex()), 0));
-                it2->GetCheckBox()->Show(true);
-            } else {
-                it2->GetCheckBox()->Show(false);
-            }
+    // Only show check boxes if there are less than MAX_EVENTS_PLOT events on the
+    // screen (it's impossible to check them anyway). The check boxes are taken
+    // from a pool instead of being created for every event:
+    std::vector<std::size_t> visible;
+    for (std::size_t n_event = first; n_event < last && visible.size() < MAX_EVENTS_PLOT; ++n_event) {
+        if (xFormat(events->GetEventStartIndex(n_event)) > 0) {
+            visible.push_back(n_event);
         }
-    } else {
-        for (event_it it2 = sec_attr.eventList.begin(); it2 != sec_attr.eventList.end(); ++it2) {
-            it2->GetCheckBox()->Show(false);
+    }
+    if (visible.size() >= MAX_EVENTS_PLOT) {
+        visible.clear();
+    }
+    while (eventCheckBoxes.size() < visible.size()) {
+        eventCheckBoxes.push_back(new wxCheckBox(this, wxID_ANY, wxEmptyString));
+        eventCheckBoxStarts.push_back(0);
+    }
+    for (std::size_t n_cb = 0; n_cb < eventCheckBoxes.size(); ++n_cb) {
+        if (n_cb < visible.size()) {
+            std::size_t start = events->GetEventStartIndex(visible[n_cb]);
+            eventCheckBoxStarts[n_cb] = start;
+            eventCheckBoxes[n_cb]->SetValue(!events->GetDiscard(visible[n_cb]));
+            eventCheckBoxes[n_cb]->Move(wxPoint(xFormat(start), 0));
+            eventCheckBoxes[n_cb]->Show(true);
+        } else {
+            eventCheckBoxes[n_cb]->Show(false);
         }
     }
 
@@ -572,16 +593,30 @@ void wxStfGraph::PlotEvents(wxDC& DC) {
     SetFocus();
 }
 
-void wxStfGraph::ClearEvents() {
-    stf::SectionAttributes sec_attr;
+void wxStfGraph::OnEventCheckBox(wxCommandEvent& event) {
+    std::vector<wxCheckBox*>::const_iterator it =
+        std::find(eventCheckBoxes.begin(), eventCheckBoxes.end(), event.GetEventObject());
+    if (it == eventCheckBoxes.end()) {
+        event.Skip();
+        return;
+    }
+    // the check box belongs to the event that starts at this position:
+    std::size_t start = eventCheckBoxStarts[it - eventCheckBoxes.begin()];
     try {
-        sec_attr = Doc()->GetCurrentSectionAttributes();
+        stf::EventList& events = Doc()->GetCurrentSectionAttributesW().eventList;
+        std::size_t n_event = events.LowerBound(start);
+        if (n_event < events.size() && events.GetEventStartIndex(n_event) == start) {
+            events.SetDiscard(n_event, !event.IsChecked());
+        }
     }
     catch (const std::out_of_range& e) {
-        return;
+        /* Do nothing for now */
     }
-    for (event_it it2 = sec_attr.eventList.begin(); it2 != sec_attr.eventList.end(); ++it2) {
-        it2->GetCheckBox()->Destroy();
+}
+
+void wxStfGraph::ClearEvents() {
+    for (std::size_t n_cb = 0; n_cb < eventCheckBoxes.size(); ++n_cb) {
+        eventCheckBoxes[n_cb]->Show(false);
     }
 }
 
@@ -659,7 +694,7 @@ double wxStfGraph::get_plot_y2max() const {
     return SPY2()/YZ2();
 }
 
-void wxStfGraph::PlotTrace( wxDC* pDC, const Vector_double& trace, plottype pt, int bgno ) {
+void wxStfGraph::PlotTrace( wxDC* pDC, const Section& trace, plottype pt, int bgno ) {
     // speed up drawing by omitting points that are outside the window:
 
     // find point before left window border:
@@ -683,7 +718,7 @@ void wxStfGraph::PlotTrace( wxDC* pDC, const Vector_double& trace, plottype pt,
     DoPlot(pDC, trace, start, end, 1, pt, bgno);
 }
 
-void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int end, int step, plottype pt, int bgno) {
+void wxStfGraph::DoPlot( wxDC* pDC, const Section& trace, int start, int end, int step, plottype pt, int bgno) {
 #if (__cplusplus < 201103)
     boost::function<int(double)> yFormatFunc;
 #else
@@ -698,12 +733,11 @@ void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int e
          yFormatFunc = std::bind( std::mem_fn(&wxStfGraph::yFormatD2), this, std::placeholders::_1);
          break;
      case background:
-         Vector_double::const_iterator max_el = std::max_element(trace.begin(), trace.end());
-         Vector_double::const_iterator min_el = std::min_element(trace.begin(), trace.end());
-         double min = *min_el;
+         // look up the extrema in the envelope of the section:
+         double min = 0, max = 0;
+         trace.minmax(0, trace.size(), min, max);
          if (min>1.0e12)  min= 1.0e12;
          if (min<-1.0e12) min=-1.0e12;
-         double max = *max_el;
          if (max>1.0e12)  max= 1.0e12;
          if (max<-1.0e12) max=-1.0e12;
          wxRect WindowRect=GetRect();
@@ -744,29 +778,29 @@ void wxStfGraph::DoPlot( wxDC* pDC, const Vector_double& trace, int start, int e
 #else
     } else {
 #endif
-    double y_max = trace[start];
-    double y_min = trace[start];
-    for (int n=start; n<end-1; ++n) {
-        x_next = xFormat(n+1);
-        // if we are still in the same pixel column, find extrema:
-        if (x_next == x_last) {
-            if (trace[n+1] < y_min) {
-                y_min = trace[n+1];
-            }
-            if (trace[n+1] > y_max) {
-                y_max = trace[n+1];
-            }
-        } else {
-            // plot line between extrema of previous column:
-            pDC->DrawLine( x_last, yFormatFunc(y_min), x_last, yFormatFunc(y_max) );
-
-            // plot line between last point of previous and first point of this column:
-            pDC->DrawLine( x_last, yFormatFunc(trace[n]), x_next, yFormatFunc(trace[n+1]) );
-
-            y_min = trace[n+1];
-            y_max = trace[n+1];
-            x_last = x_next;
+    // one vertical line per pixel column between the extrema of the points
+    // that fall into it; the extrema are looked up in the envelope of the
+    // section, so that this takes O(pixels) rather than O(points):
+    for (long n=start; n<end; ) {
+        x_next = xFormat(n);
+        // find the first point of the next column:
+        long n_next = (long)ceil((x_next+1-SPX())/XZ());
+        if (n_next <= n) n_next = n+1;
+        if (n_next > end) n_next = end;
+        while (n_next > n+1 && xFormat(n_next-1) > x_next) --n_next;
+        while (n_next < end && xFormat(n_next) <= x_next) ++n_next;
+
+        double y_min = 0, y_max = 0;
+        trace.minmax(n, n_next, y_min, y_max);
+        // plot line between last point of previous and first point of this column:
+        if (n > start) {
+            pDC->DrawLine( x_last, yFormatFunc(trace[n-1]), x_next, yFormatFunc(trace[n]) );
         }
+        // plot line between extrema of this column:
+        pDC->DrawLine( x_next, yFormatFunc(y_min), x_next, yFormatFunc(y_max) );
+
+        x_last = x_next;
+        n = n_next;
     }
 #ifdef BENCHMARK //def _STFDEBUG
     current_utc_time(&time1);
@@ -1059,10 +1093,11 @@ void wxStfGraph::DrawIntegral(wxDC* pDC) {
     // add trapezoidal integration part if uneven:
     if (!even) {
     // draw a straight line:
+        const Section& sec = Doc()->cursec();
         quadTrace.push_back(
             wxPoint(
                     xFormat(sec_attr.storeIntEnd),
-                    yFormat(Doc()->cursec()[sec_attr.storeIntEnd])
+                    yFormat(sec[sec_attr.storeIntEnd])
                     ));
     }
     quadTrace.push_back(
@@ -2011,17 +2046,11 @@ void wxStfGraph::Fittowindow(bool refresh)
         wxGetApp().ErrorMsg(wxT("Array of size zero in wxGraph::Fittowindow()"));
         return;
     }
-#if (__cplusplus < 201103)
-    Vector_double::const_iterator max_el = std::max_element(Doc()->cursec().get().begin(), Doc()->cursec().get().end());
-    Vector_double::const_iterator min_el = std::min_element(Doc()->cursec().get().begin(), Doc()->cursec().get().end());
-#else
-    Vector_double::const_iterator max_el = std::max(Doc()->cursec().get().begin(), Doc()->cursec().get().end());
-    Vector_double::const_iterator min_el = std::min(Doc()->cursec().get().begin(), Doc()->cursec().get().end());
-#endif
-    double min = *min_el;
+    const Section& sec = Doc()->cursec();
+    double min = 0, max = 0;
+    sec.minmax(0, points, min, max);
     if (min>1.0e12)  min= 1.0e12;
     if (min<-1.0e12) min=-1.0e12;
-    double max = *max_el;
     if (max>1.0e12)  max= 1.0e12;
     if (max<-1.0e12) max=-1.0e12;
     wxRect WindowRect(GetRect());
@@ -2070,31 +2099,20 @@ void wxStfGraph::FitToWindowSecCh(bool refresh)
         std::size_t secCh=Doc()->GetSecChIndex();
     #undef min
     #undef max
-#if (__cplusplus < 201103)
-        Vector_double::const_iterator max_el = std::max_element(Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().begin(),
-                                                                Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().end());
-        Vector_double::const_iterator min_el = std::min_element(Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().begin(),
-                                                                Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().end());
-#else
-        Vector_double::const_iterator max_el = std::max(Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().begin(),
-                                                               Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().end());
-        Vector_double::const_iterator min_el = std::min(Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().begin(),
-                                                                Doc()->get()[secCh][Doc()->GetCurSecIndex()].get().end());
-#endif
-
-        double min=*min_el;
-        double max=*max_el;
+        const Section& sec = Doc()->get()[secCh][Doc()->GetCurSecIndex()];
+        if (sec.size()==0) {
+            return;
+        }
+        double min=0, max=0;
+        sec.minmax(0, sec.size(), min, max);
         FittorectY(Doc()->GetYZoomW(Doc()->GetSecChIndex()), WindowRect, min, max, screen_part);
         if (refresh) Refresh();
     }
 }	//End FitToWindowSecCh()
 
 void wxStfGraph::ChangeTrace(std::size_t trace) {
-    stf::SectionAttributes sec_attr = Doc()->GetCurrentSectionAttributes();
-    if (!sec_attr.eventList.empty() && trace != Doc()->GetCurSecIndex()) {
-        for (event_it it2 = sec_attr.eventList.begin(); it2 != sec_attr.eventList.end(); ++it2) {
-            it2->GetCheckBox()->Show(false);
-        }
+    if (trace != Doc()->GetCurSecIndex()) {
+        ClearEvents();
     }
 
     Doc()->SetSection(trace);
@@ -2330,7 +2348,7 @@ void wxStfGraph::Ch2base() {
         double base2=0.0;
         try {
             double var2=0.0;
-            base2=stfnum::base(Doc()->GetBaselineMethod(),var2,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get(),
+            base2=stfnum::base(Doc()->GetBaselineMethod(),var2,*Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get_shared(),
                     Doc()->GetBaseBeg(),Doc()->GetBaseEnd());
         }
         catch (const std::out_of_range& e) {
@@ -2371,7 +2389,7 @@ void wxStfGraph::Ch2basezoom() {
         double base2=0.0;
         try {
             double var2=0.0;
-            base2=stfnum::base(Doc()->GetBaselineMethod(),var2,Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get(),
+            base2=stfnum::base(Doc()->GetBaselineMethod(),var2,*Doc()->get()[Doc()->GetSecChIndex()][Doc()->GetCurSecIndex()].get_shared(),
                     Doc()->GetBaseBeg(),Doc()->GetBaseEnd());
         }
         catch (const std::out_of_range& e) {
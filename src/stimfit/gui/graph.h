@@ -210,7 +210,7 @@ public:
      */
     void Fittowindow(bool refresh);
 
-    //! Destroys all event check boxes
+    //! Hides all event check boxes
     void ClearEvents();
 
     //! Set to true if the graph is drawn on a printer.
@@ -350,6 +350,11 @@ public:
     wxPoint lastLDown;
 
     YZoom yzoombg;
+
+    // Pool of check boxes for the events on the screen, and the start
+    // index of the event that each of them currently belongs to:
+    std::vector<wxCheckBox*> eventCheckBoxes;
+    std::vector<std::size_t> eventCheckBoxStarts;
     
 #if (__cplusplus < 201103)
     boost::shared_ptr<wxMenu> m_zoomContext;
@@ -366,8 +371,8 @@ public:
     void PlotGimmicks(wxDC& DC);
     void PlotEvents(wxDC& DC);
     void DrawCrosshair( wxDC& DC, const wxPen& pen, const wxPen& printPen, int crosshairSize, double xch, double ych);
-    void PlotTrace( wxDC* pDC, const Vector_double& trace, plottype pt=active, int bgno=0 );
-    void DoPlot( wxDC* pDC, const Vector_double& trace, int start, int end, int step, plottype pt=active, int bgno=0 );
+    void PlotTrace( wxDC* pDC, const Section& trace, plottype pt=active, int bgno=0 );
+    void DoPlot( wxDC* pDC, const Section& trace, int start, int end, int step, plottype pt=active, int bgno=0 );
     void PrintScale(wxRect& WindowRect);
     void PrintTrace( wxDC* pDC, const Vector_double& trace, plottype ptype=active);
     void DoPrint( wxDC* pDC, const Vector_double& trace, int start, int end, plottype ptype=active);
@@ -428,6 +433,7 @@ public:
     void OnZoomHV(wxCommandEvent& event);
     void OnZoomH(wxCommandEvent& event);
     void OnZoomV(wxCommandEvent& event);
+    void OnEventCheckBox(wxCommandEvent& event);
 #if defined __WXMAC__ && !(wxCHECK_VERSION(2, 9, 0))
     void OnPaint(wxPaintEvent &event);
 #endif
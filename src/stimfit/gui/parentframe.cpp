@@ -151,6 +151,8 @@ EVT_MENU(ID_CONVERT, wxStfParentFrame::OnConvert)
 
 EVT_MENU(ID_AVERAGE, wxStfParentFrame::OnAverage)
 EVT_MENU(ID_ALIGNEDAVERAGE, wxStfParentFrame::OnAlignedAverage)
+EVT_MENU(ID_MEDIANAVERAGE, wxStfParentFrame::OnMedianAverage)
+EVT_MENU(ID_WEIGHTEDAVERAGE, wxStfParentFrame::OnWeightedAverage)
 EVT_MENU( ID_VIEW_RESULTS, wxStfParentFrame::OnViewResults)
 EVT_MENU( ID_CH2BASE, wxStfParentFrame::OnCh2base )
 EVT_MENU( ID_CH2POS, wxStfParentFrame::OnCh2pos )
@@ -750,17 +752,34 @@ void wxStfParentFrame::OnConvert(wxCommandEvent& WXUNUSED(event) ) {
 		stfio::filetype eft = myDlg.GetDestFileExt();
         src_ext = myDlg.GetSrcFilter();
 
-        // wxProgressDialog
-        wxProgressDialog progDlg( wxT("CFS conversion utility"), wxT("Starting file conversion"),
-            100, NULL, wxPD_SMOOTH | wxPD_AUTO_HIDE | wxPD_APP_MODAL );
+        switch ( eft ) {
+         case stfio::atf:
+             dest_ext = wxT("Axon textfile [*.atf]");
+             break;
+         case stfio::igor:
+             dest_ext = wxT("Igor binary file [*.ibw]");
+             break;
+         case stfio::hdf5:
+             dest_ext = wxT("HDF5 file [*.h5]");
+             break;
+#if defined(WITH_BIOSIG)
+         case stfio::biosig:
+             dest_ext = wxT("Biosig/GDF [*.gdf]");
+             break;
+#endif
+         default:
+             wxString errorMsg(wxT("Unknown export file type\n"));
+             wxGetApp().ErrorMsg(errorMsg);
+             return;
+        }
 
         wxArrayString srcFilenames(myDlg.GetSrcFileNames());
         nfiles = srcFilenames.size(); // number of files to convert
         wxString myDestDir = myDlg.GetDestDir();
 
+        std::vector<std::string> srcNames(srcFilenames.size());
+        std::vector<std::string> destNames(srcFilenames.size());
         for (std::size_t nFile=0; nFile<srcFilenames.size(); ++nFile) {
-            wxString progStr;
-
             // Strip source directory from source file name:
             wxFileName srcWxFilename(srcFilenames[nFile]);
             srcWxFilename.MakeRelativeTo(myDlg.GetSrcDir());
@@ -778,61 +797,44 @@ void wxStfParentFrame::OnConvert(wxCommandEvent& WXUNUSED(event) ) {
             if ( eft == stfio::atf ) {
                 destFilename += wxT(".atf");
             }
+            srcNames[nFile] = stf::wx2std(srcFilenames[nFile]);
+            destNames[nFile] = stf::wx2std(destFilename);
+        }
 
-            // Update progress bar:
-            progStr << wxT("Converting file #") << (int)nFile + 1
-                << wxT(" of ") << (int)srcFilenames.size() << wxT("\n")
-                << srcFilenames[nFile] << wxT(" -> ") << destFilename;
-            progDlg.Update(
-                (int)(((double)nFile/(double)srcFilenames.size())*100.0),
-                progStr
-                );
-
-            // Open source file and convert:
-            Recording sourceFile;
-            try {
-
-                stf::wxProgressInfo progDlgIn("Reading file", "Opening file", 100);
-                stfio::importFile(stf::wx2std(srcFilenames[nFile]), ift, sourceFile, wxGetApp().GetTxtImport(), progDlgIn);
-
-                stf::wxProgressInfo progDlgOut("Writing file", "Opening file", 100);
-                switch ( eft ) {
-                 case stfio::atf:
-                     stfio::exportATFFile(stf::wx2std(destFilename), sourceFile);
-                     dest_ext = wxT("Axon textfile [*.atf]");
-                     break;
-                 case stfio::igor:
-                     stfio::exportIGORFile(stf::wx2std(destFilename), sourceFile, progDlgOut);
-                     dest_ext = wxT("Igor binary file [*.ibw]");
-                     break;
-
-#if defined(WITH_BIOSIG)
-                 case stfio::biosig:
-                     stfio::exportBiosigFile(stf::wx2std(destFilename), sourceFile, progDlgOut);
-                     dest_ext = wxT("Biosig/GDF [*.gdf]");
-                     break;
-#endif
-                 default:
-                     wxString errorMsg(wxT("Unknown export file type\n"));
-                     wxGetApp().ErrorMsg(errorMsg);
-                     return;
+        // Files are read and written concurrently; a file that can't be
+        // converted doesn't stop the others:
+        stfio::ConversionStats stats;
+        try {
+            stf::wxProgressInfo progDlg("File conversion utility", "Starting file conversion", 100);
+            stats = stfio::convertFiles(srcNames, ift, destNames, eft, wxGetApp().GetTxtImport(), progDlg);
+        }
+        catch (const std::exception& e) {
+            wxString errorMsg(wxT("Error during file conversion\n"));
+            errorMsg += wxString( e.what(), wxConvLocal );
+            wxGetApp().ExceptMsg(errorMsg);
+            return;
+        }
+        nfiles = (int)stats.nConverted;
+
+        std::size_t nFailed = 0;
+        wxString errorMsg;
+        for (std::size_t nFile=0; nFile<stats.errors.size(); ++nFile) {
+            if (!stats.errors[nFile].empty()) {
+                // Only list the first few errors:
+                if (nFailed < 10) {
+                    errorMsg << stf::std2wx(stats.errors[nFile]) << wxT("\n");
                 }
+                nFailed++;
             }
-           catch (const std::runtime_error& e) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                errorMsg += wxT("Runtime Error\n");
-                errorMsg += wxString( e.what(), wxConvLocal );
-                wxGetApp().ExceptMsg(errorMsg);
-                return;
-            }
-
-            catch (const std::exception& e) {
-                wxString errorMsg(wxT("Error opening file\n"));
-                errorMsg += wxT("Exception\n");
-                errorMsg += wxString( e.what(), wxConvLocal );
-                wxGetApp().ExceptMsg(errorMsg);
-                return;
+        }
+        if (nFailed > 0) {
+            wxString msg;
+            msg << (int)nFailed << wxT(" of ") << (int)stats.errors.size()
+                << wxT(" files couldn't be converted:\n") << errorMsg;
+            if (nFailed > 10) {
+                msg << wxT("...\n");
             }
+            wxGetApp().ErrorMsg(msg);
         }
     // Show now a smal information dialog
     //std::count << srcFilter.c_str() << std::endl;
@@ -841,6 +843,7 @@ void wxStfParentFrame::OnConvert(wxCommandEvent& WXUNUSED(event) ) {
     msg << src_ext;
     msg << wxT(" files \nwere converted to ");
     msg << dest_ext;
+    msg << wxString::Format(wxT("\n(%.1f MB/s)"), stats.throughput());
 	wxMessageDialog Simple(this, msg);
 	Simple.ShowModal();
     } // end of wxStfConvertDlg
@@ -1192,6 +1195,20 @@ void wxStfParentFrame::OnAlignedAverage(wxCommandEvent& WXUNUSED(event)) {
     }
 }
 
+void wxStfParentFrame::OnMedianAverage(wxCommandEvent& WXUNUSED(event)) {
+    wxStfDoc* pDoc=wxGetApp().GetActiveDoc();
+    if (pDoc!=NULL) {
+        pDoc->CreateAverage(false,false,stfio::average_median);
+    }
+}
+
+void wxStfParentFrame::OnWeightedAverage(wxCommandEvent& WXUNUSED(event)) {
+    wxStfDoc* pDoc=wxGetApp().GetActiveDoc();
+    if (pDoc!=NULL) {
+        pDoc->CreateAverage(false,false,stfio::average_weighted);
+    }
+}
+
 #if 0
 void wxStfParentFrame::OnUserdef(wxCommandEvent& event) {
     wxStfDoc* pDoc=wxGetApp().GetActiveDoc();
@@ -222,6 +222,8 @@ private:
     void OnCh2basezoom(wxCommandEvent& event);
     void OnAverage(wxCommandEvent& event);
     void OnAlignedAverage(wxCommandEvent& event);
+    void OnMedianAverage(wxCommandEvent& event);
+    void OnWeightedAverage(wxCommandEvent& event);
     void OnExportfile(wxCommandEvent& event);
     void OnExportatf(wxCommandEvent& event);
     void OnExportigor(wxCommandEvent& event);
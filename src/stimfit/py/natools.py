@@ -251,18 +251,18 @@ def inact_batch():
     dict_keys = [ "Peak amplitude", ]
     dict_values = np.empty( (gDictSize, gPulses) )
 
-    for n in range( 0, gPulses ):
-        if ( stf.set_trace( n ) == False ):
-            print('Couldn\'t set a new trace; aborting now.')
-            return False
-        
-        print('Analyzing pulse %d of %d'%( n+1, stf.get_size_channel()))
-
-        # Update calculations:
-        stf.measure()
+    # Measure all pulses at once:
+    try:
+        results = stf.measure_batch( range( 0, gPulses ) )
+    except (IndexError, ValueError, RuntimeError) as err:
+        print('Couldn\'t measure the traces (%s); aborting now.' % err)
+        return False
+    if results is None:
+        print('Couldn\'t measure the traces; aborting now.')
+        return False
 
-        # Store values:
-        dict_values[0][n] = stf.get_peak() - stf.get_base()
+    # Store values:
+    dict_values[0] = results["peak"] - results["base"]
     
     inactDict = dict()
     # Create the dictionary for the table:
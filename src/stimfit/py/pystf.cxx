@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <set>
 
 #ifndef WX_PRECOMP
 #include "wx/wx.h"
@@ -227,21 +229,96 @@ PyObject* get_trace(int trace, int channel) {
     double* gDataP = (double*)PyArray_DATA((PyArrayObject*)np_array);
 
     /* fill */
-    std::copy( (*actDoc())[channel][trace].get().begin(),
-               (*actDoc())[channel][trace].get().end(),
-               gDataP);
+    stfio::SharedSamplesPtr samples = (*actDoc())[channel][trace].get_shared();
+    std::copy( samples->begin(), samples->end(), gDataP);
 
     return np_array;
 }
+
+void release_shared_samples(PyObject* capsule) {
+    delete (stfio::SharedSamplesPtr*)PyCapsule_GetPointer(capsule, NULL);
+}
+
+PyObject* get_trace_view(int trace, int channel, bool writable) {
+    wrap_array();
+
+    if ( !check_doc() ) return NULL;
+
+    if ( trace == -1 ) {
+        trace = actDoc()->GetCurSecIndex();
+    }
+    if ( channel == -1 ) {
+        channel = actDoc()->GetCurChIndex();
+    }
+
+    Section* sec = NULL;
+    try {
+        sec = &actDoc()->at(channel).at(trace);
+    }
+    catch ( const std::out_of_range& e) {
+        ShowExcept( e );
+        return NULL;
+    }
+
+    npy_intp dims[1] = {(npy_intp)sec->size()};
+    if (dims[0] == 0) {
+        return PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    }
+
+    double* data = NULL;
+    PyObject* base = NULL;
+    if (writable) {
+        // copies memory-mapped samples into the trace:
+        data = &(sec->get_w()[0]);
+    } else {
+        // the array holds the samples, or the converted copy of memory-mapped
+        // samples, even if the trace is changed or the file is closed:
+        stfio::SharedSamplesPtr* values = new stfio::SharedSamplesPtr(sec->get_shared());
+        data = &(**values)[0];
+        base = PyCapsule_New(values, NULL, release_shared_samples);
+    }
+
+    PyObject* np_array = PyArray_New(&PyArray_Type, 1, dims, NPY_DOUBLE, NULL, data, 0,
+                                     writable ? NPY_ARRAY_CARRAY : NPY_ARRAY_CARRAY_RO, NULL);
+    if (np_array == NULL) {
+        Py_XDECREF(base);
+        return NULL;
+    }
+    // steals the reference to base:
+    if (base != NULL && PyArray_SetBaseObject((PyArrayObject*)np_array, base) < 0) {
+        Py_DECREF(np_array);
+        return NULL;
+    }
+    return np_array;
+}
 #endif
 
+bool update_trace( int trace, int channel ) {
+    if ( !check_doc() ) return false;
+
+    if ( trace == -1 ) {
+        trace = actDoc()->GetCurSecIndex();
+    }
+    if ( channel == -1 ) {
+        channel = actDoc()->GetCurChIndex();
+    }
+
+    try {
+        // write access drops the min/max envelope that is used for drawing:
+        actDoc()->at(channel).at(trace).get_w();
+    }
+    catch ( const std::out_of_range& e) {
+        ShowExcept( e );
+        return false;
+    }
+    return refresh_graph();
+}
+
 bool new_window( double* invec, int size ) {
     bool open_doc = actDoc() != NULL;
 
-    std::vector< double > va(size);
-    std::copy( &invec[0], &invec[size], va.begin() );
-    Section sec(va);
-    Channel ch(sec);
+    Channel ch( 1, size );
+    std::copy( &invec[0], &invec[size], ch[0].get_w().begin() );
     if (open_doc) {
         ch.SetYUnits( actDoc()->at( actDoc()->GetCurChIndex() ).GetYUnits() );
     }
@@ -297,13 +374,11 @@ bool _new_window_gMatrix( ) {
 bool new_window_matrix( double* invec, int traces, int size ) {
     bool open_doc = actDoc() != NULL;
 
-    Channel ch( traces );
+    // copy the traces straight into the sections of the new channel:
+    Channel ch( traces, size );
     for (int n = 0; n < traces; ++n) {
         std::size_t offset = n * size;
-        std::vector< double > va(size);
-        std::copy( &invec[offset], &invec[offset+size], &va[0] );
-        Section sec(va);
-        ch.InsertSection(sec, n);
+        std::copy( &invec[offset], &invec[offset+size], ch[n].get_w().begin() );
     }
     if (open_doc) {
         ch.SetYUnits( actDoc()->at( actDoc()->GetCurChIndex() ).GetYUnits() );
@@ -1033,6 +1108,8 @@ const char* get_baseline_method() {
         method = "mean";
     else if ( actDoc()->GetBaselineMethod() == stfnum::median_iqr )
         method = "median";
+    else if ( actDoc()->GetBaselineMethod() == stfnum::median_running )
+        method = "running";
 
     return method;
 }
@@ -1055,6 +1132,13 @@ bool set_baseline_method( const char* method ) {
         write_stf_registry(myitem, stfnum::median_iqr); // write in .Stimfit
         return true;
     }
+    else if ( strcmp( method, "running" ) == 0 ) {
+        actDoc()->SetBaselineMethod( stfnum::median_running );
+        update_cursor_dialog();
+        update_results_table();
+        write_stf_registry(myitem, stfnum::median_running);
+        return true;
+    }
     else {
         wxString msg;
         msg << wxT("\"") << wxString::FromAscii(method) << wxT("\" is not a valid method\n");
@@ -1633,12 +1717,9 @@ void align_selected(  double (*alignment)( bool ), bool active ) {
               sel_it != pDoc->GetSelectedSections().end() && it3 != shift.end();
               ++sel_it )
         {
-            Vector_double va( new_size );
-            std::copy( &(chan_it->at( *sel_it ).get_w()[ 0 + (*it3) ]),
-                       &(chan_it->at( *sel_it ).get_w()[ (*it3) + new_size ]),
-                       &va[0] );
-            Section sec(va);
-            ch.InsertSection(sec, n_sec++);
+            // read-only access, so that shared data points aren't copied:
+            Section sec(chan_it->at( *sel_it ).get_window( *it3, new_size ));
+            ch.InsertSection(std::move(sec), n_sec++);
             ++it3;
         }
         Aligned.InsertChannel( ch, n_ch++ );
@@ -1669,6 +1750,24 @@ int leastsq_param_size( int fselect ) {
     return npar;
 }
 
+// Options for Lourakis' implementation of the Levenberg-Marquardt algorithm
+// that are used for fits from the python shell.
+Vector_double leastsq_opts( ) {
+    Vector_double opts( 6 );
+    // check values in src/stimfit/gui/dlgs/fitseldlg.cpp
+    // Respectively the scale factor for initial damping term \mu,
+    // stopping thresholds for ||J^T e||_inf, ||Dp||_2 and ||e||_2,
+    // maxIter, maxPass
+    //opts[0]=5*1E-3; //default: 1E-03;
+    opts[0] = 1E-05; //default: 1E-03;
+    opts[1] = 1E-17; //default: 1E-17;
+    opts[2] = 1E-17; //default: 1E-17;
+    opts[3] = 1E-32; //default: 1E-17;
+    opts[4] = 64; //default: 64;
+    opts[5] = 16;
+    return opts;
+}
+
 PyObject* leastsq( int fselect, bool refresh ) {
     if ( !check_doc() ) return NULL;
 
@@ -1687,9 +1786,15 @@ PyObject* leastsq( int fselect, bool refresh ) {
         return NULL;
     }
 
-    std::vector< double > x( pDoc->GetFitEnd() - pDoc->GetFitBeg() );
-    //fill array:
-    std::copy(&pDoc->cursec()[pDoc->GetFitBeg()], &pDoc->cursec()[pDoc->GetFitEnd()], &x[0]);
+    std::vector< double > x;
+    try {
+        //fill array:
+        x = pDoc->cursec().get_window(pDoc->GetFitBeg(), pDoc->GetFitEnd() - pDoc->GetFitBeg());
+    }
+    catch (const std::out_of_range& e) {
+        ShowExcept( e );
+        return NULL;
+    }
 
     std::vector< double > params( n_params );
 
@@ -1698,18 +1803,7 @@ PyObject* leastsq( int fselect, bool refresh ) {
             pDoc->GetRTLoHi(), pDoc->GetHalfDuration(), pDoc->GetXScale(), params );
     std::string fitInfo;
     int fitWarning = 0;
-    std::vector< double > opts( 6 );
-    // check values in src/stimfit/gui/dlgs/fitseldlg.cpp
-    // Respectively the scale factor for initial damping term \mu,
-    // stopping thresholds for ||J^T e||_inf, ||Dp||_2 and ||e||_2,
-    // maxIter, maxPass
-    //opts[0]=5*1E-3; //default: 1E-03;
-    opts[0] = 1E-05; //default: 1E-03;
-    opts[1] = 1E-17; //default: 1E-17;
-    opts[2] = 1E-17; //default: 1E-17;
-    opts[3] = 1E-32; //default: 1E-17;
-    opts[4] = 64; //default: 64;
-    opts[5] = 16;
+    std::vector< double > opts = leastsq_opts();
     double chisqr = 0.0;
     try {
         chisqr = stfnum::lmFit( x, pDoc->GetXScale(), wxGetApp().GetFuncLib().at(fselect),
@@ -1787,6 +1881,206 @@ PyObject* get_fit( int trace, int channel ) {
 
     return np_array;
 }
+
+namespace {
+    bool append_field( PyObject* fields, const char* name, const char* type ) {
+        PyObject* field = Py_BuildValue( "(ss)", name, type );
+        if ( field == NULL ) return false;
+        int err = PyList_Append( fields, field );
+        Py_DECREF( field );
+        return err == 0;
+    }
+}
+
+PyObject* _measure_batch( const std::vector<int>& sections, int channel,
+                          const std::vector<int>& cursors, int fselect, bool fit_from_peak )
+{
+    wrap_array();
+
+    if ( !check_doc() ) return NULL;
+    wxStfDoc* pDoc = actDoc();
+
+    if ( channel < 0 ) {
+        channel = pDoc->GetCurChIndex();
+    }
+    if ( channel >= (int)pDoc->size() ) {
+        PyErr_SetString( PyExc_IndexError, "Channel index out of range" );
+        return NULL;
+    }
+    std::vector<std::size_t> secs( sections.size() );
+    for ( std::size_t n_s = 0; n_s < sections.size(); ++n_s ) {
+        if ( sections[n_s] < 0 || sections[n_s] >= (int)pDoc->get()[channel].size() ) {
+            PyErr_SetString( PyExc_IndexError, "Trace index out of range" );
+            return NULL;
+        }
+        secs[n_s] = sections[n_s];
+    }
+    if ( cursors.size() != 6 ) {
+        PyErr_SetString( PyExc_ValueError, "Expected 6 cursor positions" );
+        return NULL;
+    }
+
+    // Use the cursors of the document unless they are given explicitly:
+    stfnum::MeasureSpec spec = pDoc->GetMeasureSpec();
+    if ( cursors[0] >= 0 ) spec.baseBeg = cursors[0];
+    if ( cursors[1] >= 0 ) spec.baseEnd = cursors[1];
+    if ( cursors[2] >= 0 ) spec.peakBeg = cursors[2];
+    if ( cursors[3] >= 0 ) spec.peakEnd = cursors[3];
+    std::size_t fitBeg = cursors[4] >= 0 ? (std::size_t)cursors[4] : pDoc->GetFitBeg();
+    std::size_t fitEnd = cursors[5] >= 0 ? (std::size_t)cursors[5] : pDoc->GetFitEnd();
+    if ( spec.baseBeg > spec.baseEnd || spec.peakBeg > spec.peakEnd ) {
+        PyErr_SetString( PyExc_ValueError, "Cursors are reversed" );
+        return NULL;
+    }
+    int reference = -1;
+    if ( pDoc->size() > 1 && (int)pDoc->GetSecChIndex() != channel ) {
+        reference = (int)pDoc->GetSecChIndex();
+    }
+
+    const stfnum::storedFunc* fitFunc = NULL;
+    if ( fselect >= 0 ) {
+        if ( fselect >= (int)wxGetApp().GetFuncLib().size() ) {
+            PyErr_SetString( PyExc_ValueError, "Could not retrieve function from library" );
+            return NULL;
+        }
+        fitFunc = &wxGetApp().GetFuncLib()[fselect];
+    }
+    std::size_t n_params = fitFunc ? fitFunc->pInfo.size() : 0;
+
+    // Neither the measurement nor the fits touch any Python objects or
+    // the window, so that other threads can run in the meantime:
+    std::vector<stfnum::MeasureResult> results;
+    std::vector<Vector_double> params;
+    std::vector<std::size_t> fitBegs, fitEnds;
+    std::vector<std::string> fitInfo;
+    std::vector<int> fitWarning;
+    Vector_double chisqr;
+    std::string error;
+    PyObject* errorType = PyExc_ValueError;
+    double dt = pDoc->GetXScale();
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        try {
+            results = stfnum::measure( *pDoc, std::vector<std::size_t>(1, channel), secs,
+                                       spec, reference )[0];
+        }
+        catch (const std::out_of_range&) {
+            errorType = PyExc_IndexError;
+            throw;
+        }
+        if ( fitFunc ) {
+            std::vector<Vector_double> fitData( secs.size() );
+            fitBegs.resize( secs.size() );
+            fitEnds.resize( secs.size() );
+            params.resize( secs.size(), Vector_double(n_params) );
+            for ( std::size_t n_s = 0; n_s < secs.size(); ++n_s ) {
+                const Section& sec = pDoc->get()[channel][secs[n_s]];
+                std::size_t beg = fit_from_peak ? (std::size_t)std::max( 0.0, results[n_s].maxT ) : fitBeg;
+                fitBegs[n_s] = std::min( beg, sec.size()-1 );
+                fitEnds[n_s] = std::min( fitEnd, sec.size()-1 );
+                if ( fitEnds[n_s] <= fitBegs[n_s]+1 ) {
+                    throw std::runtime_error( "Check fit limits" );
+                }
+                fitData[n_s] = sec.get_window( fitBegs[n_s], fitEnds[n_s]-fitBegs[n_s] );
+                fitFunc->init( fitData[n_s], results[n_s].base, results[n_s].peak, results[n_s].rtLoHi,
+                               results[n_s].halfDuration, dt, params[n_s] );
+            }
+            chisqr = stfnum::lmFitBatch( fitData, dt, *fitFunc, leastsq_opts(), true,
+                                         params, fitInfo, fitWarning );
+        }
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if ( !error.empty() ) {
+        PyErr_SetString( errorType, error.c_str() );
+        return NULL;
+    }
+
+    // Store the fits so that they can be shown later, but don't redraw:
+    for ( std::size_t n_s = 0; fitFunc && n_s < secs.size(); ++n_s ) {
+        if ( fitWarning[n_s] == -1 ) continue;
+        try {
+            pDoc->SetIsFitted( channel, secs[n_s], params[n_s], wxGetApp().GetFuncLibPtr(fselect),
+                               chisqr[n_s], fitBegs[n_s], fitEnds[n_s] );
+        }
+        catch (const std::exception& e) {
+            PyErr_SetString( PyExc_RuntimeError, e.what() );
+            return NULL;
+        }
+    }
+
+    // One record per trace: the index of the trace, the measurements and,
+    // if a function was fitted, its parameters, the SSE and the fit warning.
+    // Field names have to be unique, so the parameters are prefixed with
+    // "fit_", and numbered if their name is taken nonetheless:
+    std::set<std::string> names;
+    names.insert( "trace" );
+    names.insert( "SSE" );
+    names.insert( "fit_warning" );
+    for ( const stfnum::MeasureColumn* col = stfnum::measure_columns; col->name != NULL; ++col ) {
+        names.insert( col->name );
+    }
+    std::vector<std::string> param_names( n_params );
+    for ( std::size_t n_p = 0; n_p < n_params; ++n_p ) {
+        std::string name( "fit_" + fitFunc->pInfo[n_p].desc );
+        param_names[n_p] = name;
+        for ( int n = 2; names.count( param_names[n_p] ); ++n ) {
+            std::ostringstream numbered;
+            numbered << name << "_" << n;
+            param_names[n_p] = numbered.str();
+        }
+        names.insert( param_names[n_p] );
+    }
+    PyObject* fields = PyList_New( 0 );
+    if ( fields == NULL ) return NULL;
+    bool ok = append_field( fields, "trace", "i8" );
+    for ( const stfnum::MeasureColumn* col = stfnum::measure_columns; ok && col->name != NULL; ++col ) {
+        ok = append_field( fields, col->name, "f8" );
+    }
+    for ( std::size_t n_p = 0; ok && n_p < n_params; ++n_p ) {
+        ok = append_field( fields, param_names[n_p].c_str(), "f8" );
+    }
+    if ( ok && fitFunc ) {
+        ok = append_field( fields, "SSE", "f8" ) && append_field( fields, "fit_warning", "i8" );
+    }
+    PyArray_Descr* descr = NULL;
+    if ( !ok || !PyArray_DescrConverter( fields, &descr ) ) {
+        Py_DECREF( fields );
+        return NULL;
+    }
+    Py_DECREF( fields );
+
+    npy_intp dims[1] = {(npy_intp)secs.size()};
+    PyObject* np_array = PyArray_NewFromDescr( &PyArray_Type, descr, 1, dims, NULL, NULL, 0, NULL );
+    if ( np_array == NULL ) return NULL;
+
+    // All fields are 8 bytes wide and packed in the order given above:
+    char* gDataP = PyArray_BYTES( (PyArrayObject*)np_array );
+    for ( std::size_t n_s = 0; n_s < secs.size(); ++n_s ) {
+        npy_int64 trace = (npy_int64)secs[n_s];
+        memcpy( gDataP, &trace, 8 );
+        gDataP += 8;
+        for ( const stfnum::MeasureColumn* col = stfnum::measure_columns; col->name != NULL; ++col ) {
+            double val = results[n_s].*(col->value);
+            if ( col->in_samples ) val *= dt;
+            memcpy( gDataP, &val, 8 );
+            gDataP += 8;
+        }
+        if ( fitFunc ) {
+            memcpy( gDataP, &params[n_s][0], 8*n_params );
+            gDataP += 8*n_params;
+            memcpy( gDataP, &chisqr[n_s], 8 );
+            gDataP += 8;
+            npy_int64 warning = fitWarning[n_s];
+            memcpy( gDataP, &warning, 8 );
+            gDataP += 8;
+        }
+    }
+
+    return np_array;
+}
 #endif
 
 bool show_table( PyObject* dict, const char* caption ) {
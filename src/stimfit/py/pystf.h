@@ -11,7 +11,9 @@ std::string get_versionstring( );
 
 #ifdef WITH_PYTHON
 PyObject* get_trace(int trace=-1, int channel=-1);
+PyObject* get_trace_view(int trace=-1, int channel=-1, bool writable=false);
 #endif
+bool update_trace( int trace=-1, int channel=-1 );
 
 bool new_window( double* invec, int size );
 bool new_window_matrix( double* inarr, int traces, int size );
@@ -68,6 +70,8 @@ int leastsq_param_size( int fselect );
 #ifdef WITH_PYTHON
 PyObject* leastsq( int fselect, bool refresh = true );
 PyObject* get_fit( int trace = -1, int channel = -1 );
+PyObject* _measure_batch( const std::vector<int>& sections, int channel,
+                          const std::vector<int>& cursors, int fselect, bool fit_from_peak );
 #endif 
 
 bool check_doc( bool show_dialog = true );
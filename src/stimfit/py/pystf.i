@@ -19,6 +19,7 @@ application from the embedded python shell."
 %include "std_vector.i"
 namespace std {
     %template(vectord) vector<double>;
+    %template(vectori) vector<int>;
 };
 
 %init %{
@@ -62,6 +63,45 @@ The trace as a 1D NumPy array.""") get_trace;
 PyObject* get_trace(int trace=-1, int channel=-1);
 //--------------------------------------------------------------------
 
+//--------------------------------------------------------------------
+%feature("autodoc", 0) get_trace_view;
+%feature("kwargs") get_trace_view;
+%feature("docstring", """Returns a trace as a 1-dimensional NumPy array
+that shares its memory with the trace instead of copying it.
+A read-only array keeps the samples alive after the trace has been
+changed or the file has been closed, but doesn't see the changes.
+A writable array must not be used after the file has been closed.
+
+Arguments:       
+trace --    ZERO-BASED index of the trace within the channel.
+            The default value of -1 returns the currently
+            displayed trace.
+channel --  ZERO-BASED index of the channel. The default value
+            of -1 returns the currently active channel.
+writable -- If True, changes to the array change the trace.
+            Call update_trace() when you are done to redraw it.
+Returns:
+The trace as a 1D NumPy array.""") get_trace_view;
+PyObject* get_trace_view(int trace=-1, int channel=-1, bool writable=false);
+//--------------------------------------------------------------------
+
+//--------------------------------------------------------------------
+%feature("autodoc", 0) update_trace;
+%feature("kwargs") update_trace;
+%feature("docstring", "Redraws a trace after it has been changed through
+an array returned by get_trace_view().
+
+Arguments:
+trace --   ZERO-BASED index of the trace within the channel.
+           The default value of -1 uses the currently
+           displayed trace.
+channel -- ZERO-BASED index of the channel. The default value
+           of -1 uses the currently active channel.
+Returns:
+True upon successful completion.") update_trace;
+bool update_trace( int trace=-1, int channel=-1 );
+//--------------------------------------------------------------------
+
 //--------------------------------------------------------------------
 %feature("autodoc", 0) new_window;
 %feature("docstring", "Creates a new window showing a
@@ -385,6 +425,20 @@ A 2D Numpy array with the x-values of the fit in the first dimension, and the y-
 PyObject* get_fit( int trace = -1, int channel = -1 );
 //--------------------------------------------------------------------
 
+//--------------------------------------------------------------------
+%feature("autodoc", 0) _measure_batch;
+%feature("docstring", "Measures and optionally fits several traces of the
+current file in a single call.
+
+Arguments:
+See measure_batch().
+
+Returns:
+A NumPy structured array with one record per trace.") _measure_batch;
+PyObject* _measure_batch( const std::vector<int>& sections, int channel,
+                          const std::vector<int>& cursors, int fselect, bool fit_from_peak );
+//--------------------------------------------------------------------
+
 //--------------------------------------------------------------------
 %feature("autodoc", 0) leastsq_param_size;
 %feature("docstring", "Retrieves the number of parameters for a
@@ -1112,7 +1166,8 @@ bool set_latency_start_mode( const char* mode );
 
 Returns:
 A string specifying the method to compute the baseline. Can be one of
-\"mean\" or \"median\"") get_baseline_method;
+\"mean\", \"median\" or \"running\" (running median for a drifting
+baseline)") get_baseline_method;
 const char* get_baseline_method( );
 //--------------------------------------------------------------------
 
@@ -1122,7 +1177,8 @@ const char* get_baseline_method( );
 
 Arguments:
 method -- A string specifying the method to calculate the baseline.
-            Can be one of \"mean\" or \"median\"
+            Can be one of \"mean\", \"median\" or \"running\"
+            (running median for a drifting baseline)
 
 Returns:
 False upon failure.") set_baseline_method;
@@ -1667,6 +1723,73 @@ def peak_detection(data, threshold, min_distance):
     import stfio
     return stfio.peak_detection(data, threshold, min_distance)
 
+def measure_batch(sections=None, channel=-1, base=None, peak=None, fit=None,
+                  fselect=-1, fit_from_peak=False, is_time=False):
+    """Measures several traces of the current file, and optionally fits
+    a function to them, in a single call. As opposed to calling
+    set_trace(), measure() and get_peak() for every trace, the current
+    trace isn't changed, nothing is redrawn, and the traces are
+    measured concurrently.
+
+    Arguments:
+    sections      -- ZERO-BASED indices of the traces. None (default)
+                     uses the selected traces, or all traces of the
+                     channel if none is selected.
+    channel       -- ZERO-BASED index of the channel. The default
+                     value of -1 uses the currently active channel.
+    base          -- (start, end) of the baseline window. None (default)
+                     uses the current baseline cursors, and so does a
+                     start or end that is None.
+    peak          -- (start, end) of the peak window, see base.
+    fit           -- (start, end) of the fit window, see base.
+    fselect       -- Zero-based index of the function that is fitted
+                     to each trace as it appears in the fit selection
+                     dialog, or -1 (default) to skip the fits.
+    fit_from_peak -- If True, the fits start at the peak of each trace.
+    is_time       -- If True, the windows are given in x-units,
+                     otherwise in sampling points.
+
+    The remaining settings (e.g. the direction of the peak and the
+    rise time factor) are those of the current file.
+
+    Returns:
+    A NumPy structured array with one record per trace. The fields
+    are "trace", the measurements of stfio.measure() (e.g. "base",
+    "peak", "rt_lohi", "half_duration", "max_rise", "latency") and,
+    if a function was fitted, its parameters, "SSE" and "fit_warning"
+    (-1 if the fit failed). The parameters are named "fit_" followed by
+    their description, e.g. "fit_Baseline"; a name that is already
+    taken is numbered, e.g. a second "fit_tau" becomes "fit_tau_2".
+    Times are given in x-units, measured from the start of the trace.
+    None if no file is open.
+
+    Raises:
+    IndexError   -- if the channel, a trace index or a window is out
+                    of range.
+    ValueError   -- if a window is reversed, if fselect doesn't refer
+                    to a function, or if a fit can't be started.
+    RuntimeError -- if the fits can't be stored.
+    """
+    if not check_doc():
+        return None
+    if sections is None:
+        sections = get_selected_indices()
+        if not sections:
+            sections = range(get_size_channel(channel))
+    cursors = []
+    for window in (base, peak, fit):
+        if window is None:
+            window = (None, None)
+        for pos in window:
+            if pos is None:
+                cursors.append(-1)
+            elif is_time:
+                cursors.append(int(round(pos / get_sampling_interval())))
+            else:
+                cursors.append(int(pos))
+    return _measure_batch([int(s) for s in sections], int(channel), cursors,
+                          int(fselect), bool(fit_from_peak))
+
 class _cursor_pair(object):
     def __init__(self, get_start, set_start, get_end, set_end, get_value=None, index=None):
         self._get_start = get_start
@@ -21,6 +21,9 @@
  *  Implements some general functions within the stf namespace
  */
 
+#include <algorithm>
+#include <sstream>
+
 #include "stf.h"
 
 #if 0
@@ -53,6 +56,215 @@ bool stf::wxProgressInfo::Update(int value, const std::string& newmsg, bool* ski
     return pd.Update(value, stf::std2wx(newmsg), skip);
 }
 
+stf::wxThreadProgressInfo::wxThreadProgressInfo(const std::string& title, const std::string& message, int maximum, bool verbose)
+    : ProgressInfo(title, message, maximum, verbose),
+      cs(), progress(0), message(message), cancelled(false)
+{
+    
+}
+
+bool stf::wxThreadProgressInfo::Update(int value, const std::string& newmsg, bool* skip) {
+    wxCriticalSectionLocker lock(cs);
+    progress = value;
+    if (!newmsg.empty()) {
+        message = newmsg;
+    }
+    if (skip != NULL) {
+        *skip = cancelled;
+    }
+    return !cancelled;
+}
+
+void stf::wxThreadProgressInfo::Get(int& value, std::string& msg) {
+    wxCriticalSectionLocker lock(cs);
+    value = progress;
+    msg = message;
+}
+
+void stf::wxThreadProgressInfo::Cancel() {
+    wxCriticalSectionLocker lock(cs);
+    cancelled = true;
+}
+
+bool stf::wxThreadProgressInfo::IsCancelled() {
+    wxCriticalSectionLocker lock(cs);
+    return cancelled;
+}
+
+namespace {
+
+// Takes files from a shared queue and imports them until the queue is empty.
+class ImportThread : public wxThread {
+public:
+    ImportThread(const std::vector<std::string>& fNames_,
+                 const std::vector<stfio::filetype>& types_,
+                 const stfio::txtImportSettings& txtImport_,
+                 std::vector<Recording>& ReturnData_,
+                 std::vector<std::string>& errors_,
+                 std::vector<stf::wxThreadProgressInfo*>& progress_,
+                 std::size_t& next_, wxCriticalSection& cs_)
+        : wxThread(wxTHREAD_JOINABLE), fNames(fNames_), types(types_), txtImport(txtImport_),
+          ReturnData(ReturnData_), errors(errors_), progress(progress_), next(next_), cs(cs_)
+    {}
+
+protected:
+    ExitCode Entry() {
+        for (;;) {
+            std::size_t n = 0;
+            {
+                wxCriticalSectionLocker lock(cs);
+                if (next >= fNames.size()) {
+                    break;
+                }
+                n = next++;
+            }
+            if (progress[n]->IsCancelled()) {
+                continue;
+            }
+            try {
+                stfio::importFile(fNames[n], types[n], ReturnData[n], txtImport, *progress[n]);
+            }
+            catch (const std::exception& e) {
+                errors[n] = e.what();
+                if (errors[n].empty()) {
+                    errors[n] = "Unknown error";
+                }
+            }
+            catch (...) {
+                errors[n] = "Unknown error";
+            }
+            progress[n]->Update(100);
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    const std::vector<std::string>& fNames;
+    const std::vector<stfio::filetype>& types;
+    const stfio::txtImportSettings& txtImport;
+    std::vector<Recording>& ReturnData;
+    std::vector<std::string>& errors;
+    std::vector<stf::wxThreadProgressInfo*>& progress;
+    std::size_t& next;
+    wxCriticalSection& cs;
+};
+
+}
+
+bool stf::importFilesAsync(const std::vector<std::string>& fNames,
+                           const std::vector<stfio::filetype>& types,
+                           const stfio::txtImportSettings& txtImport,
+                           const std::string& title,
+                           std::vector<Recording>& ReturnData,
+                           std::vector<std::string>& errors)
+{
+    std::size_t nFiles = fNames.size();
+    if (types.size() != nFiles) {
+        throw std::out_of_range("Number of file types differs from number of files in stf::importFilesAsync");
+    }
+    ReturnData.assign(nFiles, Recording());
+    errors.assign(nFiles, std::string());
+    if (nFiles == 0) {
+        return true;
+    }
+
+    std::vector<stf::wxThreadProgressInfo*> progress(nFiles);
+    for (std::size_t n = 0; n < nFiles; ++n) {
+        progress[n] = new stf::wxThreadProgressInfo(title, "Opening file", 100);
+    }
+
+    // Concurrent imports need a thread-safe stfio::importFile:
+#if (__cplusplus >= 201103)
+    int nThreads = wxThread::GetCPUCount();
+    if (nThreads < 1) {
+        nThreads = 1;
+    }
+#else
+    int nThreads = 1;
+#endif
+    if (nThreads > (int)nFiles) {
+        nThreads = (int)nFiles;
+    }
+
+    std::size_t next = 0;
+    wxCriticalSection cs;
+    std::vector<ImportThread*> threads;
+    for (int nt = 0; nt < nThreads; ++nt) {
+        ImportThread* thread = new ImportThread(fNames, types, txtImport, ReturnData, errors,
+                                                progress, next, cs);
+        if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR) {
+            delete thread;
+            break;
+        }
+        threads.push_back(thread);
+    }
+
+    bool cancelled = false;
+    if (threads.empty()) {
+        // Couldn't start a worker thread; import in this thread instead.
+        for (std::size_t nFile = 0; nFile < nFiles; ++nFile) {
+            stf::wxProgressInfo progDlg(title, "Opening file", 100);
+            try {
+                stfio::importFile(fNames[nFile], types[nFile], ReturnData[nFile], txtImport, progDlg);
+            }
+            catch (const std::exception& e) {
+                errors[nFile] = e.what();
+            }
+        }
+    } else {
+        wxProgressDialog progDlg(stf::std2wx(title), wxT("Opening file"), 100, NULL,
+                                 wxPD_SMOOTH | wxPD_AUTO_HIDE | wxPD_APP_MODAL | wxPD_CAN_ABORT);
+        for (;;) {
+            bool running = false;
+            for (std::size_t nt = 0; nt < threads.size(); ++nt) {
+                if (threads[nt]->IsAlive()) {
+                    running = true;
+                }
+            }
+            if (!running) {
+                break;
+            }
+            // Show the overall progress and the message of the first unfinished file:
+            int total = 0;
+            std::string msg;
+            for (std::size_t n = 0; n < nFiles; ++n) {
+                int value = 0;
+                std::string fmsg;
+                progress[n]->Get(value, fmsg);
+                total += value;
+                if (msg.empty() && value < 100) {
+                    msg = fmsg;
+                }
+            }
+            std::ostringstream progStr;
+            if (nFiles > 1) {
+                progStr << "Reading " << nFiles << " files\n";
+            }
+            progStr << msg;
+            if (!cancelled && !progDlg.Update(total / (int)nFiles, stf::std2wx(progStr.str()))) {
+                cancelled = true;
+                for (std::size_t n = 0; n < nFiles; ++n) {
+                    progress[n]->Cancel();
+                }
+            }
+            wxMilliSleep(20);
+        }
+        for (std::size_t nt = 0; nt < threads.size(); ++nt) {
+            threads[nt]->Wait();
+            delete threads[nt];
+        }
+    }
+
+    for (std::size_t n = 0; n < nFiles; ++n) {
+        delete progress[n];
+    }
+    if (cancelled) {
+        ReturnData.clear();
+        return false;
+    }
+    return true;
+}
+
 std::string stf::wx2std(const wxString& wxs) {
 #if (wxCHECK_VERSION(2, 9, 0) || defined(MODULE_ONLY))
     return wxs.ToStdString();
@@ -89,13 +301,35 @@ stf::SectionPointer::SectionPointer(Section* pSec, const stf::SectionAttributes&
     pSection(pSec), sec_attr(sa)
 {}
 
-stf::Event::Event(std::size_t start, std::size_t peak, std::size_t size, wxCheckBox* cb) :
-    eventStartIndex(start), eventPeakIndex(peak), eventSize(size), checkBox(cb)
-{
-    checkBox->Show(true);
-    checkBox->SetValue(true);
+void stf::EventList::clear() {
+    starts.clear();
+    peaks.clear();
+    sizes.clear();
+    discard.clear();
+    maxSize = 0;
 }
 
-stf::Event::~Event()
-{
+void stf::EventList::reserve(std::size_t n) {
+    starts.reserve(n);
+    peaks.reserve(n);
+    sizes.reserve(n);
+    discard.reserve(n);
+}
+
+std::size_t stf::EventList::insert(std::size_t start, std::size_t peak, std::size_t size) {
+    // detected events arrive in order, so this is usually an append:
+    std::size_t n = starts.size();
+    if (!starts.empty() && start < starts.back()) {
+        n = std::upper_bound(starts.begin(), starts.end(), start) - starts.begin();
+    }
+    starts.insert(starts.begin()+n, start);
+    peaks.insert(peaks.begin()+n, peak);
+    sizes.insert(sizes.begin()+n, size);
+    discard.insert(discard.begin()+n, (char)0);
+    maxSize = std::max(maxSize, size);
+    return n;
+}
+
+std::size_t stf::EventList::LowerBound(std::size_t start) const {
+    return std::lower_bound(starts.begin(), starts.end(), start) - starts.begin();
 }
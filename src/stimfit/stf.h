@@ -73,6 +73,7 @@
 
     #include <wx/wfstream.h>
     #include <wx/progdlg.h>
+    #include <wx/thread.h>
     //! child frame type; depends on whether aui is used for the doc/view interface
     // typedef wxDocChildFrameAny<wxAuiMDIChildFrame, wxAuiMDIParentFrame> wxStfChildType;
     typedef wxDocMDIChildFrame wxStfChildType;
@@ -108,6 +109,55 @@ private:
     wxProgressDialog pd;
 };
 
+//! Progress Info interface adapter for worker threads
+/*! Update() can be called from any thread and never touches the GUI.
+ *  The GUI thread reads the progress with Get() and stops the worker
+ *  with Cancel(), which is passed on through the return value and the
+ *  skip argument of Update().
+ */
+class wxThreadProgressInfo : public stfio::ProgressInfo {
+public:
+    wxThreadProgressInfo(const std::string& title, const std::string& message, int maximum, bool verbose=true);
+    bool Update(int value, const std::string& newmsg="", bool* skip=NULL);
+
+    //! Retrieves the most recent progress.
+    /*! \param value On return, the value of the progress meter.
+     *  \param msg On return, the info text.
+     */
+    void Get(int& value, std::string& msg);
+
+    //! Asks the worker thread to stop.
+    void Cancel();
+
+    //! Tells whether Cancel() has been called.
+    bool IsCancelled();
+
+private:
+    wxCriticalSection cs;
+    int progress;
+    std::string message;
+    bool cancelled;
+};
+
+//! Imports files in worker threads while the GUI stays responsive.
+/*! Up to one file per CPU is read at the same time. A progress dialog
+ *  shows the overall progress and allows the user to cancel the import.
+ *  \param fNames Full paths of the files.
+ *  \param types File types, one per file.
+ *  \param txtImport The text import filter settings.
+ *  \param title Title of the progress dialog.
+ *  \param ReturnData On return, contains one recording per file.
+ *  \param errors On return, contains an error message for each file that
+ *         couldn't be read, or an empty string.
+ *  \return false if the user has cancelled the import.
+ */
+bool importFilesAsync(const std::vector<std::string>& fNames,
+                      const std::vector<stfio::filetype>& types,
+                      const stfio::txtImportSettings& txtImport,
+                      const std::string& title,
+                      std::vector<Recording>& ReturnData,
+                      std::vector<std::string>& errors);
+
 std::string wx2std(const wxString& wxs);
 wxString std2wx(const std::string& sst);
  
@@ -255,60 +305,86 @@ struct ofstreamMan {
     wxFFile myStream;
 };
  
-//! Describes the attributes of an event.
-class Event {
+//! The events of a section, stored column by column.
+/*! Events are kept in the order of their start indices. Nothing but the
+ *  indices and the discard flags is stored per event, so that long
+ *  recordings with many events stay cheap to detect and to draw.
+ */
+class StfDll EventList {
 public:
     //! Constructor
-    explicit Event(std::size_t start, std::size_t peak, std::size_t size, wxCheckBox* cb);
-    
-    //! Destructor
-    ~Event();
+    EventList() : maxSize(0) {}
+
+    //! Retrieves the number of events.
+    /*! \return The number of events. */
+    std::size_t size() const { return starts.size(); }
+
+    //! Indicates whether there are no events.
+    /*! \return true if there are no events. */
+    bool empty() const { return starts.empty(); }
+
+    //! Removes all events.
+    void clear();
+
+    //! Reserves memory for a number of events.
+    /*! \param n The number of events. */
+    void reserve(std::size_t n);
+
+    //! Adds an event, keeping the events in the order of their start indices.
+    /*! The event is not discarded.
+     *  \param start The start index of the event within a section.
+     *  \param peak The index of the event's peak within a section.
+     *  \param size The size of the event in units of data points.
+     *  \return The index of the new event.
+     */
+    std::size_t insert(std::size_t start, std::size_t peak, std::size_t size);
+
+    //! Retrieves the index of the first event that starts at or after a position.
+    /*! \param start A position within a section.
+     *  \return The index of the event, or size() if there is none.
+     */
+    std::size_t LowerBound(std::size_t start) const;
 
     //! Retrieves the start index of an event.
-    /*! \return The start index of an event within a section. */
-    std::size_t GetEventStartIndex() const { return eventStartIndex; }
+    /*! \param n The index of the event.
+     *  \return The start index of an event within a section. */
+    std::size_t GetEventStartIndex(std::size_t n) const { return starts.at(n); }
 
     //! Retrieves the index of an event's peak.
-    /*! \return The index of an event's peak within a section. */
-    std::size_t GetEventPeakIndex() const { return eventPeakIndex; }
+    /*! \param n The index of the event.
+     *  \return The index of an event's peak within a section. */
+    std::size_t GetEventPeakIndex(std::size_t n) const { return peaks.at(n); }
 
     //! Retrieves the size of an event.
-    /*! \return The size of an event in units of data points. */
-    std::size_t GetEventSize() const { return eventSize; }
-
-    //! Indicates whether an event should be discarded.
-    /*! \return true if it should be discarded, false otherwise. */
-    bool GetDiscard() const { return !checkBox->GetValue(); }
+    /*! \param n The index of the event.
+     *  \return The size of an event in units of data points. */
+    std::size_t GetEventSize(std::size_t n) const { return sizes.at(n); }
 
-    //! Get the check box associated with this event
-    /*! \return The wxCheckBox associated with this event  */
-    wxCheckBox* GetCheckBox() {return checkBox;}
+    //! Retrieves the largest size of all events.
+    /*! \return The largest event size in units of data points. */
+    std::size_t GetMaxEventSize() const { return maxSize; }
 
-    //! Sets the start index of an event.
-    /*! \param value The start index of an event within a section. */
-    void SetEventStartIndex( std::size_t value ) { eventStartIndex = value; }
+    //! Indicates whether an event should be discarded.
+    /*! \param n The index of the event.
+     *  \return true if it should be discarded, false otherwise. */
+    bool GetDiscard(std::size_t n) const { return discard.at(n) != 0; }
 
     //! Sets the index of an event's peak.
-    /*! \param value The index of an event's peak within a section. */
-    void SetEventPeakIndex( std::size_t value ) { eventPeakIndex = value; }
-
-    //! Sets the size of an event.
-    /*! \param value The size of an event in units of data points. */
-    void SetEventSize( std::size_t value ) { eventSize = value; }
+    /*! \param n The index of the event.
+     *  \param value The index of an event's peak within a section. */
+    void SetEventPeakIndex(std::size_t n, std::size_t value) { peaks.at(n) = value; }
 
     //! Determines whether an event should be discarded.
-    /*! \param true if it should be discarded, false otherwise. */
-    /*void SetDiscard( bool value ) { discard = value; }*/
-
-    //! Sets discard to true if it was false and vice versa.
-    /*void ToggleStatus() { discard = !discard; }*/
+    /*! \param n The index of the event.
+     *  \param value true if it should be discarded, false otherwise. */
+    void SetDiscard(std::size_t n, bool value) { discard.at(n) = value; }
 
 private:
-    std::size_t eventStartIndex;
-    std::size_t eventPeakIndex;
-    std::size_t eventSize;
-    wxCheckBox* checkBox;
-
+    std::vector<std::size_t> starts;
+    std::vector<std::size_t> peaks;
+    std::vector<std::size_t> sizes;
+    std::vector<char> discard;
+    std::size_t maxSize;
 };
 
 //! A marker that can be set from Python
@@ -326,7 +402,7 @@ struct PyMarker {
 
 struct StfDll SectionAttributes {
     SectionAttributes();
-    std::vector<stf::Event> eventList;
+    stf::EventList eventList;
     std::vector<stf::PyMarker> pyMarkers;
     bool isFitted,isIntegrated;
     stfnum::storedFunc *fitFunc;
@@ -376,15 +452,14 @@ enum zoom_channels {
     zoomboth /*!< Scaling applies to both channels. */
 };
 
-//! Latency cursor settings
-enum latency_mode {
-    manualMode = 0, /*!< Set the corresponding latency cursor manually (by clicking on the graph). */ 
-    peakMode = 1,   /*!< Set the corresponding latency cursor to the peak. */ 
-    riseMode = 2,   /*!< Set the corresponding latency cursor to the maximal slope of rise. */ 
-    halfMode = 3,   /*!< Set the corresponding latency cursor to the half-maximal amplitude. */ 
-    footMode = 4,    /*!< Set the corresponding latency cursor to the beginning of an event. */ 
-    undefinedMode   /*!< undefined mode. */
-};
+//! Latency cursor settings; measured by stfnum::measure().
+typedef stfnum::latency_mode latency_mode;
+using stfnum::manualMode;
+using stfnum::peakMode;
+using stfnum::riseMode;
+using stfnum::halfMode;
+using stfnum::footMode;
+using stfnum::undefinedMode;
 
 //! Latency window settings
 enum latency_window_mode {
@@ -394,22 +469,20 @@ enum latency_window_mode {
 
 #ifdef WITH_PSLOPE
 //! PSlope start cursor settings
-enum pslope_mode_beg {
-    psBeg_manualMode =0,    /*< Set the start Slope cursor manually. */
-    psBeg_footMode   =1,    /*< Set the start Slope cursor to the beginning of an event. */
-    psBeg_thrMode    =2,    /*< Set the start Slope cursor to a threshold. */
-    psBeg_t50Mode    =3,    /*< Set the start Slope cursor to the half-width of an event*/
-    psBeg_undefined
-};
+typedef stfnum::pslope_mode_beg pslope_mode_beg;
+using stfnum::psBeg_manualMode;
+using stfnum::psBeg_footMode;
+using stfnum::psBeg_thrMode;
+using stfnum::psBeg_t50Mode;
+using stfnum::psBeg_undefined;
 
 //! PSlope end cursor settings
-enum pslope_mode_end {
-    psEnd_manualMode =0,    /*< Set the end Slope cursor manually. */
-    psEnd_t50Mode    =1,    /*< Set the Slope cursor to the half-width of an event. */
-    psEnd_DeltaTMode =2,    /*< Set the Slope cursor to a given distance from the first cursor. */
-    psEnd_peakMode   =3,    /*< Set the Slope cursor to the peak. */
-    psEnd_undefined
-};
+typedef stfnum::pslope_mode_end pslope_mode_end;
+using stfnum::psEnd_manualMode;
+using stfnum::psEnd_t50Mode;
+using stfnum::psEnd_DeltaTMode;
+using stfnum::psEnd_peakMode;
+using stfnum::psEnd_undefined;
 
 #endif // WITH_PSLOPE
 
@@ -430,8 +503,6 @@ inline int stf::round(double toRound) {
 
 typedef std::vector< wxString >::iterator       wxs_it;      /*!< std::string iterator */
 typedef std::vector< wxString >::const_iterator c_wxs_it;    /*!< constant std::string iterator */
-typedef std::vector< stf::Event      >::iterator       event_it;    /*!< stf::Event iterator */
-typedef std::vector< stf::Event      >::const_iterator c_event_it;  /*!< constant stf::Event iterator */
 typedef std::vector< stf::PyMarker   >::iterator       marker_it;   /*!< stf::PyMarker iterator */
 typedef std::vector< stf::PyMarker   >::const_iterator c_marker_it; /*!< constant stf::PyMarker iterator */
 
@@ -0,0 +1,119 @@
+#include "../libstfio/stfio.h"
+#include "../libstfio/atf/atflib.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+
+// Writes the text to a temporary file and imports it as an ATF file:
+Recording import_atf_text(const std::string& text)
+{
+    const std::string fName("stimfittest_import.atf");
+    {
+        std::ofstream file(fName.c_str(), std::ios::binary);
+        file << text;
+    }
+    Recording rec;
+    stfio::StdoutProgressInfo progDlg("Importing ATF file", "", 100, false);
+    try {
+        stfio::importATFFile(fName, rec, progDlg);
+    }
+    catch (...) {
+        std::remove(fName.c_str());
+        throw;
+    }
+    std::remove(fName.c_str());
+    return rec;
+}
+
+TEST(ATF_test, tab_separated)
+{
+    Recording rec = import_atf_text(
+        "ATF\t1.0\n"
+        "0\t3\n"
+        "\"Time (ms)\"\t\"Trace #1 (pA)\"\t\"Trace #2 (pA)\"\n"
+        "0\t1.5\t-2\n"
+        "0.05\t2.25\t-3.125\n"
+        "0.1\t3\t-4\n");
+    ASSERT_EQ( rec.size(), 1 );
+    // the time column only sets the sampling interval:
+    ASSERT_EQ( rec[0].size(), 2 );
+    ASSERT_EQ( rec[0][0].size(), 3 );
+    EXPECT_DOUBLE_EQ( rec.GetXScale(), 0.05 );
+    EXPECT_EQ( rec[0].GetYUnits(), "pA" );
+    EXPECT_DOUBLE_EQ( rec[0][0][0], 1.5 );
+    EXPECT_DOUBLE_EQ( rec[0][0][1], 2.25 );
+    EXPECT_DOUBLE_EQ( rec[0][0][2], 3.0 );
+    EXPECT_DOUBLE_EQ( rec[0][1][0], -2.0 );
+    EXPECT_DOUBLE_EQ( rec[0][1][1], -3.125 );
+    EXPECT_DOUBLE_EQ( rec[0][1][2], -4.0 );
+}
+
+TEST(ATF_test, comma_separated)
+{
+    // no time column, CRLF line ends and blanks around the values:
+    Recording rec = import_atf_text(
+        "ATF,1.0\r\n"
+        "0,2\r\n"
+        "\"Trace #1 (mV)\",\"Trace #2 (mV)\"\r\n"
+        "1, 2\r\n"
+        " 3 ,4\r\n");
+    ASSERT_EQ( rec.size(), 1 );
+    ASSERT_EQ( rec[0].size(), 2 );
+    ASSERT_EQ( rec[0][0].size(), 2 );
+    EXPECT_EQ( rec[0].GetYUnits(), "mV" );
+    EXPECT_DOUBLE_EQ( rec[0][0][0], 1.0 );
+    EXPECT_DOUBLE_EQ( rec[0][0][1], 3.0 );
+    EXPECT_DOUBLE_EQ( rec[0][1][0], 2.0 );
+    EXPECT_DOUBLE_EQ( rec[0][1][1], 4.0 );
+}
+
+TEST(ATF_test, optional_header)
+{
+    // the data start after the optional header records and stop at the
+    // first empty line:
+    Recording rec = import_atf_text(
+        "ATF\t1.0\n"
+        "2\t2\n"
+        "\"AcquisitionMode=Episodic Stimulation\"\n"
+        "\"Comment=1, 2\"\n"
+        "\"Time (s)\"\t\"Trace #1 (nA)\"\n"
+        "0\t1\n"
+        "1e-4\t2\n"
+        "\n"
+        "2e-4\t3\n");
+    ASSERT_EQ( rec.size(), 1 );
+    ASSERT_EQ( rec[0].size(), 1 );
+    ASSERT_EQ( rec[0][0].size(), 2 );
+    EXPECT_DOUBLE_EQ( rec.GetXScale(), 1e-4 );
+    EXPECT_EQ( rec[0].GetYUnits(), "nA" );
+    EXPECT_DOUBLE_EQ( rec[0][0][1], 2.0 );
+}
+
+TEST(ATF_test, columns)
+{
+    // exponents, long mantissas, unreadable and missing values:
+    Recording rec = import_atf_text(
+        "ATF\t1.0\n"
+        "0\t3\n"
+        "\"Trace #1 (pA)\"\t\"Trace #2 (pA)\"\t\"Trace #3 (pA)\"\n"
+        "1.5e3\t-2.5E-2\t+7\n"
+        "0.12345678901234567890\tn/a\t8\n"
+        "12345678901234567890\t3\n");
+    ASSERT_EQ( rec.size(), 1 );
+    ASSERT_EQ( rec[0].size(), 3 );
+    ASSERT_EQ( rec[0][0].size(), 3 );
+    EXPECT_DOUBLE_EQ( rec[0][0][0], 1500.0 );
+    EXPECT_DOUBLE_EQ( rec[0][1][0], -0.025 );
+    EXPECT_DOUBLE_EQ( rec[0][2][0], 7.0 );
+    EXPECT_DOUBLE_EQ( rec[0][0][1], 0.12345678901234567890 );
+    EXPECT_DOUBLE_EQ( rec[0][1][1], 0.0 );
+    EXPECT_DOUBLE_EQ( rec[0][2][1], 8.0 );
+    EXPECT_DOUBLE_EQ( rec[0][0][2], 12345678901234567890.0 );
+    EXPECT_DOUBLE_EQ( rec[0][1][2], 3.0 );
+    EXPECT_DOUBLE_EQ( rec[0][2][2], 0.0 );
+}
+
+TEST(ATF_test, exceptions)
+{
+    EXPECT_THROW( import_atf_text("no ATF file\n"), std::runtime_error );
+}
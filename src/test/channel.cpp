@@ -40,3 +40,38 @@ TEST(Channel_test, data_access)
     EXPECT_THROW( ch3.at( ch3.size() ), std::out_of_range );
     EXPECT_THROW( ch3[ch3.size()-1].at(ch3[ch3.size()-1].size()), std::out_of_range );
 }
+
+TEST(Channel_test, move_insertion)
+{
+    // the data points are taken over, not copied:
+    Vector_double data(32768, 1.0);
+    const double* buffer = &data[0];
+    Section sec(std::move(data), "moved");
+    EXPECT_EQ( &sec.get()[0], buffer );
+    EXPECT_EQ( sec.GetSectionDescription(), "moved" );
+
+    Channel ch(4);
+    ch.InsertSection(std::move(sec), 2);
+    EXPECT_EQ( &ch[2].get()[0], buffer );
+    EXPECT_THROW( ch.InsertSection(Section(16), 4), std::out_of_range );
+
+    Recording rec(2);
+    rec.InsertChannel(std::move(ch), 1);
+    EXPECT_EQ( &rec[1][2].get()[0], buffer );
+    EXPECT_EQ( rec[1].size(), 4 );
+    EXPECT_DOUBLE_EQ( rec[1][2][100], 1.0 );
+
+    Recording moved(std::move(rec));
+    EXPECT_EQ( &moved[1][2].get()[0], buffer );
+
+    // copies share the data points until they are written to:
+    Channel copy(moved[1]);
+    EXPECT_EQ( &copy[2].get()[0], buffer );
+    copy[2][0] = 2.0;
+    EXPECT_NE( &copy[2].get()[0], buffer );
+    EXPECT_DOUBLE_EQ( moved[1][2][0], 1.0 );
+    Section sec2(16);
+    copy.InsertSection(sec2, 0);
+    EXPECT_EQ( sec2.size(), 16 );
+    EXPECT_THROW( moved.InsertChannel(std::move(copy), 2), std::out_of_range );
+}
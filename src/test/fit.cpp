@@ -922,3 +922,96 @@ TEST(fitlib_test, id_12_fgaussian){
     //data.clear();
 
 }
+
+//=========================================================================
+// Tests fitting several traces at once; the result has to be
+// identical to fitting each trace on its own
+//=========================================================================
+TEST(fitlib_test, batch_monoexponential){
+
+    const int n_traces = 8;
+    std::vector<Vector_double> data(n_traces);
+    std::vector<Vector_double> mypars(n_traces, Vector_double(3));
+    std::vector<Vector_double> pars(n_traces, Vector_double(3));
+    for (int n = 0; n < n_traces; ++n) {
+        mypars[n][0] = 50.0 + 5.0*n;   /* amplitude */
+        mypars[n][1] = 10.0 + 2.0*n;   /* time constant */
+        mypars[n][2] = -20.0 + n;      /* end  */
+        data[n] = fexp_simple(mypars[n]);
+
+        /* Initial parameters guesses */
+        pars[n][0] = 0.0;
+        pars[n][1] = 5.0;
+        pars[n][2] = -35.0;
+    }
+    std::vector<Vector_double> pars_single(pars);
+
+    std::vector<std::string> info;
+    std::vector<int> warning;
+
+    Vector_double chisqr = stfnum::lmFitBatch(data, dt, funcLib[0], opts,
+        true, /* use_scaling */
+        pars, info, warning );
+
+    EXPECT_EQ(chisqr.size(), (std::size_t)n_traces);
+    for (int n = 0; n < n_traces; ++n) {
+        std::string info_single;
+        int warning_single;
+        double chisqr_single = stfnum::lmFit(data[n], dt, funcLib[0], opts,
+            true, pars_single[n], info_single, warning_single );
+
+        EXPECT_EQ(warning[n], 0);
+        EXPECT_EQ(warning[n], warning_single);
+        EXPECT_DOUBLE_EQ(chisqr[n], chisqr_single);
+        for (int n_p = 0; n_p < 3; ++n_p) {
+            EXPECT_DOUBLE_EQ(pars[n][n_p], pars_single[n][n_p]);
+            par_test(pars[n][n_p], mypars[n][n_p], tol);
+        }
+    }
+
+    /* A mismatching number of parameter sets must be rejected */
+    pars.pop_back();
+    EXPECT_THROW(stfnum::lmFitBatch(data, dt, funcLib[0], opts, true,
+                                    pars, info, warning ), std::out_of_range);
+}
+
+//=========================================================================
+// Tests that the batch evaluators of the function library give the
+// same results as evaluating the functions point by point
+//=========================================================================
+TEST(fitlib_test, batch_evaluators){
+
+    const std::size_t n = 1000;
+    const double dx = 0.05;
+    for (std::size_t n_f = 0; n_f < funcLib.size(); ++n_f) {
+        const stfnum::storedFunc& f = funcLib[n_f];
+        if (!f.funcBatch) {
+            continue;
+        }
+
+        /* positive parameters that keep all functions finite */
+        Vector_double pars(f.pInfo.size());
+        for (std::size_t n_p = 0; n_p < pars.size(); ++n_p) {
+            pars[n_p] = 1.0 + 0.75*n_p;
+        }
+
+        Vector_double hx(n);
+        f.funcBatch(dx, pars, &hx[0], n);
+        for (std::size_t n_x = 0; n_x < n; ++n_x) {
+            double y = f.func((double)n_x*dx, pars);
+            EXPECT_NEAR(hx[n_x], y, 1e-12*(1.0+fabs(y))) << f.name;
+        }
+
+        if (!f.jacBatch) {
+            continue;
+        }
+        Vector_double jac(n*pars.size());
+        f.jacBatch(dx, pars, &jac[0], n);
+        for (std::size_t n_x = 0; n_x < n; ++n_x) {
+            Vector_double j = f.jac((double)n_x*dx, pars);
+            for (std::size_t n_p = 0; n_p < pars.size(); ++n_p) {
+                EXPECT_NEAR(jac[n_x*pars.size()+n_p], j[n_p], 1e-12*(1.0+fabs(j[n_p]))) << f.name;
+            }
+        }
+    }
+}
@@ -0,0 +1,214 @@
+#include "../libstfio/stfio.h"
+#include "../libstfio/hdf5/hdf5lib.h"
+#include "hdf5.h"
+#include "hdf5_hl.h"
+#include <cmath>
+#include <sstream>
+#include <cstdio>
+#include <gtest/gtest.h>
+
+const static std::string h5_name("stimfittest_export.h5");
+
+// Two channels with sections of different lengths; all values can be
+// represented exactly as float32:
+Recording h5_recording()
+{
+    Recording rec(2, 3, 0);
+    for (std::size_t n_c=0; n_c < rec.size(); ++n_c) {
+        rec[n_c].SetChannelName(n_c ? "IN 1" : "IN 0");
+        rec[n_c].SetYUnits(n_c ? "pA" : "mV");
+        for (std::size_t n_s=0; n_s < rec[n_c].size(); ++n_s) {
+            std::ostringstream label;
+            label << "Section " << n_s;
+            Section sec(100 + n_s*17, label.str());
+            for (std::size_t n=0; n < sec.size(); ++n) {
+                sec[n] = (n_c+1.0) * (0.25*n - 10.0*n_s);
+            }
+            rec[n_c].InsertSection(sec, n_s);
+        }
+    }
+    rec.SetXScale(0.05);
+    return rec;
+}
+
+// The legacy layout names the sections by their index instead of keeping their descriptions:
+void expect_same_recording(const Recording& expected, const Recording& rec, bool descriptions = true)
+{
+    ASSERT_EQ( rec.size(), expected.size() );
+    EXPECT_DOUBLE_EQ( rec.GetXScale(), expected.GetXScale() );
+    for (std::size_t n_c=0; n_c < expected.size(); ++n_c) {
+        EXPECT_EQ( rec[n_c].GetChannelName(), expected[n_c].GetChannelName() );
+        EXPECT_EQ( rec[n_c].GetYUnits(), expected[n_c].GetYUnits() );
+        ASSERT_EQ( rec[n_c].size(), expected[n_c].size() );
+        for (std::size_t n_s=0; n_s < expected[n_c].size(); ++n_s) {
+            const Section& sec = rec[n_c][n_s];
+            ASSERT_EQ( sec.size(), expected[n_c][n_s].size() );
+            if (descriptions) {
+                EXPECT_EQ( sec.GetSectionDescription(), expected[n_c][n_s].GetSectionDescription() );
+            }
+            for (std::size_t n=0; n < sec.size(); ++n) {
+                EXPECT_DOUBLE_EQ( sec[n], expected[n_c][n_s][n] );
+            }
+        }
+    }
+}
+
+// Writes the recording with the given options and reads it back:
+Recording h5_round_trip(const Recording& rec, const stfio::HDF5Options& options)
+{
+    stfio::StdoutProgressInfo progDlg("HDF5 test", "", 100, false);
+    EXPECT_TRUE( stfio::exportHDF5File(h5_name, rec, progDlg, options) );
+    Recording ReturnData;
+    stfio::importHDF5File(h5_name, ReturnData, progDlg);
+    return ReturnData;
+}
+
+void expect_reader(const Recording& rec, stfio::hdf5_layout layout)
+{
+    stfio::HDF5Reader reader(h5_name);
+    EXPECT_EQ( reader.GetLayout(), layout );
+    ASSERT_EQ( reader.size(), rec.size() );
+    std::size_t n_c = rec.size()-1;
+    EXPECT_EQ( reader.GetChannelName(n_c), rec[n_c].GetChannelName() );
+    ASSERT_EQ( reader.size(n_c), rec[n_c].size() );
+    ASSERT_EQ( reader.size(n_c, 2), rec[n_c][2].size() );
+    Vector_double window(reader.read(n_c, 2, 10, 20));
+    ASSERT_EQ( window.size(), 20 );
+    for (std::size_t n=0; n < window.size(); ++n) {
+        EXPECT_DOUBLE_EQ( window[n], rec[n_c][2][10+n] );
+    }
+    EXPECT_EQ( reader.read(n_c, 2).size(), rec[n_c][2].size() );
+    EXPECT_THROW( reader.read(n_c, 2, rec[n_c][2].size()-5, 10), std::out_of_range );
+    EXPECT_THROW( reader.size(rec.size()), std::out_of_range );
+}
+
+TEST(HDF5_test, chunked)
+{
+    Recording rec(h5_recording());
+    stfio::HDF5Options options;
+    EXPECT_EQ( options.layout, stfio::hdf5_chunked );
+    expect_same_recording(rec, h5_round_trip(rec, options));
+    expect_reader(rec, stfio::hdf5_chunked);
+    std::remove(h5_name.c_str());
+}
+
+TEST(HDF5_test, deflate_shuffle)
+{
+    Recording rec(h5_recording());
+    stfio::HDF5Options options;
+    options.deflate = 4;
+    options.shuffle = true;
+    expect_same_recording(rec, h5_round_trip(rec, options));
+    expect_reader(rec, stfio::hdf5_chunked);
+    std::remove(h5_name.c_str());
+
+    options.deflate = 10;
+    stfio::StdoutProgressInfo progDlg("HDF5 test", "", 100, false);
+    EXPECT_THROW( stfio::exportHDF5File(h5_name, rec, progDlg, options), std::out_of_range );
+}
+
+TEST(HDF5_test, legacy)
+{
+    Recording rec(h5_recording());
+    stfio::HDF5Options options;
+    options.layout = stfio::hdf5_legacy;
+    expect_same_recording(rec, h5_round_trip(rec, options), false);
+    expect_reader(rec, stfio::hdf5_legacy);
+    std::remove(h5_name.c_str());
+}
+
+TEST(HDF5_test, mapped)
+{
+    // 16-bit samples in a memory-mapped file are written as integers:
+    const std::string raw_name("stimfittest_export.raw");
+    {
+        FILE* fh = fopen(raw_name.c_str(), "wb");
+        ASSERT_TRUE( fh != NULL );
+        for (short n=0; n < 600; ++n) {
+            short raw = n - 300;
+            fwrite(&raw, sizeof(short), 1, fh);
+        }
+        fclose(fh);
+    }
+    Recording rec(1, 3, 0);
+    {
+        stfio::MappedFilePtr file(new stfio::MappedFile(raw_name));
+        for (std::size_t n_s=0; n_s < rec[0].size(); ++n_s) {
+            stfio::RawSamples raw(file, n_s*400, sizeof(short), 200, stfio::sample_int16,
+                                  false, 0.5, 1.0);
+            rec[0].InsertSection(Section(raw, "mapped"), n_s);
+        }
+    }
+    rec[0].SetChannelName("IN 0");
+    rec[0].SetYUnits("mV");
+    rec.SetXScale(0.1);
+
+    // Large files are memory-mapped when they are read, unless they are compressed:
+    std::size_t threshold = stfio::GetMappingThreshold();
+    stfio::SetMappingThreshold(1);
+    const stfio::hdf5_layout layouts[] = {stfio::hdf5_chunked, stfio::hdf5_legacy};
+    for (int n_l=0; n_l < 2; ++n_l) {
+        stfio::HDF5Options options;
+        options.layout = layouts[n_l];
+        Recording ReturnData(h5_round_trip(rec, options));
+        expect_same_recording(rec, ReturnData, layouts[n_l] != stfio::hdf5_legacy);
+        EXPECT_TRUE( ReturnData[0][1].is_mapped() );
+        expect_reader(ReturnData, layouts[n_l]);
+    }
+    stfio::HDF5Options options;
+    options.deflate = 1;
+    Recording ReturnData(h5_round_trip(rec, options));
+    expect_same_recording(rec, ReturnData);
+    EXPECT_FALSE( ReturnData[0][1].is_mapped() );
+    stfio::SetMappingThreshold(threshold);
+
+    std::remove(h5_name.c_str());
+    std::remove(raw_name.c_str());
+}
+
+TEST(HDF5_test, unknown_layout)
+{
+    Recording rec(h5_recording());
+    stfio::StdoutProgressInfo progDlg("HDF5 test", "", 100, false);
+    ASSERT_TRUE( stfio::exportHDF5File(h5_name, rec, progDlg) );
+    hid_t file_id = H5Fopen(h5_name.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+    ASSERT_GE( file_id, 0 );
+    int layout = 3;
+    H5LTset_attribute_int(file_id, "/", "stfio_layout", &layout, 1);
+    H5Fclose(file_id);
+
+    Recording ReturnData;
+    EXPECT_THROW( stfio::importHDF5File(h5_name, ReturnData, progDlg), std::runtime_error );
+    EXPECT_THROW( stfio::HDF5Reader reader(h5_name), std::runtime_error );
+    std::remove(h5_name.c_str());
+}
+
+TEST(HDF5_test, unknown_export_layout)
+{
+    Recording rec(h5_recording());
+    stfio::StdoutProgressInfo progDlg("HDF5 test", "", 100, false);
+    stfio::HDF5Options options;
+    options.layout = (stfio::hdf5_layout)3;
+    EXPECT_THROW( stfio::exportHDF5File(h5_name, rec, progDlg, options), std::runtime_error );
+    std::remove(h5_name.c_str());
+}
+
+TEST(HDF5_test, open_reader)
+{
+    // importing and exporting other files must not close the reader:
+    Recording rec(h5_recording());
+    stfio::StdoutProgressInfo progDlg("HDF5 test", "", 100, false);
+    ASSERT_TRUE( stfio::exportHDF5File(h5_name, rec, progDlg) );
+    stfio::HDF5Reader reader(h5_name);
+    const std::string other_name("stimfittest_other.h5");
+    ASSERT_TRUE( stfio::exportHDF5File(other_name, rec, progDlg) );
+    Recording ReturnData;
+    stfio::importHDF5File(other_name, ReturnData, progDlg);
+    std::remove(other_name.c_str());
+    Vector_double window(reader.read(0, 1, 5, 10));
+    ASSERT_EQ( window.size(), 10 );
+    for (std::size_t n=0; n < window.size(); ++n) {
+        EXPECT_DOUBLE_EQ( window[n], rec[0][1][5+n] );
+    }
+    std::remove(h5_name.c_str());
+}
@@ -0,0 +1,193 @@
+#include "../libstfio/stfio.h"
+#include "../libstfio/intan/intanlib.h"
+#include "../libstfio/intan/streams.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+
+const static std::string intan_name("stimfittest_import.clp");
+
+// Little-endian fields of a CLAMP file:
+void put_bytes(std::string& buf, unsigned long long value, int n)
+{
+    for (int b = 0; b < n; ++b) {
+        buf += (char)((value >> (8*b)) & 0xff);
+    }
+}
+
+void put_float(std::string& buf, float value)
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_bytes(buf, bits, 4);
+}
+
+// Pseudo-random numbers that don't depend on the platform:
+unsigned int next_random(unsigned int& seed)
+{
+    seed = seed*1103515245u + 12345u;
+    return seed >> 8;
+}
+
+// Writes a CLAMP file without chips and waveform segments, and returns the
+// size of its header. datatype 0 holds both channels of the amplifier,
+// datatype 1 holds three auxiliary ADCs. The data end with a partial record.
+std::size_t write_intan_file(int datatype, bool voltage_clamp, std::size_t n_records)
+{
+    std::string header;
+    put_bytes(header, 0xf3b1a481, 4);
+    put_bytes(header, 1, 2);
+    put_bytes(header, 0, 2);
+    put_bytes(header, datatype, 2);
+    std::string body;
+    const int date[] = {2017, 3, 11, 10, 20, 30};
+    for (int n = 0; n < 6; ++n) {
+        put_bytes(body, date[n], 2);
+    }
+    if (datatype == 1) {
+        put_bytes(header, 3, 2);
+        put_bytes(header, header.size() + 2 + body.size() + 4, 2);
+        put_float(body, 20000.0f);
+        header += body;
+    } else {
+        // no chips, then the settings:
+        put_bytes(body, 0, 2);
+        put_bytes(body, 0, 2);
+        put_bytes(body, 1, 1);
+        for (int n = 0; n < 7; ++n) {
+            put_float(body, 1.0f);
+        }
+        put_bytes(body, voltage_clamp ? 1 : 0, 1);
+        put_bytes(body, 0, 1);
+        for (int n = 0; n < (voltage_clamp ? 5 : 2); ++n) {
+            put_float(body, 1.0f);
+        }
+        put_float(body, 1.0f);
+        put_bytes(body, 0, 2);
+        put_bytes(header, header.size() + 2 + body.size(), 2);
+        header += body;
+    }
+
+    std::string data;
+    unsigned int seed = 1;
+    for (std::size_t n = 0; n < n_records; ++n) {
+        put_bytes(data, n, 4);
+        if (datatype == 1) {
+            put_bytes(data, 0, 2);
+            put_bytes(data, 0, 2);
+            for (int n_adc = 0; n_adc < 3; ++n_adc) {
+                put_bytes(data, next_random(seed) & 0xffff, 2);
+            }
+        } else {
+            put_float(data, (next_random(seed) % 2001 - 1000.0f) * 1e-3f);
+            put_float(data, (next_random(seed) % 2001 - 1000.0f) * 1e-4f);
+            put_float(data, (next_random(seed) % 2001 - 1000.0f) * 1e-12f);
+        }
+    }
+    data += "\x01\x02\x03";
+
+    std::ofstream file(intan_name.c_str(), std::ios::binary);
+    file << header << data;
+    return header.size();
+}
+
+// Reads the data records one field at a time, as importIntanFile() did before
+// it read them in blocks:
+std::vector<std::vector<float> > read_intan_records(std::size_t header_size, int datatype, bool voltage_clamp)
+{
+    unique_ptr<FileInStream> fs(new FileInStream());
+    fs->open(toFileName(intan_name));
+    BinaryReader binreader(std::move(fs));
+    std::vector<char> header(header_size);
+    binreader.read(&header[0], header_size);
+
+    uint64_t bytes_remaining = binreader.bytesRemaining();
+    if (datatype == 1) {
+        uint16_t numADCs = 3;
+        uint64_t length = bytes_remaining / (4+2+2+2*numADCs);
+        std::vector<uint32_t> timestamps(length);
+        std::vector<uint16_t> digitalIn(length);
+        std::vector<uint16_t> digitalOut(length);
+        std::vector<std::vector<float> > adc(numADCs);
+        for (unsigned int iadc = 0; iadc < numADCs; ++iadc) {
+            adc[iadc].resize(length);
+        }
+        for (unsigned int idata = 0; idata < length; ++idata) {
+            binreader >> timestamps[idata];
+            binreader >> digitalIn[idata];
+            binreader >> digitalOut[idata];
+            for (unsigned int iadc = 0; iadc < numADCs; ++iadc) {
+                uint16_t tmpui;
+                binreader >> tmpui;
+                adc[iadc][idata] = tmpui*0.0003125 - (1<<15);
+            }
+        }
+        return adc;
+    }
+
+    uint64_t length = bytes_remaining / (4+4+4+4);
+    std::vector<uint32_t> timestamps(length);
+    std::vector<float> applied(length);
+    std::vector<std::vector<float> > channels(2);
+    channels[0].resize(length);
+    channels[1].resize(length);
+    for (unsigned int idata = 0; idata < length; ++idata) {
+        binreader >> timestamps[idata];
+        binreader >> applied[idata];
+        binreader >> channels[1][idata];
+        binreader >> channels[0][idata];
+        float vfactor = 1e3; // V -> mV
+        float ifactor = 1e12; // A -> pA
+        if (voltage_clamp) {
+            channels[0][idata] *= ifactor;
+            channels[1][idata] *= vfactor;
+        } else {
+            channels[1][idata] *= ifactor;
+            channels[0][idata] *= vfactor;
+        }
+    }
+    return channels;
+}
+
+// The records are decoded in blocks of 1 MB; the files span several blocks:
+void expect_same_records(int datatype, bool voltage_clamp, std::size_t n_records)
+{
+    std::size_t header_size = write_intan_file(datatype, voltage_clamp, n_records);
+    std::vector<std::vector<float> > expected(read_intan_records(header_size, datatype, voltage_clamp));
+    Recording rec;
+    stfio::StdoutProgressInfo progDlg("Importing Intan file", "", 100, false);
+    stfio::importIntanFile(intan_name, rec, progDlg);
+    std::remove(intan_name.c_str());
+
+    // only the first ADC is imported from auxiliary data:
+    std::size_t n_channels = (datatype == 1) ? 1 : 2;
+    ASSERT_EQ( rec.size(), n_channels );
+    for (std::size_t n_c = 0; n_c < n_channels; ++n_c) {
+        ASSERT_EQ( rec[n_c].size(), 1 );
+        const Section& sec = rec[n_c][0];
+        ASSERT_EQ( sec.size(), n_records );
+        std::size_t n_diff = 0;
+        for (std::size_t n = 0; n < n_records; ++n) {
+            if (sec[n] != (double)expected[n_c][n]) {
+                ++n_diff;
+            }
+        }
+        EXPECT_EQ( n_diff, 0 );
+    }
+}
+
+TEST(Intan_test, voltage_clamp)
+{
+    expect_same_records(0, true, 150000);
+}
+
+TEST(Intan_test, current_clamp)
+{
+    expect_same_records(0, false, 70000);
+}
+
+TEST(Intan_test, aux_data)
+{
+    expect_same_records(1, false, 160000);
+}
@@ -1,6 +1,7 @@
 #include "../stimfit/stf.h"
 #include "../libstfnum/measure.h"
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #if (__cplusplus < 201103)
@@ -200,6 +201,81 @@ TEST(measlib_test, baseline_basic) {
 
 }
 
+//=========================================================================
+// test median and IQR against a sorted copy
+//=========================================================================
+TEST(measlib_test, baseline_median) {
+
+    std::vector<double> myrand = norm(1.0, 2.0);
+    for (int n=1; n<=64; ++n) {
+        std::vector<double> sorted(myrand.begin()+10, myrand.begin()+10+n);
+        std::sort(sorted.begin(), sorted.end());
+        double median = (sorted[(n-1)/2] + sorted[n/2]) / 2;
+        double q3 = (sorted[std::min<long>(n-1, (long)ceil(3*n/4.0-1))] +
+                     sorted[std::max<long>(0l, (long)floor(3*n/4.0-1))]) / 2;
+        double q1 = (sorted[std::min<long>(n-1, (long)ceil(n/4.0-1))] +
+                     sorted[std::max<long>(0l, (long)floor(n/4.0-1))]) / 2;
+
+        double var = 0;
+        EXPECT_EQ(median, stfnum::base(stfnum::median_iqr, var, myrand, 10, 10+n-1));
+        EXPECT_DOUBLE_EQ(q3-q1, var);
+    }
+}
+
+//=========================================================================
+// test running median against the median of each window
+//=========================================================================
+TEST(measlib_test, baseline_running_median) {
+
+    std::vector<double> myrand = norm(0.0, 1.0);
+    // repeated values, as in digitized data:
+    std::vector<double> digitized(myrand.size());
+    for (std::size_t i=0; i<myrand.size(); ++i) {
+        digitized[i] = floor(myrand[i]*4.0);
+    }
+    std::size_t widths[] = {1, 2, 7, 50};
+    for (int d=0; d<2; ++d) {
+        const std::vector<double>& data = d ? digitized : myrand;
+        for (int w=0; w<4; ++w) {
+            std::size_t width = widths[w];
+            Vector_double running = stfnum::running_median(data, 100, 299, width);
+            ASSERT_EQ(200u, running.size());
+            for (std::size_t i=100; i<300; ++i) {
+                std::size_t start = std::max<long>(100, (long)i-(long)(width-1)/2);
+                std::size_t end = std::min<std::size_t>(299, i+width/2) + 1;
+                std::vector<double> sorted(data.begin()+start, data.begin()+end);
+                std::sort(sorted.begin(), sorted.end());
+                std::size_t n = sorted.size();
+                EXPECT_EQ((sorted[(n-1)/2] + sorted[n/2]) / 2, running[i-100]);
+            }
+        }
+    }
+
+    EXPECT_THROW(stfnum::running_median(myrand, 0, N_MAX, 3), std::out_of_range);
+    EXPECT_THROW(stfnum::running_median(myrand, 0, 10, 0), std::out_of_range);
+}
+
+//=========================================================================
+// the running median follows a drifting baseline
+//=========================================================================
+TEST(measlib_test, baseline_drift) {
+
+    std::vector<double> noise = norm(0.0, 0.1);
+    std::vector<double> data(N_MAX);
+    for (int i=0; i<N_MAX; ++i)
+        data[i] = 0.01*i + noise[i];
+
+    double var_median = 0, var_running = 0;
+    double median = stfnum::base(stfnum::median_iqr, var_median, data, 0, N_MAX-1);
+    double running = stfnum::base(stfnum::median_running, var_running, data, 0, N_MAX-1);
+    EXPECT_NEAR(median, 0.01*N_MAX/2, 0.1);
+    /* the running median ends close to the last point */
+    EXPECT_NEAR(running, 0.01*(N_MAX-1), 0.5);
+    /* IQR of the noise (1.35 s.d.), without the drift */
+    EXPECT_NEAR(var_running, 0.135, 0.03);
+    EXPECT_GT(var_median, 1.0);
+}
+
 //=========================================================================
 // test baseline out of range 
 //=========================================================================
@@ -319,6 +395,97 @@ TEST(measlib_test, peak_random) {
     
     
 }
+//=========================================================================
+// The original peak search, which averages pM points for every candidate
+//=========================================================================
+double peak_reference(const std::vector<double>& data, double base, std::size_t llp,
+                      std::size_t ulp, int pM, stfnum::direction dir, double& maxT){
+    double max=data[llp];
+    maxT=(double)llp;
+    for (std::size_t i=llp+1; i <=ulp; i++) {
+        double peak=0.0;
+        int counter = 0;
+        int start = i-(pM-1)/2;
+        if (start < 0)
+            start = 0;
+        for (counter=start; counter <= start+pM-1 && counter < (int)data.size(); counter++)
+            peak+=data[counter];
+        peak /= (counter-start);
+        if ((dir == stfnum::both && fabs(peak-base) > fabs(max-base)) ||
+            (dir == stfnum::up && peak-base > max-base) ||
+            (dir == stfnum::down && peak-base < max-base)) {
+            max = peak;
+            maxT = (double)i;
+        }
+    }
+    return max;
+}
+
+//=========================================================================
+// Running sums give the same peak as the original search
+//=========================================================================
+TEST(measlib_test, peak_running_mean) {
+    std::vector<double> mywave = norm(0.0, 1.0);
+    // a plateau, a spike and large values to make rounding errors matter:
+    for (int i=400; i<450; ++i)
+        mywave[i] = 3.0;
+    mywave[700] = 1e6;
+    mywave[701] = -1e6;
+
+    stfnum::direction dirs[] = {stfnum::up, stfnum::down, stfnum::both};
+    int pMs[] = {1, 2, 3, 10, 51, 200};
+    for (int d=0; d<3; ++d) {
+        for (int p=0; p<6; ++p) {
+            double maxT, refT;
+            double peak = stfnum::peak(mywave, 0.1, 5, N_MAX-1, pMs[p], dirs[d], maxT);
+            double ref = peak_reference(mywave, 0.1, 5, N_MAX-1, pMs[p], dirs[d], refT);
+            EXPECT_EQ(ref, peak);
+            EXPECT_EQ(refT, maxT);
+        }
+    }
+
+    // a NaN is skipped like in the original search:
+    mywave[300] = NAN;
+    double maxT, refT;
+    double peak = stfnum::peak(mywave, 0.0, 0, 600, 10, stfnum::up, maxT);
+    double ref = peak_reference(mywave, 0.0, 0, 600, 10, stfnum::up, refT);
+    EXPECT_EQ(ref, peak);
+    EXPECT_EQ(refT, maxT);
+}
+
+//=========================================================================
+// The single pass over the peak window gives the same results as
+// the separate measurements
+//=========================================================================
+TEST(measlib_test, scan_peak) {
+    std::vector<double> mywave = sinwave(long(2*PI/dt));
+    std::vector<double> noise = norm(0.0, 0.01);
+    for (std::size_t i=0; i<mywave.size(); ++i)
+        mywave[i] += noise[i % noise.size()];
+
+    int pMs[] = {-1, 1, 5};
+    for (int p=0; p<3; ++p) {
+        stfnum::PeakScan scan = stfnum::scan_peak(mywave, 0.0, 10, mywave.size()-10,
+                                                  pMs[p], stfnum::up, 0.01, 3);
+        double maxT, thrT, maxRiseT, maxRiseY=NAN;
+        double peak = stfnum::peak(mywave, 0.0, 10, mywave.size()-10, pMs[p], stfnum::up, maxT);
+        double thr = stfnum::threshold(mywave, 10, mywave.size()-10, 0.01, thrT, 3);
+        double rise = stfnum::maxRise(mywave, 10, maxT, maxRiseT, maxRiseY, 3);
+        EXPECT_EQ(peak, scan.peak);
+        EXPECT_EQ(maxT, scan.maxT);
+        EXPECT_EQ(thr, scan.threshold);
+        EXPECT_EQ(thrT, scan.thrT);
+        EXPECT_EQ(rise, scan.maxRise);
+        EXPECT_EQ(maxRiseT, scan.maxRiseT);
+        EXPECT_EQ(maxRiseY, scan.maxRiseY);
+    }
+
+    // out of range:
+    stfnum::PeakScan scan = stfnum::scan_peak(mywave, 0.0, 10, mywave.size(), 1, stfnum::up, 0.01, 3);
+    EXPECT_TRUE(isnan(scan.peak));
+    EXPECT_TRUE(isnan(scan.maxT));
+}
+
 //=========================================================================
 // test threshold 
 //=========================================================================
@@ -874,3 +1041,106 @@ TEST(measlib_validation, threshold) {
     
 
 }
+
+//=========================================================================
+// test the measurement of a complete event
+//=========================================================================
+TEST(measlib_test, measure_event){
+
+    /* a baseline of 1.0 followed by a sine wave between 0 and PI */
+    std::size_t n_base = 100;
+    std::vector<double> mysin = sinwave( long(PI/dt) );
+    std::vector<double> mywave(n_base, 1.0);
+    for (std::size_t i=0; i<mysin.size(); i++)
+        mywave.push_back(1.0+mysin[i]);
+    mywave.resize(mywave.size()+n_base, 1.0);
+
+    stfnum::MeasureSpec spec;
+    spec.baseBeg = 0;
+    spec.baseEnd = n_base-1;
+    spec.peakBeg = n_base;
+    spec.peakAtEnd = true;
+    stfnum::MeasureResult res = stfnum::measure(mywave, dt, spec);
+
+    EXPECT_NEAR(res.base, 1.0, 1e-12);
+    EXPECT_NEAR(res.baseSD, 0.0, 1e-12);
+    EXPECT_NEAR(res.peak, 2.0, 1e-3);
+    EXPECT_NEAR((res.maxT-n_base)*dt, PI/2, tol);
+
+    /* the same values as the single functions */
+    double risetime_xpted = std::asin(0.8) - std::asin(0.2);
+    EXPECT_NEAR(res.rtLoHi, risetime_xpted, fabs(risetime_xpted*tol));
+    double half_dur_xpted = std::asin(0.5)+std::asin(1.0);
+    EXPECT_NEAR(res.halfDuration, half_dur_xpted, fabs(half_dur_xpted*tol));
+    EXPECT_NEAR(res.maxRise, 1.0, 0.01);
+    EXPECT_NEAR(res.maxDecay, 1.0, 0.05);
+
+    /* latency from a manual cursor to the foot of the event */
+    spec.latencyBeg = 50;
+    res = stfnum::measure(mywave, dt, spec);
+    EXPECT_DOUBLE_EQ(res.latencyBeg, 50);
+    EXPECT_DOUBLE_EQ(res.latencyEnd, res.tLoReal-(res.tHiReal-res.tLoReal)/3.0);
+    EXPECT_DOUBLE_EQ(res.latency, res.latencyEnd-50);
+
+    /* cursors are clamped to the section */
+    spec.latencyBeg = -10;
+    res = stfnum::measure(mywave, dt, spec);
+    EXPECT_DOUBLE_EQ(res.latencyBeg, 0);
+
+    /* as for the single functions, cursors out of range give NaN */
+    spec.baseEnd = mywave.size();
+    res = stfnum::measure(mywave, dt, spec);
+    EXPECT_TRUE(isnan(res.base));
+
+    EXPECT_THROW(stfnum::measure(std::vector<double>(), dt, spec), std::out_of_range);
+}
+
+//=========================================================================
+// test measuring sections of a recording concurrently
+//=========================================================================
+TEST(measlib_test, measure_recording){
+
+    std::size_t n_sections = 64;
+    Recording rec(2, n_sections, 1000);
+    rec.SetXScale(dt);
+    for (std::size_t n_c=0; n_c<rec.size(); n_c++) {
+        for (std::size_t n_s=0; n_s<n_sections; n_s++) {
+            Vector_double& trace = rec[n_c][n_s].get_w();
+            for (std::size_t i=0; i<trace.size(); i++) {
+                /* a peak of height n_s at 300+n_s */
+                trace[i] = (n_c+1)*n_s*std::exp(-std::fabs((double)i-300.0-n_s)/20.0);
+            }
+        }
+    }
+    stfnum::MeasureSpec spec;
+    spec.baseBeg = 0;
+    spec.baseEnd = 99;
+    spec.peakBeg = 100;
+
+    std::vector<std::size_t> channels(2), sections;
+    channels[0] = 1; channels[1] = 0;
+    for (std::size_t n_s=0; n_s<n_sections; n_s+=2)
+        sections.push_back(n_s);
+    std::vector< std::vector<stfnum::MeasureResult> > res =
+        stfnum::measure(rec, channels, sections, spec, 1);
+
+    ASSERT_EQ(res.size(), channels.size());
+    for (std::size_t n_c=0; n_c<channels.size(); n_c++) {
+        ASSERT_EQ(res[n_c].size(), sections.size());
+        for (std::size_t n=0; n<sections.size(); n++) {
+            std::size_t n_s = sections[n];
+            stfnum::MeasureResult single = stfnum::measure(rec[channels[n_c]][n_s].get(), dt,
+                                                           spec, &rec[1][n_s].get());
+            EXPECT_DOUBLE_EQ(res[n_c][n].peak, single.peak);
+            EXPECT_DOUBLE_EQ(res[n_c][n].halfDuration, single.halfDuration);
+            EXPECT_DOUBLE_EQ(res[n_c][n].APMaxT, single.APMaxT);
+            EXPECT_NEAR(res[n_c][n].peak, (channels[n_c]+1)*n_s, 1e-9);
+            if (n_s > 0) {
+                EXPECT_DOUBLE_EQ(res[n_c][n].maxT, 300.0+n_s);
+            }
+        }
+    }
+
+    std::vector<std::size_t> bad(1, n_sections);
+    EXPECT_THROW(stfnum::measure(rec, channels, bad, spec), std::out_of_range);
+}
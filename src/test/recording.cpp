@@ -1,4 +1,7 @@
 #include "../libstfio/stfio.h"
+#include "../libstfio/tdms/tdmslib.h"
+#include <cstdio>
+#include <cstring>
 #include <gtest/gtest.h>
 
 TEST(Recording_test, constructors)
@@ -58,3 +61,248 @@ TEST(Recording_test, data_access)
     EXPECT_THROW( rec3[recsize-1].at(chsize), std::out_of_range );
     EXPECT_THROW( rec3[recsize-1][chsize-1].at(secsize), std::out_of_range );
 }
+
+TEST(Recording_test, average)
+{
+    // 5 sections whose data points are 0..4 plus an offset:
+    Channel ch(5, 1000);
+    for (std::size_t ns=0; ns < ch.size(); ++ns) {
+        for (std::size_t np=0; np < ch[ns].size(); ++np) {
+            ch[ns][np] = (double)ns + 0.001*np;
+        }
+    }
+    ch[4][500] = 1000.0; // outlier
+    Recording rec(ch);
+    rec.SetXScale(0.5);
+
+    std::vector<std::size_t> sections;
+    for (std::size_t ns=0; ns < ch.size(); ++ns) sections.push_back(ns);
+    std::vector<int> shift(sections.size(), 0);
+
+    Section avg(1000), sig(1000);
+    rec.MakeAverage(avg, sig, 0, sections, true, shift);
+    EXPECT_DOUBLE_EQ( avg.GetXScale(), 0.5 );
+    EXPECT_NEAR( avg[10], 2.0 + 0.01, 1e-12 );
+    EXPECT_NEAR( sig[10], sqrt(2.5), 1e-12 );
+    EXPECT_NEAR( avg[500], (0+1+2+3+1000)/5.0 + 0.4, 1e-9 );
+
+    // shifted by one data point:
+    Section avg_s(999), sig_s(999);
+    std::vector<int> shift1(sections.size(), 1);
+    rec.MakeAverage(avg_s, sig_s, 0, sections, false, shift1);
+    EXPECT_NEAR( avg_s[9], avg[10], 1e-12 );
+
+    // weights:
+    Vector_double weights(sections.size(), 0.0);
+    weights[1] = 1.0;
+    weights[3] = 3.0;
+    rec.MakeAverage(avg, sig, 0, sections, true, shift, stfio::average_weighted, weights);
+    EXPECT_NEAR( avg[0], (1.0*1 + 3.0*3)/4.0, 1e-12 );
+    // reliability weights: sum(w*(x-mean)^2) / (V1 - V2/V1)
+    EXPECT_NEAR( sig[0], sqrt((1.0*1.5*1.5 + 3.0*0.5*0.5)/(4.0 - 10.0/4.0)), 1e-12 );
+    EXPECT_THROW( rec.MakeAverage(avg, sig, 0, sections, true, shift, stfio::average_weighted, Vector_double(2, 1.0)),
+                  std::out_of_range );
+
+    // the median ignores the outlier:
+    rec.MakeAverage(avg, sig, 0, sections, true, shift, stfio::average_median);
+    EXPECT_NEAR( avg[500], 2.5, 1e-12 );
+    EXPECT_NEAR( sig[500], 1.4826, 1e-12 );
+    sections.pop_back();
+    shift.pop_back();
+    rec.MakeAverage(avg, sig, 0, sections, false, shift, stfio::average_median);
+    EXPECT_NEAR( avg[0], 1.5, 1e-12 );
+
+    EXPECT_THROW( rec.MakeAverage(avg, sig, 1, sections, false, shift), std::out_of_range );
+    EXPECT_THROW( rec.MakeAverage(avg, sig, 0, std::vector<std::size_t>(), false, std::vector<int>()),
+                  std::out_of_range );
+}
+
+TEST(Recording_test, trace_arithmetic)
+{
+    // more data points than a block of TraceOps:
+    std::size_t n_points = 3*stfio::TraceOps::block_size + 7;
+    Channel ch(6, n_points);
+    for (std::size_t ns=0; ns < ch.size(); ++ns) {
+        for (std::size_t np=0; np < ch[ns].size(); ++np) {
+            ch[ns][np] = (double)ns + 0.001*np;
+        }
+    }
+    ch.SetYUnits("pA");
+    Recording rec(ch);
+
+    // a fused chain gives the same result as one operation after another:
+    Vector_double x(ch[2].get());
+    Vector_double expected = stfio::vec_scal_div(stfio::vec_scal_mul(stfio::vec_scal_minus(x, 0.3), 1.7), 3.0);
+    stfio::TraceOps ops;
+    ops.minus(0.3).mul(1.7).div(3.0);
+    EXPECT_EQ( ops.size(), 3 );
+    ops.apply(x);
+    for (std::size_t np=0; np < n_points; ++np) {
+        EXPECT_EQ( x[np], expected[np] );
+    }
+
+    std::vector<std::size_t> sections(2);
+    sections[0] = 1;
+    sections[1] = 4;
+    Recording mult = stfio::multiply(rec, sections, 0, 2.0);
+    EXPECT_EQ( mult[0].size(), 2 );
+    EXPECT_EQ( mult[0].GetYUnits(), "pA" );
+    EXPECT_DOUBLE_EQ( mult[0][1][n_points-1], 2.0*(4.0 + 0.001*(n_points-1)) );
+
+    Vector_double base(2);
+    base[0] = 1.0;
+    base[1] = 4.0;
+    Recording sub = stfio::subtract_base(rec, sections, 0, base);
+    EXPECT_NEAR( sub[0][0][10], 0.01, 1e-12 );
+    EXPECT_NEAR( sub[0][1][2000], 2.0, 1e-12 );
+    EXPECT_THROW( stfio::subtract_base(rec, sections, 0, Vector_double(1)), std::out_of_range );
+
+    // 2 groups of a test pulse and 2 leak pulses:
+    Recording pon = stfio::p_over_n(rec, 0, 2, -1);
+    EXPECT_EQ( pon[0].size(), 2 );
+    EXPECT_NEAR( pon[0][0][100], (0.0+0.1) + (1.0+0.1) + (2.0+0.1), 1e-12 );
+    EXPECT_NEAR( pon[0][1][100], (3.0+0.1) + (4.0+0.1) + (5.0+0.1), 1e-12 );
+    pon = stfio::p_over_n(rec, 0, 1, 1);
+    EXPECT_EQ( pon[0].size(), 3 );
+    EXPECT_NEAR( pon[0][2][100], -1.0, 1e-12 );
+
+    EXPECT_THROW( stfio::p_over_n(rec, 0, 6, 1), std::runtime_error );
+    EXPECT_THROW( stfio::multiply(rec, sections, 1, 2.0), std::out_of_range );
+}
+
+TEST(Recording_test, concatenate)
+{
+    Channel ch(3, 50);
+    for (std::size_t ns=0; ns < ch.size(); ++ns) {
+        for (std::size_t np=0; np < ch[ns].size(); ++np) {
+            ch[ns][np] = 100.0*ns + np;
+        }
+    }
+    ch.SetChannelName("Vm");
+    Recording rec(ch);
+    rec.SetXScale(0.1);
+
+    std::vector<std::size_t> sections(2);
+    sections[0] = 2;
+    sections[1] = 0;
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Recording conc = stfio::concatenate(rec, sections, progDlg);
+    ASSERT_EQ( conc[0].size(), 1 );
+    const Section& sec = conc[0][0];
+    EXPECT_EQ( sec.size(), 100 );
+    EXPECT_EQ( conc[0].GetChannelName(), "Vm" );
+    EXPECT_DOUBLE_EQ( sec.GetXScale(), 0.1 );
+    EXPECT_DOUBLE_EQ( sec[0], 200.0 );
+    EXPECT_DOUBLE_EQ( sec[50], 0.0 );
+    EXPECT_DOUBLE_EQ( sec[99], 49.0 );
+
+    // the source can be changed or destroyed without changing the concatenation:
+    rec[0][0][0] = -1.0;
+    rec.resize(0);
+    EXPECT_DOUBLE_EQ( sec[50], 0.0 );
+    EXPECT_DOUBLE_EQ( sec.get()[49], 249.0 );
+}
+
+// Appends a value in little- or big-endian byte order:
+template <typename T>
+static void append(std::string& buf, T value, bool big_endian=false) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    const unsigned short one = 1;
+    if (big_endian == (*(const char*)&one == 1)) {
+        std::reverse(bytes, bytes+sizeof(T));
+    }
+    buf.append(bytes, sizeof(T));
+}
+
+static void appendString(std::string& buf, const std::string& str) {
+    append<unsigned int>(buf, (unsigned int)str.size());
+    buf += str;
+}
+
+static void appendSegment(std::string& file, unsigned int toc, const std::string& meta,
+                          const std::string& raw, bool big_endian=false) {
+    file += "TDSm";
+    append<unsigned int>(file, toc);
+    append<unsigned int>(file, 4713, big_endian);
+    append<unsigned long long>(file, meta.size()+raw.size(), big_endian);
+    append<unsigned long long>(file, meta.size(), big_endian);
+    file += meta + raw;
+}
+
+TEST(Recording_test, import_tdms)
+{
+    // two channels with 3 values per chunk: int16 a=n and double b=n/2
+    std::string meta;
+    append<unsigned int>(meta, 3);
+    appendString(meta, "/");
+    append<unsigned int>(meta, 0xFFFFFFFF);
+    append<unsigned int>(meta, 1);
+    appendString(meta, "Sampling Rate");
+    append<unsigned int>(meta, 0x0A);
+    append<double>(meta, 20000.0);
+    const char* paths[] = {"/'Untitled'/'a'", "/'Untitled'/'b'"};
+    const unsigned int types[] = {0x02, 0x0A};
+    for (int nc=0; nc<2; ++nc) {
+        appendString(meta, paths[nc]);
+        append<unsigned int>(meta, 20);
+        append<unsigned int>(meta, types[nc]);
+        append<unsigned int>(meta, 1);
+        append<unsigned long long>(meta, 3);
+        append<unsigned int>(meta, nc == 0 ? 1 : 0);
+        if (nc == 0) {
+            appendString(meta, "unit_string");
+            append<unsigned int>(meta, 0x20);
+            appendString(meta, "mV");
+        }
+    }
+    std::string file, raw;
+    // two contiguous chunks:
+    for (int n=0; n<6; n+=3) {
+        for (int i=n; i<n+3; ++i) append<short>(raw, (short)i);
+        for (int i=n; i<n+3; ++i) append<double>(raw, 0.5*i);
+    }
+    appendSegment(file, (1<<1)|(1<<2)|(1<<3), meta, raw);
+    // the same layout, interleaved:
+    raw.clear();
+    for (int i=6; i<9; ++i) {
+        append<short>(raw, (short)i);
+        append<double>(raw, 0.5*i);
+    }
+    appendSegment(file, (1<<3)|(1<<5), "", raw);
+    // the same layout, big-endian:
+    raw.clear();
+    for (int i=9; i<12; ++i) append<short>(raw, (short)i, true);
+    for (int i=9; i<12; ++i) append<double>(raw, 0.5*i, true);
+    appendSegment(file, (1<<3)|(1<<6), "", raw, true);
+
+    const char* fName = "stfio_recording_test.tdms";
+    FILE* fh = fopen(fName, "wb");
+    ASSERT_TRUE( fh != NULL );
+    fwrite(file.data(), 1, file.size(), fh);
+    fclose(fh);
+
+    std::size_t threshold = stfio::GetMappingThreshold();
+    for (int mapped=0; mapped<2; ++mapped) {
+        // the second pass maps the file:
+        stfio::SetMappingThreshold(mapped ? 0 : threshold);
+        stfio::StdoutProgressInfo progDlg("", "", 100, false);
+        Recording rec;
+        stfio::importTDMSFile(fName, rec, progDlg);
+        ASSERT_EQ( rec.size(), 2 );
+        EXPECT_EQ( rec[0].GetChannelName(), "a" );
+        EXPECT_EQ( rec[0].GetYUnits(), "mV" );
+        EXPECT_DOUBLE_EQ( rec.GetXScale(), 0.05 );
+        for (std::size_t nc=0; nc<2; ++nc) {
+            ASSERT_EQ( rec[nc].size(), 1 );
+            const Section& sec = rec[nc][0];
+            EXPECT_EQ( sec.is_mapped(), mapped == 1 );
+            ASSERT_EQ( sec.size(), 12 );
+            for (std::size_t i=0; i<sec.size(); ++i) {
+                EXPECT_DOUBLE_EQ( sec[i], (nc == 0 ? 1.0 : 0.5)*i );
+            }
+        }
+    }
+    stfio::SetMappingThreshold(threshold);
+    remove(fName);
+}
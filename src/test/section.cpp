@@ -1,4 +1,5 @@
 #include "../libstfio/stfio.h"
+#include <cstdio>
 #include <gtest/gtest.h>
 
 TEST(Section_test, constructors) {
@@ -22,3 +23,236 @@ TEST(Section_test, data_access) {
     EXPECT_EQ( sec2[sec2.size()-1], 0 );
     EXPECT_THROW( sec2.at( sec2.size() ), std::out_of_range );
 }
+
+TEST(Section_test, mapped_access) {
+    // two multiplexed int16 channels:
+    std::vector<short> raw(2048);
+    for (std::size_t n=0; n<raw.size(); ++n) {
+        raw[n] = (short)(n%2==0 ? n/2 : -(int)(n/2));
+    }
+    const char* fName = "stfio_section_test.bin";
+    FILE* fh = fopen(fName, "wb");
+    ASSERT_TRUE( fh != NULL );
+    fwrite(&raw[0], sizeof(short), raw.size(), fh);
+    fclose(fh);
+
+    {
+        stfio::MappedFilePtr file(new stfio::MappedFile(fName));
+        EXPECT_EQ( file->size(), raw.size()*sizeof(short) );
+
+        stfio::RawSamples ch0(file, 0, 2*sizeof(short), raw.size()/2,
+                              stfio::sample_int16, false, 0.5, 1.0);
+        Section sec(ch0, "Mapped section");
+        EXPECT_TRUE( sec.is_mapped() );
+        EXPECT_EQ( sec.size(), raw.size()/2 );
+        const Section& csec = sec;
+        EXPECT_DOUBLE_EQ( csec[10], 10*0.5+1.0 );
+        EXPECT_DOUBLE_EQ( csec.at(1023), 1023*0.5+1.0 );
+        EXPECT_THROW( csec.at( csec.size() ), std::out_of_range );
+
+        Vector_double window = csec.get_window(100, 4);
+        ASSERT_EQ( window.size(), 4 );
+        EXPECT_DOUBLE_EQ( window[3], 103*0.5+1.0 );
+        EXPECT_THROW( csec.get_window(1020, 5), std::out_of_range );
+        EXPECT_DOUBLE_EQ( csec.get()[500], 500*0.5+1.0 );
+        double min = 0, max = 0;
+        csec.minmax(0, csec.size(), min, max);
+        EXPECT_DOUBLE_EQ( min, 1.0 );
+        EXPECT_DOUBLE_EQ( max, 1023*0.5+1.0 );
+        EXPECT_TRUE( sec.is_mapped() );
+
+        stfio::RawSamples ch1(file, sizeof(short), 2*sizeof(short), raw.size()/2,
+                              stfio::sample_int16);
+        Section sec1(ch1);
+        EXPECT_DOUBLE_EQ( sec1.get_window(7, 1)[0], -7.0 );
+
+        // write access copies the samples into memory:
+        sec[0] = 42.0;
+        EXPECT_FALSE( sec.is_mapped() );
+        EXPECT_EQ( sec.size(), raw.size()/2 );
+        EXPECT_DOUBLE_EQ( sec[0], 42.0 );
+        EXPECT_DOUBLE_EQ( sec[1023], 1023*0.5+1.0 );
+
+        EXPECT_THROW( stfio::RawSamples(file, 0, sizeof(short), raw.size()+1, stfio::sample_int16),
+                      std::out_of_range );
+    }
+    remove(fName);
+}
+
+// memory that is owned by the test rather than mapped from a file:
+class BufferFile : public stfio::MappedFile {
+public:
+    explicit BufferFile(const Vector_double& buf)
+        : stfio::MappedFile((const char*)&buf[0], buf.size()*sizeof(double)) {}
+};
+
+TEST(Section_test, external_buffer) {
+    Vector_double buf(100);
+    for (std::size_t n=0; n<buf.size(); ++n) {
+        buf[n] = (double)n;
+    }
+    stfio::MappedFilePtr file(new BufferFile(buf));
+    Section sec(stfio::RawSamples(file, 0, sizeof(double), buf.size(), stfio::sample_float64));
+    const Section& csec = sec;
+    EXPECT_DOUBLE_EQ( csec[42], 42.0 );
+    ASSERT_TRUE( csec.get_mapped() );
+    EXPECT_EQ( csec.get_mapped()->get_raw().file->data(), (const char*)&buf[0] );
+
+    // changes to the buffer are seen until the section is written to:
+    buf[42] = -1.0;
+    EXPECT_DOUBLE_EQ( csec[42], -1.0 );
+    stfio::MappedSamplesPtr mapped = csec.get_mapped();
+    sec[0] = 5.0;
+    EXPECT_FALSE( sec.is_mapped() );
+    buf[42] = 42.0;
+    EXPECT_DOUBLE_EQ( csec[42], -1.0 );
+    EXPECT_DOUBLE_EQ( buf[0], 0.0 );
+    // the samples stay available to holders of the pointer:
+    EXPECT_DOUBLE_EQ( mapped->get_raw().value(42), 42.0 );
+}
+
+TEST(Section_test, converted_copy) {
+    Vector_double buf(100);
+    for (std::size_t n=0; n<buf.size(); ++n) {
+        buf[n] = (double)n;
+    }
+    stfio::MappedFilePtr file(new BufferFile(buf));
+    Section sec(stfio::RawSamples(file, 0, sizeof(double), buf.size(), stfio::sample_float64));
+    const Section& csec = sec;
+
+    // holders of the converted copy share it; it is freed by the last one:
+    stfio::SharedSamplesPtr shared = csec.get_shared();
+    EXPECT_EQ( csec.get_shared(), shared );
+    EXPECT_EQ( &csec.get(), shared.get() );
+    EXPECT_DOUBLE_EQ( (*shared)[42], 42.0 );
+#if (__cplusplus < 201103)
+    boost::weak_ptr<Vector_double> weak(shared);
+#else
+    std::weak_ptr<Vector_double> weak(shared);
+#endif
+    shared.reset();
+    EXPECT_FALSE( weak.expired() );
+    sec.release();
+    EXPECT_TRUE( weak.expired() );
+    EXPECT_TRUE( sec.is_mapped() );
+
+    // write access takes over the copy that get() made:
+    const double* values = &csec.get()[0];
+    sec[0] = 5.0;
+    EXPECT_FALSE( sec.is_mapped() );
+    EXPECT_EQ( &csec.get()[0], values );
+    EXPECT_DOUBLE_EQ( buf[0], 0.0 );
+
+    // a copy that is held elsewhere is copied before write access:
+    Section other(stfio::RawSamples(file, 0, sizeof(double), buf.size(), stfio::sample_float64));
+    shared = other.get_shared();
+    other[0] = 5.0;
+    EXPECT_NE( &other.get()[0], &(*shared)[0] );
+    EXPECT_DOUBLE_EQ( (*shared)[0], 0.0 );
+}
+
+TEST(Section_test, minmax) {
+    // a pseudo-random trace whose length isn't a multiple of the block size:
+    Vector_double data(10000+37);
+    unsigned int seed = 1;
+    for (std::size_t n=0; n<data.size(); ++n) {
+        seed = seed*1103515245u + 12345u;
+        data[n] = (double)((seed >> 16) % 20001) - 10000.0;
+    }
+    Section sec(data);
+    const Section& csec = sec;
+
+    std::size_t ranges[][2] = { {0, data.size()}, {0, 1}, {5, 130}, {63, 64}, {64, 128},
+                                {1, data.size()-1}, {777, 9001}, {4096, 8192}, {9999, 10037} };
+    for (std::size_t nr=0; nr<sizeof(ranges)/sizeof(ranges[0]); ++nr) {
+        std::size_t start = ranges[nr][0], end = ranges[nr][1];
+        double min = 0, max = 0;
+        csec.minmax(start, end, min, max);
+        EXPECT_DOUBLE_EQ( min, *std::min_element(data.begin()+start, data.begin()+end) );
+        EXPECT_DOUBLE_EQ( max, *std::max_element(data.begin()+start, data.begin()+end) );
+    }
+    double min = 0, max = 0;
+    EXPECT_THROW( csec.minmax(10, 10, min, max), std::out_of_range );
+    EXPECT_THROW( csec.minmax(0, data.size()+1, min, max), std::out_of_range );
+
+    // write access drops the envelope:
+    sec[5000] = 1.0e6;
+    csec.minmax(0, data.size(), min, max);
+    EXPECT_DOUBLE_EQ( max, 1.0e6 );
+    sec.get_w()[6000] = -1.0e6;
+    csec.minmax(4000, 7000, min, max);
+    EXPECT_DOUBLE_EQ( min, -1.0e6 );
+}
+
+TEST(Section_test, copy_on_write) {
+    Section sec(Vector_double(1000, 1.0));
+    const Section& csec = sec;
+    Section copy(sec);
+    const Section& ccopy = copy;
+    // copies share the data points until one of them is written to:
+    EXPECT_EQ( &csec.get()[0], &ccopy.get()[0] );
+    copy[10] = 2.0;
+    EXPECT_NE( &csec.get()[0], &ccopy.get()[0] );
+    EXPECT_DOUBLE_EQ( csec[10], 1.0 );
+    EXPECT_DOUBLE_EQ( ccopy[10], 2.0 );
+
+    // the last owner writes in place:
+    const double* data = &csec.get()[0];
+    sec[10] = 3.0;
+    EXPECT_EQ( &csec.get()[0], data );
+
+    // sections of a new channel share one buffer until they are filled:
+    Channel ch(3, 100);
+    ch[1][0] = 1.0;
+    EXPECT_DOUBLE_EQ( ch[0][0], 0.0 );
+    EXPECT_DOUBLE_EQ( ch[2][0], 0.0 );
+
+    // a section that has been moved from is empty:
+    Section moved(std::move(copy));
+    EXPECT_EQ( copy.size(), 0 );
+    EXPECT_TRUE( copy.get().empty() );
+    copy.resize(5);
+    EXPECT_EQ( copy.size(), 5 );
+}
+
+TEST(Section_test, parts) {
+    Vector_double first(100), second(200);
+    for (std::size_t n=0; n<first.size(); ++n) {
+        first[n] = (double)n;
+    }
+    for (std::size_t n=0; n<second.size(); ++n) {
+        second[n] = 1000.0 + n;
+    }
+    Section sec1(first), sec2(second);
+
+    std::vector<stfio::RawSamples> parts(sec1.get_parts());
+    std::vector<stfio::RawSamples> parts2(sec2.get_parts());
+    parts.insert(parts.end(), parts2.begin(), parts2.end());
+    // empty sections don't add a part:
+    EXPECT_TRUE( Section().get_parts().empty() );
+    Section view(parts);
+    const Section& cview = view;
+    ASSERT_EQ( cview.size(), 300 );
+    EXPECT_TRUE( cview.is_mapped() );
+    EXPECT_FALSE( cview.get_mapped()->contiguous() );
+    EXPECT_DOUBLE_EQ( cview[99], 99.0 );
+    EXPECT_DOUBLE_EQ( cview[100], 1000.0 );
+    EXPECT_DOUBLE_EQ( cview[299], 1199.0 );
+    Vector_double window = cview.get_window(95, 10);
+    EXPECT_DOUBLE_EQ( window[4], 99.0 );
+    EXPECT_DOUBLE_EQ( window[5], 1000.0 );
+    EXPECT_THROW( cview.get_window(295, 10), std::out_of_range );
+    double min = 0, max = 0;
+    cview.minmax(0, cview.size(), min, max);
+    EXPECT_DOUBLE_EQ( min, 0.0 );
+    EXPECT_DOUBLE_EQ( max, 1199.0 );
+
+    // writing to a source section doesn't change the view:
+    sec1[0] = -5.0;
+    EXPECT_DOUBLE_EQ( cview[0], 0.0 );
+    // writing to the view copies the data points:
+    view[100] = -1.0;
+    EXPECT_FALSE( view.is_mapped() );
+    EXPECT_DOUBLE_EQ( cview[99], 99.0 );
+    EXPECT_DOUBLE_EQ( sec2[0], 1000.0 );
+}
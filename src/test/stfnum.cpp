@@ -0,0 +1,173 @@
+#include "../stimfit/stf.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+
+const static double tol = 1e-8; /* relative tolerance */
+
+//=========================================================================
+// Data with events: an alpha-like template added at a few positions
+// on top of a noisy baseline with an offset
+//=========================================================================
+Vector_double event_template(std::size_t size){
+    Vector_double templ(size);
+    for (std::size_t n=0; n < size; ++n){
+        double x = (double)n/(size/5.0);
+        templ[n] = -x*exp(1-x);
+    }
+    return templ;
+}
+
+Vector_double event_data(const Vector_double& templ, std::size_t size){
+    srand(42);
+    Vector_double data(size);
+    for (std::size_t n=0; n < size; ++n){
+        data[n] = -65.0 + 0.1*((double)rand()/RAND_MAX - 0.5);
+    }
+    for (std::size_t n_ev = 500; n_ev+templ.size() < size; n_ev += 1700){
+        for (std::size_t n=0; n < templ.size(); ++n){
+            data[n_ev+n] += 2.0*templ[n];
+        }
+    }
+    return data;
+}
+
+//=========================================================================
+// Direct O(N*M) reference implementations
+//=========================================================================
+Vector_double direct_dot(const Vector_double& data, const Vector_double& templ){
+    Vector_double dot(data.size()-templ.size());
+    for (std::size_t n=0; n < dot.size(); ++n){
+        for (std::size_t k=0; k < templ.size(); ++k){
+            dot[n] += templ[k]*data[n+k];
+        }
+    }
+    return dot;
+}
+
+Vector_double direct_criterion(const Vector_double& data, const Vector_double& templ){
+    std::size_t M = templ.size();
+    Vector_double crit(data.size()-M);
+    for (std::size_t n=0; n < crit.size(); ++n){
+        double st=0, stt=0, sd=0, std_=0;
+        for (std::size_t k=0; k < M; ++k){
+            st += templ[k]; stt += templ[k]*templ[k];
+            sd += data[n+k]; std_ += templ[k]*data[n+k];
+        }
+        double scale = (std_-st*sd/M)/(stt-st*st/M);
+        double offset = (sd-scale*st)/M;
+        double sse = 0;
+        for (std::size_t k=0; k < M; ++k){
+            double e = data[n+k]-(scale*templ[k]+offset);
+            sse += e*e;
+        }
+        crit[n] = scale/sqrt(sse/(M-1));
+    }
+    return crit;
+}
+
+Vector_double direct_corr(const Vector_double& data, const Vector_double& templ){
+    std::size_t M = templ.size();
+    Vector_double corr(data.size()-M);
+    for (std::size_t n=0; n < corr.size(); ++n){
+        double st=0, stt=0, sd=0, std_=0;
+        for (std::size_t k=0; k < M; ++k){
+            st += templ[k]; stt += templ[k]*templ[k];
+            sd += data[n+k]; std_ += templ[k]*data[n+k];
+        }
+        /* correlate with the optimally scaled template */
+        double scale = (std_-st*sd/M)/(stt-st*st/M);
+        double offset = (sd-scale*st)/M;
+        double md = sd/M, mo = (st*scale+offset*M)/M;
+        double sdd=0, soo=0, r=0;
+        for (std::size_t k=0; k < M; ++k){
+            sdd += (data[n+k]-md)*(data[n+k]-md);
+            soo += (templ[k]*scale+offset-mo)*(templ[k]*scale+offset-mo);
+            r += (data[n+k]-md)*(templ[k]*scale+offset-mo);
+        }
+        /* as in Stimfit: s.d.s normalised by M, covariance by M-1 */
+        corr[n] = r/((M-1)*sqrt(sdd/M)*sqrt(soo/M));
+    }
+    return corr;
+}
+
+TEST(Stfnum_test, sliding_dot_product) {
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double templ(event_template(100));
+    Vector_double data(event_data(templ, 5000));
+
+    Vector_double dot(stfnum::slidingDotProduct(data, templ, progDlg));
+    Vector_double ref(direct_dot(data, templ));
+    ASSERT_EQ( dot.size(), ref.size() );
+    for (std::size_t n=0; n < ref.size(); ++n){
+        EXPECT_NEAR( dot[n], ref[n], fabs(ref[n])*tol );
+    }
+
+    EXPECT_THROW( stfnum::slidingDotProduct(templ, data, progDlg), std::runtime_error );
+}
+
+TEST(Stfnum_test, detection_criterion) {
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double templ(event_template(100));
+    Vector_double data(event_data(templ, 5000));
+
+    Vector_double crit(stfnum::detectionCriterion(data, templ, progDlg));
+    Vector_double ref(direct_criterion(data, templ));
+    ASSERT_EQ( crit.size(), ref.size() );
+    for (std::size_t n=0; n < ref.size(); ++n){
+        EXPECT_NEAR( crit[n], ref[n], std::max(fabs(ref[n]), 1.0)*1e-6 );
+    }
+}
+
+TEST(Stfnum_test, linear_correlation) {
+    stfio::StdoutProgressInfo progDlg("", "", 100, false);
+    Vector_double templ(event_template(100));
+    Vector_double data(event_data(templ, 5000));
+
+    Vector_double corr(stfnum::linCorr(data, templ, progDlg));
+    Vector_double ref(direct_corr(data, templ));
+    ASSERT_EQ( corr.size(), ref.size() );
+    for (std::size_t n=0; n < ref.size(); ++n){
+        EXPECT_NEAR( corr[n], ref[n], 1e-6 );
+    }
+    /* a perfectly matching event must be detected at its onset */
+    EXPECT_NEAR( corr[500], 1.0, 1e-2 );
+}
+
+TEST(Stfnum_test, filter_sections) {
+    Vector_double templ(event_template(100));
+    std::deque<Section> sec_list;
+    for (int n_s=0; n_s < 4; ++n_s) {
+        Vector_double data(event_data(templ, 2000));
+        for (std::size_t n=0; n < data.size(); ++n) {
+            data[n] += n_s*sin(n/50.0);
+        }
+        sec_list.push_back(Section(data));
+    }
+    Recording rec((Channel(sec_list)));
+    Vector_double a(1, 0.5); /* cutoff frequency */
+    int SR = 10;
+
+    std::vector<std::size_t> sections;
+    sections.push_back(3);
+    sections.push_back(0);
+    sections.push_back(2);
+    std::vector<Vector_double> filtered(stfnum::filter(rec, 0, sections, 100, 1899,
+                                                       a, SR, stfnum::fgaussColqu));
+    ASSERT_EQ( filtered.size(), sections.size() );
+    for (std::size_t n_s=0; n_s < sections.size(); ++n_s) {
+        /* the same as filtering every section on its own */
+        Vector_double ref(stfnum::filter(rec[0][sections[n_s]].get(), 100, 1899,
+                                         a, SR, stfnum::fgaussColqu));
+        ASSERT_EQ( filtered[n_s].size(), ref.size() );
+        for (std::size_t n=0; n < ref.size(); ++n) {
+            EXPECT_NEAR( filtered[n_s][n], ref[n], 1e-10 );
+        }
+    }
+
+    sections.push_back(4);
+    EXPECT_THROW( stfnum::filter(rec, 0, sections, 100, 1899, a, SR, stfnum::fgaussColqu),
+                  std::out_of_range );
+    EXPECT_THROW( stfnum::filter(rec, 1, sections, 100, 1899, a, SR, stfnum::fgaussColqu),
+                  std::out_of_range );
+}